@@ -0,0 +1,450 @@
+// Micro-benchmarks of instrumentation hot paths, dump and load.
+// Results are printed as CSV (or JSON) to catch overhead regressions between versions.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <easy/profiler.h>
+#include <easy/arbitrary_value.h>
+#include <easy/reader.h>
+#include <easy/statistics.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+struct Options
+{
+    uint32_t repetitions = 15;      ///< Measured repetitions of each benchmark
+    uint32_t warmup = 3;            ///< Not measured repetitions run before measured ones
+    uint32_t iterations = 100000;   ///< Operations per repetition
+    uint32_t maxThreads = 64;       ///< Max threads number for contention benchmark
+    uint32_t captureBlocks = 1000000; ///< Blocks number of synthetic capture for dump and load benchmarks
+    std::string filename = "easy_profiler_bench.prof";
+    bool json = false;
+};
+
+struct Result
+{
+    std::string name;
+    uint32_t threads;
+    const char* unit;
+    std::vector<double> samples;
+};
+
+using clock_type = std::chrono::steady_clock;
+
+static volatile uint32_t g_sink = 0;
+
+static double elapsed_ns(clock_type::time_point _begin, clock_type::time_point _end)
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(_end - _begin).count());
+}
+
+/** Drop all stored blocks to keep memory usage and storage state the same for each benchmark. */
+static void drop_capture(const Options& _options)
+{
+    profiler::dumpBlocksToFile(_options.filename.c_str());
+    std::remove(_options.filename.c_str());
+}
+
+/** Runs _body(iterations) warmup + repetitions times, _body returns measured value of one repetition. */
+static Result run(const Options& _options, const std::string& _name, uint32_t _threads, const char* _unit,
+                  const std::function<double(uint32_t)>& _body)
+{
+    Result result {_name, _threads, _unit, {}};
+    result.samples.reserve(_options.repetitions);
+
+    for (uint32_t i = 0; i < _options.warmup; ++i)
+        _body(_options.iterations);
+
+    for (uint32_t i = 0; i < _options.repetitions; ++i)
+        result.samples.push_back(_body(_options.iterations));
+
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Instrumentation hot paths
+
+static double block_pairs(uint32_t _iterations)
+{
+    EASY_BLOCK("Frame");
+    const auto begin = clock_type::now();
+    for (uint32_t i = 0; i < _iterations; ++i)
+    {
+        EASY_BLOCK("Block");
+    }
+    const auto end = clock_type::now();
+    return elapsed_ns(begin, end) / _iterations;
+}
+
+static double frame_pairs(uint32_t _iterations)
+{
+    const auto begin = clock_type::now();
+    for (uint32_t i = 0; i < _iterations; ++i)
+    {
+        EASY_BLOCK("Frame");
+    }
+    const auto end = clock_type::now();
+    return elapsed_ns(begin, end) / _iterations;
+}
+
+static double off_recursive_block_pairs(uint32_t _iterations)
+{
+    EASY_BLOCK("Frame", profiler::OFF_RECURSIVE);
+    const auto begin = clock_type::now();
+    for (uint32_t i = 0; i < _iterations; ++i)
+    {
+        EASY_BLOCK("Block");
+    }
+    const auto end = clock_type::now();
+    return elapsed_ns(begin, end) / _iterations;
+}
+
+static double nonscoped_block_pairs(uint32_t _iterations)
+{
+    EASY_BLOCK("Frame");
+    const auto begin = clock_type::now();
+    for (uint32_t i = 0; i < _iterations; ++i)
+    {
+        EASY_NONSCOPED_BLOCK("Nonscoped");
+        EASY_END_BLOCK;
+    }
+    const auto end = clock_type::now();
+    return elapsed_ns(begin, end) / _iterations;
+}
+
+static double values(uint32_t _iterations)
+{
+    EASY_BLOCK("Frame");
+    const auto begin = clock_type::now();
+    for (uint32_t i = 0; i < _iterations; ++i)
+    {
+        EASY_VALUE("Value", i);
+    }
+    const auto end = clock_type::now();
+    return elapsed_ns(begin, end) / _iterations;
+}
+
+static double arrays(uint32_t _iterations)
+{
+    EASY_CONSTEXPR uint32_t ArraySize = 16;
+    uint32_t data[ArraySize] = {};
+
+    EASY_BLOCK("Frame");
+    const auto begin = clock_type::now();
+    for (uint32_t i = 0; i < _iterations; ++i)
+    {
+        data[i % ArraySize] = i;
+        EASY_ARRAY("Array", data, ArraySize);
+    }
+    const auto end = clock_type::now();
+    return elapsed_ns(begin, end) / _iterations;
+}
+
+/** Average time of one block pair for each of _threads threads running simultaneously. */
+static double contended_block_pairs(uint32_t _threads, uint32_t _iterations)
+{
+    std::atomic<uint32_t> ready(0);
+    std::atomic_bool go(false);
+    std::vector<double> results(_threads, 0.);
+    std::vector<std::thread> threads;
+    threads.reserve(_threads);
+
+    for (uint32_t t = 0; t < _threads; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            ready.fetch_add(1, std::memory_order_acq_rel);
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            results[t] = block_pairs(_iterations);
+        });
+    }
+
+    while (ready.load(std::memory_order_acquire) != _threads)
+        std::this_thread::yield();
+    go.store(true, std::memory_order_release);
+
+    for (auto& thread : threads)
+        thread.join();
+
+    double sum = 0;
+    for (auto value : results)
+        sum += value;
+    return sum / _threads;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Dump and load
+
+static void make_capture(uint32_t _blocks)
+{
+    // Frames of 1 + 4 + 4 * 3 blocks
+    EASY_CONSTEXPR uint32_t FrameBlocks = 17;
+    for (uint32_t i = 0; i < _blocks; i += FrameBlocks)
+    {
+        EASY_BLOCK("Frame");
+        for (int j = 0; j < 4; ++j)
+        {
+            EASY_BLOCK("Task");
+            for (int k = 0; k < 3; ++k)
+            {
+                EASY_BLOCK("Job");
+                g_sink = g_sink + k;
+            }
+        }
+    }
+}
+
+static uint64_t file_size(const std::string& _filename)
+{
+    std::ifstream file(_filename, std::fstream::binary | std::fstream::ate);
+    return file.is_open() ? static_cast<uint64_t>(file.tellg()) : 0;
+}
+
+static double megabytes_per_second(uint64_t _bytes, double _ns)
+{
+    return _ns > 0 ? static_cast<double>(_bytes) * 1e9 / (_ns * 1024. * 1024.) : 0.;
+}
+
+static double dump(const Options& _options)
+{
+    profiler::setEnabled(true);
+    make_capture(_options.captureBlocks);
+    profiler::setEnabled(false);
+
+    const auto begin = clock_type::now();
+    profiler::dumpBlocksToFile(_options.filename.c_str());
+    const auto end = clock_type::now();
+
+    return megabytes_per_second(file_size(_options.filename), elapsed_ns(begin, end));
+}
+
+static double load(const std::string& _capture)
+{
+    std::atomic<int> progress(0);
+    std::istringstream stream(_capture);
+    profiler::BeginEndTime beginEndTime;
+    profiler::SerializedData serializedBlocks, serializedDescriptors;
+    profiler::descriptors_list_t descriptors;
+    profiler::blocks_t blocks;
+    profiler::thread_blocks_tree_t trees;
+    profiler::bookmarks_t bookmarks;
+    uint32_t descriptorsCount = 0, version = 0;
+    profiler::processid_t pid = 0;
+    std::ostringstream log;
+
+    const auto begin = clock_type::now();
+    const auto count = fillTreesFromStream(progress, stream, beginEndTime, serializedBlocks, serializedDescriptors,
+                                           descriptors, blocks, trees, bookmarks, descriptorsCount, version, pid,
+                                           true, false, log);
+    const auto end = clock_type::now();
+
+    if (count == 0)
+    {
+        std::cerr << "Can not load synthetic capture: " << log.str() << std::endl;
+        std::exit(1);
+    }
+
+    return megabytes_per_second(_capture.size(), elapsed_ns(begin, end));
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Output
+
+struct Statistics
+{
+    double min, median, mean, max, stddev;
+};
+
+static Statistics statistics(std::vector<double> _samples)
+{
+    Statistics s {0, 0, 0, 0, 0};
+    if (_samples.empty())
+        return s;
+
+    std::sort(_samples.begin(), _samples.end());
+    const auto n = _samples.size();
+
+    s.min = _samples.front();
+    s.max = _samples.back();
+    s.median = (n & 1) ? _samples[n / 2] : (_samples[n / 2 - 1] + _samples[n / 2]) * 0.5;
+
+    for (auto value : _samples)
+        s.mean += value;
+    s.mean /= n;
+
+    for (auto value : _samples)
+        s.stddev += (value - s.mean) * (value - s.mean);
+    s.stddev = n > 1 ? std::sqrt(s.stddev / (n - 1)) : 0.;
+
+    return s;
+}
+
+static void print(const Options& _options, const std::vector<Result>& _results)
+{
+    const auto version = profiler::versionName();
+    char buffer[512];
+
+    if (_options.json)
+    {
+        std::cout << "[\n";
+        for (size_t i = 0; i < _results.size(); ++i)
+        {
+            const auto& r = _results[i];
+            const auto s = statistics(r.samples);
+            snprintf(buffer, sizeof(buffer), "  {\"version\": \"%s\", \"benchmark\": \"%s\", \"threads\": %u, \"unit\": \"%s\", "
+                "\"repetitions\": %u, \"min\": %.3f, \"median\": %.3f, \"mean\": %.3f, \"max\": %.3f, \"stddev\": %.3f}%s\n",
+                version, r.name.c_str(), r.threads, r.unit, static_cast<unsigned>(r.samples.size()),
+                s.min, s.median, s.mean, s.max, s.stddev, i + 1 < _results.size() ? "," : "");
+            std::cout << buffer;
+        }
+        std::cout << "]" << std::endl;
+        return;
+    }
+
+    std::cout << "version,benchmark,threads,unit,repetitions,min,median,mean,max,stddev\n";
+    for (const auto& r : _results)
+    {
+        const auto s = statistics(r.samples);
+        snprintf(buffer, sizeof(buffer), "%s,%s,%u,%s,%u,%.3f,%.3f,%.3f,%.3f,%.3f\n", version, r.name.c_str(),
+                 r.threads, r.unit, static_cast<unsigned>(r.samples.size()), s.min, s.median, s.mean, s.max, s.stddev);
+        std::cout << buffer;
+    }
+    std::cout.flush();
+}
+
+static void usage(const char* _program)
+{
+    std::cout << "Usage: " << _program << " [options]\n"
+                 "  --repetitions N   measured repetitions of each benchmark (default 15)\n"
+                 "  --warmup N        warmup repetitions (default 3)\n"
+                 "  --iterations N    operations per repetition (default 100000)\n"
+                 "  --max-threads N   max threads number for contention benchmark (default 64)\n"
+                 "  --blocks N        blocks number of synthetic capture for dump/load (default 1000000)\n"
+                 "  --file PATH       temporary capture file (default easy_profiler_bench.prof)\n"
+                 "  --json            print results as JSON instead of CSV\n";
+}
+
+static bool parse(int argc, char* argv[], Options& _options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--json")
+            _options.json = true;
+        else if (arg == "--repetitions" && hasValue)
+            _options.repetitions = static_cast<uint32_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        else if (arg == "--warmup" && hasValue)
+            _options.warmup = static_cast<uint32_t>(std::max(0L, std::strtol(argv[++i], nullptr, 10)));
+        else if (arg == "--iterations" && hasValue)
+            _options.iterations = static_cast<uint32_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        else if (arg == "--max-threads" && hasValue)
+            _options.maxThreads = static_cast<uint32_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        else if (arg == "--blocks" && hasValue)
+            _options.captureBlocks = static_cast<uint32_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        else if (arg == "--file" && hasValue)
+            _options.filename = argv[++i];
+        else
+            return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<Result> results;
+    using namespace std::placeholders;
+
+    profiler::setEnabled(false);
+    results.push_back(run(options, "block_disabled", 1, "ns/op", block_pairs));
+
+    profiler::setEnabled(true);
+    results.push_back(run(options, "block_enabled", 1, "ns/op", block_pairs));
+    drop_capture(options);
+
+    profiler::setEnabled(true);
+    results.push_back(run(options, "frame_enabled", 1, "ns/op", frame_pairs));
+    drop_capture(options);
+
+    profiler::setEnabled(true);
+    results.push_back(run(options, "block_off_recursive", 1, "ns/op", off_recursive_block_pairs));
+    drop_capture(options);
+
+    profiler::setEnabled(true);
+    results.push_back(run(options, "nonscoped_block_enabled", 1, "ns/op", nonscoped_block_pairs));
+    drop_capture(options);
+
+    profiler::setStatisticsOnly(true);
+    profiler::setEnabled(true);
+    results.push_back(run(options, "block_statistics_only", 1, "ns/op", block_pairs));
+    profiler::setEnabled(false);
+    profiler::setStatisticsOnly(false);
+
+    profiler::setEnabled(true);
+    results.push_back(run(options, "value_enabled", 1, "ns/op", values));
+    drop_capture(options);
+
+    profiler::setEnabled(true);
+    results.push_back(run(options, "array16_enabled", 1, "ns/op", arrays));
+    drop_capture(options);
+
+    for (uint32_t threads = 1; threads <= options.maxThreads; threads *= 2)
+    {
+        // Keep total work the same for each threads number
+        Options contention = options;
+        contention.iterations = std::max(1000U, options.iterations / threads);
+        contention.warmup = std::min(options.warmup, 1U);
+
+        profiler::setEnabled(true);
+        results.push_back(run(contention, "block_enabled_contention", threads, "ns/op",
+                              std::bind(contended_block_pairs, threads, _1)));
+        drop_capture(options);
+    }
+
+    // Dump and load are much longer than hot path operations
+    Options capture = options;
+    capture.repetitions = std::min(options.repetitions, 5U);
+    capture.warmup = std::min(options.warmup, 1U);
+
+    results.push_back(run(capture, "dump", 1, "MB/s", [&options](uint32_t) { return dump(options); }));
+
+    std::string data;
+    {
+        std::ifstream file(options.filename, std::fstream::binary);
+        std::ostringstream content;
+        content << file.rdbuf();
+        data = content.str();
+    }
+    std::remove(options.filename.c_str());
+
+    results.push_back(run(capture, "load", 1, "MB/s", [&data](uint32_t) { return load(data); }));
+
+    print(options, results);
+
+    return 0;
+}
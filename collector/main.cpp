@@ -0,0 +1,51 @@
+///std
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <easy/reader.h>
+
+static std::atomic<bool> STOP(false);
+
+static void onSignal(int)
+{
+    STOP.store(true, std::memory_order_release);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || argv[1] == nullptr || argv[2] == nullptr)
+    {
+        std::cout << "Usage: " << argv[0] << " CAPTURE_DIRECTORY OUTPUT_PROF_FILE [INTERVAL_MS] [PART_SIZE_MB]\n"
+                                             "where:\n"
+                                             "CAPTURE_DIRECTORY (easy_capture_<pid> directory of a running process) // Required\n"
+                                             "OUTPUT_PROF_FILE (written when the process exits or on Ctrl+C) // Required\n"
+                                             "INTERVAL_MS (interval between collecting new frames, 100 by default) // Optional\n"
+                                             "PART_SIZE_MB (collected data is written and released each time it exceeds this size;\n"
+                                             "              parts are written into OUTPUT_PROF_FILE, <name>.1.prof, <name>.2.prof...;\n"
+                                             "              256 by default, 0 - keep everything in memory and write one file) // Optional\n";
+        return 1;
+    }
+
+    const uint32_t interval = argc > 3 && argv[3] ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 100;
+    const uint64_t partSize = (argc > 4 && argv[4] ? static_cast<uint64_t>(std::strtoull(argv[4], nullptr, 10)) : 256) << 20;
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    std::stringstream log;
+    const auto blocksNumber = collectCapture(argv[1], argv[2], interval, partSize, STOP, log);
+
+    const auto messages = log.str();
+    if (!messages.empty())
+        std::cerr << messages << std::endl;
+
+    if (blocksNumber == 0)
+        return 1;
+
+    std::cout << "Collected " << blocksNumber << " blocks into \"" << argv[2] << "\"\n";
+
+    return 0;
+}
@@ -68,9 +68,10 @@ profiler::block_index_t FileReader::readFile(const std::string& filename)
     uint32_t total_descriptors_number = 0;
 
     EASY_CONSTEXPR bool DoNotGatherStats = false;
+    EASY_CONSTEXPR bool DoNotCompensateOverhead = false;
     const auto blocks_number = ::fillTreesFromFile(filename.c_str(), beginEndTime, serialized_blocks, serialized_descriptors,
         descriptors, blocks, threaded_trees, bookmarks, total_descriptors_number, m_version, pid, DoNotGatherStats,
-        m_errorMessage);
+        DoNotCompensateOverhead, m_errorMessage);
 
     if (blocks_number == 0)
         return 0;
@@ -0,0 +1,153 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+/** Global operator new and operator delete replacements counting heap allocations of each thread.
+
+Linking easy_profiler_alloc_hooks library into an application enables allocation tracking
+(see profiler::setAllocationTracking()): bytes and number of allocations are attributed to the
+innermost opened block. When profiler is disabled each allocation costs only an increment
+of thread-local counters.
+
+Over-aligned allocations (C++17 operator new with std::align_val_t) are not counted.
+*/
+
+#include <easy/profiler.h>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+    struct AllocationTrackingEnabler
+    {
+        AllocationTrackingEnabler() { profiler::setAllocationTracking(true); }
+    };
+
+    AllocationTrackingEnabler ALLOCATION_TRACKING_ENABLER;
+
+    void* allocate(std::size_t _size)
+    {
+        profiler::trackAllocation(_size);
+
+        if (_size == 0)
+            _size = 1;
+
+        for (;;)
+        {
+            void* pointer = std::malloc(_size);
+            if (pointer != nullptr)
+                return pointer;
+
+            auto handler = std::get_new_handler();
+            if (handler == nullptr)
+                throw std::bad_alloc();
+
+            handler();
+        }
+    }
+
+    void* allocate(std::size_t _size, const std::nothrow_t&) EASY_NOEXCEPT
+    {
+        try
+        {
+            return allocate(_size);
+        }
+        catch (...)
+        {
+            return nullptr;
+        }
+    }
+
+} // END of namespace.
+
+//////////////////////////////////////////////////////////////////////////
+
+void* operator new(std::size_t _size)
+{
+    return allocate(_size);
+}
+
+void* operator new[](std::size_t _size)
+{
+    return allocate(_size);
+}
+
+void* operator new(std::size_t _size, const std::nothrow_t& _tag) EASY_NOEXCEPT
+{
+    return allocate(_size, _tag);
+}
+
+void* operator new[](std::size_t _size, const std::nothrow_t& _tag) EASY_NOEXCEPT
+{
+    return allocate(_size, _tag);
+}
+
+void operator delete(void* _pointer) EASY_NOEXCEPT
+{
+    std::free(_pointer);
+}
+
+void operator delete[](void* _pointer) EASY_NOEXCEPT
+{
+    std::free(_pointer);
+}
+
+void operator delete(void* _pointer, const std::nothrow_t&) EASY_NOEXCEPT
+{
+    std::free(_pointer);
+}
+
+void operator delete[](void* _pointer, const std::nothrow_t&) EASY_NOEXCEPT
+{
+    std::free(_pointer);
+}
+
+#if defined(__cpp_sized_deallocation) || (defined(_MSC_VER) && _MSC_VER >= 1900)
+void operator delete(void* _pointer, std::size_t) EASY_NOEXCEPT
+{
+    std::free(_pointer);
+}
+
+void operator delete[](void* _pointer, std::size_t) EASY_NOEXCEPT
+{
+    std::free(_pointer);
+}
+#endif
@@ -52,6 +52,8 @@ namespace profiler
         , m_color(_color)
         , m_type(_block_type)
         , m_status(_status)
+        , m_sampling(0)
+        , m_perfCounters(false)
     {
 
     }
@@ -110,7 +110,8 @@ Block::Block(timestamp_t _begin_time, timestamp_t _end_time, block_id_t _descrip
 Block::Block(const BaseBlockDescriptor* _descriptor, const char* _runtimeName, bool _scoped) EASY_NOEXCEPT
     : BaseBlockData(1ULL, _descriptor->id())
     , m_name(_runtimeName)
-    , m_status(_descriptor->status())
+    , m_status(static_cast<profiler::EasyBlockStatus>(_descriptor->status() | (_descriptor->sampling() > 1 ? SAMPLED_FLAG : 0) |
+                                                      (_descriptor->perfCounters() ? COUNTERS_FLAG : 0)))
     , m_isScoped(_scoped)
 {
 
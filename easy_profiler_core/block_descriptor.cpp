@@ -40,17 +40,9 @@ The Apache License, Version 2.0 (the "License");
 
 **/
 
-#include <memory.h>
+#include <string.h>
 #include "block_descriptor.h"
 
-#if EASY_BLOCK_DESC_FULL_COPY == 0
-# define EASY_BLOCK_DESC_STRING_LEN(s) static_cast<uint16_t>(strlen(s) + 1)
-# define EASY_BLOCK_DESC_STRING_VAL(s) s
-#else
-# define EASY_BLOCK_DESC_STRING_LEN(s) static_cast<uint16_t>(s.size() + 1)
-# define EASY_BLOCK_DESC_STRING_VAL(s) s.c_str()
-#endif
-
 BlockDescriptor::BlockDescriptor(profiler::block_id_t _id, profiler::EasyBlockStatus _status, const char* _name,
                                  const char* _filename, int _line, profiler::block_type_t _block_type,
                                  profiler::color_t _color)
@@ -62,31 +54,20 @@ BlockDescriptor::BlockDescriptor(profiler::block_id_t _id, profiler::EasyBlockSt
 
 const char* BlockDescriptor::name() const
 {
-    return EASY_BLOCK_DESC_STRING_VAL(m_name);
+    return m_name;
 }
 
 const char* BlockDescriptor::filename() const
 {
-    return EASY_BLOCK_DESC_STRING_VAL(m_filename);
+    return m_filename;
 }
 
 uint16_t BlockDescriptor::nameSize() const
 {
-    return EASY_BLOCK_DESC_STRING_LEN(m_name);
+    return static_cast<uint16_t>(strlen(m_name) + 1);
 }
 
 uint16_t BlockDescriptor::filenameSize() const
 {
-    return EASY_BLOCK_DESC_STRING_LEN(m_filename);
-}
-
-void BlockDescriptor::destroy(BlockDescriptor* instance)
-{
-#if EASY_BLOCK_DESC_FULL_COPY == 0
-    if (instance != nullptr)
-        instance->~BlockDescriptor();
-    free(instance);
-#else
-    delete instance;
-#endif
+    return static_cast<uint16_t>(strlen(m_filename) + 1);
 }
@@ -43,27 +43,27 @@ The Apache License, Version 2.0 (the "License");
 #ifndef EASY_PROFILER_BLOCK_DESCRIPTOR_H
 #define EASY_PROFILER_BLOCK_DESCRIPTOR_H
 
-#include <string>
 #include <easy/details/profiler_public_types.h>
 
 #ifndef EASY_BLOCK_DESC_FULL_COPY
-# define EASY_BLOCK_DESC_FULL_COPY 1
+# define EASY_BLOCK_DESC_FULL_COPY 1 // Copy file names of descriptors (block names are copied if needed)
 #endif
 
+class DescriptorRegistry;
+
+/** Block descriptor stored in DescriptorRegistry.
+
+Names are not owned by descriptor: they are either static strings or copies stored in registry memory arena.
+*/
 class BlockDescriptor : public profiler::BaseBlockDescriptor
 {
     friend ProfileManager;
+    friend DescriptorRegistry;
 
     using Parent = profiler::BaseBlockDescriptor;
 
-#if EASY_BLOCK_DESC_FULL_COPY == 0
-    using string_t = const char*;
-#else
-    using string_t = std::string;
-#endif
-
-    string_t m_filename; ///< Source file name where this block is declared
-    string_t     m_name; ///< Static name of all blocks of the same type (blocks can have dynamic name) which is, in pair with descriptor id, a unique block identifier
+    const char* m_filename; ///< Source file name where this block is declared
+    const char*     m_name; ///< Static name of all blocks of the same type (blocks can have dynamic name) which is, in pair with descriptor id, a unique block identifier
 
 public:
 
@@ -79,8 +79,6 @@ public:
     uint16_t     nameSize() const;
     uint16_t filenameSize() const;
 
-    static void destroy(BlockDescriptor* instance);
-
 }; // END of class BlockDescriptor.
 
 #endif //EASY_PROFILER_BLOCK_DESCRIPTOR_H
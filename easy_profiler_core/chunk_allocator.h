@@ -46,7 +46,10 @@ The Apache License, Version 2.0 (the "License");
 #include <easy/details/easy_compiler_support.h>
 #include <cstring>
 #include <ostream>
+#include <atomic>
+#include <thread>
 #include "alignment_helpers.h"
+#include "chunk_pool.h"
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -60,95 +63,133 @@ The Apache License, Version 2.0 (the "License");
 
 #if EASY_ENABLE_ALIGNMENT == 0
 # define EASY_ALIGNED(TYPE, VAR, A) TYPE VAR
-# define EASY_MALLOC(MEMSIZE, A) malloc(MEMSIZE)
-# define EASY_FREE(MEMPTR) free(MEMPTR)
 #else
-// MSVC and GNUC aligned versions of malloc are defined in malloc.h
-# include <malloc.h>
 # if defined(_MSC_VER)
 #  define EASY_ALIGNED(TYPE, VAR, A) __declspec(align(A)) TYPE VAR
-#  define EASY_MALLOC(MEMSIZE, A) _aligned_malloc(MEMSIZE, A)
-#  define EASY_FREE(MEMPTR) _aligned_free(MEMPTR)
 # elif defined(__GNUC__)
 #  define EASY_ALIGNED(TYPE, VAR, A) TYPE VAR __attribute__((aligned(A)))
-#  define EASY_MALLOC(MEMSIZE, A) memalign(A, MEMSIZE)
-#  define EASY_FREE(MEMPTR) free(MEMPTR)
 # else
 #  define EASY_ALIGNED(TYPE, VAR, A) TYPE VAR
-#  define EASY_MALLOC(MEMSIZE, A) malloc(MEMSIZE)
-#  define EASY_FREE(MEMPTR) free(MEMPTR)
 # endif
 #endif
 
 //////////////////////////////////////////////////////////////////////////
 
+/** Positions of chunk_allocator data mirrored into file-backed memory for crash recovery and out-of-process collecting.
+
+Each position is packed as (ChunkPool::index(chunk) << 16) | offset. Zero means there is no position.
+*/
+struct persistent_cursor
+{
+    std::atomic<uint64_t>     read; ///< Position of the first not serialized element
+    std::atomic<uint64_t>   marked; ///< End of data closed by the last put_mark()
+    std::atomic<uint64_t> consumed; ///< End of data collected by an external reader (written by the reader, see chunk_allocator::apply_consumed())
+};
+
+//////////////////////////////////////////////////////////////////////////
+
 template <const uint16_t N>
 class chunk_allocator
 {
     static_assert(N != 0, "chunk_allocator<N> N must be a positive value");
 
-    struct chunk { EASY_ALIGNED(char, data[N], EASY_ALIGNMENT_SIZE); chunk* prev = nullptr; };
+    // Used as chunk::frameOffset value for chunks in which no frame begins.
+    EASY_STATIC_CONSTEXPR uint16_t NoFrame = N;
+
+    struct chunk
+    {
+        EASY_ALIGNED(char, data[N], EASY_ALIGNMENT_SIZE);
+        chunk*          prev = nullptr;
+        chunk*          next = nullptr;
+        uint16_t frameOffset = NoFrame; ///< Offset of the first frame which begins in this chunk. Used to drop whole frames in ring mode.
+    };
+
+    static_assert(sizeof(chunk) <= ChunkPool::SLOT_SIZE, "chunk_allocator<N> chunk does not fit into ChunkPool slot");
 
     struct chunk_list
     {
-        chunk* last;
+        chunk*  first;
+        chunk*   last;
+        uint32_t size; ///< Number of chunks in the list.
 
         chunk_list(const chunk_list&) = delete;
         chunk_list(chunk_list&&) = delete;
 
-        chunk_list() : last(nullptr)
+        chunk_list() : first(nullptr), last(nullptr), size(0)
         {
             static_assert(sizeof(char) == 1, "easy_profiler logic error: sizeof(char) != 1 for this platform! Please, contact easy_profiler authors to resolve your problem.");
-            emplace_back();
+            emplace_back(nullptr);
         }
 
         ~chunk_list()
         {
-            do free_last(); while (last != nullptr);
+            free_list(first);
         }
 
-        void clear_all_except_last()
-        {
-            while (last->prev != nullptr)
-                free_last();
-            zero_last_chunk_size();
-        }
+        /** Append a new chunk to the end of the list.
 
-        void emplace_back()
+        \param _recycled Previously released chunk which could be reused instead of taking a new one from ChunkPool (may be nullptr).
+        */
+        void emplace_back(chunk* _recycled)
         {
             auto prev = last;
-            last = ::new (EASY_MALLOC(sizeof(chunk), EASY_ALIGNMENT_SIZE)) chunk();
+            last = ::new (_recycled != nullptr ? _recycled : ChunkPool::instance().allocate()) chunk();
             last->prev = prev;
+
+            if (prev != nullptr)
+                prev->next = last;
+            else
+                first = last;
+
+            ++size;
             zero_last_chunk_size();
         }
 
-        /** Invert current chunks list to enable to iterate over chunks list in direct order.
+        /** Detach all chunks preceding _newFirst from the list.
 
-        This method is used by serialize().
+        Detached chunks are returned as a list linked by next pointers.
         */
-        void invert()
+        chunk* pop_front(chunk* _newFirst)
         {
-            chunk* next = nullptr;
+            chunk* head = first;
+            for (chunk* c = head; c != _newFirst; c = c->next)
+                --size;
 
-            while (last->prev != nullptr) {
-                auto p = last->prev;
-                last->prev = next;
-                next = last;
-                last = p;
-            }
+            _newFirst->prev->next = nullptr;
+            _newFirst->prev = nullptr;
+            first = _newFirst;
 
-            last->prev = next;
+            return head;
         }
 
-    private:
+        /** Return all chunks following _newLast into ChunkPool.
+        */
+        void pop_back(chunk* _newLast)
+        {
+            for (chunk* c = _newLast->next; c != nullptr; c = c->next)
+                --size;
 
-        void free_last()
+            free_list(_newLast->next);
+            _newLast->next = nullptr;
+            last = _newLast;
+        }
+
+        static void free_list(chunk* _head)
         {
-            auto p = last;
-            last = last->prev;
-            EASY_FREE(p);
+            if (_head == nullptr)
+                return;
+
+            auto& pool = ChunkPool::instance();
+            while (_head != nullptr)
+            {
+                auto p = _head;
+                _head = _head->next;
+                pool.release(p);
+            }
         }
 
+    private:
+
         void zero_last_chunk_size()
         {
             // Although there is no need for unaligned access stuff b/c a new chunk will
@@ -164,20 +205,66 @@ class chunk_allocator
     EASY_STATIC_CONSTEXPR int_fast32_t MaxChunkOffset = N - sizeof(uint16_t);
     EASY_STATIC_CONSTEXPR uint16_t OneBeforeN = static_cast<uint16_t>(N - 1);
 
-    chunk_list          m_chunks; ///< List of chunks.
-    chunk*         m_markedChunk; ///< Chunk marked by last closed frame
-    uint32_t              m_size; ///< Number of elements stored(# of times allocate() has been called.)
-    uint32_t        m_markedSize; ///< Number of elements to the moment when put_mark() has been called.
-    uint16_t       m_chunkOffset; ///< Number of bytes used in the current chunk.
-    uint16_t m_markedChunkOffset; ///< Last byte in marked chunk for serializing.
+    // Data written by the owner thread only.
+    chunk_list                   m_chunks; ///< List of chunks.
+    chunk*                  m_markedChunk; ///< Chunk marked by last closed frame
+    uint32_t                       m_size; ///< Number of elements stored(# of times allocate() has been called.)
+    uint32_t                 m_markedSize; ///< Number of elements to the moment when put_mark() has been called.
+    uint16_t                m_chunkOffset; ///< Number of bytes used in the current chunk.
+    uint16_t          m_markedChunkOffset; ///< Last byte in marked chunk for serializing.
+
+    // Last mark published for readers (protected by sequence lock, written by the owner thread only).
+    std::atomic<chunk*>    m_publishedChunk; ///< Copy of m_markedChunk visible for readers.
+    std::atomic<uint16_t> m_publishedOffset; ///< Copy of m_markedChunkOffset visible for readers.
+    std::atomic<uint32_t>    m_publishedSeq; ///< Sequence lock counter (odd value means that the mark is being updated).
+
+    // Read cursor: position of the first not yet serialized element.
+    // Moved by reader in end_read() and by the owner thread when dropping oldest frames in ring mode.
+    std::atomic<chunk*>         m_readChunk; ///< Chunk containing the first not serialized element.
+    std::atomic<uint16_t>      m_readOffset; ///< Offset of the first not serialized element in m_readChunk.
+
+    std::atomic<uint32_t>       m_maxChunks; ///< Max number of chunks in ring mode (0 means unlimited storage).
+    persistent_cursor*         m_persistent; ///< Positions mirrored for crash recovery (nullptr if disabled).
+    uint64_t              m_appliedConsumed; ///< The last m_persistent->consumed value checked by apply_consumed().
+    std::atomic_bool              m_reading; ///< True while reader is serializing data (set by reader).
+    std::atomic_bool             m_trimming; ///< True while the owner thread is dropping oldest frames (set by the owner thread).
+    std::atomic_bool               m_pinned; ///< True if closed frames must not be dropped in ring mode.
 
 public:
 
+    /** Closed data range captured by begin_read().
+    */
+    struct snapshot
+    {
+        chunk*          first = nullptr; ///< First chunk to serialize.
+        chunk*         marked = nullptr; ///< Last chunk to serialize.
+        uint64_t       memory = 0;       ///< Summary size of all elements payloads.
+        uint32_t         size = 0;       ///< Number of elements.
+        uint16_t  startOffset = 0;       ///< Offset of the first element in the first chunk.
+        uint16_t markedOffset = 0;       ///< End offset in the last chunk.
+    };
+
     chunk_allocator(const chunk_allocator&) = delete;
     chunk_allocator(chunk_allocator&&) = delete;
 
-    chunk_allocator() : m_markedChunk(nullptr), m_size(0), m_markedSize(0), m_chunkOffset(0), m_markedChunkOffset(0)
+    chunk_allocator()
+        : m_markedChunk(nullptr)
+        , m_size(0)
+        , m_markedSize(0)
+        , m_chunkOffset(0)
+        , m_markedChunkOffset(0)
+        , m_publishedChunk(nullptr)
+        , m_publishedOffset(0)
+        , m_publishedSeq(0)
+        , m_readChunk(m_chunks.first)
+        , m_readOffset(0)
+        , m_maxChunks(0)
+        , m_persistent(nullptr)
+        , m_appliedConsumed(0)
     {
+        m_reading = ATOMIC_VAR_INIT(false);
+        m_trimming = ATOMIC_VAR_INIT(false);
+        m_pinned = ATOMIC_VAR_INIT(false);
     }
 
     /** Allocate n bytes.
@@ -208,8 +295,8 @@ public:
             return data;
         }
 
+        expand();
         m_chunkOffset = n + sizeof(uint16_t);
-        m_chunks.emplace_back();
 
         char* data = m_chunks.last->data;
         unaligned_store16(data, n);
@@ -248,67 +335,259 @@ public:
         return m_markedSize == 0;
     }
 
-    void clear()
+    /** Limit the number of chunks (ring mode).
+
+    When the limit is reached the oldest closed frames are dropped and their chunks are reused.
+    Storage grows beyond the limit only if there is no closed frame to drop,
+    if the data is being serialized at this moment or if frames are pinned (see set_pinned()).
+
+    \param _maxChunks Max number of chunks (0 means unlimited storage). Values less than 2 are rounded up to 2.
+
+    \note This method is thread-safe.
+    */
+    void set_max_chunks(uint32_t _maxChunks)
     {
-        m_size = 0;
-        m_markedSize = 0;
-        m_chunkOffset = 0;
-        m_markedChunk = nullptr;
-        m_chunks.clear_all_except_last(); // There is always at least one chunk
+        m_maxChunks.store(_maxChunks != 0 && _maxChunks < 2 ? 2 : _maxChunks, std::memory_order_relaxed);
     }
 
-    /** Serialize data to stream.
+    /** Keep all closed frames in ring mode until unpinned (e.g. while they are waiting to be serialized).
 
-    \warning Data will be cleared after serialization.
+    \note This method is thread-safe.
     */
-    void serialize(std::ostream& _outputStream)
+    void set_pinned(bool _pinned)
     {
-        // Chunks are stored in reversed order (stack).
-        // To be able to iterate them in direct order we have to invert the chunks list.
-        m_chunks.invert();
+        m_pinned.store(_pinned, std::memory_order_relaxed);
+    }
 
-        // Each chunk is an array of N bytes that can hold between
-        // 1(if the list isn't empty) and however many elements can fit in a chunk,
-        // where an element consists of a payload size + a payload as follows:
-        // elementStart[0..1]: size as a uint16_t
-        // elementStart[2..size-1]: payload.
-        
-        // The maximum chunk offset is N-sizeof(uint16_t) b/c, if we hit that (or go past),
-        // there is either no space left, 1 byte left, or 2 bytes left, all of which are
-        // too small to cary more than a zero-sized element.
+    /** Mirror read cursor and the last mark into _cursor (crash recovery mode).
+
+    \note Must be called by the owner thread.
+    */
+    void set_persistent(persistent_cursor* _cursor)
+    {
+        m_persistent = _cursor;
+        if (_cursor == nullptr)
+            return;
+
+        _cursor->read.store(persistent_position(m_readChunk.load(std::memory_order_acquire), m_readOffset.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+        _cursor->marked.store(m_markedChunk != nullptr ? persistent_position(m_markedChunk, m_markedChunkOffset) : 0, std::memory_order_release);
+    }
+
+    /** Iterate over elements stored by a crashed process in file-backed chunks.
 
-        chunk* current = m_chunks.last;
+    \param _read Position of the first element (see persistent_cursor).
+    \param _marked End position (see persistent_cursor).
+    \param _chunkAt Functor returning pointer to the chunk by its index or nullptr if the index is invalid.
+    \param _indexOf Functor returning index of the chunk by its address in the crashed process or 0 if the address is invalid.
+    \param _func Functor called for each element with pointer to the element (starting with its payload size) and payload size.
+
+    \retval false if the chunks list is broken.
+    */
+    template <class TChunkAt, class TIndexOf, class TFunc>
+    static bool walk_persistent(uint64_t _read, uint64_t _marked, TChunkAt _chunkAt, TIndexOf _indexOf, TFunc _func)
+    {
+        if (_marked == 0)
+            return true;
+
+        const auto markedIndex = static_cast<uint32_t>(_marked >> 16);
+        const auto markedOffset = static_cast<int_fast32_t>(_marked & 0xffff);
+
+        auto index = static_cast<uint32_t>(_read >> 16);
+        int_fast32_t chunkOffset = static_cast<int_fast32_t>(_read & 0xffff);
         bool isMarked;
         do {
 
-            isMarked = (current == m_markedChunk);
-            const char* data = current->data;
-
-            const int_fast32_t maxOffset = isMarked ? m_markedChunkOffset : MaxChunkOffset;
-            int_fast32_t chunkOffset = 0; // signed int so overflow is not checked.
-            auto payloadSize = unaligned_load16<uint16_t>(data);
+            const auto current = reinterpret_cast<const chunk*>(_chunkAt(index));
+            if (current == nullptr)
+                return false;
 
-            while (chunkOffset < maxOffset && payloadSize != 0)
+            isMarked = (index == markedIndex);
+            const int_fast32_t maxOffset = isMarked ? markedOffset : MaxChunkOffset;
+            while (chunkOffset < maxOffset)
             {
+                const char* data = current->data + chunkOffset;
+                const auto payloadSize = unaligned_load16<uint16_t>(data);
+                if (payloadSize == 0)
+                    break;
+
                 const uint16_t chunkSize = sizeof(uint16_t) + payloadSize;
-                _outputStream.write(data, chunkSize);
-                data += chunkSize;
+                if (chunkOffset + chunkSize > N)
+                    return false;
+
+                _func(data, payloadSize);
                 chunkOffset += chunkSize;
-                unaligned_load16(data, &payloadSize);
             }
 
-            current = current->prev;
+            if (isMarked)
+                break;
+
+            index = _indexOf(reinterpret_cast<uintptr_t>(current->next));
+            chunkOffset = 0;
+
+        } while (index != 0);
+
+        return isMarked;
+    }
+
+    /** Capture all data closed by the last put_mark() for serialization.
+
+    The owner thread may continue storing new elements while captured data is being serialized.
+    Each begin_read() must be followed by end_read().
+
+    \note Only one reader at a time is allowed.
+    */
+    void begin_read(snapshot& _snapshot)
+    {
+        // Handshake with drop_oldest_frames(): either the owner thread sees m_reading and does
+        // not touch the read cursor, or we wait here until it has finished moving the cursor.
+        m_reading.store(true, std::memory_order_seq_cst);
+        while (m_trimming.load(std::memory_order_seq_cst))
+            std::this_thread::yield();
+
+        uint32_t seq;
+        do {
+            seq = m_publishedSeq.load(std::memory_order_acquire);
+            _snapshot.marked = m_publishedChunk.load(std::memory_order_relaxed);
+            _snapshot.markedOffset = m_publishedOffset.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) != 0 || seq != m_publishedSeq.load(std::memory_order_relaxed));
+
+        _snapshot.first = m_readChunk.load(std::memory_order_acquire);
+        _snapshot.startOffset = m_readOffset.load(std::memory_order_relaxed);
+        _snapshot.memory = 0;
+        _snapshot.size = 0;
+
+        if (_snapshot.marked == nullptr)
+            return;
+
+        walk(_snapshot, [&_snapshot](const char*, uint16_t _payloadSize) {
+            _snapshot.memory += _payloadSize;
+            ++_snapshot.size;
+        });
+    }
+
+    /** Finish reading.
+
+    \param _consumed If true then captured data would not be serialized again.
+    */
+    void end_read(const snapshot& _snapshot, bool _consumed)
+    {
+        if (_consumed && _snapshot.marked != nullptr)
+        {
+            if (m_persistent != nullptr)
+                m_persistent->read.store(persistent_position(_snapshot.marked, _snapshot.markedOffset), std::memory_order_release);
+            m_readOffset.store(_snapshot.markedOffset, std::memory_order_relaxed);
+            m_readChunk.store(_snapshot.marked, std::memory_order_release);
+        }
+
+        m_reading.store(false, std::memory_order_release);
+    }
+
+    /** Serialize captured data to stream.
+    */
+    void serialize(const snapshot& _snapshot, std::ostream& _outputStream) const
+    {
+        if (_snapshot.size == 0)
+            return;
+
+        walk(_snapshot, [&_outputStream](const char* _data, uint16_t _payloadSize) {
+            _outputStream.write(_data, sizeof(uint16_t) + _payloadSize);
+        });
+    }
+
+    /** Iterate over captured data.
+
+    \param _func Functor called for each element with pointer to the element (starting with its payload size) and payload size.
+    */
+    template <class TFunc>
+    void read(const snapshot& _snapshot, TFunc _func) const
+    {
+        if (_snapshot.size != 0)
+            walk(_snapshot, _func);
+    }
+
+    /** Exclude leading elements from captured data.
+
+    \param _func Predicate called for each element with pointer to the element (starting with its payload size) and payload size.
+    Elements preceding the first one for which it returns true are excluded from the snapshot
+    (but they are still consumed by end_read()).
+    */
+    template <class TFunc>
+    static void skip_until(snapshot& _snapshot, TFunc _func)
+    {
+        if (_snapshot.size == 0)
+            return;
+
+        chunk* current = _snapshot.first;
+        int_fast32_t chunkOffset = _snapshot.startOffset;
+        bool isMarked;
+        do {
+
+            isMarked = (current == _snapshot.marked);
+            const int_fast32_t maxOffset = isMarked ? _snapshot.markedOffset : MaxChunkOffset;
+            while (chunkOffset < maxOffset)
+            {
+                const char* data = current->data + chunkOffset;
+                const auto payloadSize = unaligned_load16<uint16_t>(data);
+                if (payloadSize == 0)
+                    break;
+
+                if (_func(data, payloadSize))
+                {
+                    _snapshot.first = current;
+                    _snapshot.startOffset = static_cast<uint16_t>(chunkOffset);
+                    return;
+                }
+
+                _snapshot.memory -= payloadSize;
+                --_snapshot.size;
+                chunkOffset += sizeof(uint16_t) + payloadSize;
+            }
+
+            current = current->next;
+            chunkOffset = 0;
 
         } while (current != nullptr && !isMarked);
 
-        clear();
+        _snapshot.first = _snapshot.marked;
+        _snapshot.startOffset = _snapshot.markedOffset;
     }
 
     void put_mark()
     {
-        m_markedChunk = m_chunks.last;
+        chunk* last = m_chunks.last;
+        m_markedChunk = last;
         m_markedSize = m_size;
         m_markedChunkOffset = m_chunkOffset;
+        if (last->frameOffset == NoFrame)
+            last->frameOffset = m_chunkOffset;
+        publish_mark();
+    }
+
+    /** Remove all elements stored after the last put_mark().
+
+    Used to discard a frame which has not been closed while profiler was enabled.
+    */
+    void drop_unmarked()
+    {
+        if (m_markedSize == m_size)
+            return;
+
+        chunk* marked = m_markedChunk;
+        uint16_t offset = m_markedChunkOffset;
+        if (marked == nullptr)
+        {
+            // Nothing has been closed yet, so nothing has been serialized too
+            marked = m_chunks.first;
+            offset = m_readOffset.load(std::memory_order_relaxed);
+        }
+
+        m_chunks.pop_back(marked);
+        m_chunkOffset = offset;
+        m_size = m_markedSize;
+
+        if (offset < OneBeforeN)
+            unaligned_zero16(marked->data + offset);
     }
 
     void* marked_allocate(uint16_t n)
@@ -342,6 +621,8 @@ public:
             if (marked == m_chunks.last && chunkOffset > m_chunkOffset)
                 m_chunkOffset = chunkOffset;
 
+            publish_mark();
+
             return data;
         }
 
@@ -351,17 +632,20 @@ public:
         chunk* last = m_chunks.last;
         if (marked == last)
         {
-            m_chunks.emplace_back();
+            m_chunks.emplace_back(nullptr);
             last = m_chunks.last;
             m_chunkOffset = chunkOffset;
             m_size = m_markedSize;
         }
         else
         {
-            do last = last->prev; while (last->prev != m_markedChunk);
+            last = marked->next;
         }
 
         m_markedChunk = last;
+        if (last->frameOffset == NoFrame)
+            last->frameOffset = 0;
+
         char* data = last->data;
         unaligned_store16(data, n);
         data += sizeof(uint16_t);
@@ -369,9 +653,208 @@ public:
         // We assume here that it takes more than one element to fill a chunk.
         unaligned_zero16(data + n);
 
+        publish_mark();
+
         return data;
     }
 
+private:
+
+    /** Make current mark visible for readers.
+    */
+    void publish_mark()
+    {
+        const uint32_t seq = m_publishedSeq.load(std::memory_order_relaxed);
+        m_publishedSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_publishedChunk.store(m_markedChunk, std::memory_order_relaxed);
+        m_publishedOffset.store(m_markedChunkOffset, std::memory_order_relaxed);
+        m_publishedSeq.store(seq + 2, std::memory_order_release);
+
+        if (m_persistent != nullptr)
+            m_persistent->marked.store(persistent_position(m_markedChunk, m_markedChunkOffset), std::memory_order_release);
+    }
+
+    static uint64_t persistent_position(const chunk* _chunk, uint16_t _offset)
+    {
+        return (static_cast<uint64_t>(ChunkPool::instance().index(_chunk)) << 16) | _offset;
+    }
+
+    /** Iterate over all elements of captured data.
+    */
+    template <class TFunc>
+    static void walk(const snapshot& _snapshot, TFunc _func)
+    {
+        // Each chunk is an array of N bytes that can hold between
+        // 1(if the list isn't empty) and however many elements can fit in a chunk,
+        // where an element consists of a payload size + a payload as follows:
+        // elementStart[0..1]: size as a uint16_t
+        // elementStart[2..size-1]: payload.
+
+        // The maximum chunk offset is N-sizeof(uint16_t) b/c, if we hit that (or go past),
+        // there is either no space left, 1 byte left, or 2 bytes left, all of which are
+        // too small to cary more than a zero-sized element.
+
+        const chunk* current = _snapshot.first;
+        int_fast32_t chunkOffset = _snapshot.startOffset; // signed int so overflow is not checked.
+        bool isMarked;
+        do {
+
+            isMarked = (current == _snapshot.marked);
+            const char* data = current->data + chunkOffset;
+
+            const int_fast32_t maxOffset = isMarked ? _snapshot.markedOffset : MaxChunkOffset;
+            while (chunkOffset < maxOffset)
+            {
+                const auto payloadSize = unaligned_load16<uint16_t>(data);
+                if (payloadSize == 0)
+                    break;
+
+                _func(data, payloadSize);
+
+                const uint16_t chunkSize = sizeof(uint16_t) + payloadSize;
+                data += chunkSize;
+                chunkOffset += chunkSize;
+            }
+
+            current = current->next;
+            chunkOffset = 0;
+
+        } while (current != nullptr && !isMarked);
+    }
+
+    /** Release chunks which have been already serialized.
+
+    \retval One of released chunks which could be reused or nullptr.
+    */
+    chunk* reclaim()
+    {
+        chunk* readChunk = m_readChunk.load(std::memory_order_acquire);
+        if (readChunk == m_chunks.first)
+            return nullptr;
+
+        chunk* released = m_chunks.pop_front(readChunk);
+        chunk_list::free_list(released->next);
+
+        return released;
+    }
+
+    /** Append new chunk to the list (reusing released chunks if possible).
+    */
+    void expand()
+    {
+        if (m_persistent != nullptr)
+            apply_consumed();
+
+        chunk* recycled = reclaim();
+        if (recycled == nullptr)
+        {
+            const uint32_t maxChunks = m_maxChunks.load(std::memory_order_relaxed);
+            if (maxChunks != 0 && m_chunks.size >= maxChunks && !m_pinned.load(std::memory_order_relaxed))
+                recycled = drop_oldest_frames();
+        }
+
+        // If the last frame has been closed exactly at the end of the last chunk
+        // then the next frame begins at the start of the new chunk.
+        // Moving the mark there keeps frame boundaries not later than the mark.
+        const bool frameBegins = m_markedChunk == m_chunks.last && m_markedChunkOffset == m_chunkOffset;
+
+        m_chunks.emplace_back(recycled);
+
+        if (frameBegins)
+        {
+            m_markedChunk = m_chunks.last;
+            m_markedChunkOffset = 0;
+            m_markedChunk->frameOffset = 0;
+            publish_mark();
+        }
+    }
+
+    /** Move the read cursor to the end of data collected by an external reader (see persistent_cursor::consumed).
+
+    Consumed position is ignored if it is not between the read cursor and the mark
+    (data has been already serialized or dropped by another way).
+    */
+    void apply_consumed()
+    {
+        const uint64_t consumed = m_persistent->consumed.load(std::memory_order_acquire);
+        if (consumed == 0 || consumed == m_appliedConsumed)
+            return;
+
+        // See begin_read() for the other side of this handshake.
+        m_trimming.store(true, std::memory_order_seq_cst);
+        if (m_reading.load(std::memory_order_seq_cst))
+        {
+            // Try again on the next expand()
+            m_trimming.store(false, std::memory_order_release);
+            return;
+        }
+
+        m_appliedConsumed = consumed;
+
+        const auto target = reinterpret_cast<chunk*>(ChunkPool::instance().slot(static_cast<uint32_t>(consumed >> 16)));
+        const auto offset = static_cast<uint16_t>(consumed & 0xffff);
+        const auto readChunk = m_readChunk.load(std::memory_order_relaxed);
+        const auto readOffset = m_readOffset.load(std::memory_order_relaxed);
+
+        for (chunk* current = readChunk; current != nullptr; current = current->next)
+        {
+            if (current == target)
+            {
+                if ((current != readChunk || offset > readOffset) && (current != m_markedChunk || offset <= m_markedChunkOffset))
+                {
+                    m_persistent->read.store(consumed, std::memory_order_release);
+                    m_readOffset.store(offset, std::memory_order_relaxed);
+                    m_readChunk.store(target, std::memory_order_release);
+                }
+                break;
+            }
+
+            if (current == m_markedChunk)
+                break;
+        }
+
+        m_trimming.store(false, std::memory_order_release);
+    }
+
+    /** Drop the oldest not serialized frames so that at least one chunk is released.
+
+    \retval Released chunk which could be reused or nullptr if there is no closed frame to drop
+    or if the data is being serialized at this moment.
+    */
+    chunk* drop_oldest_frames()
+    {
+        chunk* head = m_chunks.first;
+        if (m_markedChunk == nullptr || m_markedChunk == head)
+            return nullptr;
+
+        // See begin_read() for the other side of this handshake.
+        m_trimming.store(true, std::memory_order_seq_cst);
+        if (m_reading.load(std::memory_order_seq_cst))
+        {
+            m_trimming.store(false, std::memory_order_release);
+            return nullptr;
+        }
+
+        // reclaim() has been called before, so head is the read chunk here.
+        // Every frame boundary is placed not later than the mark, so this loop
+        // stops at m_markedChunk at the latest.
+        chunk* newHead = head->next;
+        while (newHead->frameOffset == NoFrame)
+            newHead = newHead->next;
+
+        if (m_persistent != nullptr)
+            m_persistent->read.store(persistent_position(newHead, newHead->frameOffset), std::memory_order_release);
+        m_readOffset.store(newHead->frameOffset, std::memory_order_relaxed);
+        m_readChunk.store(newHead, std::memory_order_release);
+        m_trimming.store(false, std::memory_order_release);
+
+        chunk* released = m_chunks.pop_front(newHead);
+        chunk_list::free_list(released->next);
+
+        return released;
+    }
+
 }; // END of class chunk_allocator.
 
 //////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,253 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#include <stdlib.h>
+#include <string.h>
+#include "chunk_pool.h"
+
+#if defined(_WIN32)
+# include <malloc.h>
+#else
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+#ifndef EASY_OPTION_HUGE_PAGES_ENABLED
+# define EASY_OPTION_HUGE_PAGES_ENABLED 1
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+/** Allocates REGION_SIZE bytes aligned by REGION_SIZE and touches every page of it.
+
+If _fd is not -1 then the region is mapped from the file at offset _number * REGION_SIZE. */
+static char* allocateRegion(bool _hugePages, int _fd, uint32_t _number)
+{
+    EASY_CONSTEXPR size_t size = ChunkPool::REGION_SIZE;
+
+#if defined(_WIN32)
+    (void)_hugePages; // Large pages on Windows require SeLockMemoryPrivilege, so they are not used
+    (void)_fd;
+    (void)_number;
+    auto region = static_cast<char*>(_aligned_malloc(size, size));
+    if (region == nullptr)
+        return nullptr;
+#else
+    // Map twice as much memory to be able to align the region by its size
+    auto mapped = static_cast<char*>(mmap(nullptr, size << 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (mapped == MAP_FAILED)
+        return nullptr;
+
+    const auto offset = size - (reinterpret_cast<uintptr_t>(mapped) & (size - 1));
+    auto region = offset == size ? mapped : mapped + offset;
+    if (region != mapped)
+        munmap(mapped, region - mapped);
+    munmap(region + size, mapped + (size << 1) - (region + size));
+
+    if (_fd != -1)
+    {
+        // Replace reserved anonymous memory with the file keeping the alignment
+        const auto offset = static_cast<off_t>(_number) * size;
+        if (ftruncate(_fd, offset + size) != 0
+            || mmap(region, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, _fd, offset) == MAP_FAILED)
+        {
+            munmap(region, size);
+            return nullptr;
+        }
+    }
+# ifdef MADV_HUGEPAGE
+    else if (_hugePages)
+    {
+        madvise(region, size, MADV_HUGEPAGE);
+    }
+# else
+    (void)_hugePages;
+# endif
+#endif
+
+    // Pre-fault the region to not to page fault later while storing blocks
+    memset(region, 0, size);
+
+    return region;
+}
+
+static std::atomic<uint32_t>& link(char* _slot)
+{
+    // A free slot stores (index + 1) of the next free slot
+    return *reinterpret_cast<std::atomic<uint32_t>*>(_slot);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+ChunkPool& ChunkPool::instance()
+{
+    // The pool is never destroyed because chunks are released by thread storages
+    // which could be destroyed after static objects destruction
+    static ChunkPool* pool = new ChunkPool(EASY_OPTION_HUGE_PAGES_ENABLED != 0);
+    return *pool;
+}
+
+ChunkPool::ChunkPool(bool _hugePages) : m_backingFile(-1), m_hugePages(_hugePages)
+{
+    for (auto& region : m_regions)
+        region.store(nullptr, std::memory_order_relaxed);
+
+    m_head.store(0, std::memory_order_relaxed);
+    m_regionsCount.store(0, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void* ChunkPool::allocate()
+{
+    uint32_t i;
+    while (!pop(i))
+    {
+        profiler::guard_lock<profiler::spin_lock> lock(m_growLock);
+
+        // Another thread may have grown the pool while we were waiting for the lock
+        if (static_cast<uint32_t>(m_head.load(std::memory_order_acquire)) == 0 && !grow())
+            return nullptr;
+    }
+
+    return slot(i);
+}
+
+void ChunkPool::release(void* _chunk)
+{
+    const auto i = index(_chunk);
+    push(i, i);
+}
+
+bool ChunkPool::setBackingFile(int _fd)
+{
+#if defined(_WIN32)
+    (void)_fd;
+    return false;
+#else
+    profiler::guard_lock<profiler::spin_lock> lock(m_growLock);
+    if (m_regionsCount.load(std::memory_order_acquire) != 0)
+        return false;
+
+    m_backingFile = _fd;
+    return true;
+#endif
+}
+
+void ChunkPool::reserve(uint64_t _bytes)
+{
+    profiler::guard_lock<profiler::spin_lock> lock(m_growLock);
+    while (memorySize() < _bytes && grow());
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+char* ChunkPool::slot(uint32_t _index) const
+{
+    return m_regions[_index / SLOTS_PER_REGION].load(std::memory_order_acquire) + (_index % SLOTS_PER_REGION) * SLOT_SIZE;
+}
+
+uint32_t ChunkPool::index(const void* _chunk) const
+{
+    // Regions are aligned by their size and the first slot of a region stores the region number
+    const auto address = reinterpret_cast<uintptr_t>(_chunk);
+    const auto region = reinterpret_cast<const char*>(address & ~static_cast<uintptr_t>(REGION_SIZE - 1));
+
+    uint32_t number;
+    memcpy(&number, region, sizeof(uint32_t));
+
+    return number * SLOTS_PER_REGION + static_cast<uint32_t>((address & (REGION_SIZE - 1)) / SLOT_SIZE);
+}
+
+bool ChunkPool::pop(uint32_t& _index)
+{
+    uint64_t head = m_head.load(std::memory_order_acquire), newHead;
+    do {
+        const auto top = static_cast<uint32_t>(head);
+        if (top == 0)
+            return false;
+
+        // The slot could be popped and overwritten by another thread at this moment,
+        // but then the ABA-counter has been changed and compare_exchange would fail.
+        _index = top - 1;
+        const uint64_t next = link(slot(_index)).load(std::memory_order_relaxed);
+        newHead = (((head >> 32) + 1) << 32) | next;
+    } while (!m_head.compare_exchange_weak(head, newHead, std::memory_order_acq_rel, std::memory_order_acquire));
+
+    return true;
+}
+
+void ChunkPool::push(uint32_t _first, uint32_t _last)
+{
+    auto& last = link(slot(_last));
+
+    uint64_t head = m_head.load(std::memory_order_relaxed), newHead;
+    do {
+        last.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        newHead = (((head >> 32) + 1) << 32) | (_first + 1);
+    } while (!m_head.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+bool ChunkPool::grow()
+{
+    const auto number = m_regionsCount.load(std::memory_order_relaxed);
+    if (number == REGIONS_NUMBER)
+        return false;
+
+    auto region = allocateRegion(m_hugePages, m_backingFile, number);
+    if (region == nullptr)
+        return false;
+
+    const auto address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(region));
+    memcpy(region, &number, sizeof(uint32_t));
+    memcpy(region + sizeof(uint64_t), &address, sizeof(uint64_t));
+    m_regions[number].store(region, std::memory_order_release);
+    m_regionsCount.store(number + 1, std::memory_order_release);
+
+    // Link all slots of the region (except the header) and push them at once
+    const uint32_t first = number * SLOTS_PER_REGION + 1, last = first + SLOTS_PER_REGION - 2;
+    for (uint32_t i = first; i < last; ++i)
+        link(slot(i)).store(i + 2, std::memory_order_relaxed);
+    push(first, last);
+
+    return true;
+}
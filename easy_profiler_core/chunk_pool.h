@@ -0,0 +1,135 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_CHUNK_POOL_H
+#define EASY_PROFILER_CHUNK_POOL_H
+
+#include <stdint.h>
+#include <atomic>
+#include <easy/details/easy_compiler_support.h>
+#include "spin_lock.h"
+
+/** Process-wide pool of memory chunks used by chunk_allocator.
+
+Chunks are carved out of big pre-faulted regions (2 MB, advised to be backed by huge pages where supported),
+so storing profiled blocks never calls malloc or triggers a page fault while the pool has free chunks.
+Chunks released by threads (after a dump, on thread exit etc.) are returned into the pool and reused by any thread.
+
+Allocation and release are lock-free (free chunks form a stack with an ABA-counter in its head).
+A lock is taken only when the pool is empty and a new region must be allocated.
+
+\note Regions are never returned to the OS, the pool lives until the process exits.
+*/
+class ChunkPool EASY_FINAL
+{
+public:
+
+    EASY_STATIC_CONSTEXPR uint32_t SLOT_SIZE = 4096; ///< Size of one chunk (one memory page)
+    EASY_STATIC_CONSTEXPR uint32_t REGION_SIZE = 2 * 1024 * 1024; ///< Size of one region (one huge page)
+
+private:
+
+    EASY_STATIC_CONSTEXPR uint32_t SLOTS_PER_REGION = REGION_SIZE / SLOT_SIZE; ///< The first slot of a region is reserved for the region header
+    EASY_STATIC_CONSTEXPR uint32_t REGIONS_NUMBER = 8192; ///< Maximum number of regions (16 GB)
+
+    std::atomic<char*> m_regions[REGIONS_NUMBER]; ///< Allocated regions
+    std::atomic<uint64_t>                 m_head; ///< Free chunks stack head: (ABA-counter << 32) | (slot index + 1), 0 slot means empty stack
+    std::atomic<uint32_t>         m_regionsCount; ///< Number of allocated regions
+    profiler::spin_lock               m_growLock; ///< Guards allocating of new regions
+    int                            m_backingFile; ///< File which regions are mapped from (-1 means anonymous memory)
+    const bool                       m_hugePages; ///< Advise the OS to use huge pages for regions
+
+public:
+
+    ChunkPool(const ChunkPool&) = delete;
+    ChunkPool& operator = (const ChunkPool&) = delete;
+
+    static ChunkPool& instance();
+
+    /** Returns a free chunk of SLOT_SIZE bytes allocating a new region if the pool is empty.
+
+    \retval nullptr if there is no memory left. */
+    void* allocate();
+
+    /** Returns the chunk previously allocated by allocate() into the pool. */
+    void release(void* _chunk);
+
+    /** Pre-allocates (and pre-faults) regions until the pool memory is not less than _bytes.
+
+    \note The pool never shrinks. */
+    void reserve(uint64_t _bytes);
+
+    /** Map regions from the file instead of anonymous memory, so stored data survives a crash of the process.
+
+    Region N is mapped from offset N * REGION_SIZE of the file. Header slot of each region stores
+    the region number and its address, so the chunks list could be restored from the file.
+
+    \note Not supported on Windows.
+
+    \retval false if the pool already has regions. */
+    bool setBackingFile(int _fd);
+
+    /** Returns index of the chunk previously allocated by allocate().
+
+    Index is the number of the chunk slot in the backing file (see setBackingFile()). */
+    uint32_t index(const void* _chunk) const;
+
+    /** Returns the chunk slot by its index (inverse of index()). */
+    char* slot(uint32_t _index) const;
+
+    /** Returns summary size of all allocated regions. */
+    uint64_t memorySize() const
+    {
+        return static_cast<uint64_t>(m_regionsCount.load(std::memory_order_acquire)) * REGION_SIZE;
+    }
+
+private:
+
+    explicit ChunkPool(bool _hugePages);
+
+    bool pop(uint32_t& _index);
+    void push(uint32_t _first, uint32_t _last);
+    bool grow();
+
+}; // END of class ChunkPool.
+
+#endif // EASY_PROFILER_CHUNK_POOL_H
@@ -0,0 +1,242 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#include <chrono>
+#include <thread>
+#include "clock_calibration.h"
+#include "current_time.h"
+
+#if defined(__APPLE__)
+# include <mach/mach_time.h>
+#elif !defined(_WIN32)
+# include <time.h>
+#endif
+
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__GNUC__) || defined(__clang__))
+# include <cpuid.h>
+# define EASY_CPUID_AVAILABLE
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+ClockCalibration::ClockCalibration(int64_t _exactFrequency)
+    : m_reference(sample())
+    , m_error(0)
+    , m_drift(0)
+    , m_exact(_exactFrequency != 0)
+{
+    m_captureBegin = m_reference;
+    m_frequency.store(_exactFrequency, std::memory_order_release);
+}
+
+void ClockCalibration::reset(int64_t _exactFrequency)
+{
+    const auto reference = sample();
+
+    guard_lock_t lock(m_spin);
+    m_reference = reference;
+    m_captureBegin = reference;
+    m_error = 0;
+    m_drift = 0;
+    m_exact = _exactFrequency != 0;
+    m_frequency.store(_exactFrequency, std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int64_t ClockCalibration::frequency()
+{
+    const auto frequency = m_frequency.load(std::memory_order_acquire);
+    if (frequency != 0)
+        return frequency;
+
+    const auto elapsed = monotonicNanoseconds() - m_reference.nanoseconds;
+    if (elapsed < MIN_INTERVAL)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(MIN_INTERVAL - elapsed));
+
+    refine();
+
+    return m_frequency.load(std::memory_order_acquire);
+}
+
+void ClockCalibration::refine()
+{
+    refine(sample());
+}
+
+double ClockCalibration::error() const
+{
+    guard_lock_t lock(m_spin);
+    return m_error;
+}
+
+void ClockCalibration::beginCapture()
+{
+    const auto current = sample();
+    guard_lock_t lock(m_spin);
+    m_captureBegin = current;
+}
+
+double ClockCalibration::measureDrift()
+{
+    const auto current = sample();
+    refine(current);
+
+    const auto frequency = m_frequency.load(std::memory_order_acquire);
+
+    guard_lock_t lock(m_spin);
+
+    const auto nanoseconds = current.nanoseconds - m_captureBegin.nanoseconds;
+    if (nanoseconds < MIN_INTERVAL || frequency == 0)
+    {
+        m_drift = 0;
+        return m_drift;
+    }
+
+    const auto ticks = static_cast<double>(current.ticks - m_captureBegin.ticks);
+    const auto captureFrequency = ticks * 1e9 / static_cast<double>(nanoseconds);
+    m_drift = (captureFrequency - static_cast<double>(frequency)) * 1e6 / static_cast<double>(frequency);
+
+    return m_drift;
+}
+
+double ClockCalibration::drift() const
+{
+    guard_lock_t lock(m_spin);
+    return m_drift;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int64_t ClockCalibration::hardwareFrequency()
+{
+#if defined(EASY_CPUID_AVAILABLE)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    // CPUID.80000007H:EDX[8] - invariant TSC (runs at constant rate in all ACPI P-, C- and T-states)
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+        return 0;
+    __cpuid(0x80000007, eax, ebx, ecx, edx);
+    if ((edx & (1U << 8)) == 0)
+        return 0;
+
+    // CPUID.15H - TSC/crystal clock ratio (EBX/EAX) and crystal clock frequency (ECX, 0 if not enumerated)
+    if (__get_cpuid_max(0, nullptr) < 0x15)
+        return 0;
+    __cpuid_count(0x15, 0, eax, ebx, ecx, edx);
+    if (eax == 0 || ebx == 0 || ecx == 0)
+        return 0;
+
+    return static_cast<int64_t>(ecx) * ebx / eax;
+#elif defined(__aarch64__) && !(EASY_CHRONO_HIGHRES_CLOCK || EASY_CHRONO_STEADY_CLOCK)
+    // profiler::clock reads the virtual timer which runs at fixed frequency reported by CNTFRQ
+    uint64_t frequency = 0;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    return static_cast<int64_t>(frequency);
+#else
+    return 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+ClockCalibration::Sample ClockCalibration::sample()
+{
+    // Read monotonic clock between two profiler::clock readings and keep the tightest of a few attempts
+    Sample result;
+    for (int i = 0; i < 5; ++i)
+    {
+        const auto before = profiler::clock::now();
+        const auto nanoseconds = monotonicNanoseconds();
+        const auto after = profiler::clock::now();
+
+        const auto uncertainty = (after - before) >> 1;
+        if (i == 0 || uncertainty < result.uncertainty)
+        {
+            result.ticks = before + uncertainty;
+            result.nanoseconds = nanoseconds;
+            result.uncertainty = uncertainty;
+        }
+    }
+
+    return result;
+}
+
+uint64_t ClockCalibration::monotonicNanoseconds()
+{
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebase = {0, 0};
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#elif defined(_WIN32)
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#else
+    struct timespec ts;
+# ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts); // not affected by NTP frequency adjustments
+# else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+# endif
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+#endif
+}
+
+void ClockCalibration::refine(const Sample& _current)
+{
+    guard_lock_t lock(m_spin);
+    if (m_exact)
+        return;
+
+    const auto nanoseconds = _current.nanoseconds - m_reference.nanoseconds;
+    const auto ticks = _current.ticks - m_reference.ticks;
+    if (nanoseconds == 0 || ticks == 0)
+        return;
+
+    const auto error = static_cast<double>(m_reference.uncertainty + _current.uncertainty) * 1e6 / static_cast<double>(ticks);
+    if (m_frequency.load(std::memory_order_relaxed) != 0 && error >= m_error)
+        return;
+
+    m_error = error;
+    m_frequency.store(static_cast<int64_t>(static_cast<double>(ticks) * 1e9 / static_cast<double>(nanoseconds)), std::memory_order_release);
+}
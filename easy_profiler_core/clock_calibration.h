@@ -0,0 +1,131 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_CLOCK_CALIBRATION_H
+#define EASY_PROFILER_CLOCK_CALIBRATION_H
+
+#include <stdint.h>
+#include <atomic>
+#include <easy/details/profiler_public_types.h>
+#include "spin_lock.h"
+
+/** Frequency of profiler::clock ticks.
+
+If the frequency is known exactly (std::chrono clocks, QueryPerformanceFrequency, ARMv8 CNTFRQ) it is used as is.
+On x86 the invariant TSC frequency is taken from CPUID leaf 0x15 when it reports the crystal clock frequency,
+otherwise it is calibrated against monotonic raw clock: a reference sample is taken on construction
+and every refine() measures the frequency over the whole time elapsed since then. So calibration does not burn CPU
+and becomes more precise the longer the application runs.
+
+Also measures drift of the clock during a capture: the difference between the frequency measured
+from the beginning to the end of the capture and the calibrated frequency.
+*/
+class ClockCalibration EASY_FINAL
+{
+    using guard_lock_t = profiler::guard_lock<profiler::spin_lock>;
+
+    /** Pair of simultaneous profiler::clock and monotonic clock values. */
+    struct Sample
+    {
+        profiler::timestamp_t       ticks = 0; ///< profiler::clock value
+        uint64_t              nanoseconds = 0; ///< Monotonic clock value
+        profiler::timestamp_t uncertainty = 0; ///< Half of profiler::clock ticks spent to read monotonic clock
+    };
+
+    EASY_STATIC_CONSTEXPR uint64_t MIN_INTERVAL = 10000000; ///< Minimal calibration interval in nanoseconds (10 ms)
+
+    Sample                    m_reference; ///< Sample taken on construction
+    Sample                 m_captureBegin; ///< Sample taken on capture start
+    std::atomic<int64_t>      m_frequency; ///< Ticks per second (0 means not calibrated yet)
+    double                        m_error; ///< Relative error of m_frequency in ppm
+    double                        m_drift; ///< Drift during the last capture in ppm
+    mutable profiler::spin_lock    m_spin; ///< Guards everything except m_frequency
+    bool                          m_exact; ///< Is the frequency known exactly
+
+public:
+
+    ClockCalibration(const ClockCalibration&) = delete;
+    ClockCalibration& operator = (const ClockCalibration&) = delete;
+
+    /** \param _exactFrequency Known exact frequency in ticks per second or 0 if it must be found out. */
+    explicit ClockCalibration(int64_t _exactFrequency);
+
+    /** Starts calibration from scratch (used when profiler::clock source is changed).
+
+    \param _exactFrequency Known exact frequency in ticks per second or 0 if it must be found out. */
+    void reset(int64_t _exactFrequency);
+
+    /** Returns ticks per second.
+
+    The first call may wait (without a busy loop) until the minimal calibration interval elapses since construction. */
+    int64_t frequency();
+
+    /** Refines calibrated frequency using the time elapsed since construction. */
+    void refine();
+
+    /** Returns relative error of frequency() in parts per million (0 for exact frequency). */
+    double error() const;
+
+    /** Remembers the moment of capture start. */
+    void beginCapture();
+
+    /** Measures and returns the drift (in ppm) of the clock from the capture start until now.
+
+    Also refines the frequency. Returns 0 if the capture is too short to measure the drift. */
+    double measureDrift();
+
+    /** Returns the drift measured by the last measureDrift() call in ppm. */
+    double drift() const;
+
+    /** Returns the frequency reported by the hardware or 0 if it is unknown. */
+    static int64_t hardwareFrequency();
+
+private:
+
+    static Sample sample();
+    static uint64_t monotonicNanoseconds();
+
+    void refine(const Sample& _current);
+
+}; // END of class ClockCalibration.
+
+#endif // EASY_PROFILER_CLOCK_CALIBRATION_H
@@ -0,0 +1,251 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "clock_source.h"
+#include "clock_calibration.h"
+#include "current_time.h"
+
+#if defined(EASY_X86_CLOCK_AVAILABLE) && !defined(_MSC_VER)
+# include <cpuid.h>
+#endif
+
+#if defined(_WIN32)
+# include <Windows.h>
+#elif defined(__linux__)
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+std::atomic<uint8_t> profiler::clock::currentSource(static_cast<uint8_t>(profiler::ClockSource::Native));
+
+//////////////////////////////////////////////////////////////////////////
+
+static void pinToCpu(unsigned int _cpu)
+{
+#if defined(__linux__) && !defined(__ANDROID__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(_cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << _cpu);
+#else
+    (void)_cpu; // Threads are not pinned, so the test would only catch violations between cores OS has chosen
+#endif
+}
+
+static double measureCallCost(profiler::ClockSource _source)
+{
+    EASY_CONSTEXPR int CALLS = 100000;
+
+    profiler::timestamp_t sum = 0;
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < CALLS; ++i)
+        sum += profiler::clock::read(_source);
+    const auto end = std::chrono::steady_clock::now();
+
+    volatile profiler::timestamp_t sink = sum; // Prevent the loop from being optimized out
+    (void)sink;
+
+    return std::chrono::duration<double, std::nano>(end - begin).count() / CALLS;
+}
+
+/** Two threads pinned to different cores read the clock by turns, each reading must not be less than the previous one. */
+static uint32_t countViolations(profiler::ClockSource _source, unsigned int _cpu1, unsigned int _cpu2)
+{
+    EASY_CONSTEXPR uint32_t ROUNDS = 1000;
+
+    std::atomic<profiler::timestamp_t> stamp(0);
+    std::atomic<uint32_t> turn(0);
+    std::atomic<uint32_t> violations(0);
+
+    auto player = [&](unsigned int _cpu, uint32_t _parity)
+    {
+        pinToCpu(_cpu);
+        for (uint32_t round = 0; round < ROUNDS; ++round)
+        {
+            const uint32_t expected = (round << 1) + _parity;
+            while (turn.load(std::memory_order_acquire) != expected)
+                std::this_thread::yield();
+
+            const auto time = profiler::clock::read(_source);
+            if (time < stamp.load(std::memory_order_relaxed))
+                violations.fetch_add(1, std::memory_order_relaxed);
+
+            stamp.store(time, std::memory_order_relaxed);
+            turn.store(expected + 1, std::memory_order_release);
+        }
+    };
+
+    std::thread first(player, _cpu1, 0U);
+    std::thread second(player, _cpu2, 1U);
+    first.join();
+    second.join();
+
+    return violations.load(std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace profiler { namespace clock {
+
+bool isAvailable(profiler::ClockSource _source)
+{
+    switch (_source)
+    {
+        case profiler::ClockSource::Native:
+            return true;
+
+#ifdef EASY_X86_CLOCK_AVAILABLE
+        case profiler::ClockSource::Rdtsc:
+        case profiler::ClockSource::LfenceRdtsc:
+            return true;
+
+        case profiler::ClockSource::Rdtscp:
+        {
+            // CPUID.80000001H:EDX[27] - RDTSCP instruction is supported
+# ifdef _MSC_VER
+            int regs[4] = {};
+            __cpuid(regs, 0x80000000);
+            if (static_cast<unsigned int>(regs[0]) < 0x80000001)
+                return false;
+            __cpuid(regs, 0x80000001);
+            return (regs[3] & (1 << 27)) != 0;
+# else
+            unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+            if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) == 0)
+                return false;
+            return (edx & (1U << 27)) != 0;
+# endif
+        }
+#endif
+
+#ifdef EASY_POSIX_CLOCK_AVAILABLE
+        case profiler::ClockSource::MonotonicRaw:
+        case profiler::ClockSource::MonotonicCoarse:
+            return true;
+#endif
+
+        default:
+            return false;
+    }
+}
+
+int64_t exactFrequency(profiler::ClockSource _source)
+{
+    switch (_source)
+    {
+        case profiler::ClockSource::MonotonicRaw:
+        case profiler::ClockSource::MonotonicCoarse:
+            return 1000000000LL;
+
+        case profiler::ClockSource::Native:
+        {
+#if defined(EASY_CHRONO_CLOCK)
+            return EASY_CHRONO_CLOCK::period::den / EASY_CHRONO_CLOCK::period::num;
+#elif defined(_WIN32)
+            LARGE_INTEGER freq;
+            QueryPerformanceFrequency(&freq);
+            return static_cast<int64_t>(freq.QuadPart);
+#else
+            return ClockCalibration::hardwareFrequency();
+#endif
+        }
+
+        default:
+            return ClockCalibration::hardwareFrequency();
+    }
+}
+
+profiler::ClockSource resolvedSource()
+{
+    const auto source = static_cast<profiler::ClockSource>(currentSource.load(std::memory_order_relaxed));
+#if defined(EASY_X86_CLOCK_AVAILABLE) && !defined(EASY_CHRONO_CLOCK) && !defined(_WIN32)
+    if (source == profiler::ClockSource::Native)
+        return profiler::ClockSource::Rdtsc;
+#endif
+    return source;
+}
+
+void test(profiler::ClockSource _source, profiler::ClockSourceInfo& _info)
+{
+    _info.source = _source;
+    _info.available = isAvailable(_source);
+    _info.callCost = 0;
+    _info.violations = 0;
+
+    if (!_info.available)
+        return;
+
+    _info.callCost = measureCallCost(_source);
+
+    // Check pairs of the first core with each other core
+    const auto cpus = std::min(std::max(std::thread::hardware_concurrency(), 2U), 16U);
+    for (unsigned int cpu = 1; cpu < cpus; ++cpu)
+        _info.violations += countViolations(_source, 0, cpu);
+}
+
+profiler::ClockSource choose()
+{
+    const profiler::ClockSource candidates[] = {
+        profiler::ClockSource::Rdtsc,
+        profiler::ClockSource::Rdtscp,
+        profiler::ClockSource::LfenceRdtsc,
+        profiler::ClockSource::MonotonicRaw
+    };
+
+    profiler::ClockSourceInfo best;
+    for (auto source : candidates)
+    {
+        profiler::ClockSourceInfo info;
+        test(source, info);
+        if (info.available && info.violations == 0 && (!best.available || info.callCost < best.callCost))
+            best = info;
+    }
+
+    return best.available ? best.source : profiler::ClockSource::Native;
+}
+
+} } // end of namespace profiler::clock.
@@ -0,0 +1,71 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_CLOCK_SOURCE_H
+#define EASY_PROFILER_CLOCK_SOURCE_H
+
+#include <easy/details/profiler_public_types.h>
+
+namespace profiler { namespace clock {
+
+/** Returns true if the clock source is supported by this platform and CPU. */
+bool isAvailable(profiler::ClockSource _source);
+
+/** Returns exact frequency of the clock source in ticks per second or 0 if it must be calibrated. */
+int64_t exactFrequency(profiler::ClockSource _source);
+
+/** Returns the source which is actually read by profiler::clock::now() (Native is resolved if possible). */
+profiler::ClockSource resolvedSource();
+
+/** Measures cost of one reading of the clock source and checks if it is monotonic across CPU cores.
+
+\note Takes a few tens of milliseconds, spawns two threads for each tested pair of CPU cores. */
+void test(profiler::ClockSource _source, profiler::ClockSourceInfo& _info);
+
+/** Tests all sources and returns the cheapest one which is monotonic across CPU cores.
+
+Coarse clock is not considered because of its low resolution. Returns Native if none of the sources passed the test. */
+profiler::ClockSource choose();
+
+} } // end of namespace profiler::clock.
+
+#endif // EASY_PROFILER_CLOCK_SOURCE_H
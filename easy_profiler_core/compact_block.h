@@ -0,0 +1,362 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_COMPACT_BLOCK_H
+#define EASY_PROFILER_COMPACT_BLOCK_H
+
+#include <string.h>
+#include <easy/details/profiler_public_types.h>
+#include <easy/serialized_block.h>
+
+/** Compact encoding of blocks list elements (since v2.3.0).
+
+Each element starts with a tag byte. Arbitrary value tag (COMPACT_VALUE) is followed by ArbitraryValue data as is.
+Block tag has COMPACT_BLOCK bit set and is followed by varint-encoded fields:
+- begin time: absolute (if COMPACT_ABSOLUTE bit is set) or zigzag-encoded delta from the begin time
+  of the previous block of the same thread;
+- duration;
+- block id;
+- run-time name: varint id of interned name (if COMPACT_INTERNED_NAME bit is set)
+  or '\0'-terminated name (if COMPACT_INLINE_NAME bit is set).
+
+Dropped calls tag (COMPACT_DROPPED, since v2.6.0) is followed by varint-encoded block id and number of calls
+of this block which were dropped by sampling during the frame preceding this element. COMPACT_FRAME bit
+is set if this frame has been stored.
+
+Performance counters tag (COMPACT_COUNTERS, since v2.7.0) follows the block which these counters belong to
+and is followed by varint-encoded mask of sampled counters and varint-encoded value of each sampled counter.
+
+Allocations tag (COMPACT_ALLOCATIONS, since v2.8.0) follows the block (and it's performance counters if any)
+which these allocations belong to and is followed by varint-encoded inclusive bytes and number of allocations
+and varint-encoded bytes and number of allocations made by child blocks (zero for leaf blocks).
+
+Flow tag (COMPACT_FLOW, since v2.9.0) is COMPACT_DROPPED tag combined with COMPACT_INLINE_NAME bit which is never set
+for dropped calls. It is followed by varint-encoded flow point type (see profiler::FlowPointType), flow id and absolute time.
+The point belongs to the innermost block containing this time which is stored later (when it would be closed).
+
+Blocks are decoded into usual SerializedBlock while reading.
+*/
+
+EASY_CONSTEXPR uint8_t COMPACT_VALUE = 0x00;
+EASY_CONSTEXPR uint8_t COMPACT_BLOCK = 0x01;
+EASY_CONSTEXPR uint8_t COMPACT_ABSOLUTE = 0x02;
+EASY_CONSTEXPR uint8_t COMPACT_INTERNED_NAME = 0x04;
+EASY_CONSTEXPR uint8_t COMPACT_INLINE_NAME = 0x08;
+EASY_CONSTEXPR uint8_t COMPACT_DROPPED = 0x10;
+EASY_CONSTEXPR uint8_t COMPACT_FRAME = 0x20;
+EASY_CONSTEXPR uint8_t COMPACT_COUNTERS = 0x40;
+EASY_CONSTEXPR uint8_t COMPACT_ALLOCATIONS = 0x80;
+EASY_CONSTEXPR uint8_t COMPACT_FLOW = COMPACT_DROPPED | COMPACT_INLINE_NAME;
+
+EASY_CONSTEXPR uint16_t MAX_VARINT_SIZE = 10;
+EASY_CONSTEXPR uint16_t MAX_COMPACT_BLOCK_SIZE = 1 + MAX_VARINT_SIZE * 3 + 5; ///< Max size of a block without inline name
+EASY_CONSTEXPR uint16_t MAX_COMPACT_COUNTERS_SIZE = 1 + MAX_VARINT_SIZE * (1 + profiler::PERF_COUNTERS_NUMBER);
+EASY_CONSTEXPR uint16_t MAX_COMPACT_ALLOCATIONS_SIZE = 1 + MAX_VARINT_SIZE * 4;
+EASY_CONSTEXPR uint16_t MAX_COMPACT_FLOW_SIZE = 1 + MAX_VARINT_SIZE * 3;
+
+struct CompactBlock
+{
+    profiler::timestamp_t begin = 0;
+    profiler::timestamp_t   end = 0;
+    uint64_t             nameId = 0; ///< Interned name id (valid if COMPACT_INTERNED_NAME bit is set)
+    const char*            name = nullptr; ///< Inline name (valid if COMPACT_INLINE_NAME bit is set)
+    uint16_t         nameLength = 0; ///< Inline name length without trailing '\0'
+    profiler::block_id_t     id = 0;
+    uint8_t                 tag = COMPACT_BLOCK;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+inline char* writeVarint(char* _data, uint64_t _value)
+{
+    while (_value >= 0x80)
+    {
+        *_data++ = static_cast<char>(_value | 0x80);
+        _value >>= 7;
+    }
+
+    *_data++ = static_cast<char>(_value);
+    return _data;
+}
+
+inline uint16_t varintSize(uint64_t _value)
+{
+    uint16_t size = 1;
+    while (_value >= 0x80)
+    {
+        ++size;
+        _value >>= 7;
+    }
+
+    return size;
+}
+
+inline bool readVarint(const char*& _data, const char* _end, uint64_t& _value)
+{
+    // Fast path: most of the values (ids, durations and deltas of short blocks) are encoded by 1 byte
+    if (_data != _end && (static_cast<uint8_t>(*_data) & 0x80) == 0)
+    {
+        _value = static_cast<uint8_t>(*_data++);
+        return true;
+    }
+
+    _value = 0;
+    for (unsigned shift = 0; _data != _end && shift < 64; shift += 7)
+    {
+        const auto byte = static_cast<uint8_t>(*_data++);
+        _value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+inline uint64_t zigzagEncode(int64_t _value)
+{
+    return (static_cast<uint64_t>(_value) << 1) ^ static_cast<uint64_t>(_value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t _value)
+{
+    return static_cast<int64_t>(_value >> 1) ^ -static_cast<int64_t>(_value & 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/** Encodes block into buffer.
+
+\param _buffer Buffer of at least MAX_COMPACT_BLOCK_SIZE bytes (+ inline name length + 1)
+\param _block Block to encode. Begin time is encoded as delta if COMPACT_ABSOLUTE bit is not set.
+\param _previousBegin Begin time of the previous block
+
+\retval Encoded size in bytes. */
+inline uint16_t encodeCompactBlock(char* _buffer, const CompactBlock& _block, profiler::timestamp_t _previousBegin)
+{
+    char* data = _buffer;
+    *data++ = static_cast<char>(_block.tag);
+
+    if (_block.tag & COMPACT_ABSOLUTE)
+        data = writeVarint(data, _block.begin);
+    else
+        data = writeVarint(data, zigzagEncode(static_cast<int64_t>(_block.begin - _previousBegin)));
+
+    data = writeVarint(data, _block.end - _block.begin);
+    data = writeVarint(data, _block.id);
+
+    if (_block.tag & COMPACT_INTERNED_NAME)
+    {
+        data = writeVarint(data, _block.nameId);
+    }
+    else if (_block.tag & COMPACT_INLINE_NAME)
+    {
+        memcpy(data, _block.name, _block.nameLength);
+        data += _block.nameLength;
+        *data++ = 0;
+    }
+
+    return static_cast<uint16_t>(data - _buffer);
+}
+
+/** Decodes block.
+
+\param _data Encoded block (starting with the tag byte)
+\param _end End of encoded block data
+\param _previousBegin Begin time of the previous block
+\param _block Decoded block
+
+\retval false if data is corrupted. */
+inline bool decodeCompactBlock(const char* _data, const char* _end, profiler::timestamp_t _previousBegin, CompactBlock& _block)
+{
+    if (_data == _end)
+        return false;
+
+    _block.tag = static_cast<uint8_t>(*_data++);
+
+    uint64_t begin = 0, duration = 0, id = 0;
+    if (!readVarint(_data, _end, begin) || !readVarint(_data, _end, duration) || !readVarint(_data, _end, id))
+        return false;
+
+    _block.begin = (_block.tag & COMPACT_ABSOLUTE) ? begin : _previousBegin + static_cast<uint64_t>(zigzagDecode(begin));
+    _block.end = _block.begin + duration;
+    _block.id = static_cast<profiler::block_id_t>(id);
+
+    if (_block.tag & COMPACT_INTERNED_NAME)
+        return readVarint(_data, _end, _block.nameId);
+
+    if (_block.tag & COMPACT_INLINE_NAME)
+    {
+        const auto length = strnlen(_data, static_cast<size_t>(_end - _data));
+        if (_data + length == _end)
+            return false;
+
+        _block.name = _data;
+        _block.nameLength = static_cast<uint16_t>(length);
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/** Encodes performance counters into buffer of at least MAX_COMPACT_COUNTERS_SIZE bytes.
+
+\retval Encoded size in bytes. */
+inline uint16_t encodeCompactCounters(char* _buffer, const profiler::PerfCounters& _counters)
+{
+    char* data = _buffer;
+    *data++ = static_cast<char>(COMPACT_COUNTERS);
+
+    data = writeVarint(data, _counters.mask);
+    for (int i = 0; i < profiler::PERF_COUNTERS_NUMBER; ++i)
+    {
+        if (_counters.has(static_cast<profiler::PerfCounter>(i)))
+            data = writeVarint(data, _counters.values[i]);
+    }
+
+    return static_cast<uint16_t>(data - _buffer);
+}
+
+/** Decodes performance counters (values of not sampled counters are set to 0).
+
+\retval false if data is corrupted. */
+inline bool decodeCompactCounters(const char* _data, const char* _end, profiler::PerfCounters& _counters)
+{
+    if (_data == _end)
+        return false;
+
+    uint64_t mask = 0;
+    ++_data; // skip the tag
+    if (!readVarint(_data, _end, mask) || mask >= (1U << profiler::PERF_COUNTERS_NUMBER))
+        return false;
+
+    _counters.mask = static_cast<uint8_t>(mask);
+    for (int i = 0; i < profiler::PERF_COUNTERS_NUMBER; ++i)
+    {
+        _counters.values[i] = 0;
+        if (_counters.has(static_cast<profiler::PerfCounter>(i)) && !readVarint(_data, _end, _counters.values[i]))
+            return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/** Encodes allocations into buffer of at least MAX_COMPACT_ALLOCATIONS_SIZE bytes.
+
+\retval Encoded size in bytes. */
+inline uint16_t encodeCompactAllocations(char* _buffer, const profiler::Allocations& _allocations)
+{
+    char* data = _buffer;
+    *data++ = static_cast<char>(COMPACT_ALLOCATIONS);
+
+    data = writeVarint(data, _allocations.bytes);
+    data = writeVarint(data, _allocations.count);
+    data = writeVarint(data, _allocations.bytes - _allocations.self_bytes);
+    data = writeVarint(data, _allocations.count - _allocations.self_count);
+
+    return static_cast<uint16_t>(data - _buffer);
+}
+
+/** Decodes allocations.
+
+\retval false if data is corrupted. */
+inline bool decodeCompactAllocations(const char* _data, const char* _end, profiler::Allocations& _allocations)
+{
+    if (_data == _end)
+        return false;
+
+    uint64_t childrenBytes = 0, childrenCount = 0;
+    ++_data; // skip the tag
+    if (!readVarint(_data, _end, _allocations.bytes) || !readVarint(_data, _end, _allocations.count) ||
+        !readVarint(_data, _end, childrenBytes) || !readVarint(_data, _end, childrenCount) ||
+        childrenBytes > _allocations.bytes || childrenCount > _allocations.count)
+    {
+        return false;
+    }
+
+    _allocations.self_bytes = _allocations.bytes - childrenBytes;
+    _allocations.self_count = _allocations.count - childrenCount;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/** Encodes flow point into buffer of at least MAX_COMPACT_FLOW_SIZE bytes.
+
+\retval Encoded size in bytes. */
+inline uint16_t encodeCompactFlow(char* _buffer, profiler::FlowPointType _type, uint64_t _id, profiler::timestamp_t _time)
+{
+    char* data = _buffer;
+    *data++ = static_cast<char>(COMPACT_FLOW);
+
+    data = writeVarint(data, static_cast<uint64_t>(_type));
+    data = writeVarint(data, _id);
+    data = writeVarint(data, _time);
+
+    return static_cast<uint16_t>(data - _buffer);
+}
+
+/** Decodes flow point.
+
+\retval false if data is corrupted. */
+inline bool decodeCompactFlow(const char* _data, const char* _end, profiler::FlowPointType& _type, uint64_t& _id, profiler::timestamp_t& _time)
+{
+    if (_data == _end)
+        return false;
+
+    uint64_t type = 0;
+    ++_data; // skip the tag
+    if (!readVarint(_data, _end, type) || type >= static_cast<uint64_t>(profiler::FlowPointType::TypesCount) ||
+        !readVarint(_data, _end, _id) || !readVarint(_data, _end, _time))
+    {
+        return false;
+    }
+
+    _type = static_cast<profiler::FlowPointType>(type);
+
+    return true;
+}
+
+#endif // EASY_PROFILER_COMPACT_BLOCK_H
@@ -0,0 +1,1035 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <vector>
+#include <string.h>
+#include <easy/reader.h>
+#include "crash_recovery.h"
+#include "descriptor_registry.h"
+#include "compact_block.h"
+#include "clock_source.h"
+#include "thread_storage.h"
+
+#ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
+# include <signal.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+extern const uint32_t EASY_PROFILER_SIGNATURE;
+extern const uint32_t EASY_PROFILER_VERSION;
+
+static const char* const REGIONS_FILE = "/regions";
+static const char* const THREADS_FILE = "/threads";
+static const char* const DESCRIPTORS_FILE = "/descriptors";
+static const char* const NAMES_FILE = "/names";
+
+EASY_CONSTEXPR size_t NO_THREAD = ~static_cast<size_t>(0); ///< Record is not used by any collected thread
+EASY_CONSTEXPR size_t THREADS_FILE_SIZE = sizeof(CrashRecoveryHeader) + CrashRecovery::MAX_THREADS * sizeof(CrashThreadRecord);
+
+static_assert(sizeof(CrashThreadRecord) == 128, "CrashThreadRecord size is changed: threads file layout would be incompatible");
+
+//////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+static void write(std::ostream& _stream, const char* _data, T _size)
+{
+    _stream.write(_data, _size);
+}
+
+template <class T>
+static void write(std::ostream& _stream, const T& _data)
+{
+    _stream.write((const char*)&_data, sizeof(T));
+}
+
+template <class T>
+static void append(std::string& _buffer, const T& _data)
+{
+    _buffer.append(reinterpret_cast<const char*>(&_data), sizeof(T));
+}
+
+#ifndef _WIN32
+static bool writeAll(int _fd, const std::string& _buffer)
+{
+    const char* data = _buffer.data();
+    size_t size = _buffer.size();
+    while (size != 0)
+    {
+        const auto written = ::write(_fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+/** Append data written into the file since the previous call. */
+static void readAppended(int _fd, std::string& _buffer)
+{
+    char data[4096];
+    for (;;)
+    {
+        const auto bytes = ::read(_fd, data, sizeof(data));
+        if (bytes > 0)
+            _buffer.append(data, static_cast<size_t>(bytes));
+        else if (bytes == 0 || errno != EINTR)
+            break;
+    }
+}
+
+static bool isProcessAlive(uint64_t _processId)
+{
+    return kill(static_cast<pid_t>(_processId), 0) == 0 || errno == EPERM;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+CrashRecovery& CrashRecovery::instance()
+{
+    // Like ChunkPool, it is never destroyed because mapped records are used by thread storages
+    // which could be destroyed after static objects destruction
+    static CrashRecovery* crashRecovery = new CrashRecovery();
+    return *crashRecovery;
+}
+
+CrashRecovery::CrashRecovery()
+    : m_header(nullptr)
+    , m_threads(nullptr)
+    , m_descriptorsFile(-1)
+    , m_namesFile(-1)
+{
+    m_journaledDescriptors = ATOMIC_VAR_INIT(0);
+    m_isOpened = ATOMIC_VAR_INIT(false);
+}
+
+bool CrashRecovery::open(const char* _directory, uint64_t _processId)
+{
+#ifdef _WIN32
+    (void)_directory;
+    (void)_processId;
+    return false;
+#else
+    guard_lock_t lock(m_lock);
+
+    if (isOpened() || _directory == nullptr || *_directory == 0)
+        return false;
+
+    const auto directory = std::string(_directory) + "/easy_capture_" + std::to_string(_processId);
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        return false;
+
+    const int regionsFile = ::open((directory + REGIONS_FILE).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    const int threadsFile = ::open((directory + THREADS_FILE).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    const int descriptorsFile = ::open((directory + DESCRIPTORS_FILE).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    const int namesFile = ::open((directory + NAMES_FILE).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+
+    void* threads = MAP_FAILED;
+    if (threadsFile != -1 && ftruncate(threadsFile, static_cast<off_t>(THREADS_FILE_SIZE)) == 0)
+        threads = mmap(nullptr, THREADS_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, threadsFile, 0);
+
+    // Mapping stays valid after closing the file
+    if (threadsFile != -1)
+        ::close(threadsFile);
+
+    if (regionsFile == -1 || threads == MAP_FAILED || descriptorsFile == -1 || namesFile == -1
+        || !ChunkPool::instance().setBackingFile(regionsFile))
+    {
+        if (threads != MAP_FAILED)
+            munmap(threads, THREADS_FILE_SIZE);
+        for (int fd : {regionsFile, descriptorsFile, namesFile})
+        {
+            if (fd != -1)
+                ::close(fd);
+        }
+
+        for (auto file : {REGIONS_FILE, THREADS_FILE, DESCRIPTORS_FILE, NAMES_FILE})
+            unlink((directory + file).c_str());
+        rmdir(directory.c_str());
+
+        return false;
+    }
+
+    m_header = static_cast<CrashRecoveryHeader*>(threads);
+    m_threads = reinterpret_cast<CrashThreadRecord*>(m_header + 1);
+    m_header->signature = EASY_PROFILER_SIGNATURE;
+    m_header->version = EASY_PROFILER_VERSION;
+    m_header->processId = _processId;
+    m_header->collectorProcessId.store(0, std::memory_order_relaxed);
+
+    m_directory = directory;
+    m_descriptorsFile = descriptorsFile;
+    m_namesFile = namesFile;
+    m_isOpened.store(true, std::memory_order_release);
+
+    return true;
+#endif
+}
+
+void CrashRecovery::close()
+{
+#ifndef _WIN32
+    guard_lock_t lock(m_lock);
+
+    if (!m_isOpened.exchange(false, std::memory_order_acq_rel))
+        return;
+
+    // Regions file stays opened: ChunkPool may still grow. Removing of the opened file is allowed on Unix.
+    ::close(m_descriptorsFile);
+    ::close(m_namesFile);
+    m_descriptorsFile = m_namesFile = -1;
+
+    for (auto file : {REGIONS_FILE, THREADS_FILE, DESCRIPTORS_FILE, NAMES_FILE})
+        unlink((m_directory + file).c_str());
+    rmdir(m_directory.c_str());
+#endif
+}
+
+void CrashRecovery::waitForCollector(uint32_t _timeoutMs) const
+{
+#ifdef _WIN32
+    (void)_timeoutMs;
+#else
+    if (!isOpened())
+        return;
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_timeoutMs);
+    for (;;)
+    {
+        const auto collector = m_header->collectorProcessId.load(std::memory_order_acquire);
+        if (collector == 0 || !isProcessAlive(collector) || std::chrono::steady_clock::now() > deadline)
+            return;
+
+        bool collected = true;
+        for (uint32_t i = 0, threadsCount = m_header->threadsCount; i < threadsCount && collected; ++i)
+        {
+            const auto& record = m_threads[i];
+            const auto marked = record.blocks.marked.load(std::memory_order_acquire);
+            collected = record.used.load(std::memory_order_acquire) == 0 || marked == 0
+                || marked == record.blocks.read.load(std::memory_order_acquire)
+                || marked == record.blocks.consumed.load(std::memory_order_acquire);
+        }
+
+        if (collected)
+            return;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+#endif
+}
+
+void CrashRecovery::updateHeader(int64_t _frequency, profiler::timestamp_t _beginTime, profiler::timestamp_t _blockOverhead, uint16_t _clockSource)
+{
+    if (!isOpened())
+        return;
+
+    m_header->frequency = _frequency;
+    m_header->beginTime = _beginTime;
+    m_header->blockOverhead = _blockOverhead;
+    m_header->clockSource = _clockSource;
+}
+
+CrashThreadRecord* CrashRecovery::addThread(profiler::thread_id_t _id)
+{
+    guard_lock_t lock(m_lock);
+
+    if (!isOpened())
+        return nullptr;
+
+    for (uint32_t i = 0; i < MAX_THREADS; ++i)
+    {
+        auto& record = m_threads[i];
+        if (record.used.load(std::memory_order_relaxed) != 0)
+            continue;
+
+        if (++record.generation == 0)
+            record.generation = 1;
+
+        record.blocks.read.store(0, std::memory_order_relaxed);
+        record.blocks.marked.store(0, std::memory_order_relaxed);
+        record.blocks.consumed.store(0, std::memory_order_relaxed);
+        record.threadId = _id;
+        record.nameSize = 0;
+        record.used.store(record.generation, std::memory_order_release);
+
+        if (i >= m_header->threadsCount)
+            m_header->threadsCount = i + 1;
+
+        return &record;
+    }
+
+    return nullptr;
+}
+
+void CrashRecovery::removeThread(CrashThreadRecord& _record)
+{
+    _record.used.store(0, std::memory_order_release);
+}
+
+void CrashRecovery::setThreadName(CrashThreadRecord& _record, const std::string& _name)
+{
+    const auto size = std::min(_name.size(), sizeof(_record.name) - 1);
+    memcpy(_record.name, _name.c_str(), size);
+    _record.name[size] = 0;
+    _record.nameSize = static_cast<uint16_t>(size + 1);
+}
+
+void CrashRecovery::journalDescriptors(const DescriptorRegistry& _descriptors)
+{
+    const auto count = _descriptors.size();
+    if (m_journaledDescriptors.load(std::memory_order_acquire) >= count)
+        return;
+
+    guard_lock_t lock(m_lock);
+
+    if (!isOpened())
+        return;
+
+    std::string buffer;
+    for (auto id = m_journaledDescriptors.load(std::memory_order_relaxed); id < count; ++id)
+    {
+        // Descriptor may still be under construction by another thread
+        const BlockDescriptor* descriptor = _descriptors.get(id);
+        while (descriptor == nullptr)
+        {
+            std::this_thread::yield();
+            descriptor = _descriptors.get(id);
+        }
+
+        // The same format as descriptors section of .prof file
+        const auto name_size = descriptor->nameSize();
+        const auto filename_size = descriptor->filenameSize();
+        const auto size = static_cast<uint16_t>(sizeof(profiler::SerializedBlockDescriptor) + name_size + filename_size);
+
+        append(buffer, size);
+        append<profiler::BaseBlockDescriptor>(buffer, *descriptor);
+        append(buffer, name_size);
+        buffer.append(descriptor->name(), name_size);
+        buffer.append(descriptor->filename(), filename_size);
+    }
+
+#ifndef _WIN32
+    writeAll(m_descriptorsFile, buffer);
+#endif
+    m_journaledDescriptors.store(count, std::memory_order_release);
+}
+
+void CrashRecovery::journalName(const CrashThreadRecord& _record, const char* _name, uint16_t _length)
+{
+    guard_lock_t lock(m_lock);
+
+    if (!isOpened())
+        return;
+
+    std::string buffer;
+    append(buffer, static_cast<uint32_t>(&_record - m_threads));
+    append(buffer, _record.used.load(std::memory_order_relaxed));
+    append(buffer, static_cast<uint16_t>(_length + 1));
+    buffer.append(_name, _length);
+    buffer.push_back(0);
+
+#ifndef _WIN32
+    writeAll(m_namesFile, buffer);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef _WIN32
+
+/** Reads blocks stored by another process in its capture directory.
+
+Used both for recovering data of a crashed process and for collecting data of a living one.
+Each collect() reads frames closed since the previous call, so data of a living process is read incrementally.
+Files are kept opened, so they could be read after the process removes them on exit.
+*/
+class CaptureReader EASY_FINAL
+{
+    struct Thread
+    {
+        std::string                     blocks; ///< Collected elements in .prof format
+        std::vector<uint32_t>    globalNameIds; ///< Ids of thread-local run-time names in the global names table
+        std::string                       name;
+        profiler::thread_id_t               id = 0;
+        profiler::timestamp_t    previousBegin = 0; ///< Begin time of the last collected block
+        uint64_t                      position = 0; ///< End of collected data
+        uint64_t                          read = 0; ///< Read cursor of the owner thread at the moment of the last collect()
+        uint32_t                         count = 0; ///< Number of collected elements
+        uint32_t                    generation = 0; ///< Generation of the record used by the thread
+    };
+
+    struct Cursor
+    {
+        uint32_t  generation;
+        uint64_t        read;
+        uint64_t      marked;
+    };
+
+    EASY_STATIC_CONSTEXPR uint32_t SlotsPerRegion = ChunkPool::REGION_SIZE / ChunkPool::SLOT_SIZE;
+
+    std::vector<Thread>                     m_threads; ///< All collected threads including finished ones
+    std::vector<size_t>               m_recordThreads; ///< Index of the thread in m_threads using each record
+    std::vector<std::pair<uint64_t, uint32_t> > m_addresses; ///< (region address in the captured process, region number) sorted by address
+    std::map<uint64_t, std::vector<std::string> > m_names; ///< Journaled run-time names by (record index << 32 | generation)
+    std::vector<std::string>            m_globalNames; ///< Run-time names of all collected threads
+    std::string                       m_descriptors; ///< Descriptors journal data
+    std::string                      m_namesJournal; ///< Not parsed names journal data
+    CrashRecoveryHeader*                   m_header;
+    CrashThreadRecord*              m_threadRecords;
+    const char*                           m_regions; ///< Mapped regions file
+    size_t                            m_regionsSize;
+    uint64_t                      m_namesMemorySize;
+    uint64_t                       m_usedMemorySize;
+    profiler::timestamp_t               m_beginTime;
+    profiler::timestamp_t                 m_endTime;
+    uint32_t                         m_writtenParts; ///< Number of parts written and released by release()
+    int                               m_regionsFile;
+    int                           m_descriptorsFile;
+    int                                 m_namesFile;
+    bool                              m_isCollector;
+
+public:
+
+    CaptureReader()
+        : m_header(nullptr)
+        , m_threadRecords(nullptr)
+        , m_regions(nullptr)
+        , m_regionsSize(0)
+        , m_namesMemorySize(0)
+        , m_usedMemorySize(0)
+        , m_beginTime(~0ULL)
+        , m_endTime(0)
+        , m_writtenParts(0)
+        , m_regionsFile(-1)
+        , m_descriptorsFile(-1)
+        , m_namesFile(-1)
+        , m_isCollector(false)
+    {
+    }
+
+    ~CaptureReader()
+    {
+        if (m_isCollector)
+            m_header->collectorProcessId.store(0, std::memory_order_release);
+        if (m_regions != nullptr)
+            munmap(const_cast<char*>(m_regions), m_regionsSize);
+        if (m_header != nullptr)
+            munmap(m_header, THREADS_FILE_SIZE);
+        for (int fd : {m_regionsFile, m_descriptorsFile, m_namesFile})
+        {
+            if (fd != -1)
+                ::close(fd);
+        }
+    }
+
+    /** Open files of the capture directory.
+
+    \param _writable If true then collected positions are written back into the threads file,
+    so threads of a living process could reuse memory of collected data.
+    */
+    bool open(const std::string& _directory, bool _writable, std::ostream& _log)
+    {
+        const int threadsFile = ::open((_directory + THREADS_FILE).c_str(), _writable ? O_RDWR : O_RDONLY);
+        struct stat threadsStat;
+        if (threadsFile == -1 || fstat(threadsFile, &threadsStat) != 0 || static_cast<size_t>(threadsStat.st_size) < THREADS_FILE_SIZE)
+        {
+            if (threadsFile != -1)
+                ::close(threadsFile);
+            _log << "Can not read \"" << _directory << THREADS_FILE << "\"";
+            return false;
+        }
+
+        // Threads file is mapped as shared even for reading to see changes made by a living process
+        auto threads = mmap(nullptr, THREADS_FILE_SIZE, _writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, threadsFile, 0);
+        ::close(threadsFile);
+        if (threads == MAP_FAILED)
+        {
+            _log << "Can not map \"" << _directory << THREADS_FILE << "\"";
+            return false;
+        }
+
+        m_header = static_cast<CrashRecoveryHeader*>(threads);
+        m_threadRecords = reinterpret_cast<CrashThreadRecord*>(m_header + 1);
+        if (m_header->signature != EASY_PROFILER_SIGNATURE || m_header->version != EASY_PROFILER_VERSION)
+        {
+            _log << "Capture has been made by another version of easy_profiler";
+            return false;
+        }
+
+        m_regionsFile = ::open((_directory + REGIONS_FILE).c_str(), O_RDONLY);
+        m_descriptorsFile = ::open((_directory + DESCRIPTORS_FILE).c_str(), O_RDONLY);
+        m_namesFile = ::open((_directory + NAMES_FILE).c_str(), O_RDONLY);
+        if (m_regionsFile == -1 || m_descriptorsFile == -1 || m_namesFile == -1)
+        {
+            _log << "Can not open files in \"" << _directory << "\"";
+            return false;
+        }
+
+        m_recordThreads.assign(CrashRecovery::MAX_THREADS, NO_THREAD);
+
+        if (_writable)
+            m_header->collectorProcessId.store(static_cast<uint64_t>(getpid()), std::memory_order_release);
+        m_isCollector = _writable;
+
+        return true;
+    }
+
+    uint64_t processId() const
+    {
+        return m_header->processId;
+    }
+
+    /** Collect frames closed since the previous call.
+
+    \param _consume If true then threads are allowed to reuse memory of collected data.
+    \retval false if blocks list of some thread is broken (the captured process could be writing it while crashing).
+    */
+    bool collect(bool _consume, std::ostream& _log)
+    {
+        const auto threadsCount = m_header->threadsCount < CrashRecovery::MAX_THREADS ? m_header->threadsCount : CrashRecovery::MAX_THREADS;
+
+        // Positions are loaded before reading other files: regions, names and descriptors used by closed frames
+        // are written into files before these frames are published
+        std::vector<Cursor> cursors(threadsCount);
+        for (uint32_t i = 0; i < threadsCount; ++i)
+        {
+            const auto& record = m_threadRecords[i];
+            auto& cursor = cursors[i];
+            cursor.generation = record.used.load(std::memory_order_acquire);
+            cursor.marked = record.blocks.marked.load(std::memory_order_acquire);
+            cursor.read = record.blocks.read.load(std::memory_order_acquire);
+        }
+
+        if (!updateRegions())
+            return true; // Nothing has been stored yet
+
+        readAppended(m_descriptorsFile, m_descriptors);
+        readNames();
+
+        bool valid = true;
+        for (uint32_t i = 0; i < threadsCount; ++i)
+        {
+            const auto& cursor = cursors[i];
+            if (cursor.generation == 0)
+            {
+                m_recordThreads[i] = NO_THREAD;
+                continue;
+            }
+
+            auto& record = m_threadRecords[i];
+            if (m_recordThreads[i] == NO_THREAD || m_threads[m_recordThreads[i]].generation != cursor.generation)
+            {
+                m_recordThreads[i] = m_threads.size();
+                m_threads.emplace_back();
+                m_threads.back().id = record.threadId;
+                m_threads.back().generation = cursor.generation;
+            }
+
+            auto& thread = m_threads[m_recordThreads[i]];
+            if (record.nameSize != 0)
+                thread.name.assign(record.name, strnlen(record.name, sizeof(record.name)));
+
+            // Continue from the end of collected data unless the owner thread has moved its read cursor
+            // by itself (data has been dumped or dropped by flight recorder)
+            const bool continued = thread.position != 0 && (cursor.read == thread.read || cursor.read == thread.position);
+            const auto start = continued ? thread.position : cursor.read;
+            if (start == cursor.marked)
+                continue;
+
+            const auto& names = m_names[(static_cast<uint64_t>(i) << 32) | cursor.generation];
+            while (thread.globalNameIds.size() < names.size())
+            {
+                const auto& name = names[thread.globalNameIds.size()];
+                thread.globalNameIds.push_back(static_cast<uint32_t>(m_globalNames.size()));
+                m_globalNames.push_back(name);
+                m_namesMemorySize += name.size() + 1;
+            }
+
+            if (!walk(thread, start, cursor.marked))
+            {
+                _log << "Blocks list of thread " << thread.id << " is broken, collected " << thread.count << " blocks\n";
+                valid = false;
+                continue;
+            }
+
+            thread.position = cursor.marked;
+            thread.read = cursor.read;
+            if (_consume)
+                record.blocks.consumed.store(cursor.marked, std::memory_order_release);
+        }
+
+        return valid;
+    }
+
+    /** Write collected data as a .prof file.
+
+    \retval Number of written blocks.
+    */
+    uint32_t write(std::ostream& _outputStream) const
+    {
+        uint32_t blocksNumber = 0, threadsCount = 0;
+        for (const auto& thread : m_threads)
+        {
+            if (thread.count != 0)
+            {
+                blocksNumber += thread.count;
+                ++threadsCount;
+            }
+        }
+
+        if (blocksNumber == 0)
+            return 0;
+
+        // Descriptors journal is written in .prof format
+        uint32_t descriptorsCount = 0;
+        uint64_t descriptorsMemorySize = 0;
+        size_t descriptorsDataSize = 0;
+        while (descriptorsDataSize + sizeof(uint16_t) <= m_descriptors.size())
+        {
+            uint16_t size = 0;
+            memcpy(&size, m_descriptors.data() + descriptorsDataSize, sizeof(uint16_t));
+            if (descriptorsDataSize + sizeof(uint16_t) + size > m_descriptors.size())
+                break;
+
+            descriptorsDataSize += sizeof(uint16_t) + size;
+            descriptorsMemorySize += size;
+            ++descriptorsCount;
+        }
+
+        // Only the first part starts when profiling was enabled, the others start from their first block
+        const auto& header = *m_header;
+        const auto beginTime = header.beginTime != 0 && m_writtenParts == 0 ? std::min(header.beginTime, m_beginTime) : m_beginTime;
+
+        // The same format as ProfileManager::dumpBlocksToStream() writes
+        ::write(_outputStream, EASY_PROFILER_SIGNATURE);
+        ::write(_outputStream, EASY_PROFILER_VERSION);
+        ::write(_outputStream, header.processId);
+        ::write(_outputStream, header.frequency);
+        ::write(_outputStream, beginTime);
+        ::write(_outputStream, m_endTime);
+        ::write(_outputStream, m_usedMemorySize);
+        ::write(_outputStream, descriptorsMemorySize);
+        ::write(_outputStream, blocksNumber);
+        ::write(_outputStream, descriptorsCount);
+        ::write(_outputStream, threadsCount);
+        ::write(_outputStream, static_cast<uint16_t>(0)); // Bookmarks count
+        ::write(_outputStream, header.clockSource);
+        ::write(_outputStream, header.blockOverhead);
+
+        ::write(_outputStream, m_descriptors.data(), descriptorsDataSize);
+
+        ::write(_outputStream, static_cast<uint32_t>(m_globalNames.size()));
+        ::write(_outputStream, m_namesMemorySize);
+        for (const auto& name : m_globalNames)
+        {
+            const auto name_size = static_cast<uint16_t>(name.size() + 1);
+            ::write(_outputStream, name_size);
+            ::write(_outputStream, name.c_str(), name_size);
+        }
+
+        for (const auto& thread : m_threads)
+        {
+            if (thread.count == 0)
+                continue;
+
+            ::write(_outputStream, thread.id);
+            const auto name_size = static_cast<uint16_t>(thread.name.size() + 1);
+            ::write(_outputStream, name_size);
+            ::write(_outputStream, thread.name.c_str(), name_size);
+
+            ::write(_outputStream, static_cast<uint32_t>(0)); // Context switch events are not stored in files
+            ::write(_outputStream, thread.count);
+            ::write(_outputStream, thread.blocks.data(), thread.blocks.size());
+        }
+
+        ::write(_outputStream, EASY_PROFILER_SIGNATURE);
+
+        return blocksNumber;
+    }
+
+    /** Size of collected elements not released yet. */
+    uint64_t collectedSize() const
+    {
+        uint64_t size = 0;
+        for (const auto& thread : m_threads)
+            size += thread.blocks.size();
+        return size;
+    }
+
+    /** Release collected elements after they have been written, so the next write() produces the next part.
+
+    Collection always stops at the last mark of each thread and the first block after a mark has absolute
+    begin time, so every part is decoded independently. Descriptors and run-time names are kept:
+    they are small and blocks of the next parts may refer to them.
+    */
+    void release()
+    {
+        // Finished threads are not used by any record and will never get new data
+        std::vector<size_t> indices(m_threads.size(), NO_THREAD);
+        for (auto index : m_recordThreads)
+        {
+            if (index != NO_THREAD)
+                indices[index] = 0;
+        }
+
+        size_t used = 0;
+        for (size_t i = 0; i < m_threads.size(); ++i)
+        {
+            if (indices[i] == NO_THREAD)
+                continue;
+
+            indices[i] = used;
+            if (used != i)
+                m_threads[used] = std::move(m_threads[i]);
+
+            auto& thread = m_threads[used++];
+            std::string().swap(thread.blocks);
+            thread.count = 0;
+        }
+
+        m_threads.resize(used);
+        for (auto& index : m_recordThreads)
+        {
+            if (index != NO_THREAD)
+                index = indices[index];
+        }
+
+        m_beginTime = ~0ULL;
+        m_endTime = 0;
+        m_usedMemorySize = 0;
+        ++m_writtenParts;
+    }
+
+private:
+
+    /** Map regions file again if it has grown and restore addresses of regions in the captured process. */
+    bool updateRegions()
+    {
+        struct stat regionsStat;
+        if (fstat(m_regionsFile, &regionsStat) != 0)
+            return m_regions != nullptr;
+
+        const auto size = static_cast<size_t>(regionsStat.st_size) / ChunkPool::REGION_SIZE * ChunkPool::REGION_SIZE;
+        if (size == 0 || size == m_regionsSize)
+            return m_regions != nullptr;
+
+        auto regions = mmap(nullptr, size, PROT_READ, MAP_SHARED, m_regionsFile, 0);
+        if (regions == MAP_FAILED)
+            return m_regions != nullptr;
+
+        if (m_regions != nullptr)
+            munmap(const_cast<char*>(m_regions), m_regionsSize);
+        m_regions = static_cast<const char*>(regions);
+        m_regionsSize = size;
+
+        m_addresses.clear();
+        for (uint32_t number = 0, regionsNumber = static_cast<uint32_t>(size / ChunkPool::REGION_SIZE); number < regionsNumber; ++number)
+        {
+            uint64_t address = 0;
+            memcpy(&address, m_regions + static_cast<size_t>(number) * ChunkPool::REGION_SIZE + sizeof(uint64_t), sizeof(uint64_t));
+            if (address != 0)
+                m_addresses.emplace_back(address, number);
+        }
+        std::sort(m_addresses.begin(), m_addresses.end());
+
+        return true;
+    }
+
+    /** Parse names journal records: (record index, record generation, name size, name). */
+    void readNames()
+    {
+        readAppended(m_namesFile, m_namesJournal);
+
+        EASY_CONSTEXPR size_t HeaderSize = sizeof(uint32_t) * 2 + sizeof(uint16_t);
+
+        size_t offset = 0;
+        while (offset + HeaderSize <= m_namesJournal.size())
+        {
+            uint32_t index = 0, generation = 0;
+            uint16_t size = 0;
+            memcpy(&index, m_namesJournal.data() + offset, sizeof(uint32_t));
+            memcpy(&generation, m_namesJournal.data() + offset + sizeof(uint32_t), sizeof(uint32_t));
+            memcpy(&size, m_namesJournal.data() + offset + sizeof(uint32_t) * 2, sizeof(uint16_t));
+
+            if (size == 0 || offset + HeaderSize + size > m_namesJournal.size())
+                break; // the record is being written
+
+            m_names[(static_cast<uint64_t>(index) << 32) | generation].emplace_back(m_namesJournal.data() + offset + HeaderSize, size - 1);
+            offset += HeaderSize + size;
+        }
+
+        m_namesJournal.erase(0, offset);
+    }
+
+    const char* chunkAt(uint32_t _index) const
+    {
+        if (_index / SlotsPerRegion >= m_regionsSize / ChunkPool::REGION_SIZE || _index % SlotsPerRegion == 0)
+            return nullptr;
+        return m_regions + static_cast<size_t>(_index) * ChunkPool::SLOT_SIZE;
+    }
+
+    uint32_t indexOf(uintptr_t _address) const
+    {
+        const auto address = static_cast<uint64_t>(_address);
+        auto it = std::upper_bound(m_addresses.begin(), m_addresses.end(), std::make_pair(address, ~0U));
+        if (it == m_addresses.begin())
+            return 0;
+        --it;
+
+        const auto offset = address - it->first;
+        if (offset >= ChunkPool::REGION_SIZE || offset % ChunkPool::SLOT_SIZE != 0)
+            return 0;
+
+        return it->second * SlotsPerRegion + static_cast<uint32_t>(offset / ChunkPool::SLOT_SIZE);
+    }
+
+    /** Append elements between _start and _marked positions to collected data of the thread
+    replacing thread-local run-time name ids with global ones. */
+    bool walk(Thread& _thread, uint64_t _start, uint64_t _marked)
+    {
+        return chunk_allocator<CHUNK_SIZE>::walk_persistent(_start, _marked,
+            [this](uint32_t _index) { return chunkAt(_index); },
+            [this](uintptr_t _address) { return indexOf(_address); },
+            [this, &_thread](const char* _data, uint16_t _payloadSize)
+        {
+            const char* payload = _data + sizeof(uint16_t);
+            const auto tag = static_cast<uint8_t>(*payload);
+
+            if ((tag & COMPACT_BLOCK) == 0 || (tag & COMPACT_DROPPED) != 0)
+            {
+                // Memory accounting is the same as in ThreadStorage::beginRead()
+                if (tag & COMPACT_COUNTERS)
+                    m_usedMemorySize += sizeof(profiler::PerfCounters);
+                else if (tag & COMPACT_ALLOCATIONS)
+                    m_usedMemorySize += sizeof(profiler::Allocations);
+                else if ((tag & COMPACT_DROPPED) == 0)
+                    m_usedMemorySize += _payloadSize - 1;
+                _thread.blocks.append(_data, sizeof(uint16_t) + _payloadSize);
+                ++_thread.count;
+                return;
+            }
+
+            CompactBlock block;
+            const auto base = _thread.previousBegin;
+            if (!decodeCompactBlock(payload, payload + _payloadSize, base, block))
+                return;
+
+            _thread.previousBegin = block.begin;
+            m_beginTime = std::min(m_beginTime, block.begin);
+            m_endTime = std::max(m_endTime, block.end);
+            m_usedMemorySize += sizeof(profiler::BaseBlockData) + 1;
+
+            if ((tag & COMPACT_INTERNED_NAME) == 0)
+            {
+                _thread.blocks.append(_data, sizeof(uint16_t) + _payloadSize);
+                ++_thread.count;
+                return;
+            }
+
+            if (block.nameId < _thread.globalNameIds.size())
+            {
+                block.nameId = _thread.globalNameIds[static_cast<size_t>(block.nameId)];
+                m_usedMemorySize += m_globalNames[static_cast<size_t>(block.nameId)].size();
+            }
+            else
+            {
+                // The name has not been written into journal (the process has crashed while writing it)
+                block.tag &= ~COMPACT_INTERNED_NAME;
+            }
+
+            // Encoding with the same base keeps delta of begin time unchanged
+            char buffer[sizeof(uint16_t) + MAX_COMPACT_BLOCK_SIZE];
+            const uint16_t size = encodeCompactBlock(buffer + sizeof(uint16_t), block, base);
+            unaligned_store16(buffer, size);
+
+            _thread.blocks.append(buffer, sizeof(uint16_t) + size);
+            ++_thread.count;
+        });
+    }
+
+}; // END of class CaptureReader.
+
+#endif // _WIN32
+
+//////////////////////////////////////////////////////////////////////////
+
+uint32_t CrashRecovery::recover(const char* _directory, std::ostream& _outputStream, std::ostream& _log)
+{
+#ifdef _WIN32
+    (void)_directory;
+    (void)_outputStream;
+    _log << "Crash recovery is not supported on Windows";
+    return 0;
+#else
+    CaptureReader reader;
+    if (!reader.open(_directory, false, _log))
+        return 0;
+
+    reader.collect(false, _log);
+
+    const auto blocksNumber = reader.write(_outputStream);
+    if (blocksNumber == 0)
+        _log << "Nothing to recover";
+
+    return blocksNumber;
+#endif
+}
+
+#ifndef _WIN32
+/** Name of the part file: "capture.prof" for the first part, "capture.1.prof" for the second and so on. */
+static std::string partFilename(const std::string& _filename, uint32_t _part)
+{
+    if (_part == 0)
+        return _filename;
+
+    const auto slash = _filename.find_last_of("/\\");
+    auto dot = _filename.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = _filename.size();
+
+    std::string filename(_filename, 0, dot);
+    filename += '.';
+    filename += std::to_string(_part);
+    filename.append(_filename, dot, std::string::npos);
+    return filename;
+}
+#endif
+
+uint32_t CrashRecovery::collect(const char* _directory, const char* _filename, uint32_t _intervalMs, uint64_t _partSize,
+                                const std::atomic<bool>& _stop, std::ostream& _log)
+{
+#ifdef _WIN32
+    (void)_directory;
+    (void)_filename;
+    (void)_intervalMs;
+    (void)_partSize;
+    (void)_stop;
+    _log << "Collecting is not supported on Windows";
+    return 0;
+#else
+    CaptureReader reader;
+    if (!reader.open(_directory, true, _log))
+        return 0;
+
+    uint32_t blocksNumber = 0, part = 0;
+    const auto writePart = [&]() -> bool
+    {
+        const auto filename = partFilename(_filename, part);
+        std::ofstream outputFile(filename.c_str(), std::fstream::binary);
+        if (!outputFile.is_open())
+        {
+            _log << "Can not open \"" << filename << "\" for writing";
+            return false;
+        }
+
+        blocksNumber += reader.write(outputFile);
+        reader.release();
+        ++part;
+
+        return true;
+    };
+
+    // Files stay opened after the process removes them on exit, so the last frames are collected too
+    bool alive = true;
+    while (alive && !_stop.load(std::memory_order_acquire))
+    {
+        alive = isProcessAlive(reader.processId());
+        reader.collect(true, _log);
+
+        // Collected data is written in parts, so memory of the collector is bounded by the part size
+        if (_partSize != 0 && reader.collectedSize() >= _partSize && !writePart())
+            return blocksNumber;
+
+        if (alive)
+            std::this_thread::sleep_for(std::chrono::milliseconds(_intervalMs));
+    }
+
+    if (reader.collectedSize() != 0 && !writePart())
+        return blocksNumber;
+
+    if (blocksNumber == 0)
+        _log << "Nothing has been collected";
+    else if (part > 1)
+        _log << "Collected data has been written into " << part << " files: \"" << _filename << "\" ... \""
+             << partFilename(_filename, part - 1) << "\"";
+
+    return blocksNumber;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+extern "C" PROFILER_API uint32_t recoverCrashCapture(const char* capture_directory, const char* filename, std::ostream& _log)
+{
+    std::ofstream outputFile(filename, std::fstream::binary);
+    if (!outputFile.is_open())
+    {
+        _log << "Can not open \"" << filename << "\" for writing";
+        return 0;
+    }
+
+    return CrashRecovery::recover(capture_directory, outputFile, _log);
+}
+
+extern "C" PROFILER_API uint32_t collectCapture(const char* capture_directory, const char* filename, uint32_t interval_ms,
+                                                uint64_t part_size, const std::atomic<bool>& stop, std::ostream& _log)
+{
+    return CrashRecovery::collect(capture_directory, filename, interval_ms, part_size, stop, _log);
+}
@@ -0,0 +1,180 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_CRASH_RECOVERY_H
+#define EASY_PROFILER_CRASH_RECOVERY_H
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <easy/details/profiler_public_types.h>
+#include "chunk_allocator.h"
+#include "spin_lock.h"
+
+class DescriptorRegistry;
+
+//////////////////////////////////////////////////////////////////////////
+
+/** Header of the threads file in the crash recovery directory. */
+struct CrashRecoveryHeader
+{
+    uint32_t           signature; ///< EASY_PROFILER_SIGNATURE
+    uint32_t             version; ///< EASY_PROFILER_VERSION
+    uint64_t           processId;
+    int64_t            frequency; ///< Clock frequency at the moment of the last setEnabled(true)
+    uint64_t           beginTime; ///< Time of the last setEnabled(true)
+    uint64_t       blockOverhead;
+    uint32_t        threadsCount; ///< Number of records which have been ever used
+    uint16_t         clockSource;
+    uint16_t            reserved;
+    std::atomic<uint64_t> collectorProcessId; ///< Process id of attached collector (0 if there is no collector)
+};
+
+/** Record of a thread in the threads file of the crash recovery directory. */
+struct CrashThreadRecord
+{
+    persistent_cursor     blocks; ///< Positions of stored blocks in the regions file
+    uint64_t            threadId;
+    std::atomic<uint32_t>   used; ///< Generation of the thread which uses the record (0 if the record is free)
+    uint32_t          generation; ///< Last generation of the record
+    uint16_t            nameSize; ///< Size of the name including trailing '\0'
+    char               name[86]; ///< Thread name (truncated)
+};
+
+/** Files in which profiled blocks survive a crash of the process (Unix only).
+
+The capture directory contains:
+- regions: memory of ChunkPool (see ChunkPool::setBackingFile());
+- threads: CrashRecoveryHeader followed by CrashThreadRecord array. Every thread mirrors the position
+  of its first not serialized block and its last closed frame (see chunk_allocator::set_persistent());
+- descriptors: journal of registered block descriptors in .prof file format;
+- names: journal of interned run-time names: (record index, record generation, name size, name).
+
+Only rare events (registering of a new thread, descriptor or run-time name) are written into files
+explicitly, so storing blocks costs the same as without crash recovery.
+
+Files are removed on normal process exit. recover() converts files left by a crashed process into a .prof file.
+collect() drains frames of a living process (files could be placed in shared memory, e.g. /dev/shm on Linux).
+*/
+class CrashRecovery EASY_FINAL
+{
+    using guard_lock_t = profiler::guard_lock<profiler::spin_lock>;
+
+    std::string                   m_directory; ///< Capture directory of current process
+    CrashRecoveryHeader*             m_header; ///< Mapped header of the threads file
+    CrashThreadRecord*              m_threads; ///< Mapped records of the threads file
+    profiler::spin_lock                m_lock; ///< Guards journals and threads records allocation
+    std::atomic<uint32_t> m_journaledDescriptors; ///< Number of descriptors written into descriptors journal
+    int                     m_descriptorsFile;
+    int                           m_namesFile;
+    std::atomic_bool               m_isOpened;
+
+    CrashRecovery();
+
+public:
+
+    EASY_STATIC_CONSTEXPR uint32_t MAX_THREADS = 4096; ///< Max number of simultaneously living threads with crash-survivable storage
+
+    CrashRecovery(const CrashRecovery&) = delete;
+    CrashRecovery& operator = (const CrashRecovery&) = delete;
+
+    static CrashRecovery& instance();
+
+    /** Create "easy_capture_<pid>" directory inside _directory and back ChunkPool memory by a file in it.
+
+    \note Must be called before the first block is stored (ChunkPool must be empty).
+    */
+    bool open(const char* _directory, uint64_t _processId);
+
+    /** Remove files (called on normal process exit). Mapped memory stays valid. */
+    void close();
+
+    /** Wait until attached collector (if any) collects all closed frames (called on normal process exit).
+
+    Storage of threads is released on exit, so not collected frames would be lost otherwise.
+    */
+    void waitForCollector(uint32_t _timeoutMs) const;
+
+    bool isOpened() const
+    {
+        return m_isOpened.load(std::memory_order_acquire);
+    }
+
+    const std::string& directory() const
+    {
+        return m_directory;
+    }
+
+    void updateHeader(int64_t _frequency, profiler::timestamp_t _beginTime, profiler::timestamp_t _blockOverhead, uint16_t _clockSource);
+
+    CrashThreadRecord* addThread(profiler::thread_id_t _id);
+    void removeThread(CrashThreadRecord& _record);
+    void setThreadName(CrashThreadRecord& _record, const std::string& _name);
+
+    /** Write descriptors registered since the previous call into descriptors journal. */
+    void journalDescriptors(const DescriptorRegistry& _descriptors);
+
+    /** Write a new interned run-time name of the thread into names journal. */
+    void journalName(const CrashThreadRecord& _record, const char* _name, uint16_t _length);
+
+    /** Write blocks left by a crashed process in _directory as a .prof file.
+
+    \retval Number of recovered blocks. If 0 then there is nothing to recover or an error occured.
+    */
+    static uint32_t recover(const char* _directory, std::ostream& _outputStream, std::ostream& _log);
+
+    /** Collect frames of a living process from _directory every _intervalMs until the process exits or _stop is set.
+
+    Collected positions are written back into the threads file, so threads of the process reuse memory
+    of collected data (see chunk_allocator::apply_consumed()). Collected data is written into _filename at the end.
+    If _partSize is not 0 then a part is written as soon as collected data exceeds _partSize bytes and released
+    afterwards, next parts are written into "<name>.1.<ext>", "<name>.2.<ext>" and so on.
+
+    \retval Number of collected blocks in all parts.
+    */
+    static uint32_t collect(const char* _directory, const char* _filename, uint32_t _intervalMs, uint64_t _partSize,
+                            const std::atomic<bool>& _stop, std::ostream& _log);
+
+}; // END of class CrashRecovery.
+
+#endif // EASY_PROFILER_CRASH_RECOVERY_H
@@ -0,0 +1,144 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#include <algorithm>
+#include <string.h>
+#include "cswitch_log.h"
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+CSwitchLog::CSwitchLog()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_records(nullptr)
+    , m_count(0)
+{
+}
+
+CSwitchLog::~CSwitchLog()
+{
+#ifndef _WIN32
+    if (m_data != nullptr)
+        munmap(m_data, m_size);
+#endif
+}
+
+bool CSwitchLog::open(const char* _filename)
+{
+#ifdef _WIN32
+    (void)_filename;
+    return false;
+#else
+    const int fd = ::open(_filename, O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(CSwitchLogHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // The logger may be appending records right now: only complete records are used
+    const auto size = static_cast<size_t>(fileStat.st_size);
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    CSwitchLogHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.signature != CSWITCH_LOG_SIGNATURE || header.version != CSWITCH_LOG_VERSION || header.recordSize != sizeof(CSwitchLogRecord))
+    {
+        munmap(data, size);
+        return false;
+    }
+
+    m_data = data;
+    m_size = size;
+    m_records = reinterpret_cast<const CSwitchLogRecord*>(static_cast<const char*>(data) + sizeof(CSwitchLogHeader));
+    m_count = (size - sizeof(CSwitchLogHeader)) / sizeof(CSwitchLogRecord);
+
+    return true;
+#endif
+}
+
+void CSwitchLog::select(uint32_t _processId, profiler::timestamp_t _begin, profiler::timestamp_t _end, std::vector<uint32_t>& _indices) const
+{
+    _indices.clear();
+
+    // Binary search gives an approximate position only because records are not strictly ordered by time
+    const auto begin = std::lower_bound(m_records, m_records + m_count, _begin,
+        [](const CSwitchLogRecord& _record, profiler::timestamp_t _time) { return _record.timestamp < _time; });
+    const auto end = std::upper_bound(begin, m_records + m_count, _end,
+        [](profiler::timestamp_t _time, const CSwitchLogRecord& _record) { return _time < _record.timestamp; });
+
+    const auto beginIndex = static_cast<size_t>(begin - m_records);
+    const auto first = static_cast<uint32_t>(beginIndex > CSWITCH_LOG_REORDER_WINDOW ? beginIndex - CSWITCH_LOG_REORDER_WINDOW : 0);
+    const auto last = static_cast<uint32_t>(std::min(static_cast<size_t>(end - m_records) + CSWITCH_LOG_REORDER_WINDOW, m_count));
+
+    // Branchless compaction: index is always written and the output position advances only for matching records
+    _indices.resize(last - first);
+    uint32_t* output = _indices.data();
+    size_t found = 0;
+    for (uint32_t i = first; i < last; ++i)
+    {
+        const auto& record = m_records[i];
+        output[found] = i;
+        found += static_cast<size_t>(((record.processFrom == _processId) | (record.processTo == _processId))
+                                     & (record.timestamp >= _begin) & (record.timestamp <= _end));
+    }
+
+    _indices.resize(found);
+
+    // Stable sort keeps the log order of records with equal timestamps
+    std::stable_sort(_indices.begin(), _indices.end(), [this](uint32_t _a, uint32_t _b) {
+        return m_records[_a].timestamp < m_records[_b].timestamp;
+    });
+}
@@ -0,0 +1,133 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_CSWITCH_LOG_H
+#define EASY_PROFILER_CSWITCH_LOG_H
+
+#include <stdint.h>
+#include <vector>
+#include <easy/details/profiler_public_types.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+/** Header of binary context switch log (see scripts/context_switch_logger_binary.stp). */
+struct CSwitchLogHeader
+{
+    uint64_t  signature; ///< CSWITCH_LOG_SIGNATURE ("EASYCSW1")
+    uint32_t    version; ///< CSWITCH_LOG_VERSION
+    uint32_t recordSize; ///< sizeof(CSwitchLogRecord)
+};
+
+/** Fixed-size record of binary context switch log.
+
+Records are only roughly ordered by time: SystemTap merges them from per-CPU buffers,
+so a record may be written after records with greater timestamps (see CSWITCH_LOG_REORDER_WINDOW).
+*/
+struct CSwitchLogRecord
+{
+    uint64_t      timestamp;
+    uint64_t     threadFrom;
+    uint64_t       threadTo;
+    uint32_t    processFrom;
+    uint32_t      processTo;
+    char     targetName[16]; ///< Name of the target thread padded by spaces or '\0' (not '\0'-terminated if it is 16 characters long)
+};
+
+/** Context switch captured by the event tracer (see event_trace_linux.h). */
+struct CSwitchEvent
+{
+    profiler::timestamp_t   timestamp;
+    profiler::thread_id_t  threadFrom;
+    profiler::thread_id_t    threadTo;
+    uint32_t                processTo;
+    const char*            targetName; ///< Must stay valid until threadFrom is switched in again
+};
+
+EASY_CONSTEXPR uint64_t CSWITCH_LOG_SIGNATURE = 0x3157534359534145ULL;
+EASY_CONSTEXPR uint32_t CSWITCH_LOG_VERSION = 1;
+
+/** Max distance (in records) between the position of a record in the log and its position in order of time. */
+EASY_CONSTEXPR size_t CSWITCH_LOG_REORDER_WINDOW = 1 << 16;
+
+static_assert(sizeof(CSwitchLogHeader) == 16, "CSwitchLogHeader layout must match the logger script");
+static_assert(sizeof(CSwitchLogRecord) == 48, "CSwitchLogRecord layout must match the logger script");
+
+/** Memory-mapped binary context switch log (Unix only).
+
+Records are not parsed: the log is mapped as is and records of the capture time range are found by binary search
+widened by CSWITCH_LOG_REORDER_WINDOW records on both sides, then each record is filtered by time.
+*/
+class CSwitchLog EASY_FINAL
+{
+    void*                        m_data; ///< Mapped file
+    size_t                       m_size; ///< Size of mapped file
+    const CSwitchLogRecord*   m_records;
+    size_t                      m_count; ///< Number of complete records
+
+public:
+
+    CSwitchLog(const CSwitchLog&) = delete;
+    CSwitchLog& operator = (const CSwitchLog&) = delete;
+
+    CSwitchLog();
+    ~CSwitchLog();
+
+    /** Map the log file.
+
+    \retval false if the file can not be opened or if it is not a binary log (e.g. text log of the old logger script).
+    */
+    bool open(const char* _filename);
+
+    /** Find records within [_begin, _end] time range which switch from or to a thread of the process.
+
+    \param _indices Indices of found records sorted by time.
+    */
+    void select(uint32_t _processId, profiler::timestamp_t _begin, profiler::timestamp_t _end, std::vector<uint32_t>& _indices) const;
+
+    const CSwitchLogRecord& operator [] (size_t _index) const
+    {
+        return m_records[_index];
+    }
+
+}; // END of class CSwitchLog.
+
+#endif // EASY_PROFILER_CSWITCH_LOG_H
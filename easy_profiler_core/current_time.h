@@ -44,6 +44,7 @@ The Apache License, Version 2.0 (the "License");
 #define EASY_PROFILER_CURRENT_TIME_H
 
 #include <easy/details/profiler_public_types.h>
+#include <atomic>
 
 #if defined(_MSC_VER) && _MSC_VER <= 1800
 // std::chrono for MSVC2013 is broken - it has very low resolution of 16ms
@@ -72,9 +73,30 @@ The Apache License, Version 2.0 (the "License");
 # endif//__ARM_ARCH
 #endif
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+# include <intrin.h>
+# define EASY_X86_CLOCK_AVAILABLE
+#elif (defined(__GNUC__) || defined(__ICC)) && (defined(__i386__) || defined(__x86_64__) || defined(__amd64__))
+# define EASY_X86_CLOCK_AVAILABLE
+#endif
+
+#ifdef __linux__
+# include <time.h>
+#endif
+
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_RAW) && defined(CLOCK_MONOTONIC_COARSE)
+# define EASY_POSIX_CLOCK_AVAILABLE
+#endif
+
 namespace profiler { namespace clock {
 
-static inline profiler::timestamp_t now()
+/** Clock source selected at run time (profiler::ClockSource value, Native by default).
+
+\note Must be changed only while profiler is disabled. See ProfileManager::setClockSource(). */
+extern std::atomic<uint8_t> currentSource;
+
+/** Clock chosen at compile time. */
+static inline profiler::timestamp_t native()
 {
 #if EASY_CHRONO_HIGHRES_CLOCK || EASY_CHRONO_STEADY_CLOCK
     return (profiler::timestamp_t)EASY_CHRONO_CLOCK::now().time_since_epoch().count();
@@ -172,6 +194,79 @@ static inline profiler::timestamp_t now()
 #endif
 }
 
+#ifdef EASY_X86_CLOCK_AVAILABLE
+static inline profiler::timestamp_t rdtsc()
+{
+# ifdef _MSC_VER
+    return __rdtsc();
+# else
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return (static_cast<profiler::timestamp_t>(high) << 32) | low;
+# endif
+}
+
+static inline profiler::timestamp_t rdtscp()
+{
+# ifdef _MSC_VER
+    unsigned int aux;
+    return __rdtscp(&aux);
+# else
+    uint32_t low, high, aux;
+    __asm__ volatile("rdtscp" : "=a"(low), "=d"(high), "=c"(aux));
+    return (static_cast<profiler::timestamp_t>(high) << 32) | low;
+# endif
+}
+
+static inline profiler::timestamp_t lfenceRdtsc()
+{
+# ifdef _MSC_VER
+    _mm_lfence();
+    return __rdtsc();
+# else
+    uint32_t low, high;
+    __asm__ volatile("lfence\n\trdtsc" : "=a"(low), "=d"(high) :: "memory");
+    return (static_cast<profiler::timestamp_t>(high) << 32) | low;
+# endif
+}
+#endif
+
+#ifdef EASY_POSIX_CLOCK_AVAILABLE
+static inline profiler::timestamp_t posixClock(clockid_t _clock)
+{
+    // Both clocks are read via vDSO without a system call
+    struct timespec ts;
+    clock_gettime(_clock, &ts);
+    return static_cast<profiler::timestamp_t>(ts.tv_sec) * 1000000000ULL + static_cast<profiler::timestamp_t>(ts.tv_nsec);
+}
+#endif
+
+/** Reads specified clock source. Unsupported sources fall back to native(). */
+static inline profiler::timestamp_t read(profiler::ClockSource _source)
+{
+    switch (_source)
+    {
+#ifdef EASY_X86_CLOCK_AVAILABLE
+        case profiler::ClockSource::Rdtsc: return rdtsc();
+        case profiler::ClockSource::Rdtscp: return rdtscp();
+        case profiler::ClockSource::LfenceRdtsc: return lfenceRdtsc();
+#endif
+#ifdef EASY_POSIX_CLOCK_AVAILABLE
+        case profiler::ClockSource::MonotonicRaw: return posixClock(CLOCK_MONOTONIC_RAW);
+        case profiler::ClockSource::MonotonicCoarse: return posixClock(CLOCK_MONOTONIC_COARSE);
+#endif
+        default: return native();
+    }
+}
+
+static inline profiler::timestamp_t now()
+{
+    const auto source = currentSource.load(std::memory_order_relaxed);
+    if (source == 0)
+        return native();
+    return read(static_cast<profiler::ClockSource>(source));
+}
+
 } } // end of namespace profiler::clock.
 
 #endif // EASY_PROFILER_CURRENT_TIME_H
@@ -0,0 +1,208 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "descriptor_registry.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+static size_t hashString(const char* _str)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *_str != 0; ++_str)
+    {
+        hash ^= static_cast<unsigned char>(*_str);
+        hash *= 1099511628211ULL;
+    }
+
+    return static_cast<size_t>(hash);
+}
+
+static size_t alignedSize(size_t _size)
+{
+    EASY_CONSTEXPR size_t alignment = sizeof(void*) > sizeof(uint64_t) ? sizeof(void*) : sizeof(uint64_t);
+    return (_size + alignment - 1) & ~(alignment - 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+DescriptorRegistry::DescriptorRegistry()
+    : m_arena(nullptr)
+    , m_arenaOffset(0)
+    , m_arenaSize(0)
+{
+    for (auto& bucket : m_buckets)
+        bucket.store(nullptr, std::memory_order_relaxed);
+
+    for (auto& segment : m_segments)
+        segment.store(nullptr, std::memory_order_relaxed);
+
+    m_size.store(0, std::memory_order_release);
+}
+
+DescriptorRegistry::~DescriptorRegistry()
+{
+    for (auto& segment : m_segments)
+        delete [] segment.load(std::memory_order_acquire);
+
+    // BlockDescriptor does not own any resources, so there is no need to call destructors
+    while (m_arena != nullptr)
+    {
+        auto prev = m_arena->prev;
+        free(m_arena);
+        m_arena = prev;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+BlockDescriptor* DescriptorRegistry::add(profiler::EasyBlockStatus _defaultStatus, const char* _uniqueId,
+                                         const char* _name, const char* _filename, int _line,
+                                         profiler::block_type_t _block_type, profiler::color_t _color, bool _copyName)
+{
+    const auto hash = hashString(_uniqueId);
+    if (auto node = find(hash, _uniqueId))
+        return node->descriptor;
+
+    const auto bucket = static_cast<uint32_t>(hash & (BUCKETS_NUMBER - 1));
+    guard_lock_t lock(m_locks[bucket % LOCKS_NUMBER]);
+
+    // Check again: the same descriptor could be registered by another thread while we were waiting for the lock
+    if (auto node = find(hash, _uniqueId))
+        return node->descriptor;
+
+    // Descriptors from different buckets are registered concurrently.
+    // Id is taken only if there is a free slot, so m_size never exceeds the capacity.
+    auto id = m_size.load(std::memory_order_acquire);
+    do {
+        if (id >= SEGMENT_SIZE * SEGMENTS_NUMBER)
+            return nullptr; // Too many descriptors
+    } while (!m_size.compare_exchange_weak(id, id + 1, std::memory_order_acq_rel, std::memory_order_acquire));
+
+    const auto segmentIndex = id / SEGMENT_SIZE;
+
+    auto node = reinterpret_cast<Node*>(allocate(sizeof(Node) + sizeof(BlockDescriptor)));
+
+#if EASY_BLOCK_DESC_FULL_COPY == 0
+    const char* filename = _filename;
+#else
+    const char* filename = copy(_filename);
+#endif
+
+    const char* name = _copyName || EASY_BLOCK_DESC_FULL_COPY != 0 ? copy(_name) : _name;
+    auto descriptor = ::new (reinterpret_cast<char*>(node) + sizeof(Node))
+        BlockDescriptor(id, _defaultStatus, name, filename, _line, _block_type, _color);
+
+    node->descriptor = descriptor;
+    node->key = copy(_uniqueId);
+    node->hash = hash;
+    node->next = m_buckets[bucket].load(std::memory_order_acquire);
+
+    segment(segmentIndex)[id % SEGMENT_SIZE].store(descriptor, std::memory_order_release);
+    m_buckets[bucket].store(node, std::memory_order_release);
+
+    return descriptor;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+const DescriptorRegistry::Node* DescriptorRegistry::find(size_t _hash, const char* _key) const
+{
+    const Node* node = m_buckets[_hash & (BUCKETS_NUMBER - 1)].load(std::memory_order_acquire);
+    while (node != nullptr && (node->hash != _hash || strcmp(node->key, _key) != 0))
+        node = node->next;
+    return node;
+}
+
+DescriptorRegistry::slot_t* DescriptorRegistry::segment(uint32_t _index)
+{
+    slot_t* slots = m_segments[_index].load(std::memory_order_acquire);
+    if (slots != nullptr)
+        return slots;
+
+    auto created = new slot_t[SEGMENT_SIZE];
+    for (uint32_t i = 0; i < SEGMENT_SIZE; ++i)
+        created[i].store(nullptr, std::memory_order_relaxed);
+
+    // Several threads registering descriptors from different buckets may create the same segment
+    if (m_segments[_index].compare_exchange_strong(slots, created, std::memory_order_acq_rel, std::memory_order_acquire))
+        return created;
+
+    delete [] created;
+    return slots;
+}
+
+char* DescriptorRegistry::allocate(size_t _size)
+{
+    _size = alignedSize(_size);
+
+    guard_lock_t lock(m_arenaLock);
+
+    if (m_arena == nullptr || m_arenaOffset + _size > m_arenaSize)
+    {
+        const size_t header = alignedSize(sizeof(ArenaBlock));
+        const size_t size = header + _size > ARENA_BLOCK_SIZE ? header + _size : ARENA_BLOCK_SIZE;
+
+        auto block = static_cast<ArenaBlock*>(malloc(size));
+        block->prev = m_arena;
+
+        m_arena = block;
+        m_arenaOffset = header;
+        m_arenaSize = size;
+    }
+
+    char* data = reinterpret_cast<char*>(m_arena) + m_arenaOffset;
+    m_arenaOffset += _size;
+
+    return data;
+}
+
+const char* DescriptorRegistry::copy(const char* _str)
+{
+    const auto size = strlen(_str) + 1;
+    char* data = allocate(size);
+    memcpy(data, _str, size);
+    return data;
+}
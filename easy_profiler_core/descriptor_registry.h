@@ -0,0 +1,161 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_DESCRIPTOR_REGISTRY_H
+#define EASY_PROFILER_DESCRIPTOR_REGISTRY_H
+
+#include <atomic>
+#include <thread>
+#include "block_descriptor.h"
+#include "spin_lock.h"
+
+/** Concurrent registry of block descriptors.
+
+Descriptors are never removed, so lookups are wait-free: a descriptor is found by walking
+a bucket list which is only prepended while registering. Registering of a new descriptor takes one of a few
+spin locks which are never held by readers (dumping, sending descriptors over network etc.),
+so registration never waits for a dump.
+
+Descriptors are stored in an append-only array of fixed size segments indexed by descriptor id.
+All descriptors, their unique ids and copied names are allocated in a memory arena
+which is released entirely on registry destruction.
+*/
+class DescriptorRegistry EASY_FINAL
+{
+    using guard_lock_t = profiler::guard_lock<profiler::spin_lock>;
+
+    EASY_STATIC_CONSTEXPR uint32_t BUCKETS_NUMBER = 4096; ///< Hash-table size (must be power of 2)
+    EASY_STATIC_CONSTEXPR uint32_t LOCKS_NUMBER = 64; ///< Number of spin locks used for registering
+    EASY_STATIC_CONSTEXPR uint32_t SEGMENT_SIZE = 4096; ///< Number of descriptors in one segment
+    EASY_STATIC_CONSTEXPR uint32_t SEGMENTS_NUMBER = 4096; ///< Maximum number of segments (16M descriptors)
+    EASY_STATIC_CONSTEXPR size_t ARENA_BLOCK_SIZE = 64 * 1024; ///< Memory arena allocation granularity
+
+    struct Node
+    {
+        const Node*            next; ///< Next node in the bucket list
+        BlockDescriptor* descriptor; ///< Registered descriptor
+        const char*             key; ///< Unique descriptor id string (a copy)
+        size_t                 hash; ///< Hash of the key
+    };
+
+    struct ArenaBlock
+    {
+        ArenaBlock* prev; ///< Previously allocated arena block
+    };
+
+    using slot_t = std::atomic<BlockDescriptor*>;
+
+    std::atomic<const Node*> m_buckets[BUCKETS_NUMBER]; ///< Hash-table of registered descriptors
+    std::atomic<slot_t*>   m_segments[SEGMENTS_NUMBER]; ///< Descriptors array segments
+    profiler::spin_lock           m_locks[LOCKS_NUMBER]; ///< Registering locks (one lock for several buckets)
+    profiler::spin_lock                     m_arenaLock; ///< Guards memory arena
+    ArenaBlock*                                 m_arena; ///< Current memory arena block
+    size_t                                m_arenaOffset; ///< Used bytes in current memory arena block
+    size_t                                  m_arenaSize; ///< Size of current memory arena block
+    std::atomic<uint32_t>                        m_size; ///< Number of registered descriptors
+
+public:
+
+    DescriptorRegistry(const DescriptorRegistry&) = delete;
+    DescriptorRegistry& operator = (const DescriptorRegistry&) = delete;
+
+    DescriptorRegistry();
+    ~DescriptorRegistry();
+
+    /** Returns descriptor with specified unique id or registers a new one.
+
+    \retval nullptr if there are already SEGMENT_SIZE * SEGMENTS_NUMBER registered descriptors. */
+    BlockDescriptor* add(profiler::EasyBlockStatus _defaultStatus, const char* _uniqueId, const char* _name,
+                         const char* _filename, int _line, profiler::block_type_t _block_type,
+                         profiler::color_t _color, bool _copyName);
+
+    /** Returns number of registered descriptors.
+
+    \note Some of them may still be under construction. Use forEach() to wait for them. */
+    uint32_t size() const
+    {
+        return m_size.load(std::memory_order_acquire);
+    }
+
+    /** Returns descriptor by id or nullptr if there is no such descriptor (yet). */
+    BlockDescriptor* get(profiler::block_id_t _id) const
+    {
+        const auto segment = _id / SEGMENT_SIZE;
+        if (segment >= SEGMENTS_NUMBER)
+            return nullptr;
+
+        const auto slots = m_segments[segment].load(std::memory_order_acquire);
+        return slots != nullptr ? slots[_id % SEGMENT_SIZE].load(std::memory_order_acquire) : nullptr;
+    }
+
+    /** Calls _func for descriptors with ids [0, _count) in order of ids.
+
+    Waits for descriptors which are still being registered by other threads. */
+    template <class TFunc>
+    void forEach(uint32_t _count, TFunc _func) const
+    {
+        for (profiler::block_id_t id = 0; id < _count; ++id)
+        {
+            const BlockDescriptor* descriptor = get(id);
+            while (descriptor == nullptr)
+            {
+                std::this_thread::yield();
+                descriptor = get(id);
+            }
+
+            _func(*descriptor);
+        }
+    }
+
+private:
+
+    const Node* find(size_t _hash, const char* _key) const;
+
+    slot_t* segment(uint32_t _index);
+
+    char* allocate(size_t _size);
+
+    const char* copy(const char* _str);
+
+}; // END of class DescriptorRegistry.
+
+#endif // EASY_PROFILER_DESCRIPTOR_REGISTRY_H
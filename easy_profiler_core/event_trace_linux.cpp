@@ -0,0 +1,459 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <algorithm>
+#include <fstream>
+#include <errno.h>
+#include <limits>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <easy/profiler.h>
+#include "profile_manager.h"
+#include "current_time.h"
+
+#include "event_trace_linux.h"
+
+#if EASY_OPTION_LOG_ENABLED != 0
+# include <iostream>
+
+# ifndef EASY_ERRORLOG
+#  define EASY_ERRORLOG std::cerr
+# endif
+
+# ifndef EASY_LOG
+#  define EASY_LOG std::cerr
+# endif
+
+# ifndef EASY_ERROR
+#  define EASY_ERROR(LOG_MSG) EASY_ERRORLOG << "EasyProfiler ERROR: " << LOG_MSG
+# endif
+
+# ifndef EASY_WARNING
+#  define EASY_WARNING(LOG_MSG) EASY_ERRORLOG << "EasyProfiler WARNING: " << LOG_MSG
+# endif
+
+# ifndef EASY_LOGMSG
+#  define EASY_LOGMSG(LOG_MSG) EASY_LOG << "EasyProfiler INFO: " << LOG_MSG
+# endif
+
+# ifndef EASY_LOG_ONLY
+#  define EASY_LOG_ONLY(CODE) CODE
+# endif
+
+#else
+
+# ifndef EASY_ERROR
+#  define EASY_ERROR(LOG_MSG) 
+# endif
+
+# ifndef EASY_WARNING
+#  define EASY_WARNING(LOG_MSG) 
+# endif
+
+# ifndef EASY_LOGMSG
+#  define EASY_LOGMSG(LOG_MSG) 
+# endif
+
+# ifndef EASY_LOG_ONLY
+#  define EASY_LOG_ONLY(CODE) 
+# endif
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+EASY_CONSTEXPR size_t DATA_PAGES = 64; ///< Size of ring buffer of each CPU in pages (must be a power of 2)
+EASY_CONSTEXPR int POLL_TIMEOUT = 50; ///< Max time in milliseconds between reading ring buffers
+EASY_CONSTEXPR uint64_t HOLD_BACK_TIME = 1000000; ///< Records younger than this (in nanoseconds) are not stored until the next reading
+                                                  ///< to be sure that records of all CPUs written before them have been read
+
+/** Context switch record with PERF_SAMPLE_TID|TIME attached (sample_id_all). */
+struct PerfSwitchRecord
+{
+    perf_event_header header;
+    uint32_t     nextPrevPid; ///< Process switched in (PERF_RECORD_MISC_SWITCH_OUT) or out
+    uint32_t     nextPrevTid; ///< Thread switched in (PERF_RECORD_MISC_SWITCH_OUT) or out
+    uint32_t             pid; ///< Process of the current thread
+    uint32_t             tid; ///< Current thread
+    uint64_t            time;
+};
+
+static long perfEventOpen(perf_event_attr& _attr, int _cpu)
+{
+    return syscall(__NR_perf_event_open, &_attr, -1, _cpu, -1, 0UL);
+}
+
+static uint64_t monotonicRawNanoseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+#if EASY_OPTION_LOG_ENABLED != 0
+static int perfEventParanoid()
+{
+    int value = 2;
+    std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+    file >> value;
+    return value;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef EASY_MAGIC_STATIC_AVAILABLE
+class EasyEventTracerInstance {
+    friend EasyEventTracer;
+    EasyEventTracer instance;
+} EASY_EVENT_TRACER;
+#endif
+
+EasyEventTracer& EasyEventTracer::instance()
+{
+#ifndef EASY_MAGIC_STATIC_AVAILABLE
+    return EASY_EVENT_TRACER.instance;
+#else
+    static EasyEventTracer tracer;
+    return tracer;
+#endif
+}
+
+EasyEventTracer::EasyEventTracer()
+{
+    m_lowPriority = ATOMIC_VAR_INIT(EASY_OPTION_LOW_PRIORITY_EVENT_TRACING);
+    m_stopReading = ATOMIC_VAR_INIT(false);
+    m_names[0] = "Idle";
+}
+
+EasyEventTracer::~EasyEventTracer()
+{
+    disable();
+}
+
+bool EasyEventTracer::isLowPriority() const
+{
+    return m_lowPriority.load(std::memory_order_acquire);
+}
+
+void EasyEventTracer::setLowPriority(bool _value)
+{
+    m_lowPriority.store(_value, std::memory_order_release);
+}
+
+bool EasyEventTracer::openBuffers(int& _error)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+    attr.sample_id_all = 1;
+    attr.context_switch = 1;
+    attr.use_clockid = 1;
+    attr.clockid = CLOCK_MONOTONIC_RAW;
+    attr.disabled = 1;
+    attr.watermark = 1;
+
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t mapSize = (DATA_PAGES + 1) * pageSize;
+    attr.wakeup_watermark = static_cast<uint32_t>(DATA_PAGES * pageSize / 4);
+
+    const auto cpus = sysconf(_SC_NPROCESSORS_CONF);
+    m_buffers.reserve(static_cast<size_t>(cpus));
+    for (long cpu = 0; cpu < cpus; ++cpu)
+    {
+        const auto fd = perfEventOpen(attr, static_cast<int>(cpu));
+        if (fd < 0)
+        {
+            // Offline CPU
+            if (errno == ENODEV && cpu != 0)
+                continue;
+
+            _error = errno;
+            closeBuffers();
+            return false;
+        }
+
+        Buffer buffer;
+        buffer.fd = static_cast<int>(fd);
+        buffer.data = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, buffer.fd, 0);
+        if (buffer.data == MAP_FAILED)
+        {
+            _error = errno;
+            close(buffer.fd);
+            closeBuffers();
+            return false;
+        }
+
+        m_buffers.push_back(buffer);
+    }
+
+    for (auto& buffer : m_buffers)
+        ioctl(buffer.fd, PERF_EVENT_IOC_ENABLE, 0);
+
+    return true;
+}
+
+void EasyEventTracer::closeBuffers()
+{
+    const size_t mapSize = (DATA_PAGES + 1) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for (auto& buffer : m_buffers)
+    {
+        ioctl(buffer.fd, PERF_EVENT_IOC_DISABLE, 0);
+        munmap(buffer.data, mapSize);
+        close(buffer.fd);
+    }
+
+    m_buffers.clear();
+}
+
+void EasyEventTracer::readBuffer(Buffer& _buffer)
+{
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t dataSize = DATA_PAGES * pageSize;
+
+    auto meta = static_cast<perf_event_mmap_page*>(_buffer.data);
+    const char* data = static_cast<const char*>(_buffer.data) + pageSize;
+
+    const uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = meta->data_tail;
+
+    while (tail < head)
+    {
+        // Records are 8-byte aligned, so the header itself is never wrapped
+        const uint64_t offset = tail & (dataSize - 1);
+        const auto header = reinterpret_cast<const perf_event_header*>(data + offset);
+        if (header->size == 0)
+            break;
+
+        const char* record = data + offset;
+        if (offset + header->size > dataSize)
+        {
+            const auto firstPart = static_cast<size_t>(dataSize - offset);
+            m_wrapBuffer.resize(header->size);
+            memcpy(m_wrapBuffer.data(), record, firstPart);
+            memcpy(m_wrapBuffer.data() + firstPart, data, header->size - firstPart);
+            record = m_wrapBuffer.data();
+        }
+
+        if (header->type == PERF_RECORD_SWITCH_CPU_WIDE)
+        {
+            const auto sw = reinterpret_cast<const PerfSwitchRecord*>(record);
+            if ((header->misc & PERF_RECORD_MISC_SWITCH_OUT) != 0 && (sw->pid == m_processId || sw->nextPrevPid == m_processId))
+                m_pending.push_back(PendingSwitch {sw->time, sw->pid, sw->tid, sw->nextPrevPid, sw->nextPrevTid});
+        }
+        else if (header->type == PERF_RECORD_LOST)
+        {
+            // perf_event_header, u64 id, u64 lost
+            uint64_t lost = 0;
+            memcpy(&lost, record + sizeof(perf_event_header) + sizeof(uint64_t), sizeof(lost));
+            m_lostCount += lost;
+        }
+
+        tail += header->size;
+    }
+
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+const char* EasyEventTracer::processName(uint32_t _processId)
+{
+    auto it = m_names.find(_processId);
+    if (it != m_names.end())
+        return it->second.c_str();
+
+    std::string name;
+    std::ifstream file("/proc/" + std::to_string(_processId) + "/comm");
+    if (!std::getline(file, name))
+        name.clear(); // The process has already finished
+
+    return m_names.emplace(_processId, std::move(name)).first->second.c_str();
+}
+
+void EasyEventTracer::process(uint64_t _until)
+{
+    for (auto& buffer : m_buffers)
+        readBuffer(buffer);
+
+    if (m_pending.empty())
+        return;
+
+    // Records of each CPU are ordered by time, but records of different CPUs are not
+    std::stable_sort(m_pending.begin(), m_pending.end(), [](const PendingSwitch& a, const PendingSwitch& b) {
+        return a.time < b.time;
+    });
+
+    const auto ready = std::lower_bound(m_pending.begin(), m_pending.end(), _until, [](const PendingSwitch& a, uint64_t t) {
+        return a.time < t;
+    });
+
+    if (ready == m_pending.begin())
+        return;
+
+    // Simultaneous profiler::clock and perf clock values for conversion of timestamps
+    const auto before = profiler::clock::now();
+    const auto nanoseconds = monotonicRawNanoseconds();
+    const auto after = profiler::clock::now();
+    const auto ticks = before + ((after - before) >> 1);
+    const double ticksPerNanosecond = static_cast<double>(ProfileManager::instance().clockFrequency()) * 1e-9;
+
+    m_events.clear();
+    m_events.reserve(static_cast<size_t>(ready - m_pending.begin()));
+    for (auto it = m_pending.begin(); it != ready; ++it)
+    {
+        const auto delta = static_cast<double>(static_cast<int64_t>(it->time - nanoseconds)) * ticksPerNanosecond;
+
+        CSwitchEvent event;
+        event.timestamp = static_cast<profiler::timestamp_t>(static_cast<int64_t>(ticks) + static_cast<int64_t>(delta));
+        event.threadFrom = it->tidFrom;
+        event.threadTo = it->tidTo;
+        event.processTo = it->pidTo;
+        event.targetName = it->pidFrom == m_processId ? processName(it->pidTo) : "";
+        m_events.push_back(event);
+    }
+
+    m_pending.erase(m_pending.begin(), ready);
+
+    ProfileManager::instance().storeContextSwitches(m_events.data(), m_events.size());
+}
+
+EventTracingEnableStatus EasyEventTracer::enable(bool /*_force*/)
+{
+    using Status = EventTracingEnableStatus;
+
+    profiler::guard_lock<profiler::spin_lock> lock(m_spin);
+    if (m_bEnabled)
+        return Status::LaunchedSuccessfully;
+
+    m_processId = static_cast<uint32_t>(getpid());
+    m_lostCount = 0;
+    m_pending.clear();
+
+    int error = 0;
+    if (!openBuffers(error))
+    {
+        if (error == EACCES || error == EPERM)
+        {
+            EASY_WARNING("Event tracing not launched: perf_event_open() is not permitted (kernel.perf_event_paranoid = "
+                         << perfEventParanoid() << "). Set it to 0 or less to trace context switches, log-file \""
+                         << ProfileManager::instance().getContextSwitchLogFilename() << "\" will be used instead.\n");
+            return Status::PermissionDenied;
+        }
+
+        EASY_ERROR("Event tracing not launched: perf_event_open() failed: " << strerror(error)
+                   << ". Log-file \"" << ProfileManager::instance().getContextSwitchLogFilename() << "\" will be used instead.\n");
+        return Status::OpenTraceFailed;
+    }
+
+    std::vector<pollfd> fds(m_buffers.size());
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+    {
+        fds[i].fd = m_buffers[i].fd;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+    m_stopReading.store(false, std::memory_order_release);
+    m_processThread = std::thread([this](std::vector<pollfd> _fds, bool _lowPriority)
+    {
+        if (_lowPriority) // Set low priority for event tracing thread (affects only the calling thread on Linux)
+            setpriority(PRIO_PROCESS, 0, 19);
+        EASY_THREAD_SCOPE("EasyProfiler.PerfEvents");
+
+        while (!m_stopReading.load(std::memory_order_acquire))
+        {
+            poll(_fds.data(), _fds.size(), POLL_TIMEOUT);
+            process(monotonicRawNanoseconds() - HOLD_BACK_TIME);
+        }
+
+    }, std::move(fds), m_lowPriority.load(std::memory_order_acquire));
+
+    m_bEnabled = true;
+
+    EASY_LOGMSG("Event tracing launched on " << m_buffers.size() << " CPUs\n");
+    return Status::LaunchedSuccessfully;
+}
+
+void EasyEventTracer::disable()
+{
+    profiler::guard_lock<profiler::spin_lock> lock(m_spin);
+    if (!m_bEnabled)
+        return;
+
+    EASY_LOGMSG("Event tracing is stopping...\n");
+
+    m_stopReading.store(true, std::memory_order_release);
+    if (m_processThread.joinable())
+        m_processThread.join();
+
+    for (auto& buffer : m_buffers)
+        ioctl(buffer.fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    // Store all remaining records
+    process(std::numeric_limits<uint64_t>::max());
+    closeBuffers();
+
+    m_bEnabled = false;
+
+    EASY_LOG_ONLY(
+        if (m_lostCount != 0)
+            EASY_WARNING(m_lostCount << " context switch events were lost because of ring buffer overflow.\n");
+    )
+
+    EASY_LOGMSG("Event tracing stopped\n");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif // __linux__
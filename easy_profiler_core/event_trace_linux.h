@@ -0,0 +1,137 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_EVENT_TRACE_LINUX_H
+#define EASY_PROFILER_EVENT_TRACE_LINUX_H
+#if defined(__linux__) && !defined(__ANDROID__)
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "cswitch_log.h"
+#include "event_trace_status.h"
+#include "spin_lock.h"
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+/** Context switch tracer based on perf_event_open (Linux only).
+
+Opens PERF_COUNT_SW_CONTEXT_SWITCHES software event on each CPU with context switch records enabled
+(PERF_RECORD_SWITCH_CPU_WIDE, Linux 4.3+) and PERF_SAMPLE_TID|TIME attached to every record.
+Records are read from mmap ring buffers by a separate thread, merged in order of time and stored
+by ProfileManager::storeContextSwitches(). Perf timestamps are taken from CLOCK_MONOTONIC_RAW
+and converted to profiler::clock ticks.
+
+System-wide tracing is allowed only if kernel.perf_event_paranoid <= 0 (or with CAP_PERFMON/CAP_SYS_ADMIN),
+otherwise enable() returns PermissionDenied and context switches are read from the log-file as before.
+*/
+class EasyEventTracer EASY_FINAL
+{
+#ifndef EASY_MAGIC_STATIC_AVAILABLE
+    friend class EasyEventTracerInstance;
+#endif
+
+    /** Ring buffer of one CPU. */
+    struct Buffer
+    {
+        void* data = nullptr; ///< Mapped metadata page followed by data pages
+        int          fd = -1;
+    };
+
+    /** Context switch in perf clock nanoseconds waiting to be stored. */
+    struct PendingSwitch
+    {
+        uint64_t       time;
+        uint32_t    pidFrom;
+        uint32_t    tidFrom;
+        uint32_t      pidTo;
+        uint32_t      tidTo;
+    };
+
+    std::vector<Buffer>                          m_buffers;
+    std::vector<PendingSwitch>                   m_pending;
+    std::vector<CSwitchEvent>                     m_events;
+    std::vector<char>                         m_wrapBuffer; ///< Record wrapped around the end of ring buffer
+    std::unordered_map<uint32_t, std::string>      m_names; ///< Process names by process id (never erased: names are referenced by stored events)
+    std::thread                            m_processThread;
+    profiler::spin_lock                             m_spin;
+    std::atomic_bool                         m_lowPriority;
+    std::atomic_bool                          m_stopReading;
+    uint64_t                                    m_lostCount = 0;
+    uint32_t                                    m_processId = 0;
+    bool                                         m_bEnabled = false;
+
+public:
+
+    static EasyEventTracer& instance();
+    ~EasyEventTracer();
+
+    bool isLowPriority() const;
+
+    EventTracingEnableStatus enable(bool _force = false);
+    void disable();
+    void setLowPriority(bool _value);
+
+private:
+
+    EasyEventTracer();
+
+    bool openBuffers(int& _error);
+    void closeBuffers();
+
+    /** Reads all ring buffers and stores context switches happened before _until (perf clock nanoseconds). */
+    void process(uint64_t _until);
+
+    void readBuffer(Buffer& _buffer);
+    const char* processName(uint32_t _processId);
+
+}; // END of class EasyEventTracer.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif // __linux__
+#endif // EASY_PROFILER_EVENT_TRACE_LINUX_H
@@ -44,6 +44,7 @@ The Apache License, Version 2.0 (the "License");
 #define EASY_PROFILER_ARBITRARY_VALUE_H
 
 #include <easy/details/arbitrary_value_public_types.h>
+#include <atomic>
 
 #if defined(__clang__)
 # pragma clang diagnostic push
@@ -272,6 +273,66 @@ namespace profiler
         storeValue(_desc, DataType::String, &_text[0], static_cast<uint16_t>(N), true, _vin);
     }
 
+    /** Registers a gauge which is periodically read by profiler's sampler thread.
+
+    Use gauges for values which are changed too often to store each change by EASY_VALUE
+    (queue depth, bytes in flight, etc.). The sampler thread calls \c _reader at a fixed rate while profiler is enabled
+    and stores results as arbitrary values of "EasyProfiler.Gauges" thread, so the code changing the value is not affected.
+
+    \param _name Gauge name (it is copied).
+    \param _reader Function returning current value of the gauge. It is called from the sampler thread, so it must be thread-safe and fast.
+    \param _source Pointer passed to \c _reader. It is also used as Value Identification Number of stored samples.
+    \param _color Color of the gauge.
+
+    \retval Gauge id which must be passed to unregisterGauge() before \c _source is destroyed (0 if profiler is disabled by build options).
+
+    \sa unregisterGauge, setGaugeSamplingRate
+
+    \ingroup profiler
+    */
+    extern "C" PROFILER_API uint32_t registerGauge(const char* _name, gauge_reader_t _reader, const void* _source, color_t _color);
+
+    /** Registers std::atomic variable as a gauge.
+
+    \code
+    std::atomic<uint32_t> queueDepth;
+    auto gauge = profiler::registerGauge("Queue depth", queueDepth);
+    ...
+    profiler::unregisterGauge(gauge);
+    \endcode
+
+    \sa registerGauge
+
+    \ingroup profiler
+    */
+    template <class T>
+    inline uint32_t registerGauge(const char* _name, const ::std::atomic<T>& _value, color_t _color = colors::Default)
+    {
+        static_assert(StdToDataType<T>::data_type != DataType::TypesCount,
+                      "You should use standard builtin scalar types as profiler gauge type!");
+        return registerGauge(_name, [] (const void* _source) -> double {
+            return static_cast<double>(static_cast<const ::std::atomic<T>*>(_source)->load(::std::memory_order_relaxed));
+        }, &_value, _color);
+    }
+
+    /** Unregisters a gauge.
+
+    Reader of the gauge is guaranteed not to be called after this function returns
+    (unless it is called from a gauge reader: then the current sampling pass may still call it).
+    Function waits for the current sampling pass, so it must not be called while holding a lock which readers acquire.
+
+    \ingroup profiler
+    */
+    extern "C" PROFILER_API void unregisterGauge(uint32_t _gauge);
+
+    /** Sets rate in Hz at which gauges are sampled.
+
+    Default rate is 1000 Hz (could be changed by EASY_OPTION_GAUGE_SAMPLING_RATE build option).
+
+    \ingroup profiler
+    */
+    extern "C" PROFILER_API void setGaugeSamplingRate(uint32_t _hz);
+
 } // end of namespace profiler.
 
 #else
@@ -307,6 +368,15 @@ namespace profiler
     template <size_t N>
     inline void setText(const BaseBlockDescriptor*, const char (&)[N], ValueId) {}
 
+    inline uint32_t registerGauge(const char*, gauge_reader_t, const void*, color_t) { return 0; }
+
+    template <class T>
+    inline uint32_t registerGauge(const char*, const ::std::atomic<T>&, color_t = 0) { return 0; }
+
+    inline void unregisterGauge(uint32_t) {}
+
+    inline void setGaugeSamplingRate(uint32_t) {}
+
 } // end of namespace profiler.
 
 #endif // USING_EASY_PROFILER
@@ -97,6 +97,14 @@ namespace profiler
     template <> struct StdType<DataType::String> EASY_FINAL { using value_type = char; };
     template <> struct StdToDataType<const char*> EASY_FINAL { EASY_STATIC_CONSTEXPR auto data_type = DataType::String; };
 
+    /** Function which returns current value of a gauge (see registerGauge()).
+
+    \param _source Pointer passed to registerGauge().
+
+    \ingroup profiler
+    */
+    using gauge_reader_t = double (*)(const void* _source);
+
 } // end of namespace profiler.
 
 #endif //EASY_PROFILER_ARBITRARY_VALUE_PUBLIC_TYPES_H
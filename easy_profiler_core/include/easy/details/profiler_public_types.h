@@ -71,6 +71,37 @@ namespace profiler {
         MICROSECONDS ///< Microseconds
     };
 
+    enum class ClockSource : uint8_t
+    {
+        Native = 0,      ///< Clock chosen at compile time (QueryPerformanceCounter on Windows, std::chrono if enabled, rdtsc on x86, cntvct on ARMv8)
+        Rdtsc,           ///< x86 rdtsc instruction
+        Rdtscp,          ///< x86 rdtscp instruction (waits until all previous instructions have been executed)
+        LfenceRdtsc,     ///< x86 lfence + rdtsc instructions (rdtsc is not reordered with previous instructions)
+        MonotonicRaw,    ///< clock_gettime(CLOCK_MONOTONIC_RAW) (Linux only, nanoseconds)
+        MonotonicCoarse, ///< clock_gettime(CLOCK_MONOTONIC_COARSE) (Linux only, nanoseconds with timer tick resolution)
+        Auto,            ///< The cheapest source which is monotonic across CPU cores (chosen by self-test)
+
+        SourcesCount
+    };
+
+    /** Point of a flow linking blocks of different threads (see EASY_FLOW_BEGIN, EASY_FLOW_END). */
+    enum class FlowPointType : uint8_t
+    {
+        Begin = 0, ///< Work item has been produced (e.g. pushed into a queue)
+        End,       ///< Work item has been consumed
+
+        TypesCount
+    };
+
+    /** Results of clock source self-test. */
+    struct ClockSourceInfo
+    {
+        ClockSource    source = ClockSource::Native; ///< Tested clock source
+        bool                     available = false; ///< Is the source supported by this platform and CPU
+        double                        callCost = 0; ///< Average cost of one clock reading in nanoseconds
+        uint32_t                    violations = 0; ///< Number of times the clock went backwards when read on different CPU cores
+    };
+
     //***********************************************
 
 #pragma pack(push,1)
@@ -86,6 +117,8 @@ namespace profiler {
         color_t          m_color; ///< Color of the block packed into 1-byte structure
         block_type_t      m_type; ///< Type of the block (See BlockType)
         EasyBlockStatus m_status; ///< If false then blocks with such id() will not be stored by profiler during profile session
+        uint32_t      m_sampling; ///< Only 1 of m_sampling blocks with such id() is stored by profiler (0 or 1 means every block is stored)
+        bool      m_perfCounters; ///< If true then performance counters are sampled at the begin and at the end of blocks with such id() (Linux only)
 
         explicit BaseBlockDescriptor(block_id_t _id, EasyBlockStatus _status, int _line, block_type_t _block_type, color_t _color) EASY_NOEXCEPT;
 
@@ -98,6 +131,8 @@ namespace profiler {
         inline color_t color() const EASY_NOEXCEPT { return m_color; }
         inline block_type_t type() const EASY_NOEXCEPT { return m_type; }
         inline EasyBlockStatus status() const EASY_NOEXCEPT { return m_status; }
+        inline uint32_t sampling() const EASY_NOEXCEPT { return m_sampling; }
+        inline bool perfCounters() const EASY_NOEXCEPT { return m_perfCounters; }
 
     }; // END of class BaseBlockDescriptor.
 
@@ -106,6 +141,7 @@ namespace profiler {
     class PROFILER_API Event
     {
         friend ::ProfileManager;
+        friend ::ThreadStorage;
 
     protected:
 
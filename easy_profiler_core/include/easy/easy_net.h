@@ -77,8 +77,30 @@ enum class MessageType : uint8_t
 
     Request_MainThread_FPS,
     Reply_MainThread_FPS,
+
+    Request_Start_Streaming,
+    Reply_Streaming_Started,
+    Reply_Blocks_Part,
+    Request_Stop_Streaming,
+
+    Change_Block_Sampling,
+
+    Request_Statistics, ///< Request statistics accumulated in statistics-only mode
+    Reply_Statistics, ///< DataMessage with statistics of called blocks (see below)
+
+    Change_Block_Perf_Counters,
 };
 
+/* Reply_Statistics data layout (little-endian):
+
+uint32_t blocks_count
+blocks_count times:
+    uint32_t id, uint64_t calls_number, uint64_t total_ns, uint64_t min_ns, uint64_t max_ns, uint16_t buckets_count,
+    buckets_count times: uint64_t lower_bound_ns, uint64_t count
+
+\sa profiler::gatherStatistics
+*/
+
 struct Message
 {
     uint32_t magic_number = EASY_MESSAGE_SIGN;
@@ -114,6 +136,28 @@ struct BlockStatusMessage : public Message
     BlockStatusMessage() = delete;
 };
 
+struct BlockSamplingMessage : public Message
+{
+    uint32_t       id;
+    uint32_t sampling; ///< Only 1 of sampling blocks is stored (0 or 1 means every block is stored)
+
+    explicit BlockSamplingMessage(uint32_t _id, uint32_t _sampling)
+        : Message(MessageType::Change_Block_Sampling), id(_id), sampling(_sampling) { }
+
+    BlockSamplingMessage() = delete;
+};
+
+struct BlockPerfCountersMessage : public Message
+{
+    uint32_t   id;
+    bool   enable; ///< Sample performance counters for blocks with this id (see BaseBlockDescriptor::perfCounters())
+
+    explicit BlockPerfCountersMessage(uint32_t _id, bool _enable)
+        : Message(MessageType::Change_Block_Perf_Counters), id(_id), enable(_enable) { }
+
+    BlockPerfCountersMessage() = delete;
+};
+
 struct EasyProfilerStatus : public Message
 {
     bool         isProfilerEnabled;
@@ -219,6 +219,40 @@ will end previously opened EASY_BLOCK or EASY_FUNCTION.
             ::std::is_base_of<::profiler::ForceConstStr, decltype(name)>::value));\
     ::profiler::storeEvent(EASY_UNIQUE_DESC(__LINE__), EASY_RUNTIME_NAME(name));
 
+/** Macro for marking the begin of a flow with 64-bit id inside of the current block (producer).
+
+Flow links the block which has produced a work item (e.g. pushed it into a queue) with the block
+of another (or the same) thread which has consumed it (see EASY_FLOW_END). Use any id which is unique
+while the work item is in flight, for example a pointer to the work item.
+
+\code
+    void Producer::push(Task* task) {
+        EASY_BLOCK("Push task");
+        EASY_FLOW_BEGIN(reinterpret_cast<uint64_t>(task));
+        m_queue.push(task);
+    }
+
+    void Consumer::process(Task* task) {
+        EASY_BLOCK("Process task");
+        EASY_FLOW_END(reinterpret_cast<uint64_t>(task));
+        ...
+    }
+\endcode
+
+\sa profiler::fillFlows in easy/reader.h
+
+\ingroup profiler
+*/
+# define EASY_FLOW_BEGIN(id) ::profiler::storeFlow(id, ::profiler::FlowPointType::Begin);
+
+/** Macro for marking the end of a flow with 64-bit id inside of the current block (consumer).
+
+\sa EASY_FLOW_BEGIN
+
+\ingroup profiler
+*/
+# define EASY_FLOW_END(id) ::profiler::storeFlow(id, ::profiler::FlowPointType::End);
+
 /** Macro for enabling profiler.
 
 \ingroup profiler
@@ -295,6 +329,59 @@ breakdown, but if you care about that then you change set event tracing priority
 */
 # define EASY_SET_LOW_PRIORITY_EVENT_TRACING(isLowPriority) ::profiler::setLowPriorityEventTracing(isLowPriority);
 
+/** Enable flight recorder mode: limit memory used by each thread to store profiled blocks.
+
+When the limit is reached the oldest frames are dropped, so a dump always contains
+the most recent frames which fit into the limit. Pass 0 to disable the limit.
+
+\note Default value is controlled by EASY_OPTION_FLIGHT_RECORDER_MEMORY macro.
+
+\ingroup profiler
+*/
+# define EASY_SET_FLIGHT_RECORDER_MEMORY_LIMIT(bytesPerThread) ::profiler::setFlightRecorderMemoryLimit(bytesPerThread);
+
+/** Pre-allocate memory for storing profiled blocks of all threads.
+
+Memory is reserved in the process-wide pool of storage chunks, so threads would not allocate memory
+or page fault while storing blocks until the reserved memory is exhausted.
+
+\note Default value is controlled by EASY_OPTION_CHUNK_POOL_MEMORY macro.
+
+\ingroup profiler
+*/
+# define EASY_RESERVE_STORAGE_MEMORY(bytes) ::profiler::reserveStorageMemory(bytes);
+
+/** Automatically save frames around a frame which lasts longer than frameThresholdUs microseconds.
+
+framesBefore frames preceding the slow frame, the slow frame itself and framesAfter following frames
+are saved into "filenamePrefix_YYYYMMDD_HHMMSS_mmm.prof" file without stopping profiler.
+Pass 0 as frameThresholdUs to disable the trigger.
+
+\sa EASY_SET_SPIKE_CAPTURE_BLOCK, EASY_SET_FLIGHT_RECORDER_MEMORY_LIMIT
+
+\ingroup profiler
+*/
+# define EASY_SET_SPIKE_CAPTURE(frameThresholdUs, framesBefore, framesAfter, filenamePrefix)\
+    ::profiler::setSpikeCapture(frameThresholdUs, framesBefore, framesAfter, filenamePrefix);
+
+/** Also trigger spike capture if a block with given id lasts longer than thresholdUs microseconds.
+
+Pass 0 as thresholdUs to disable the trigger.
+
+\sa EASY_SET_SPIKE_CAPTURE
+
+\ingroup profiler
+*/
+# define EASY_SET_SPIKE_CAPTURE_BLOCK(blockId, thresholdUs) ::profiler::setSpikeCaptureBlock(blockId, thresholdUs);
+
+/** Sample performance counters (task-clock, page-faults, context-switches, etc.) for blocks with given id (Linux only).
+
+\sa profiler::setBlockPerfCounters
+
+\ingroup profiler
+*/
+# define EASY_SET_BLOCK_PERF_COUNTERS(blockId, enable) ::profiler::setBlockPerfCounters(blockId, enable);
+
 /** Macro for setting temporary log-file path for Unix event tracing system.
 
 \note Default value is "/tmp/cs_profiling_info.log".
@@ -389,11 +476,18 @@ Otherwise, no log messages will be printed.
 # define EASY_PROFILER_ENABLE 
 # define EASY_PROFILER_DISABLE 
 # define EASY_EVENT(...)
+# define EASY_FLOW_BEGIN(id) 
+# define EASY_FLOW_END(id) 
 # define EASY_THREAD(...)
 # define EASY_THREAD_SCOPE(...)
 # define EASY_MAIN_THREAD 
 # define EASY_SET_EVENT_TRACING_ENABLED(isEnabled) 
 # define EASY_SET_LOW_PRIORITY_EVENT_TRACING(isLowPriority) 
+# define EASY_SET_FLIGHT_RECORDER_MEMORY_LIMIT(bytesPerThread) 
+# define EASY_RESERVE_STORAGE_MEMORY(bytes) 
+# define EASY_SET_SPIKE_CAPTURE(frameThresholdUs, framesBefore, framesAfter, filenamePrefix) 
+# define EASY_SET_SPIKE_CAPTURE_BLOCK(blockId, thresholdUs) 
+# define EASY_SET_BLOCK_PERF_COUNTERS(blockId, enable) 
 
 # ifndef _WIN32
 #  define EASY_EVENT_TRACING_SET_LOG(filename) 
@@ -453,6 +547,8 @@ namespace profiler {
 
     EASY_CONSTEXPR uint16_t DEFAULT_PORT = EASY_DEFAULT_PORT;
 
+    class ExecutionContext; ///< Opaque handle of a logical execution context \sa createExecutionContext
+
     //////////////////////////////////////////////////////////////////////
     // Core API
     // Note: It is better to use macros defined above than a direct calls to API.
@@ -487,6 +583,66 @@ namespace profiler {
         */
         PROFILER_API timestamp_t toMicroseconds(timestamp_t _ticks);
 
+        /** Returns frequency of profiler clock in ticks per second.
+
+        On x86 the invariant TSC frequency is read from CPUID if possible, otherwise it is calibrated
+        against monotonic clock without a busy loop. Calibrated frequency is refined on every dump.
+
+        \ingroup profiler
+        */
+        PROFILER_API int64_t clockFrequency();
+
+        /** Returns estimated relative error of clockFrequency() in parts per million (0 if frequency is exact).
+
+        \ingroup profiler
+        */
+        PROFILER_API double clockFrequencyError();
+
+        /** Returns drift of profiler clock relative to clockFrequency() during the last dumped capture in parts per million.
+
+        \ingroup profiler
+        */
+        PROFILER_API double clockDrift();
+
+        /** Select clock source used for timestamps.
+
+        Use ClockSource::Auto to choose the cheapest source which is monotonic across CPU cores by self-test.
+        Default source is controlled by EASY_OPTION_CLOCK_SOURCE macro. The source in use is stored into capture header.
+
+        \note Source can be changed only while profiler is disabled. Dump all captured data before changing the source,
+        timestamps of different sources could not be compared.
+
+        \retval false if the source is not available on this platform or if profiler is enabled.
+
+        \ingroup profiler
+        */
+        PROFILER_API bool setClockSource(ClockSource _source);
+
+        /** Returns currently used clock source.
+
+        \ingroup profiler
+        */
+        PROFILER_API ClockSource clockSource();
+
+        /** Measure cost of reading the clock source and check if it is monotonic across CPU cores.
+
+        \note Takes a few tens of milliseconds.
+
+        \ingroup profiler
+        */
+        PROFILER_API void testClockSource(ClockSource _source, ClockSourceInfo& _info);
+
+        /** Returns measured cost of one block in ticks (as seen from the parent block).
+
+        Cost is measured on first call or on first dump after the clock source has been changed.
+        It is stored into capture header and can be subtracted from durations of parent blocks by reader.
+
+        \note First call takes up to a few milliseconds.
+
+        \ingroup profiler
+        */
+        PROFILER_API timestamp_t blockOverhead();
+
         /** Registers static description of a block.
 
         It is general information which is common for all such blocks.
@@ -516,6 +672,16 @@ namespace profiler {
         */
         PROFILER_API void storeEvent(const BaseBlockDescriptor* _desc, const char* _runtimeName = "");
 
+        /** Stores begin or end point of a flow with given id at current time.
+
+        The point belongs to the innermost block opened by current thread (or execution context).
+
+        \note There is no need to invoke this function explicitly - use EASY_FLOW_BEGIN and EASY_FLOW_END macros instead.
+
+        \ingroup profiler
+        */
+        PROFILER_API void storeFlow(uint64_t _id, FlowPointType _type);
+
         /** Stores block explicitly in the blocks list.
 
         Use this function for additional flexibility if you want to set block duration manually.
@@ -582,6 +748,18 @@ namespace profiler {
         */
         PROFILER_API uint32_t dumpBlocksToFile(const char* _filename);
 
+        /** Save blocks of all closed frames into file without stopping profiler.
+
+        Threads continue profiling while the data is being saved. Frames which are still opened
+        would be saved by the next call to dumpSnapshotToFile() or dumpBlocksToFile(),
+        so a sequence of snapshots contains every profiled frame exactly once.
+
+        \retval Number of saved blocks. If 0 then nothing was profiled or an error occured.
+
+        \ingroup profiler
+        */
+        PROFILER_API uint32_t dumpSnapshotToFile(const char* _filename);
+
         /** Register current thread and give it a name.
 
         Also creates a scoped ThreadGuard which would unregister thread on it's destructor.
@@ -632,6 +810,177 @@ namespace profiler {
         PROFILER_API void setLowPriorityEventTracing(bool _isLowPriority);
         PROFILER_API bool isLowPriorityEventTracing();
 
+        /** Set per-thread memory limit for profiled blocks (flight recorder mode).
+
+        When the limit is reached the oldest whole frames of the thread are dropped and their memory is reused.
+        The limit is applied to blocks storage and context switch events storage separately.
+        Memory could exceed the limit only if a single frame does not fit into it.
+
+        \param _bytesPerThread Memory limit in bytes (0 means unlimited storage which is the default).
+
+        \sa EASY_SET_FLIGHT_RECORDER_MEMORY_LIMIT
+
+        \ingroup profiler
+        */
+        PROFILER_API void setFlightRecorderMemoryLimit(uint64_t _bytesPerThread);
+        PROFILER_API uint64_t flightRecorderMemoryLimit();
+
+        /** Enable spike-triggered capture.
+
+        When a frame of any thread lasts longer than the threshold, profiler saves this frame together with
+        _framesBefore preceding and _framesAfter following frames (counted on the same thread) into
+        "<_filenamePrefix>_YYYYMMDD_HHMMSS_mmm.prof" file. Data is written by a separate thread while
+        profiling continues. Spikes detected while the previous capture is being written are ignored.
+        If the thread does not close _framesAfter frames in EASY_OPTION_SPIKE_CAPTURE_TIMEOUT milliseconds
+        (or exits) then the frames closed so far are saved.
+
+        Preceding frames are taken from the stored data, so enable flight recorder mode to keep memory bounded
+        between spikes: history would be limited by whatever fits into the flight recorder limit.
+        Once a spike is detected frames are not dropped until the capture is written (the limit may be exceeded
+        meanwhile), so preceding frames could not be lost while following frames are being stored.
+        Captured data is not consumed, so it is also written by regular dumps.
+
+        \param _frameThresholdUs Frame duration threshold in microseconds (0 disables frame trigger).
+        \param _framesBefore Number of frames preceding the slow one to save.
+        \param _framesAfter Number of frames following the slow one to save.
+        \param _filenamePrefix Path prefix for saved files ("spike" if empty).
+
+        \sa setSpikeCaptureBlock, setFlightRecorderMemoryLimit, EASY_SET_SPIKE_CAPTURE
+
+        \ingroup profiler
+        */
+        PROFILER_API void setSpikeCapture(timestamp_t _frameThresholdUs, uint32_t _framesBefore, uint32_t _framesAfter, const char* _filenamePrefix);
+
+        /** Trigger spike capture if the block with given id lasts longer than the threshold.
+
+        Capture settings are the same as for frame trigger (see setSpikeCapture()).
+
+        \param _thresholdUs Block duration threshold in microseconds (0 disables block trigger).
+
+        \sa setSpikeCapture, EASY_SET_SPIKE_CAPTURE_BLOCK
+
+        \ingroup profiler
+        */
+        PROFILER_API void setSpikeCaptureBlock(block_id_t _id, timestamp_t _thresholdUs);
+
+        /** Returns number of spike captures saved into files. */
+        PROFILER_API uint32_t spikeCapturesCount();
+
+        /** Sample performance counters at the begin and at the end of blocks with given id (Linux only).
+
+        Per-thread counters are opened through perf_event_open by the first such block of each thread:
+        task-clock, page-faults, context-switches, cpu-migrations and hardware cycles and instructions
+        where available. Deltas are stored after each block and shown as additional block statistics
+        (see BlocksTree::counters() and BlockStatistics::counters in easy/reader.h).
+        Reading counters costs about a system call at the begin and at the end of each block.
+
+        \note Blocks created before the call are not affected.
+
+        \sa EASY_SET_BLOCK_PERF_COUNTERS
+
+        \ingroup profiler
+        */
+        PROFILER_API void setBlockPerfCounters(block_id_t _id, bool _enable);
+
+        /** Attribute heap allocations counted by trackAllocation() to the innermost opened block.
+
+        Each block stores inclusive and self bytes and number of allocations made while it was opened
+        (see BlocksTree::allocations() and BlockStatistics::allocated_bytes in easy/reader.h).
+        Blocks without allocations store nothing.
+
+        Tracking is enabled automatically by linking easy_profiler_alloc_hooks library which overrides
+        global operator new and operator delete. Custom allocators could call trackAllocation() instead.
+
+        \note Blocks opened before the call are not affected.
+
+        \ingroup profiler
+        */
+        PROFILER_API void setAllocationTracking(bool _enable);
+        PROFILER_API bool isAllocationTrackingEnabled();
+
+        /** Count heap allocation of _bytes made by current thread.
+
+        This is only an increment of thread-local counters, it does not depend on profiler status.
+        If an execution context is current then the allocation is counted for this context
+        (counters are swapped by switchExecutionContext()).
+
+        \sa setAllocationTracking
+
+        \ingroup profiler
+        */
+        PROFILER_API void trackAllocation(size_t _bytes);
+
+        /** Create logical execution context (fiber, coroutine, asynchronous task) with it's own blocks stack.
+
+        Blocks opened while the context is current (see switchExecutionContext) are stored into the context
+        instead of the OS thread which executes them. Each context is written to a .prof file as a pseudo-thread
+        named _name (or "Context N" if _name is empty), so blocks of a coroutine suspended in one thread
+        and resumed in another are nested correctly.
+
+        \note Performance counters are not read for blocks of execution contexts.
+        Allocations are tracked per context, so allocations made by other contexts while it is suspended
+        are not attributed to it's blocks.
+
+        \sa switchExecutionContext, destroyExecutionContext, ExecutionContextScope
+
+        \ingroup profiler
+        */
+        PROFILER_API ExecutionContext* createExecutionContext(const char* _name);
+
+        /** Make _context current for the calling thread (nullptr switches back to the thread itself).
+
+        Call it every time a fiber or coroutine is resumed or suspended. Switching is O(1).
+
+        \ingroup profiler
+        */
+        PROFILER_API void switchExecutionContext(ExecutionContext* _context);
+
+        /** Returns execution context current for the calling thread (nullptr if it is the thread itself). */
+        PROFILER_API ExecutionContext* currentExecutionContext();
+
+        /** Destroy execution context created by createExecutionContext().
+
+        Blocks already stored by the context are written by the next dump. Blocks of the context which are still
+        opened are dropped, so destroy suspended coroutine frame while it's context is current.
+
+        \ingroup profiler
+        */
+        PROFILER_API void destroyExecutionContext(ExecutionContext* _context);
+
+        /** Pre-allocate memory for storing profiled blocks.
+
+        Storage of all threads is allocated by chunks from the process-wide pool. Chunks released after
+        a dump or on thread exit are returned into the pool and reused. The pool is grown by 2 MB regions
+        which are pre-faulted and (on Linux) advised to be backed by transparent huge pages.
+
+        \param _bytes Minimal size of the pool in bytes. The pool never shrinks, so smaller values are ignored.
+
+        \sa EASY_RESERVE_STORAGE_MEMORY
+
+        \ingroup profiler
+        */
+        PROFILER_API void reserveStorageMemory(uint64_t _bytes);
+
+        /** Returns the current size of the storage chunks pool in bytes. */
+        PROFILER_API uint64_t reservedStorageMemory();
+
+        /** Make stored blocks survive a crash of the process (Unix only).
+
+        Storage chunks pool is backed by a file in "<_directory>/easy_capture_<pid>" and every thread keeps
+        positions of its stored frames in a mapped file, so blocks stored before a crash could be converted
+        into a .prof file by profiler_recover tool (see recoverCrashCapture() in easy/reader.h).
+        Descriptors and run-time names are journaled when they are registered. Files are removed on normal exit.
+
+        \note Must be called before any thread is registered and before storage memory is reserved.
+
+        \retval false if crash recovery is not supported, is already enabled or it is too late to enable it.
+
+        \note Default value is controlled by EASY_OPTION_CRASH_RECOVERY_DIRECTORY macro.
+
+        \ingroup profiler
+        */
+        PROFILER_API bool setCrashRecoveryDirectory(const char* _directory);
+
         /** Set temporary log-file path for Unix event tracing system.
 
         \note Default value is "/tmp/cs_profiling_info.log".
@@ -774,22 +1123,47 @@ namespace profiler {
     inline EASY_CONSTEXPR_FCN timestamp_t now() { return 0; }
     inline EASY_CONSTEXPR_FCN timestamp_t toNanoseconds(timestamp_t) { return 0; }
     inline EASY_CONSTEXPR_FCN timestamp_t toMicroseconds(timestamp_t) { return 0; }
+    inline EASY_CONSTEXPR_FCN int64_t clockFrequency() { return 0; }
+    inline EASY_CONSTEXPR_FCN double clockFrequencyError() { return 0; }
+    inline EASY_CONSTEXPR_FCN double clockDrift() { return 0; }
+    inline bool setClockSource(ClockSource) { return false; }
+    inline EASY_CONSTEXPR_FCN ClockSource clockSource() { return ClockSource::Native; }
+    inline void testClockSource(ClockSource, ClockSourceInfo&) { }
+    inline EASY_CONSTEXPR_FCN timestamp_t blockOverhead() { return 0; }
     inline const BaseBlockDescriptor* registerDescription(EasyBlockStatus, const char*, const char*, const char*, int, block_type_t, color_t, bool = false)
     { return reinterpret_cast<const BaseBlockDescriptor*>(0xbad); }
     inline void endBlock() { }
     inline void setEnabled(bool) { }
     inline EASY_CONSTEXPR_FCN bool isEnabled() { return false; }
     inline void storeEvent(const BaseBlockDescriptor*, const char* = "") { }
+    inline void storeFlow(uint64_t, FlowPointType) { }
     inline void storeBlock(const BaseBlockDescriptor*, const char*, timestamp_t, timestamp_t) { }
     inline void beginBlock(Block&) { }
     inline void beginNonScopedBlock(const BaseBlockDescriptor*, const char* = "") { }
     inline uint32_t dumpBlocksToFile(const char*) { return 0; }
+    inline uint32_t dumpSnapshotToFile(const char*) { return 0; }
     inline const char* registerThreadScoped(const char*, ThreadGuard&) { return ""; }
     inline const char* registerThread(const char*) { return ""; }
     inline void setEventTracingEnabled(bool) { }
     inline EASY_CONSTEXPR_FCN bool isEventTracingEnabled() { return false; }
     inline void setLowPriorityEventTracing(bool) { }
     inline EASY_CONSTEXPR_FCN bool isLowPriorityEventTracing() { return false; }
+    inline void setFlightRecorderMemoryLimit(uint64_t) { }
+    inline EASY_CONSTEXPR_FCN uint64_t flightRecorderMemoryLimit() { return 0; }
+    inline void setSpikeCapture(timestamp_t, uint32_t, uint32_t, const char*) { }
+    inline void setSpikeCaptureBlock(block_id_t, timestamp_t) { }
+    inline void setBlockPerfCounters(block_id_t, bool) { }
+    inline void setAllocationTracking(bool) { }
+    inline EASY_CONSTEXPR_FCN bool isAllocationTrackingEnabled() { return false; }
+    inline void trackAllocation(size_t) { }
+    inline ExecutionContext* createExecutionContext(const char*) { return nullptr; }
+    inline void switchExecutionContext(ExecutionContext*) { }
+    inline EASY_CONSTEXPR_FCN ExecutionContext* currentExecutionContext() { return nullptr; }
+    inline void destroyExecutionContext(ExecutionContext*) { }
+    inline EASY_CONSTEXPR_FCN uint32_t spikeCapturesCount() { return 0; }
+    inline void reserveStorageMemory(uint64_t) { }
+    inline EASY_CONSTEXPR_FCN uint64_t reservedStorageMemory() { return 0; }
+    inline bool setCrashRecoveryDirectory(const char*) { return false; }
     inline void setContextSwitchLogFilename(const char*) { }
     inline EASY_CONSTEXPR_FCN const char* getContextSwitchLogFilename() { return ""; }
     inline void startListen(uint16_t = ::profiler::DEFAULT_PORT) { }
@@ -869,6 +1243,37 @@ namespace profiler {
 
     } // END of namespace main_thread.
 
+    /** Makes execution context current for the lifetime of this object.
+
+    Previously current context is restored on destruction, so scopes could be nested.
+
+    \code
+        void Task::resume() {
+            profiler::ExecutionContextScope scope(m_context); // m_context = profiler::createExecutionContext("Task")
+            m_coroutine.resume();
+        }
+    \endcode
+
+    \ingroup profiler
+    */
+    class ExecutionContextScope EASY_FINAL
+    {
+        ExecutionContext* m_previous;
+
+    public:
+
+        explicit ExecutionContextScope(ExecutionContext* _context) : m_previous(currentExecutionContext()) {
+            switchExecutionContext(_context);
+        }
+
+        ~ExecutionContextScope() {
+            switchExecutionContext(m_previous);
+        }
+
+        ExecutionContextScope(const ExecutionContextScope&) = delete;
+        ExecutionContextScope& operator = (const ExecutionContextScope&) = delete;
+    };
+
     /** Alias for isEnabled().
 
     Added for clarification.
@@ -45,7 +45,10 @@ The Apache License, Version 2.0 (the "License");
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <atomic>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <unordered_map>
@@ -73,6 +76,14 @@ namespace profiler {
         profiler::block_index_t    max_duration_block; ///< Will be used in GUI to jump to the block with max duration
         profiler::block_index_t          parent_block; ///< Index of block which is "parent" for "per_parent_stats" or "frame" for "per_frame_stats" or thread-id for "per_thread_stats"
         profiler::calls_number_t         calls_number; ///< Block calls number
+        profiler::calls_number_t       dropped_number; ///< Number of block calls which were not stored because of sampling (see BaseBlockDescriptor::sampling())
+        profiler::calls_number_t       counted_number; ///< Number of block calls with performance counters (see BaseBlockDescriptor::perfCounters())
+        uint64_t       counters[PERF_COUNTERS_NUMBER]; ///< Total values of performance counters of counted_number calls indexed by PerfCounter
+        uint8_t                         counters_mask; ///< Bit (1 << PerfCounter) is set if the counter has been sampled by at least one call
+        uint64_t                      allocated_bytes; ///< Total heap bytes allocated by all block calls including their children (see profiler::setAllocationTracking())
+        uint64_t                 allocated_self_bytes; ///< Total heap bytes allocated by all block calls excluding their children
+        uint64_t                   allocations_number; ///< Total number of heap allocations made by all block calls including their children
+        uint64_t              allocations_self_number; ///< Total number of heap allocations made by all block calls excluding their children
 
         explicit BlockStatistics(profiler::timestamp_t _duration, profiler::block_index_t _block_index, profiler::block_index_t _parent_index)
             : total_duration(_duration)
@@ -81,7 +92,15 @@ namespace profiler {
             , max_duration_block(_block_index)
             , parent_block(_parent_index)
             , calls_number(1)
+            , dropped_number(0)
+            , counted_number(0)
+            , counters_mask(0)
+            , allocated_bytes(0)
+            , allocated_self_bytes(0)
+            , allocations_number(0)
+            , allocations_self_number(0)
         {
+            memset(counters, 0, sizeof(counters));
         }
 
         //BlockStatistics() = default;
@@ -91,6 +110,43 @@ namespace profiler {
             return total_duration / calls_number;
         }
 
+        /** Estimated number of all block calls including calls dropped by sampling. */
+        inline uint64_t estimated_calls_number() const
+        {
+            return static_cast<uint64_t>(calls_number) + dropped_number;
+        }
+
+        /** Estimated total duration of all block calls including calls dropped by sampling.
+
+        Dropped calls are supposed to have average duration of stored calls. */
+        inline profiler::timestamp_t estimated_total_duration() const
+        {
+            return dropped_number == 0 ? total_duration : static_cast<profiler::timestamp_t>(
+                static_cast<double>(total_duration) * static_cast<double>(estimated_calls_number()) / static_cast<double>(calls_number));
+        }
+
+        inline void add_counters(const PerfCounters& _counters)
+        {
+            ++counted_number;
+            counters_mask |= _counters.mask;
+            for (int i = 0; i < PERF_COUNTERS_NUMBER; ++i)
+                counters[i] += _counters.values[i];
+        }
+
+        inline void add_allocations(const Allocations& _allocations)
+        {
+            allocated_bytes += _allocations.bytes;
+            allocated_self_bytes += _allocations.self_bytes;
+            allocations_number += _allocations.count;
+            allocations_self_number += _allocations.self_count;
+        }
+
+        /** Average value of performance counter per counted call. */
+        inline double average_counter(PerfCounter _counter) const
+        {
+            return counted_number == 0 ? 0. : static_cast<double>(counters[_counter]) / static_cast<double>(counted_number);
+        }
+
     }; // END of struct BlockStatistics.
 #pragma pack(pop)
 
@@ -119,6 +175,8 @@ namespace profiler {
         profiler::BlockStatistics*  per_frame_stats; ///< Pointer to statistics for this block within the frame (may be nullptr for top-level blocks)
         profiler::BlockStatistics* per_thread_stats; ///< Pointer to statistics for this block within the bounds of all frames per current thread
         uint8_t                               depth; ///< Maximum number of sublevels (maximum children depth)
+        bool                           has_counters; ///< True if performance counters are stored after the block name (see counters())
+        bool                        has_allocations; ///< True if allocations are stored after the block name and counters (see allocations())
 
         BlocksTree(const This&) = delete;
         This& operator = (const This&) = delete;
@@ -129,6 +187,8 @@ namespace profiler {
             , per_frame_stats(nullptr)
             , per_thread_stats(nullptr)
             , depth(0)
+            , has_counters(false)
+            , has_allocations(false)
         {
 
         }
@@ -159,6 +219,21 @@ namespace profiler {
             return node->begin() < other.node->begin();
         }
 
+        /** Performance counters of the block or nullptr if they have not been sampled (see BaseBlockDescriptor::perfCounters()). */
+        const PerfCounters* counters() const EASY_NOEXCEPT
+        {
+            return has_counters ? reinterpret_cast<const PerfCounters*>(node->name() + strlen(node->name()) + 1) : nullptr;
+        }
+
+        /** Heap allocations of the block or nullptr if there were none or they have not been tracked (see profiler::setAllocationTracking()). */
+        const Allocations* allocations() const EASY_NOEXCEPT
+        {
+            if (!has_allocations)
+                return nullptr;
+            const char* data = node->name() + strlen(node->name()) + 1;
+            return reinterpret_cast<const Allocations*>(has_counters ? data + sizeof(PerfCounters) : data);
+        }
+
         void shrink_to_fit() EASY_NOEXCEPT
         {
             //for (auto& child : children)
@@ -193,6 +268,8 @@ namespace profiler {
             per_frame_stats = that.per_frame_stats;
             per_thread_stats = that.per_thread_stats;
             depth = that.depth;
+            has_counters = that.has_counters;
+            has_allocations = that.has_allocations;
 
             that.node = nullptr;
             that.per_parent_stats = nullptr;
@@ -218,6 +295,19 @@ namespace profiler {
 
     //////////////////////////////////////////////////////////////////////////
 
+    /** Begin or end point of a flow stored by EASY_FLOW_BEGIN or EASY_FLOW_END. */
+    struct FlowPoint EASY_FINAL
+    {
+        uint64_t                   id; ///< Flow id
+        profiler::timestamp_t    time; ///< Time of the point
+        profiler::block_index_t block; ///< Innermost block containing the point (~0U if the point is outside of blocks)
+        profiler::FlowPointType  type; ///< Begin or end of the flow
+    };
+
+    using flow_points_t = std::vector<FlowPoint>;
+
+    //////////////////////////////////////////////////////////////////////////
+
     class BlocksTreeRoot EASY_FINAL
     {
         using This = BlocksTreeRoot;
@@ -227,6 +317,7 @@ namespace profiler {
         BlocksTree::children_t       children; ///< List of children indexes
         BlocksTree::children_t           sync; ///< List of context-switch events
         BlocksTree::children_t         events; ///< List of events indexes
+        flow_points_t                   flows; ///< Flow points of this thread sorted by time
         std::string               thread_name; ///< Name of this thread
         profiler::timestamp_t   profiled_time; ///< Profiled time of this thread (sum of all children duration)
         profiler::timestamp_t       wait_time; ///< Wait time of this thread (sum of all context switches)
@@ -247,6 +338,7 @@ namespace profiler {
             : children(std::move(that.children))
             , sync(std::move(that.sync))
             , events(std::move(that.events))
+            , flows(std::move(that.flows))
             , thread_name(std::move(that.thread_name))
             , profiled_time(that.profiled_time)
             , wait_time(that.wait_time)
@@ -262,6 +354,7 @@ namespace profiler {
             children = std::move(that.children);
             sync = std::move(that.sync);
             events = std::move(that.events);
+            flows = std::move(that.flows);
             thread_name = std::move(that.thread_name);
             profiled_time = that.profiled_time;
             wait_time = that.wait_time;
@@ -347,8 +440,143 @@ namespace profiler {
 
     //////////////////////////////////////////////////////////////////////////
 
+    /** Joins parts of a streamed capture into one capture stream.
+
+    When capturing in streaming mode profiled application sends closed frames as a sequence
+    of complete captures (parts). Each part contains all block descriptors and only new blocks of each thread.
+    Each part has it's own run-time names table, so names of all parts are merged into one table
+    and name ids of blocks are replaced with ids in the joined table.
+    Joined stream can be read by fillTreesFromStream() as a usual capture.
+
+    If maximum size is set by setMaxSize() then the oldest parts are dropped when threads sections
+    of retained parts exceed it, so memory and the cost of reading the joined stream stay bounded
+    during a long streaming session. Only the run-time names table keeps growing (by new unique names).
+    */
+    class PROFILER_API StreamedCapture EASY_FINAL
+    {
+        struct Part
+        {
+            std::string          threads; ///< Threads sections of the part (name ids refer to m_names)
+            timestamp_t          endTime; ///< End time of the part
+            uint64_t          memorySize; ///< Memory size of blocks of the part
+            uint32_t         blocksCount; ///< Blocks number of the part
+            uint32_t        threadsCount; ///< Number of threads sections of the part
+        };
+
+        std::deque<Part>         m_parts; ///< Retained parts
+        std::string        m_descriptors; ///< Descriptors section of the latest part (contains all descriptors)
+        std::string              m_names; ///< Run-time names table entries merged from all parts
+        std::unordered_map<std::string, uint32_t> m_nameIds; ///< Ids of names in m_names
+        profiler::processid_t      m_pid; ///< Profiled process id
+        int64_t           m_cpuFrequency; ///< CPU frequency of the profiled application
+        timestamp_t      m_blockOverhead; ///< Measured cost of one block in ticks
+        timestamp_t          m_beginTime; ///< Begin time of the first part or end time of the last dropped part
+        timestamp_t            m_endTime; ///< End time of the latest part
+        uint64_t            m_memorySize; ///< Total memory size of blocks of retained parts
+        uint64_t m_descriptorsMemorySize; ///< Memory size of all descriptors
+        uint64_t       m_namesMemorySize; ///< Memory size of all names in m_names
+        uint64_t           m_threadsSize; ///< Total size of threads sections of retained parts
+        uint64_t               m_maxSize; ///< Maximum size of threads sections of retained parts (0 means unlimited)
+        uint32_t               m_version; ///< Version of the first part
+        uint32_t           m_blocksCount; ///< Total blocks number of retained parts
+        uint32_t      m_descriptorsCount; ///< Descriptors number
+        uint32_t          m_threadsCount; ///< Total number of threads sections of retained parts
+        uint32_t            m_partsCount; ///< Number of joined parts including dropped ones
+        uint32_t     m_droppedPartsCount; ///< Number of dropped parts
+        uint16_t           m_clockSource; ///< profiler::ClockSource of the profiled application
+
+    public:
+
+        StreamedCapture();
+
+        /** Appends one part of the capture.
+
+        \param _data Part data (complete capture stream)
+        \param _size Part data size in bytes
+        \param _log Stream for error messages
+
+        \retval false if part is corrupted or has incompatible version. */
+        bool append(const char* _data, uint64_t _size, std::ostream& _log);
+
+        /** Writes all retained parts as one capture. */
+        void write(std::ostream& _outputStream) const;
+
+        /** Sets maximum size of retained blocks data in bytes (0 means unlimited, which is the default).
+
+        The latest part is always retained. Begin time of the joined capture becomes the end time of the last
+        dropped part, so the first frames of the oldest retained part could be clipped by the reader.
+        The size is kept by clear(). */
+        void setMaxSize(uint64_t _size);
+
+        bool empty() const;
+
+        uint32_t parts() const;
+
+        /** Number of the oldest parts dropped because of maximum size (see setMaxSize()). */
+        uint32_t droppedParts() const;
+
+        void clear();
+
+    }; // END of class StreamedCapture.
+
+    //////////////////////////////////////////////////////////////////////////
+
     using descriptors_list_t = std::vector<SerializedBlockDescriptor*>;
 
+    //////////////////////////////////////////////////////////////////////////
+
+    /** Flow linking the block which has produced a work item with the block which has consumed it.
+
+    \sa fillFlows
+    */
+    struct Flow EASY_FINAL
+    {
+        uint64_t                         id = 0; ///< Flow id
+        profiler::thread_id_t  begin_thread = 0; ///< Thread of the begin point
+        profiler::thread_id_t    end_thread = 0; ///< Thread of the end point
+        profiler::block_index_t begin_block = ~0U; ///< Block containing the begin point (~0U if it is outside of blocks)
+        profiler::block_index_t   end_block = ~0U; ///< Block containing the end point (~0U if it is outside of blocks)
+        profiler::timestamp_t    begin_time = 0; ///< Time of the begin point (0 if it has not been captured)
+        profiler::timestamp_t      end_time = 0; ///< Time of the end point (0 if it has not been captured)
+
+        bool complete() const {
+            return begin_time != 0 && end_time != 0;
+        }
+
+        profiler::timestamp_t latency() const {
+            return complete() && end_time > begin_time ? end_time - begin_time : 0;
+        }
+    };
+
+    using flows_t = std::vector<Flow>; ///< Flows sorted by id and time
+
+    /** Latency distribution of complete flows linking blocks with the same pair of ids. */
+    struct FlowStatistics EASY_FINAL
+    {
+        profiler::block_id_t   begin_id = 0; ///< Id of the producer block (~0U if flows begin outside of blocks)
+        profiler::block_id_t     end_id = 0; ///< Id of the consumer block (~0U if flows end outside of blocks)
+        uint32_t            flows_number = 0; ///< Number of complete flows
+        profiler::timestamp_t min_latency = 0;
+        profiler::timestamp_t max_latency = 0;
+        profiler::timestamp_t average_latency = 0;
+        profiler::timestamp_t median_latency = 0;
+        profiler::timestamp_t p90_latency = 0; ///< 90th percentile
+        profiler::timestamp_t p99_latency = 0; ///< 99th percentile
+    };
+
+    using flow_statistics_t = std::vector<FlowStatistics>;
+
+    /** Returns range of flows with given id (flows are sorted by id, so it is a binary search). */
+    inline std::pair<flows_t::const_iterator, flows_t::const_iterator> findFlows(const flows_t& _flows, uint64_t _id)
+    {
+        struct Less {
+            bool operator () (const Flow& _flow, uint64_t _value) const { return _flow.id < _value; }
+            bool operator () (uint64_t _value, const Flow& _flow) const { return _value < _flow.id; }
+        };
+
+        return std::equal_range(_flows.begin(), _flows.end(), _id, Less());
+    }
+
 } // END of namespace profiler.
 
 extern "C" {
@@ -365,6 +593,7 @@ extern "C" {
                                                            uint32_t& version,
                                                            profiler::processid_t& pid,
                                                            bool gather_statistics,
+                                                           bool compensate_overhead,
                                                            std::ostream& _log);
 
     PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<int>& progress, std::istream& str,
@@ -379,13 +608,52 @@ extern "C" {
                                                              uint32_t& version,
                                                              profiler::processid_t& pid,
                                                              bool gather_statistics,
+                                                             bool compensate_overhead,
                                                              std::ostream& _log);
 
+    /** Link begin and end points of flows of all threads (see EASY_FLOW_BEGIN) into flows sorted by id and time.
+
+    Each end point is linked with the latest preceding begin point with the same id,
+    so ids could be reused after the flow has finished.
+    Only flow points are processed (blocks are not scanned).
+    */
+    PROFILER_API void fillFlows(const profiler::thread_blocks_tree_t& threaded_trees, profiler::flows_t& flows);
+
+    /** Calculate latency distribution of complete flows for each pair of producer and consumer block ids.
+
+    \note Latency is in the same units as blocks time (nanoseconds for files read by fillTreesFromFile()).
+    */
+    PROFILER_API void fillFlowStatistics(const profiler::flows_t& flows, const profiler::blocks_t& blocks,
+                                         profiler::flow_statistics_t& statistics);
+
     PROFILER_API bool readDescriptionsFromStream(std::atomic<int>& progress, std::istream& str,
                                                  profiler::SerializedData& serialized_descriptors,
                                                  profiler::descriptors_list_t& descriptors,
                                                  std::ostream& _log);
 
+    /** Convert files left by a crashed process in its capture directory into a .prof file.
+
+    The capture directory ("easy_capture_<pid>") is created inside the directory set by
+    profiler::setCrashRecoveryDirectory() and is removed on normal exit of the profiled process.
+
+    \retval Number of recovered blocks and values (0 if nothing could be recovered, see _log for details).
+    */
+    PROFILER_API uint32_t recoverCrashCapture(const char* capture_directory, const char* filename, std::ostream& _log);
+
+    /** Collect blocks of a living process from its capture directory (see recoverCrashCapture()).
+
+    Frames are drained every interval_ms until the process exits or stop is set, so the process reuses
+    memory of collected data and never serializes it by itself. Collected data is written into filename at the end.
+
+    If part_size is not 0 then collected data is written and released each time it exceeds part_size bytes,
+    so memory of the collector is bounded. Parts after the first are written into "<name>.1.<ext>", "<name>.2.<ext>"...
+    Each part is a complete .prof file.
+
+    \retval Number of collected blocks and values in all parts.
+    */
+    PROFILER_API uint32_t collectCapture(const char* capture_directory, const char* filename, uint32_t interval_ms,
+                                         uint64_t part_size, const std::atomic<bool>& stop, std::ostream& _log);
+
 }
 
 inline profiler::block_index_t fillTreesFromFile(const char* filename, profiler::BeginEndTime& begin_end_time,
@@ -398,12 +666,13 @@ inline profiler::block_index_t fillTreesFromFile(const char* filename, profiler:
                                                  uint32_t& version,
                                                  profiler::processid_t& pid,
                                                  bool gather_statistics,
+                                                 bool compensate_overhead,
                                                  std::ostream& _log)
 {
     std::atomic<int> progress(0);
     return fillTreesFromFile(progress, filename, begin_end_time, serialized_blocks, serialized_descriptors,
                              descriptors, _blocks, threaded_trees, bookmarks, descriptors_count, version, pid,
-                             gather_statistics, _log);
+                             gather_statistics, compensate_overhead, _log);
 }
 
 inline bool readDescriptionsFromStream(std::istream& str,
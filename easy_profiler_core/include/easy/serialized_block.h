@@ -58,6 +58,73 @@ namespace profiler {
 
     //////////////////////////////////////////////////////////////////////////
 
+    /** If this bit is set in the id of a block stored in .prof file then the block has an interned run-time name:
+    4-byte index of the name in the run-time names table is stored right after BaseBlockData instead of the name.
+
+    Such blocks are written since v2.2.0. They are expanded into usual SerializedBlock while reading.
+    */
+    EASY_CONSTEXPR block_id_t INTERNED_NAME_FLAG = 0x80000000U;
+
+    //////////////////////////////////////////////////////////////////////////
+
+    /** Performance counters sampled for blocks with BaseBlockDescriptor::perfCounters() flag (since v2.7.0). */
+    enum PerfCounter : uint8_t
+    {
+        PERF_TASK_CLOCK = 0, ///< CPU time of the thread in nanoseconds
+        PERF_PAGE_FAULTS,
+        PERF_CONTEXT_SWITCHES,
+        PERF_CPU_MIGRATIONS,
+        PERF_CYCLES,         ///< Hardware counter (not available on most virtual machines)
+        PERF_INSTRUCTIONS,   ///< Hardware counter (not available on most virtual machines)
+
+        PERF_COUNTERS_NUMBER
+    };
+
+    inline const char* perfCounterName(PerfCounter _counter)
+    {
+        switch (_counter)
+        {
+            case PERF_TASK_CLOCK:       return "Task clock";
+            case PERF_PAGE_FAULTS:      return "Page faults";
+            case PERF_CONTEXT_SWITCHES: return "Context switches";
+            case PERF_CPU_MIGRATIONS:   return "CPU migrations";
+            case PERF_CYCLES:           return "Cycles";
+            case PERF_INSTRUCTIONS:     return "Instructions";
+            default:                    return "";
+        }
+    }
+
+#pragma pack(push, 1)
+    /** Deltas of performance counters between the begin and the end of one block.
+
+    Reader stores them right after the name of SerializedBlock (see BlocksTree::counters()).
+    */
+    struct PerfCounters EASY_FINAL
+    {
+        uint64_t values[PERF_COUNTERS_NUMBER]; ///< Counter values indexed by PerfCounter
+        uint8_t                          mask; ///< Bit (1 << PerfCounter) is set if the counter has been sampled
+
+        inline bool has(PerfCounter _counter) const EASY_NOEXCEPT { return (mask & (1 << _counter)) != 0; }
+        inline uint64_t value(PerfCounter _counter) const EASY_NOEXCEPT { return values[_counter]; }
+    };
+
+    /** Heap allocations made while the block was opened (since v2.8.0, see profiler::trackAllocation()).
+
+    Inclusive values also contain allocations of all child blocks, self values contain allocations
+    made directly by the block. Reader stores them right after performance counters of SerializedBlock
+    or right after it's name if there are no counters (see BlocksTree::allocations()).
+    */
+    struct Allocations EASY_FINAL
+    {
+        uint64_t      bytes; ///< Inclusive allocated bytes
+        uint64_t      count; ///< Inclusive number of allocations
+        uint64_t self_bytes; ///< Bytes allocated by the block itself
+        uint64_t self_count; ///< Number of allocations made by the block itself
+    };
+#pragma pack(pop)
+
+    //////////////////////////////////////////////////////////////////////////
+
     class PROFILER_API SerializedBlock EASY_FINAL : public BaseBlockData
     {
         friend ::ProfileManager;
@@ -152,6 +219,14 @@ namespace profiler {
             m_status = _status;
         }
 
+        inline void setSampling(uint32_t _sampling) EASY_NOEXCEPT {
+            m_sampling = _sampling;
+        }
+
+        inline void setPerfCounters(bool _enable) EASY_NOEXCEPT {
+            m_perfCounters = _enable;
+        }
+
         // Instances of this class can not be created or destroyed directly
         SerializedBlockDescriptor()                                              = delete;
         SerializedBlockDescriptor(const SerializedBlockDescriptor&)              = delete;
@@ -0,0 +1,122 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights 
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies 
+    of the Software, and to permit persons to whom the Software is furnished 
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all 
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE 
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_STATISTICS_H
+#define EASY_PROFILER_STATISTICS_H
+
+#include <easy/profiler.h>
+#include <vector>
+
+namespace profiler {
+
+    /** Bucket of block durations histogram. */
+    struct HistogramBucket
+    {
+        timestamp_t lowerBound = 0; ///< Minimal duration of the bucket in nanoseconds
+        uint64_t         count = 0; ///< Number of block calls with duration in [lowerBound, next bucket lowerBound)
+    };
+
+    /** Statistics of all calls of one block aggregated in statistics-only capture mode.
+
+    Durations are accumulated in ticks and converted to nanoseconds when statistics are gathered.
+    Histogram buckets are log-scaled: each power of 2 is divided into 4 sub-buckets, so bucket width is less than 25% of it's bound.
+
+    \sa setStatisticsOnly, gatherStatistics
+    */
+    struct BlockSummary
+    {
+        block_id_t                       id = 0; ///< Block descriptor id
+        uint64_t                callsNumber = 0; ///< Number of block calls
+        timestamp_t           totalDuration = 0; ///< Total duration of all calls in nanoseconds
+        timestamp_t             minDuration = 0; ///< Min duration in nanoseconds
+        timestamp_t             maxDuration = 0; ///< Max duration in nanoseconds
+        std::vector<HistogramBucket> histogram; ///< Non-empty buckets of durations histogram sorted by lowerBound
+    };
+
+    using block_summaries_t = std::vector<BlockSummary>;
+
+#ifdef USING_EASY_PROFILER
+    extern "C" {
+
+        /** Switch statistics-only capture mode.
+
+        In this mode closed blocks are not stored. Instead, calls number, total, min and max duration
+        and durations histogram are accumulated for each block descriptor by each thread, so used memory
+        does not depend on capture duration. Accumulated statistics are reset when profiler is enabled.
+
+        \note Mode can be changed only while profiler is disabled.
+
+        \retval false if profiler is enabled.
+
+        \sa EASY_OPTION_STATISTICS_ONLY
+
+        \ingroup profiler
+        */
+        PROFILER_API bool setStatisticsOnly(bool _enable);
+
+        /** Returns true if statistics-only capture mode is on.
+
+        \ingroup profiler
+        */
+        PROFILER_API bool isStatisticsOnly();
+
+        /** Merge statistics accumulated by all threads since profiler has been enabled.
+
+        Can be called at any time without stopping profiling. Blocks with run-time names
+        are accumulated together with other blocks of the same descriptor.
+
+        \param _statistics Output list sorted by descriptor id (contains only called blocks).
+
+        \ingroup profiler
+        */
+        PROFILER_API void gatherStatistics(block_summaries_t& _statistics);
+
+    }
+#else
+    inline bool setStatisticsOnly(bool) { return false; }
+    inline EASY_CONSTEXPR_FCN bool isStatisticsOnly() { return false; }
+    inline void gatherStatistics(block_summaries_t& _statistics) { _statistics.clear(); }
+#endif
+
+} // END of namespace profiler.
+
+#endif // EASY_PROFILER_STATISTICS_H
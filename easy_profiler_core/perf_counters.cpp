@@ -0,0 +1,292 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#include <string.h>
+#include "perf_counters.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <atomic>
+#include <errno.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if EASY_OPTION_LOG_ENABLED != 0
+# include <iostream>
+
+# ifndef EASY_ERRORLOG
+#  define EASY_ERRORLOG std::cerr
+# endif
+
+# ifndef EASY_WARNING
+#  define EASY_WARNING(LOG_MSG) EASY_ERRORLOG << "EasyProfiler WARNING: " << LOG_MSG
+# endif
+
+# ifndef EASY_LOG_ONLY
+#  define EASY_LOG_ONLY(CODE) CODE
+# endif
+
+#else
+
+# ifndef EASY_WARNING
+#  define EASY_WARNING(LOG_MSG) 
+# endif
+
+# ifndef EASY_LOG_ONLY
+#  define EASY_LOG_ONLY(CODE) 
+# endif
+
+#endif
+
+#ifndef PERF_FLAG_FD_CLOEXEC
+# define PERF_FLAG_FD_CLOEXEC (1UL << 3)
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+struct PerfEventInfo
+{
+    uint32_t                type;
+    uint64_t              config;
+    profiler::PerfCounter counter;
+};
+
+static const PerfEventInfo SOFTWARE_EVENTS[] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, profiler::PERF_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, profiler::PERF_PAGE_FAULTS},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, profiler::PERF_CONTEXT_SWITCHES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, profiler::PERF_CPU_MIGRATIONS},
+};
+
+static const PerfEventInfo HARDWARE_EVENTS[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, profiler::PERF_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, profiler::PERF_INSTRUCTIONS},
+};
+
+/** Opens counter of the calling thread on any CPU.
+
+Kernel mode is excluded only if _excludeKernel is true (context switches are counted in kernel mode). */
+static int perfEventOpen(const PerfEventInfo& _event, int _group, uint64_t _readFormat, bool _disabled, bool _excludeKernel)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = _event.type;
+    attr.config = _event.config;
+    attr.read_format = _readFormat;
+    attr.disabled = _disabled ? 1 : 0;
+    attr.exclude_kernel = _excludeKernel ? 1 : 0;
+    attr.exclude_hv = 1;
+
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, _group, PERF_FLAG_FD_CLOEXEC));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static uint64_t rdpmc(uint32_t _counter)
+{
+    uint32_t low, high;
+    __asm__ __volatile__("rdpmc" : "=a" (low), "=d" (high) : "c" (_counter));
+    return static_cast<uint64_t>(low) | (static_cast<uint64_t>(high) << 32);
+}
+#endif
+
+/** Reads hardware counter from user page without a system call (see perf_event_mmap_page description).
+
+\retval false if rdpmc is not allowed or the counter is not active at the moment. */
+static bool readUserPage(const void* _page, uint64_t& _value)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    auto page = static_cast<const volatile perf_event_mmap_page*>(_page);
+    uint32_t sequence, index;
+    do
+    {
+        sequence = page->lock;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+
+        index = page->index;
+        if (!page->cap_user_rdpmc || index == 0)
+            return false;
+
+        const auto width = static_cast<uint32_t>(page->pmc_width);
+        const auto pmc = rdpmc(index - 1) << (64 - width);
+        _value = static_cast<uint64_t>(page->offset + (static_cast<int64_t>(pmc) >> (64 - width)));
+
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    } while (page->lock != sequence);
+
+    return true;
+#else
+    (void)_page;
+    (void)_value;
+    return false;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+ThreadPerfCounters::~ThreadPerfCounters()
+{
+    for (int i = 0; i < HARDWARE_COUNTERS; ++i)
+    {
+        if (m_pages[i] != nullptr)
+            munmap(m_pages[i], static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+        if (m_hardware[i] >= 0)
+            close(m_hardware[i]);
+    }
+
+    // Closing the leader after its members
+    if (m_group >= 0)
+        close(m_group);
+}
+
+bool ThreadPerfCounters::open()
+{
+    if (m_opened)
+        return m_mask != 0;
+
+    m_opened = true;
+
+    // Kernel mode is counted if allowed by kernel.perf_event_paranoid (or capabilities)
+    bool excludeKernel = false;
+    EASY_LOG_ONLY(int error = 0);
+    for (const auto& event : SOFTWARE_EVENTS)
+    {
+        // Leader is opened disabled and enabled together with all members,
+        // otherwise members added to the running group would not count until the next context switch
+        int fd = perfEventOpen(event, m_group, PERF_FORMAT_GROUP, m_group < 0, excludeKernel);
+        if (fd < 0 && (errno == EACCES || errno == EPERM) && !excludeKernel)
+        {
+            excludeKernel = true;
+            fd = perfEventOpen(event, m_group, PERF_FORMAT_GROUP, m_group < 0, excludeKernel);
+        }
+
+        if (fd < 0)
+        {
+            EASY_LOG_ONLY(error = errno);
+            continue;
+        }
+
+        if (m_group < 0)
+            m_group = fd;
+
+        m_groupCounters[m_groupSize++] = event.counter;
+        m_mask |= static_cast<uint8_t>(1 << event.counter);
+    }
+
+    if (m_group >= 0)
+        ioctl(m_group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    for (int i = 0; i < HARDWARE_COUNTERS; ++i)
+    {
+        const auto& event = HARDWARE_EVENTS[i];
+        m_hardware[i] = perfEventOpen(event, -1, 0, false, excludeKernel);
+        if (m_hardware[i] < 0)
+            continue; // Hardware counters are usually not available on virtual machines
+
+        m_mask |= static_cast<uint8_t>(1 << event.counter);
+
+#if defined(__x86_64__) || defined(__i386__)
+        void* page = mmap(nullptr, static_cast<size_t>(sysconf(_SC_PAGESIZE)), PROT_READ, MAP_SHARED, m_hardware[i], 0);
+        if (page != MAP_FAILED)
+            m_pages[i] = page;
+#endif
+    }
+
+#if EASY_OPTION_LOG_ENABLED != 0
+    static std::atomic<bool> warned(false);
+    if (m_mask == 0 && !warned.exchange(true, std::memory_order_relaxed))
+        EASY_WARNING("Performance counters are not available: " << strerror(error) << std::endl);
+#endif
+
+    return m_mask != 0;
+}
+
+void ThreadPerfCounters::read(profiler::PerfCounters& _values) const
+{
+    memset(_values.values, 0, sizeof(_values.values));
+    _values.mask = m_mask;
+
+    if (m_group >= 0)
+    {
+        // Group read format: number of counters followed by value of each counter
+        uint64_t buffer[1 + SOFTWARE_COUNTERS];
+        if (::read(m_group, buffer, sizeof(buffer)) > 0)
+        {
+            for (uint64_t i = 0; i < buffer[0] && i < m_groupSize; ++i)
+                _values.values[m_groupCounters[i]] = buffer[i + 1];
+        }
+    }
+
+    for (int i = 0; i < HARDWARE_COUNTERS; ++i)
+    {
+        if (m_hardware[i] < 0)
+            continue;
+
+        auto& value = _values.values[HARDWARE_EVENTS[i].counter];
+        if (m_pages[i] == nullptr || !readUserPage(m_pages[i], value))
+        {
+            if (::read(m_hardware[i], &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value)))
+                value = 0;
+        }
+    }
+}
+
+#else // defined(__linux__) && !defined(__ANDROID__)
+
+ThreadPerfCounters::~ThreadPerfCounters()
+{
+}
+
+bool ThreadPerfCounters::open()
+{
+    m_opened = true;
+    return false;
+}
+
+void ThreadPerfCounters::read(profiler::PerfCounters& _values) const
+{
+    memset(&_values, 0, sizeof(_values));
+}
+
+#endif // defined(__linux__) && !defined(__ANDROID__)
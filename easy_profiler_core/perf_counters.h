@@ -0,0 +1,97 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_PERF_COUNTERS_H
+#define EASY_PROFILER_PERF_COUNTERS_H
+
+#include <easy/serialized_block.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+/** Performance counters of one thread opened through perf_event_open (Linux only).
+
+Software counters (task-clock, page-faults, context-switches, cpu-migrations) form one group led by the first
+opened counter and are read by single read() call. Hardware counters (cycles, instructions) are read by rdpmc
+instruction from the mapped user page of the event if the kernel allows it (cap_user_rdpmc) or by read() otherwise.
+Counters which could not be opened (e.g. hardware counters on most virtual machines) are not sampled.
+
+Kernel mode is excluded, so counters could be opened by unprivileged user with default kernel.perf_event_paranoid.
+No counters are available on other platforms.
+*/
+class ThreadPerfCounters EASY_FINAL
+{
+#if defined(__linux__) && !defined(__ANDROID__)
+    EASY_STATIC_CONSTEXPR int SOFTWARE_COUNTERS = 4;
+    EASY_STATIC_CONSTEXPR int HARDWARE_COUNTERS = 2;
+
+    int                                m_group = -1; ///< Leader of software counters group
+    int      m_hardware[HARDWARE_COUNTERS] = {-1, -1}; ///< Hardware counters file descriptors (-1 if not opened)
+    void*       m_pages[HARDWARE_COUNTERS] = {}; ///< Mapped user pages of hardware counters (used by rdpmc)
+    uint8_t m_groupCounters[SOFTWARE_COUNTERS] = {}; ///< PerfCounter of each member of software group in order of reading
+    uint8_t                        m_groupSize = 0; ///< Number of opened software counters
+#endif
+    uint8_t                             m_mask = 0; ///< Bit (1 << PerfCounter) is set for each opened counter
+    bool                           m_opened = false; ///< True if open() has been called
+
+public:
+
+    ThreadPerfCounters() = default;
+    ~ThreadPerfCounters();
+
+    ThreadPerfCounters(const ThreadPerfCounters&) = delete;
+    ThreadPerfCounters& operator = (const ThreadPerfCounters&) = delete;
+
+    /** Opens counters for the calling thread on the first call.
+
+    \retval false if no counter is available. */
+    bool open();
+
+    /** Reads current values of opened counters (values of other counters are set to 0). */
+    void read(profiler::PerfCounters& _values) const;
+
+    uint8_t mask() const { return m_mask; }
+
+}; // END of class ThreadPerfCounters.
+
+//////////////////////////////////////////////////////////////////////////
+
+#endif // EASY_PROFILER_PERF_COUNTERS_H
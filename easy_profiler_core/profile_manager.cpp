@@ -49,38 +49,43 @@
 ************************************************************************/
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
 #include <future>
 #include <fstream>
+#include <limits>
 #include <ostream>
 #include <sstream>
 #include "profile_manager.h"
 
 #include <easy/profiler.h>
 #include <easy/arbitrary_value.h>
+#include <easy/statistics.h>
 #include <easy/easy_net.h>
 
 #ifndef _WIN32
 # include <easy/easy_socket.h>
+# include "event_trace_linux.h"
 #else
 # include "event_trace_win.h"
 #endif
 
+#if (defined(_WIN32) && !defined(_UWP)) || (defined(__linux__) && !defined(__ANDROID__))
+# define USE_TRACING
+#endif
+
 #include "block_descriptor.h"
+#include "crash_recovery.h"
+#include "cswitch_log.h"
 #include "current_time.h"
+#include "clock_source.h"
 #include "current_thread.h"
-
-#ifdef __APPLE__
-# include <mach/clock.h>
-# include <mach/mach.h>
-#endif
+#include "socket_output_buffer.h"
 
 #if EASY_OPTION_LOG_ENABLED != 0
 # include <iostream>
 
-#if defined(_WIN32) && !defined(_UWP)
-#define USE_TRACING
-#endif
-
 # ifndef EASY_ERRORLOG
 #  define EASY_ERRORLOG std::cerr
 # endif
@@ -141,6 +146,46 @@
 # define EASY_OPTION_IMPLICIT_THREAD_REGISTRATION 0
 #endif
 
+#ifndef EASY_OPTION_FLIGHT_RECORDER_MEMORY
+# define EASY_OPTION_FLIGHT_RECORDER_MEMORY 0
+#endif
+
+#ifndef EASY_OPTION_STATISTICS_ONLY_ENABLED
+# define EASY_OPTION_STATISTICS_ONLY_ENABLED 0
+#endif
+
+#ifndef EASY_OPTION_CHUNK_POOL_MEMORY
+# define EASY_OPTION_CHUNK_POOL_MEMORY 0
+#endif
+
+#ifndef EASY_OPTION_CRASH_RECOVERY_DIRECTORY
+# define EASY_OPTION_CRASH_RECOVERY_DIRECTORY "" // Empty means crash recovery is disabled
+#endif
+
+#ifndef EASY_OPTION_COLLECTOR_EXIT_TIMEOUT
+# define EASY_OPTION_COLLECTOR_EXIT_TIMEOUT 3000 // Max time in milliseconds to wait on exit for the collector to collect the last frames
+#endif
+
+#ifndef EASY_OPTION_SPIKE_CAPTURE_TIMEOUT
+# define EASY_OPTION_SPIKE_CAPTURE_TIMEOUT 3000 // Max time in milliseconds to wait for frames following the spike
+#endif
+
+#ifndef EASY_OPTION_CLOCK_SOURCE
+# define EASY_OPTION_CLOCK_SOURCE profiler::ClockSource::Native
+#endif
+
+#ifndef EASY_OPTION_SEND_BUFFER_SIZE
+# define EASY_OPTION_SEND_BUFFER_SIZE (64 * 1024) // Size in bytes of data messages used for sending blocks over network
+#endif
+
+#ifndef EASY_OPTION_STREAMING_INTERVAL
+# define EASY_OPTION_STREAMING_INTERVAL 100 // Interval in milliseconds between parts sent in streaming mode
+#endif
+
+#ifndef EASY_OPTION_GAUGE_SAMPLING_RATE
+# define EASY_OPTION_GAUGE_SAMPLING_RATE 1000 // Default rate in Hz at which registered gauges are sampled
+#endif
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
@@ -158,6 +203,8 @@ EASY_CONSTEXPR profiler::color_t EASY_COLOR_END = 0xfff44336; // profiler::color
 
 EASY_CONSTEXPR uint8_t FORCE_ON_FLAG = profiler::FORCE_ON & ~profiler::ON;
 
+EASY_CONSTEXPR profiler::thread_id_t EXECUTION_CONTEXT_ID_FLAG = 1ULL << 63; ///< Set in ids of execution contexts stored as pseudo-threads
+
 //////////////////////////////////////////////////////////////////////////
 
 static EASY_THREAD_LOCAL ::ThreadStorage* THIS_THREAD = nullptr;
@@ -170,6 +217,15 @@ static EASY_THREAD_LOCAL uint32_t THIS_THREAD_N_FRAMES = 0;
 static EASY_THREAD_LOCAL bool THIS_THREAD_FRAME_T_RESET_MAX = false;
 static EASY_THREAD_LOCAL bool THIS_THREAD_FRAME_T_RESET_AVG = false;
 
+// Allocations counted by trackAllocation() regardless of profiler status. They belong to the current
+// execution context: switchExecutionContext() saves them into the suspended context and restores them
+// from the resumed one, so allocations of other fibers are not charged to blocks of a suspended fiber.
+static EASY_THREAD_LOCAL uint64_t THIS_THREAD_ALLOCATED_BYTES = 0ULL;
+static EASY_THREAD_LOCAL uint64_t THIS_THREAD_ALLOCATIONS = 0ULL;
+
+// Storage of current thread itself while THIS_THREAD points to an execution context (nullptr otherwise)
+static EASY_THREAD_LOCAL ::ThreadStorage* THIS_THREAD_OWN = nullptr;
+
 #ifdef EASY_CXX11_TLS_AVAILABLE
 thread_local static profiler::ThreadGuard THIS_THREAD_GUARD; // thread guard for monitoring thread life time
 #endif
@@ -225,6 +281,43 @@ static void write(std::ostream& _outstream, const T& _data)
     _outstream.write((const char*)&_data, sizeof(T));
 }
 
+static uint64_t descriptorsMemorySize(const DescriptorRegistry& _descriptors, uint32_t _count)
+{
+    uint64_t memorySize = 0;
+    _descriptors.forEach(_count, [&memorySize](const BlockDescriptor& _descriptor) {
+        memorySize += sizeof(profiler::SerializedBlockDescriptor) + _descriptor.nameSize() + _descriptor.filenameSize();
+    });
+    return memorySize;
+}
+
+static void writeDescriptors(std::ostream& _outstream, const DescriptorRegistry& _descriptors, uint32_t _count)
+{
+    _descriptors.forEach(_count, [&_outstream](const BlockDescriptor& _descriptor) {
+        const auto name_size = _descriptor.nameSize();
+        const auto filename_size = _descriptor.filenameSize();
+        const auto size = static_cast<uint16_t>(sizeof(profiler::SerializedBlockDescriptor) + name_size + filename_size);
+
+        write(_outstream, size);
+        write<profiler::BaseBlockDescriptor>(_outstream, _descriptor);
+        write(_outstream, name_size);
+        write(_outstream, _descriptor.name(), name_size);
+        write(_outstream, _descriptor.filename(), filename_size);
+    });
+}
+
+static void writeRuntimeNames(std::ostream& _outstream, const RuntimeNames& _names)
+{
+    write(_outstream, _names.size());
+    write(_outstream, _names.memorySize());
+    for (uint32_t id = 0, size = _names.size(); id < size; ++id)
+    {
+        const auto& name = _names.name(id);
+        const auto name_size = static_cast<uint16_t>(name.size() + 1);
+        write(_outstream, name_size);
+        write(_outstream, name.c_str(), name_size);
+    }
+}
+
 static void clear_sstream(std::stringstream& _outstream)
 {
 #if defined(__GNUC__) && __GNUC__ < 5
@@ -241,12 +334,19 @@ static void clear_sstream(std::stringstream& _outstream)
 profiler::ThreadGuard::~ThreadGuard()
 {
 #ifndef EASY_PROFILER_API_DISABLED
+    if (THIS_THREAD_OWN != nullptr)
+    {
+        // Thread is finishing inside of an execution context
+        ProfileManager::instance().switchExecutionContext(nullptr);
+    }
+
     if (m_id != 0 && THIS_THREAD != nullptr && THIS_THREAD->id == m_id)
     {
         bool isMarked = false;
         EASY_EVENT_RES(isMarked, "ThreadFinished", EASY_COLOR_THREAD_END, profiler::FORCE_ON);
         //THIS_THREAD->markProfilingFrameEnded();
         THIS_THREAD->putMark();
+        ProfileManager::instance().finishSpikeFrames(THIS_THREAD);
         THIS_THREAD->expired.store(isMarked ? 2 : 1, std::memory_order_release);
         THIS_THREAD = nullptr;
     }
@@ -255,67 +355,6 @@ profiler::ThreadGuard::~ThreadGuard()
 
 //////////////////////////////////////////////////////////////////////////
 
-#if defined(EASY_CHRONO_CLOCK)
-static EASY_CONSTEXPR_FCN int64_t calculate_cpu_frequency()
-{
-    return EASY_CHRONO_CLOCK::period::den / EASY_CHRONO_CLOCK::period::num;
-}
-#elif defined(_WIN32)
-static int64_t calculate_cpu_frequency()
-{
-    LARGE_INTEGER freq;
-    QueryPerformanceFrequency(&freq);
-    return static_cast<int64_t>(freq.QuadPart);
-}
-#else
-# ifndef __APPLE__
-#  include <time.h>
-# endif
-static int64_t calculate_cpu_frequency()
-{
-    EASY_CONSTEXPR int NANO_SECONDS_IN_SEC = 1000000000;
-
-    uint64_t begin = 0;
-    uint64_t end = 0;
-
-# ifdef __APPLE__
-    clock_serv_t cclock;
-    mach_timespec_t begints, endts;
-    host_get_clock_service(mach_host_self(), SYSTEM_CLOCK, &cclock);
-    clock_get_time(cclock, &begints);
-# else
-    struct timespec begints, endts;
-    clock_gettime(CLOCK_MONOTONIC, &begints);
-# endif
-
-    begin = profiler::clock::now();
-    volatile uint64_t i;
-    for (i = 0; i < 100000000; i++); /* must be CPU intensive */
-    end = profiler::clock::now();
-
-# ifdef __APPLE__
-    clock_get_time(cclock, &endts);
-    mach_port_deallocate(mach_task_self(), cclock);
-# else
-    clock_gettime(CLOCK_MONOTONIC, &endts);
-# endif
-
-    struct timespec tmpts;
-    tmpts.tv_sec = endts.tv_sec - begints.tv_sec;
-    tmpts.tv_nsec = endts.tv_nsec - begints.tv_nsec;
-
-    if (tmpts.tv_nsec < 0)
-    {
-        tmpts.tv_sec--;
-        tmpts.tv_nsec += NANO_SECONDS_IN_SEC;
-    }
-
-    const uint64_t nsecElapsed = tmpts.tv_sec * 1000000000LL + tmpts.tv_nsec;
-    const double ticksPerNanoSec = static_cast<double>(end - begin) / static_cast<double>(nsecElapsed);
-
-    return int64_t(ticksPerNanoSec * 1000000);
-}
-#endif
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -327,19 +366,69 @@ ProfileManager::ProfileManager() :
     m_processId((processid_t)getpid())
 #endif
 
-#if defined(EASY_CHRONO_CLOCK) || defined(_WIN32)
-    , m_cpuFrequency(calculate_cpu_frequency())
-#endif
-
-    , m_descriptorsMemorySize(0)
+    , m_clock(profiler::clock::exactFrequency(profiler::ClockSource::Native))
+    , m_overflowDescriptor(std::numeric_limits<profiler::block_id_t>::max(), profiler::OFF, "EasyProfiler.DescriptorsOverflow",
+                           __FILE__, __LINE__, profiler::BlockType::Block, EASY_COLOR_INTERNAL_EVENT)
+    , m_blockOverhead(0)
     , m_beginTime(0)
     , m_endTime(0)
 {
     m_profilerStatus = false;
     m_isEventTracingEnabled = EASY_OPTION_EVENT_TRACING_ENABLED;
+    m_isEventTracerLaunched = false;
     m_isAlreadyListening = false;
     m_stopDumping = false;
     m_stopListen = false;
+    m_lastGaugeId = 0;
+    m_gaugeSamplingRate = EASY_OPTION_GAUGE_SAMPLING_RATE;
+    m_stopGaugeSampler = false;
+    m_threadMemoryLimit = EASY_OPTION_FLIGHT_RECORDER_MEMORY;
+    m_isStatisticsOnly = EASY_OPTION_STATISTICS_ONLY_ENABLED != 0;
+    m_statisticsEpoch = 0;
+    m_isAllocationTracking = false;
+    m_executionContextsCount = 0;
+    m_spikeFrameThreshold = 0;
+    m_spikeBlockThreshold = 0;
+    m_spikeFrameThresholdUs = 0;
+    m_spikeBlockThresholdUs = 0;
+    m_spikeBlockId = std::numeric_limits<profiler::block_id_t>::max();
+    m_spikeFramesBefore = 0;
+    m_spikeFramesAfter = 0;
+    m_spikeCaptures = 0;
+    m_spikeThread = nullptr;
+    m_isSpikeCaptureEnabled = false;
+    m_isSpikeCapturing = false;
+    m_isSpikeWriteRequested = false;
+    m_isSpikePinned = false;
+    m_stopSpikeWriter = false;
+    m_spikeSince = 0;
+    m_spikeFramesLeft = 0;
+
+#if !defined(EASY_PROFILER_API_DISABLED)
+    // Must be opened before the chunk pool is grown
+    const char* crashRecoveryDirectory = EASY_OPTION_CRASH_RECOVERY_DIRECTORY;
+    if (*crashRecoveryDirectory != 0 && !setCrashRecoveryDirectory(crashRecoveryDirectory))
+    {
+        EASY_ERROR("Can not enable crash recovery in \"" << crashRecoveryDirectory << "\"\n");
+    }
+#endif
+
+    if (EASY_OPTION_CHUNK_POOL_MEMORY != 0)
+        ChunkPool::instance().reserve(EASY_OPTION_CHUNK_POOL_MEMORY);
+
+#if !defined(EASY_PROFILER_API_DISABLED)
+    auto clockSource = EASY_OPTION_CLOCK_SOURCE;
+# ifdef _WIN32
+    // Self-test joins threads which is not allowed while DLL is being loaded.
+    // QueryPerformanceCounter is already the best monotonic source chosen by Windows.
+    if (clockSource == profiler::ClockSource::Auto)
+        clockSource = profiler::ClockSource::Native;
+# endif
+    if (clockSource != profiler::ClockSource::Native && !setClockSource(clockSource))
+    {
+        EASY_ERROR("Clock source " << static_cast<int>(clockSource) << " is not available, native clock is used\n");
+    }
+#endif
 
     m_mainThreadId = 0;
     m_frameMax = 0;
@@ -348,16 +437,6 @@ ProfileManager::ProfileManager() :
     m_frameMaxReset = false;
     m_frameAvgReset = false;
 
-#if !defined(EASY_CHRONO_CLOCK) && !defined(_WIN32)
-    m_cpuFrequency = 1;
-
-# if !defined(EASY_PROFILER_API_DISABLED)
-    const auto cpu_frequency = calculate_cpu_frequency();
-    m_cpuFrequency.store(cpu_frequency, std::memory_order_release);
-# endif
-
-#endif
-
 #if !defined(EASY_PROFILER_API_DISABLED) && EASY_OPTION_START_LISTEN_ON_STARTUP != 0
     startListen(profiler::DEFAULT_PORT);
 #endif
@@ -367,10 +446,12 @@ ProfileManager::~ProfileManager()
 {
 #ifndef EASY_PROFILER_API_DISABLED
     stopListen();
+    stopGaugeSampler();
+    stopSpikeWriter();
+    auto& crashRecovery = CrashRecovery::instance();
+    crashRecovery.waitForCollector(EASY_OPTION_COLLECTOR_EXIT_TIMEOUT);
+    crashRecovery.close();
 #endif
-
-    for (auto desc : m_descriptors)
-        BlockDescriptor::destroy(desc);
 }
 
 #ifndef EASY_MAGIC_STATIC_AVAILABLE
@@ -398,7 +479,14 @@ ProfileManager& ProfileManager::instance()
 
 ThreadStorage& ProfileManager::_threadStorage(profiler::thread_id_t _thread_id)
 {
-    return m_threads[_thread_id];
+    auto it = m_threads.find(_thread_id);
+    if (it != m_threads.end())
+        return it->second;
+
+    auto& ts = m_threads[_thread_id];
+    ts.setMemoryLimit(m_threadMemoryLimit.load(std::memory_order_acquire));
+    ts.setPinned(m_isSpikePinned.load(std::memory_order_acquire));
+    return ts;
 }
 
 ThreadStorage* ProfileManager::_findThreadStorage(profiler::thread_id_t _thread_id)
@@ -413,43 +501,20 @@ const profiler::BaseBlockDescriptor* ProfileManager::addBlockDescriptor(profiler
     , const char* _autogenUniqueId, const char* _name, const char* _filename, int _line
     , profiler::block_type_t _block_type, profiler::color_t _color, bool _copyName)
 {
-    guard_lock_t lock(m_storedSpin);
-
-    const descriptors_map_t::key_type key(_autogenUniqueId);
-    auto it = m_descriptorsMap.find(key);
-    if (it != m_descriptorsMap.end())
-        return m_descriptors[it->second];
-
-    const auto nameLen = strlen(_name);
-    m_descriptorsMemorySize += sizeof(profiler::SerializedBlockDescriptor) + nameLen + strlen(_filename) + 2;
-
-#if EASY_BLOCK_DESC_FULL_COPY == 0
-    BlockDescriptor* desc = nullptr;
-
-    if (_copyName)
-    {
-        void* data = malloc(sizeof(BlockDescriptor) + nameLen + 1);
-        char* name = reinterpret_cast<char*>(data) + sizeof(BlockDescriptor);
-        strncpy(name, _name, nameLen);
-        desc = ::new (data)BlockDescriptor(static_cast<profiler::block_id_t>(m_descriptors.size()),
-                                           _defaultStatus, name, _filename, _line, _block_type, _color);
-    }
-    else
+    // Wait-free for already registered descriptors, never blocks behind dumpBlocksToStream()
+    auto descriptor = m_descriptors.add(_defaultStatus, _autogenUniqueId, _name, _filename, _line, _block_type, _color, _copyName);
+    if (descriptor == nullptr)
     {
-        void* data = malloc(sizeof(BlockDescriptor));
-        desc = ::new (data)BlockDescriptor(static_cast<profiler::block_id_t>(m_descriptors.size()),
-                                           _defaultStatus, _name, _filename, _line, _block_type, _color);
+        // Blocks of the shared descriptor are never stored because it is disabled and it's status can not be changed
+        EASY_ERROR("Too many block descriptors, \"" << _name << "\" (" << _filename << ":" << _line << ") is disabled\n");
+        return &m_overflowDescriptor;
     }
-#else
-    auto desc = new BlockDescriptor(static_cast<profiler::block_id_t>(m_descriptors.size()),
-                                    _defaultStatus, _name, _filename, _line, _block_type, _color);
-    (void)_copyName; // unused
-#endif
 
-    m_descriptors.emplace_back(desc);
-    m_descriptorsMap.emplace(key, desc->id());
+    auto& crashRecovery = CrashRecovery::instance();
+    if (crashRecovery.isOpened())
+        crashRecovery.journalDescriptors(m_descriptors);
 
-    return desc;
+    return descriptor;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -457,7 +522,7 @@ const profiler::BaseBlockDescriptor* ProfileManager::addBlockDescriptor(profiler
 void ProfileManager::storeValue(const profiler::BaseBlockDescriptor* _desc, profiler::DataType _type, const void* _data,
                                 uint16_t _size, bool _isArray, profiler::ValueId _vin)
 {
-    if (!isEnabled() || (_desc->m_status & profiler::ON) == 0)
+    if (!isEnabled() || (_desc->m_status & profiler::ON) == 0 || isStatisticsOnly())
         return;
 
     if (THIS_THREAD == nullptr)
@@ -495,12 +560,33 @@ bool ProfileManager::storeBlock(const profiler::BaseBlockDescriptor* _desc, cons
 #endif
 
     const auto time = profiler::clock::now();
+    if (isStatisticsOnly())
+    {
+        THIS_THREAD->accumulate(_desc->id(), 0, m_statisticsEpoch.load(std::memory_order_relaxed));
+        return true;
+    }
+
     THIS_THREAD->storeBlock(profiler::Block(time, time, _desc->id(), _runtimeName));
     THIS_THREAD->putMarkIfEmpty();
 
     return true;
 }
 
+void ProfileManager::storeFlow(uint64_t _id, profiler::FlowPointType _type)
+{
+    if (!isEnabled() || isStatisticsOnly())
+        return;
+
+    if (THIS_THREAD == nullptr)
+        registerThread();
+
+    if (THIS_THREAD->stackSize > 0)
+        // Prevent from store flow until frame, which has been opened when profiler was disabled, finish
+        return;
+
+    THIS_THREAD->storeFlow(profiler::clock::now(), _id, _type);
+}
+
 bool ProfileManager::storeBlock(const profiler::BaseBlockDescriptor* _desc, const char* _runtimeName,
                                 profiler::timestamp_t _beginTime, profiler::timestamp_t _endTime)
 {
@@ -519,6 +605,12 @@ bool ProfileManager::storeBlock(const profiler::BaseBlockDescriptor* _desc, cons
         return false;
 #endif
 
+    if (isStatisticsOnly())
+    {
+        THIS_THREAD->accumulate(_desc->id(), _endTime - _beginTime, m_statisticsEpoch.load(std::memory_order_relaxed));
+        return true;
+    }
+
     profiler::Block b(_beginTime, _endTime, _desc->id(), _runtimeName);
     THIS_THREAD->storeBlock(b);
     b.m_end = b.m_begin;
@@ -601,11 +693,32 @@ void ProfileManager::beginBlock(profiler::Block& _block)
 #if EASY_ENABLE_BLOCK_STATUS != 0
     if (THIS_THREAD->allowChildren)
     {
+        if ((blockStatus & SAMPLED_FLAG) != 0 && !THIS_THREAD->sample(_block.id(), m_descriptors.get(_block.id())->sampling()))
+        {
+            // Block is dropped by sampling together with all of it's children.
+            // Number of dropped calls is stored at the end of the frame.
+            _block.m_status = profiler::OFF_RECURSIVE;
+            THIS_THREAD->allowChildren = false;
+        }
+        else
+        {
 #endif
         if (blockStatus & profiler::ON)
+        {
+            // Counters are read before the block start, so reading cost is not included into block duration.
+            // COUNTERS_FLAG is left only if counters have been read (endBlock() and popSilent() rely on it).
+            if ((blockStatus & COUNTERS_FLAG) != 0 && (isStatisticsOnly() || !THIS_THREAD->beginCounters()))
+                _block.m_status = static_cast<profiler::EasyBlockStatus>(blockStatus & ~COUNTERS_FLAG);
+            if (isAllocationTracking() && !isStatisticsOnly())
+            {
+                _block.m_status = static_cast<profiler::EasyBlockStatus>(_block.m_status | ALLOCATIONS_FLAG);
+                THIS_THREAD->beginAllocations(THIS_THREAD_ALLOCATED_BYTES, THIS_THREAD_ALLOCATIONS);
+            }
             _block.start();
+        }
 #if EASY_ENABLE_BLOCK_STATUS != 0
         THIS_THREAD->allowChildren = ((blockStatus & profiler::OFF_RECURSIVE) == 0);
+        }
     }
     else if (blockStatus & FORCE_ON_FLAG)
     {
@@ -640,9 +753,7 @@ void ProfileManager::beginContextSwitch(profiler::thread_id_t _thread_id, profil
 {
     auto ts = _lockSpin ? findThreadStorage(_thread_id) : _findThreadStorage(_thread_id);
     if (ts != nullptr)
-        // Dirty hack: _target_thread_id will be written to the field "block_id_t m_id"
-        // and will be available calling method id().
-        ts->sync.openedList.emplace_back(_time, _target_thread_id, _target_process);
+        ts->beginCSwitch(_time, _target_thread_id, _target_process);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -661,6 +772,12 @@ void ProfileManager::endBlock()
     if (!isEnabled())
     {
         THIS_THREAD->popSilent();
+        if (THIS_THREAD->blocks.openedList.empty())
+        {
+            // Profiler has been disabled before this frame has been closed.
+            // Remove this frame's blocks which have been already stored.
+            THIS_THREAD->dropUnclosedFrame();
+        }
         endFrame(); // FPS counter
         return;
     }
@@ -674,7 +791,28 @@ void ProfileManager::endBlock()
     {
         if (!top.finished())
             top.finish();
-        THIS_THREAD->storeBlock(top);
+
+        const bool counted = (top.m_status & COUNTERS_FLAG) != 0;
+        profiler::PerfCounters counters;
+        if (counted)
+            THIS_THREAD->endCounters(counters);
+
+        profiler::Allocations allocations;
+        const bool allocated = (top.m_status & ALLOCATIONS_FLAG) != 0 &&
+            THIS_THREAD->endAllocations(THIS_THREAD_ALLOCATED_BYTES, THIS_THREAD_ALLOCATIONS, allocations);
+
+        if (isStatisticsOnly())
+            THIS_THREAD->accumulate(top.id(), top.duration(), m_statisticsEpoch.load(std::memory_order_relaxed));
+        else
+        {
+            THIS_THREAD->storeBlock(top);
+            if (counted)
+                THIS_THREAD->storeCounters(counters);
+            if (allocated)
+                THIS_THREAD->storeAllocations(allocations);
+            if (top.id() == m_spikeBlockId.load(std::memory_order_relaxed) && top.duration() > m_spikeBlockThreshold.load(std::memory_order_relaxed))
+                THIS_THREAD->spikeBlockHit = true;
+        }
     }
     else
     {
@@ -682,12 +820,20 @@ void ProfileManager::endBlock()
         top.m_end = top.m_begin;
     }
 
+    const bool stored = (top.m_status & profiler::ON) != 0;
     if (!top.m_isScoped)
         THIS_THREAD->nonscopedBlocks.pop();
 
     currentThreadStack.pop_back();
     if (currentThreadStack.empty())
     {
+        if (!THIS_THREAD->droppedIds.empty())
+        {
+            if (isStatisticsOnly())
+                THIS_THREAD->clearDropped();
+            else
+                THIS_THREAD->storeDropped(stored);
+        }
         THIS_THREAD->putMark();
         endFrame(); // FPS counter
 #if EASY_ENABLE_BLOCK_STATUS != 0
@@ -725,14 +871,21 @@ void ProfileManager::endContextSwitch(profiler::thread_id_t _thread_id, processi
         ts = _lockSpin ? findThreadStorage(_thread_id) : _findThreadStorage(_thread_id);
     }
 
-    if (ts == nullptr || ts->sync.openedList.empty())
-        return;
-
-    CSwitchBlock& lastBlock = ts->sync.openedList.back();
-    lastBlock.m_end = _endtime;
+    if (ts != nullptr)
+        ts->endCSwitch(_endtime);
+}
 
-    ts->storeCSwitch(lastBlock);
-    ts->sync.openedList.pop_back();
+void ProfileManager::storeContextSwitches(const CSwitchEvent* _events, size_t _count)
+{
+    // Single lock for the whole batch: dumpBlocksToStream() clears opened context switches
+    // and removes thread storages under the same lock.
+    guard_lock_t lock(m_spin);
+    for (size_t i = 0; i < _count; ++i)
+    {
+        const auto& event = _events[i];
+        beginContextSwitch(event.threadFrom, event.timestamp, event.threadTo, event.targetName, false);
+        endContextSwitch(event.threadTo, event.processTo, event.timestamp, false);
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -749,6 +902,12 @@ void ProfileManager::endFrame()
 
     const profiler::timestamp_t duration = THIS_THREAD->endFrame();
 
+    if (m_isSpikeCaptureEnabled.load(std::memory_order_relaxed) || m_spikeThread.load(std::memory_order_relaxed) == THIS_THREAD)
+        checkSpike(duration);
+
+    if (THIS_THREAD->logical)
+        return; // Frame time statistics belong to OS threads
+
     if (THIS_THREAD_FRAME_T_RESET_MAX)
         THIS_THREAD_FRAME_T_MAX = 0;
     THIS_THREAD_FRAME_T_RESET_MAX = false;
@@ -791,6 +950,158 @@ void ProfileManager::endFrame()
     THIS_THREAD_FRAME_T_ACC = duration + reset * THIS_THREAD_FRAME_T_ACC;
 }
 
+void ProfileManager::checkSpike(profiler::timestamp_t _frameDuration)
+{
+    auto& thread = *THIS_THREAD;
+    const bool blockHit = thread.spikeBlockHit;
+    thread.spikeBlockHit = false;
+
+    if (m_spikeThread.load(std::memory_order_acquire) == &thread)
+    {
+        // Counting frames after the spike
+        if (--m_spikeFramesLeft == 0)
+            finishSpikeFrames(&thread);
+        return;
+    }
+
+    if (!isEnabled() || isStatisticsOnly())
+        return;
+
+    // Remember end time of recent frames: end of the frame preceding K frames before the spike
+    // is the earliest time to be captured.
+    const auto historySize = m_spikeFramesBefore.load(std::memory_order_relaxed) + 1;
+    if (thread.frameHistory.size() != historySize)
+    {
+        thread.frameHistory.assign(historySize, 0);
+        thread.frameHistoryIndex = 0;
+    }
+
+    const auto since = thread.frameHistory[thread.frameHistoryIndex];
+    thread.frameHistory[thread.frameHistoryIndex] = thread.frameStartTime + _frameDuration;
+    thread.frameHistoryIndex = (thread.frameHistoryIndex + 1) % historySize;
+
+    const auto threshold = m_spikeFrameThreshold.load(std::memory_order_relaxed);
+    if (!blockHit && (threshold == 0 || _frameDuration <= threshold))
+        return;
+
+    if (m_isSpikeCapturing.exchange(true, std::memory_order_acq_rel))
+        return; // Previous spike is still being captured
+
+    EASY_LOGMSG("Spike detected: frame duration " << ticks2us(_frameDuration) << " us\n");
+
+    // Frames preceding the spike stay in the flight recorder ring until the capture is written
+    pinSpikeFrames(true);
+
+    // If there is not enough frames in history yet then all stored data would be captured
+    m_spikeSince = since;
+    m_spikeFramesLeft = m_spikeFramesAfter.load(std::memory_order_relaxed);
+    if (m_spikeFramesLeft == 0)
+        m_isSpikeWriteRequested.store(true, std::memory_order_release);
+    else
+        m_spikeThread.store(&thread, std::memory_order_release);
+}
+
+void ProfileManager::finishSpikeFrames(ThreadStorage* _thread)
+{
+    // Called when the thread has closed enough frames after the spike, when it exits
+    // or by the writer on timeout. Only the first call passes the capture to the writer.
+    if (_thread != nullptr && m_spikeThread.compare_exchange_strong(_thread, nullptr, std::memory_order_acq_rel, std::memory_order_relaxed))
+        m_isSpikeWriteRequested.store(true, std::memory_order_release);
+}
+
+void ProfileManager::startSpikeWriter()
+{
+    guard_lock_t lock(m_spikeSpin);
+    if (!m_spikeWriter.joinable())
+    {
+        m_stopSpikeWriter.store(false, std::memory_order_release);
+        m_spikeWriter = std::thread(&ProfileManager::writeSpikes, this);
+    }
+}
+
+void ProfileManager::stopSpikeWriter()
+{
+    m_stopSpikeWriter.store(true, std::memory_order_release);
+    if (m_spikeWriter.joinable())
+        m_spikeWriter.join();
+}
+
+void ProfileManager::writeSpikes()
+{
+    // Profiled threads only set flags, so detecting a spike costs nothing on their side
+    EASY_CONSTEXPR uint32_t IntervalMs = 10;
+    uint32_t waitedMs = 0;
+
+    while (!m_stopSpikeWriter.load(std::memory_order_acquire))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(IntervalMs));
+
+        // The capture is not held forever if the thread stops closing frames after the spike
+        const auto thread = m_spikeThread.load(std::memory_order_acquire);
+        if (thread == nullptr)
+            waitedMs = 0;
+        else if ((waitedMs += IntervalMs) >= EASY_OPTION_SPIKE_CAPTURE_TIMEOUT)
+            finishSpikeFrames(thread);
+
+        if (!m_isSpikeWriteRequested.exchange(false, std::memory_order_acq_rel))
+            continue;
+
+        waitedMs = 0;
+        writeSpikeCapture(m_spikeSince);
+    }
+}
+
+void ProfileManager::writeSpikeCapture(profiler::timestamp_t _since)
+{
+    std::string filename;
+    {
+        guard_lock_t lock(m_spikeSpin);
+        filename = m_spikeFilenamePrefix;
+    }
+
+    // Append local time: prefix_YYYYMMDD_HHMMSS_mmm.prof
+    const auto now = std::chrono::system_clock::now();
+    const auto time = std::chrono::system_clock::to_time_t(now);
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+
+    std::tm localTime;
+#ifdef _WIN32
+    localtime_s(&localTime, &time);
+#else
+    localtime_r(&time, &localTime);
+#endif
+
+    char suffix[32];
+    const auto length = strftime(suffix, sizeof(suffix), "_%Y%m%d_%H%M%S", &localTime);
+    snprintf(suffix + length, sizeof(suffix) - length, "_%03d.prof", static_cast<int>(ms));
+    filename += suffix;
+
+    std::ofstream outputFile(filename, std::fstream::binary);
+    if (outputFile.is_open())
+    {
+        guard_lock_t lock(m_dumpSpin);
+        // Captured data is not consumed, so it is still written by regular dumps
+        EASY_LOG_ONLY(const auto blocksNumber =) dumpBlocksToStream(outputFile, false, false, _since, false, filename.c_str());
+        m_spikeCaptures.fetch_add(1, std::memory_order_relaxed);
+        EASY_LOGMSG("Spike captured into \"" << filename << "\": " << blocksNumber << " blocks\n");
+    }
+    else
+    {
+        EASY_ERROR("Can not open \"" << filename << "\" for writing\n");
+    }
+
+    pinSpikeFrames(false);
+    m_isSpikeCapturing.store(false, std::memory_order_release);
+}
+
+void ProfileManager::pinSpikeFrames(bool _pinned)
+{
+    guard_lock_t lock(m_spin);
+    m_isSpikePinned.store(_pinned, std::memory_order_release);
+    for (auto& thread_storage : m_threads)
+        thread_storage.second.setPinned(_pinned);
+}
+
 profiler::timestamp_t ProfileManager::maxFrameDuration()
 {
     auto duration = m_frameMax.load(std::memory_order_acquire);
@@ -816,7 +1127,10 @@ void ProfileManager::enableEventTracer()
 {
 #ifdef USE_TRACING 
     if (m_isEventTracingEnabled.load(std::memory_order_acquire))
-        EasyEventTracer::instance().enable(true);
+    {
+        const auto status = EasyEventTracer::instance().enable(true);
+        m_isEventTracerLaunched.store(status == EventTracingEnableStatus::LaunchedSuccessfully, std::memory_order_release);
+    }
 #endif
 }
 
@@ -840,6 +1154,9 @@ void ProfileManager::setEnabled(bool isEnable)
         EASY_LOGMSG("Enabled profiling\n");
         enableEventTracer();
         m_beginTime = time;
+        m_statisticsEpoch.fetch_add(1, std::memory_order_relaxed); // threads reset their statistics lazily
+        m_clock.beginCapture();
+        updateCrashRecoveryHeader();
     }
     else
     {
@@ -859,56 +1176,284 @@ bool ProfileManager::isEventTracingEnabled() const
     return m_isEventTracingEnabled.load(std::memory_order_acquire);
 }
 
-//////////////////////////////////////////////////////////////////////////
+void ProfileManager::setFlightRecorderMemoryLimit(uint64_t _bytesPerThread)
+{
+    guard_lock_t lock(m_spin);
+    m_threadMemoryLimit.store(_bytesPerThread, std::memory_order_release);
+    for (auto& thread_storage : m_threads)
+        thread_storage.second.setMemoryLimit(_bytesPerThread);
+}
 
-char ProfileManager::checkThreadExpired(ThreadStorage& _registeredThread)
+uint64_t ProfileManager::flightRecorderMemoryLimit() const
 {
-    const char val = _registeredThread.expired.load(std::memory_order_acquire);
-    if (val != 0)
-        return val;
+    return m_threadMemoryLimit.load(std::memory_order_acquire);
+}
 
-    if (_registeredThread.guarded)
-        return 0;
+bool ProfileManager::setCrashRecoveryDirectory(const char* _directory)
+{
+    guard_lock_t lock(m_spin);
 
-#ifdef _WIN32
-    // Check thread state for Windows
+    // Blocks of already registered threads are not crash-survivable
+    if (!m_threads.empty())
+        return false;
 
-    DWORD exitCode = 0;
-    auto hThread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)_registeredThread.id);
-    if (hThread == nullptr || GetExitCodeThread(hThread, &exitCode) == FALSE || exitCode != STILL_ACTIVE)
-    {
-        // Thread has been expired
-        _registeredThread.expired.store(1, std::memory_order_release);
-        if (hThread != nullptr)
-            CloseHandle(hThread);
-        return 1;
-    }
+    auto& crashRecovery = CrashRecovery::instance();
+    if (!crashRecovery.open(_directory, static_cast<uint64_t>(m_processId)))
+        return false;
 
-    if (hThread != nullptr)
-        CloseHandle(hThread);
+    EASY_LOGMSG("Crash recovery files are stored in \"" << crashRecovery.directory() << "\"\n");
+    updateCrashRecoveryHeader();
+    crashRecovery.journalDescriptors(m_descriptors);
 
-    return 0;
-#else
-    // Check thread state for Linux and MacOS/iOS
+    return true;
+}
 
-    // This would drop the application if pthread already died
-    //return pthread_kill(_registeredThread.pthread_id, 0) != 0 ? 1 : 0;
+void ProfileManager::updateCrashRecoveryHeader()
+{
+    // Block overhead is not measured here: it is written only if it has been already measured
+    auto& crashRecovery = CrashRecovery::instance();
+    if (crashRecovery.isOpened())
+        crashRecovery.updateHeader(m_clock.frequency(), m_beginTime, m_blockOverhead.load(std::memory_order_acquire), static_cast<uint16_t>(profiler::clock::resolvedSource()));
+}
 
-    // There is no function to check external pthread state in Linux! :((
+void ProfileManager::setSpikeCapture(profiler::timestamp_t _frameThresholdUs, uint32_t _framesBefore, uint32_t _framesAfter, const char* _filenamePrefix)
+{
+    {
+        guard_lock_t lock(m_spikeSpin);
+        m_spikeFilenamePrefix = _filenamePrefix != nullptr && *_filenamePrefix != 0 ? _filenamePrefix : "spike";
+    }
 
-#ifndef EASY_CXX11_TLS_AVAILABLE
-# pragma message "Warning: Your compiler does not support thread_local C++11 feature. Please use EASY_THREAD_SCOPE as much as possible. Otherwise, there is a possibility of memory leak if there are a lot of rapidly created and destroyed threads."
-#endif
+    m_spikeFramesBefore.store(_framesBefore, std::memory_order_relaxed);
+    m_spikeFramesAfter.store(_framesAfter, std::memory_order_relaxed);
+    m_spikeFrameThresholdUs.store(_frameThresholdUs, std::memory_order_relaxed);
+    updateSpikeThresholds();
+    if (_frameThresholdUs != 0)
+        startSpikeWriter();
+    m_isSpikeCaptureEnabled.store(_frameThresholdUs != 0 || m_spikeBlockThresholdUs.load(std::memory_order_relaxed) != 0, std::memory_order_release);
+}
 
-    return 0;
-#endif
+void ProfileManager::setSpikeCaptureBlock(profiler::block_id_t _id, profiler::timestamp_t _thresholdUs)
+{
+    m_spikeBlockThresholdUs.store(_thresholdUs, std::memory_order_relaxed);
+    updateSpikeThresholds();
+    if (_thresholdUs != 0)
+        startSpikeWriter();
+    m_spikeBlockId.store(_thresholdUs != 0 ? _id : std::numeric_limits<profiler::block_id_t>::max(), std::memory_order_relaxed);
+    m_isSpikeCaptureEnabled.store(_thresholdUs != 0 || m_spikeFrameThresholdUs.load(std::memory_order_relaxed) != 0, std::memory_order_release);
 }
 
-//////////////////////////////////////////////////////////////////////////
+void ProfileManager::updateSpikeThresholds()
+{
+    // Thresholds are compared with durations in ticks, so they are converted once here
+    // and converted again when the clock source is changed
+    const auto frameThresholdUs = m_spikeFrameThresholdUs.load(std::memory_order_relaxed);
+    const auto blockThresholdUs = m_spikeBlockThresholdUs.load(std::memory_order_relaxed);
+    const auto frequency = frameThresholdUs != 0 || blockThresholdUs != 0 ? clockFrequency() : 0;
+    m_spikeFrameThreshold.store(frameThresholdUs * frequency / 1000000LL, std::memory_order_relaxed);
+    m_spikeBlockThreshold.store(blockThresholdUs * frequency / 1000000LL, std::memory_order_relaxed);
+}
 
-uint32_t ProfileManager::dumpBlocksToStream(std::ostream& _outputStream, bool _lockSpin, bool _async)
+uint32_t ProfileManager::spikeCapturesCount() const
 {
-    EASY_LOGMSG("dumpBlocksToStream(_lockSpin = " << _lockSpin << ")...\n");
+    return m_spikeCaptures.load(std::memory_order_relaxed);
+}
+
+bool ProfileManager::setStatisticsOnly(bool _enable)
+{
+    guard_lock_t lock(m_dumpSpin);
+
+    if (m_profilerStatus.load(std::memory_order_acquire))
+        return false; // Changing capture mode is restricted while profile session is active
+
+    m_isStatisticsOnly.store(_enable, std::memory_order_release);
+    return true;
+}
+
+void ProfileManager::gatherStatistics(std::vector<profiler::BlockSummary>& _statistics)
+{
+    _statistics.clear();
+
+    std::vector<BlockAccumulator> accumulators;
+    {
+        guard_lock_t lock(m_spin);
+        const auto epoch = m_statisticsEpoch.load(std::memory_order_relaxed);
+        for (auto& thread_storage : m_threads)
+            thread_storage.second.mergeStatistics(accumulators, epoch);
+    }
+
+    for (size_t id = 0, size = accumulators.size(); id < size; ++id)
+    {
+        const auto& accumulator = accumulators[id];
+        if (accumulator.calls == 0)
+            continue;
+
+        _statistics.emplace_back();
+        auto& summary = _statistics.back();
+        summary.id = static_cast<profiler::block_id_t>(id);
+        summary.callsNumber = accumulator.calls;
+        summary.totalDuration = ticks2ns(accumulator.total);
+        summary.minDuration = ticks2ns(accumulator.min);
+        summary.maxDuration = ticks2ns(accumulator.max);
+
+        for (uint16_t i = 0; i < HISTOGRAM_SIZE; ++i)
+        {
+            if (accumulator.histogram[i] == 0)
+                continue;
+
+            profiler::HistogramBucket bucket;
+            bucket.lowerBound = ticks2ns(BlockAccumulator::histogramLowerBound(i));
+            bucket.count = accumulator.histogram[i];
+            summary.histogram.push_back(bucket);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+char ProfileManager::checkThreadExpired(ThreadStorage& _registeredThread)
+{
+    const char val = _registeredThread.expired.load(std::memory_order_acquire);
+    if (val != 0)
+        return val;
+
+    if (_registeredThread.guarded)
+        return 0;
+
+#ifdef _WIN32
+    // Check thread state for Windows
+
+    DWORD exitCode = 0;
+    auto hThread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)_registeredThread.id);
+    if (hThread == nullptr || GetExitCodeThread(hThread, &exitCode) == FALSE || exitCode != STILL_ACTIVE)
+    {
+        // Thread has been expired
+        _registeredThread.expired.store(1, std::memory_order_release);
+        if (hThread != nullptr)
+            CloseHandle(hThread);
+        return 1;
+    }
+
+    if (hThread != nullptr)
+        CloseHandle(hThread);
+
+    return 0;
+#else
+    // Check thread state for Linux and MacOS/iOS
+
+    // This would drop the application if pthread already died
+    //return pthread_kill(_registeredThread.pthread_id, 0) != 0 ? 1 : 0;
+
+    // There is no function to check external pthread state in Linux! :((
+
+#ifndef EASY_CXX11_TLS_AVAILABLE
+# pragma message "Warning: Your compiler does not support thread_local C++11 feature. Please use EASY_THREAD_SCOPE as much as possible. Otherwise, there is a possibility of memory leak if there are a lot of rapidly created and destroyed threads."
+#endif
+
+    return 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef _WIN32
+bool ProfileManager::readContextSwitchLog(profiler::timestamp_t _begin, profiler::timestamp_t _end, bool _async)
+{
+    CSwitchLog log;
+    if (!log.open(m_csInfoFilename.c_str()))
+    {
+        // Text log written by the old logger script
+        std::ifstream infile(m_csInfoFilename.c_str());
+        if (!infile.is_open())
+        {
+            EASY_ERROR("Can not open context switch log-file \"" << m_csInfoFilename << "\"\n");
+            return true;
+        }
+
+        guard_lock_t lock(m_spin);
+
+        EASY_LOG_ONLY(uint32_t num = 0);
+        uint64_t timestamp = 0;
+        profiler::thread_id_t thread_from = 0, thread_to = 0;
+        std::string next_task_name;
+        pid_t process_to = 0;
+        while (infile >> timestamp >> thread_from >> thread_to >> next_task_name >> process_to)
+        {
+            if (_async && m_stopDumping.load(std::memory_order_acquire))
+                return false;
+
+            beginContextSwitch(thread_from, timestamp, thread_to, next_task_name.c_str(), false);
+            endContextSwitch(thread_to, (processid_t)process_to, timestamp, false);
+            EASY_LOG_ONLY(++num);
+        }
+
+        EASY_LOGMSG("Done, " << num << " context switch events wrote\n");
+        return true;
+    }
+
+    std::vector<uint32_t> indices;
+    log.select(static_cast<uint32_t>(m_processId), _begin, _end, indices);
+
+    // Thread storages are removed only by dumpBlocksToStream() under m_dumpSpin which is locked by the caller,
+    // so the global lock is needed only to copy the threads table
+    std::vector<std::pair<profiler::thread_id_t, ThreadStorage*> > threads;
+    {
+        guard_lock_t lock(m_spin);
+        threads.reserve(m_threads.size());
+        for (auto& thread : m_threads)
+            threads.emplace_back(thread.first, &thread.second);
+    }
+    std::sort(threads.begin(), threads.end());
+
+    const auto findThread = [&threads](profiler::thread_id_t _id) -> ThreadStorage*
+    {
+        auto it = std::lower_bound(threads.begin(), threads.end(), std::make_pair(_id, static_cast<ThreadStorage*>(nullptr)));
+        return it != threads.end() && it->first == _id ? it->second : nullptr;
+    };
+
+    // Names of target threads must live until context switches are stored
+    EASY_CONSTEXPR size_t NameSize = sizeof(CSwitchLogRecord::targetName) + 1;
+    std::vector<char> names(indices.size() * NameSize);
+
+    for (size_t i = 0, size = indices.size(); i < size; ++i)
+    {
+        if (_async && (i & 1023) == 0 && m_stopDumping.load(std::memory_order_acquire))
+            return false;
+
+        const auto& record = log[indices[i]];
+
+        char* name = names.data() + i * NameSize;
+        size_t nameLength = sizeof(record.targetName);
+        memcpy(name, record.targetName, nameLength);
+        while (nameLength != 0 && (name[nameLength - 1] == ' ' || name[nameLength - 1] == 0))
+            --nameLength;
+        name[nameLength] = 0;
+
+        auto from = findThread(record.threadFrom);
+        if (from != nullptr)
+            from->beginCSwitch(record.timestamp, record.threadTo, name);
+
+        auto to = findThread(record.threadTo);
+#if EASY_OPTION_IMPLICIT_THREAD_REGISTRATION != 0
+        if (to == nullptr && record.processTo == m_processId)
+        {
+            // Implicit thread registration (see endContextSwitch())
+            to = &threadStorage(record.threadTo);
+            threads.insert(std::upper_bound(threads.begin(), threads.end(), std::make_pair(record.threadTo, to)), std::make_pair(record.threadTo, to));
+        }
+#endif
+        if (to != nullptr)
+            to->endCSwitch(record.timestamp);
+    }
+
+    EASY_LOGMSG("Done, " << indices.size() << " context switch events wrote\n");
+    return true;
+}
+#endif
+
+uint32_t ProfileManager::dumpBlocksToStream(std::ostream& _outputStream, bool _lockSpin, bool _async, profiler::timestamp_t _since, bool _consume,
+                                            const char* _filename)
+{
+    EASY_LOGMSG("dumpBlocksToStream(_lockSpin = " << _lockSpin << ")...\n");
 
     if (_lockSpin)
         m_dumpSpin.lock();
@@ -917,13 +1462,6 @@ uint32_t ProfileManager::dumpBlocksToStream(std::ostream& _outputStream, bool _l
     const bool eventTracingEnabled = m_isEventTracingEnabled.load(std::memory_order_acquire);
 #endif
 
-    if (isEnabled())
-    {
-        m_profilerStatus.store(false, std::memory_order_release);
-        disableEventTracer();
-        m_endTime = profiler::clock::now();
-    }
-
     if (_async && m_stopDumping.load(std::memory_order_acquire))
     {
         if (_lockSpin)
@@ -931,93 +1469,90 @@ uint32_t ProfileManager::dumpBlocksToStream(std::ostream& _outputStream, bool _l
         return 0;
     }
 
-    // Wait for some time to be sure that all operations which began before setEnabled(false) will be finished.
-    // This is much better than inserting spin-lock or atomic variable store/load into each storeBlock operation.
-    //
-    // Note: this means - wait for all ThreadStorage::storeBlock() to finish.
-    std::this_thread::sleep_for(std::chrono::milliseconds(20));
-
-    // This is to make sure that no new descriptors or new threads will be
-    // added until we finish sending data.
-    m_spin.lock();
-    m_storedSpin.lock();
-    // This is the only place using both spins, so no dead-lock will occur
-    // TODO: think about better solution because this one is not 100% safe...
-
-    const auto time = profiler::clock::now();
-    const auto endtime = m_endTime == 0 ? time : std::min(time, m_endTime);
+    // There is no need to stop profiling or to wait for storeBlock() operations to finish:
+    // only frames closed before ThreadStorage::beginRead() would be written and threads
+    // continue storing new blocks into the same storage while we are serializing data.
 
 #ifndef _WIN32
-    if (eventTracingEnabled)
+    // Events read from the log are stored into threads storage, so they are read only by consuming dumps.
+    // Otherwise the next dump would read the same events again.
+    if (_consume && eventTracingEnabled && !m_isEventTracerLaunched.load(std::memory_order_acquire))
     {
         // Read thread context switch events from temporary file
-
-        if (_async && m_stopDumping.load(std::memory_order_acquire))
+        EASY_LOGMSG("Writing context switch events...\n");
+        if (!readContextSwitchLog(std::max(m_beginTime, _since), profiler::clock::now(), _async))
         {
-            m_spin.unlock();
-            m_storedSpin.unlock();
             if (_lockSpin)
                 m_dumpSpin.unlock();
             return 0;
         }
+    }
+#endif
 
-        EASY_LOGMSG("Writing context switch events...\n");
-
-        uint64_t timestamp = 0;
-        profiler::thread_id_t thread_from = 0, thread_to = 0;
+    // This is to make sure that no new threads will be added until we capture all snapshots.
+    // New descriptors may be registered concurrently: only those registered before
+    // capturing snapshots are guaranteed to be written (and only they may be referenced).
+    m_spin.lock();
+    bool spinLocked = true;
 
-        std::ifstream infile(m_csInfoFilename.c_str());
-        if(infile.is_open())
+    struct ThreadSnapshot
+    {
+        ThreadStorage*          thread;
+        ThreadStorage::Snapshot snapshot;
+        std::string                 name; ///< Thread name captured together with data
+        profiler::thread_id_t         id;
+        char                     expired; ///< Thread state checked before capturing data
+
+        /** Size of serialized thread section. */
+        uint64_t bytes() const
         {
-            EASY_LOG_ONLY(uint32_t num = 0);
-            std::string next_task_name;
-            pid_t process_to = 0;
-            while (infile >> timestamp >> thread_from >> thread_to >> next_task_name >> process_to)
-            {
-                if (_async && m_stopDumping.load(std::memory_order_acquire))
-                {
-                    m_spin.unlock();
-                    m_storedSpin.unlock();
-                    if (_lockSpin)
-                        m_dumpSpin.unlock();
-                    return 0;
-                }
+            return sizeof(id) + sizeof(uint16_t) + name.size() + 1 + sizeof(snapshot.sync.size) + snapshot.sync.memory
+                + snapshot.sync.size * sizeof(uint16_t) + sizeof(snapshot.blocks.size) + snapshot.blocksBytes;
+        }
+    };
 
-                beginContextSwitch(thread_from, timestamp, thread_to, next_task_name.c_str(), false);
-                endContextSwitch(thread_to, (processid_t)process_to, timestamp, false);
-                EASY_LOG_ONLY(++num);
-            }
+    std::vector<ThreadSnapshot> snapshots;
+    snapshots.reserve(m_threads.size());
+    RuntimeNames runtimeNames; // Run-time names referenced by captured blocks
+    size_t writtenThreads = 0;
 
-            EASY_LOGMSG("Done, " << num << " context switch events wrote\n");
-        }
-        EASY_LOG_ONLY(
-            else {
-                EASY_ERROR("Can not open context switch log-file \"" << m_csInfoFilename << "\"\n");
-            }
-        )
-    }
-#endif
+    const auto abortDumping = [&]
+    {
+        // Captured data has not been written, so it should be written next time
+        for (size_t i = writtenThreads; i < snapshots.size(); ++i)
+            snapshots[i].thread->endRead(snapshots[i].snapshot, false);
+        if (spinLocked)
+            m_spin.unlock();
+        if (_lockSpin)
+            m_dumpSpin.unlock();
+        return 0U;
+    };
+
+    const auto time = profiler::clock::now();
+    const auto endtime = isEnabled() || m_endTime == 0 ? time : std::min(time, m_endTime);
 
     bool mainThreadExpired = false;
 
-    // Calculate used memory total size and total blocks number
+    // Capture closed data of each thread, calculate used memory total size and total blocks number
     uint64_t usedMemorySize = 0;
     uint32_t blocks_number = 0;
     for (auto thread_it = m_threads.begin(), end = m_threads.end(); thread_it != end;)
     {
         if (_async && m_stopDumping.load(std::memory_order_acquire))
-        {
-            m_spin.unlock();
-            m_storedSpin.unlock();
-            if (_lockSpin)
-                m_dumpSpin.unlock();
-            return 0;
-        }
+            return abortDumping();
 
         auto& thread = thread_it->second;
-        uint32_t num = thread.blocks.closedList.markedSize() + thread.sync.closedList.size();
         const char expired = ProfileManager::checkThreadExpired(thread);
 
+        ThreadSnapshot ts;
+        ts.thread = &thread;
+        ts.name = thread.name;
+        ts.id = thread_it->first;
+        ts.expired = expired;
+        thread.beginRead(ts.snapshot, runtimeNames, _since);
+
+        const uint32_t num = ts.snapshot.size();
+
 #ifdef _WIN32
         if (num == 0 && expired != 0)
 #elif defined(EASY_CXX11_TLS_AVAILABLE)
@@ -1034,119 +1569,258 @@ uint32_t ProfileManager::dumpBlocksToStream(std::ostream& _outputStream, bool _l
 #endif
         {
             // Remove thread if it contains no profiled information and has been finished (or is not guarded --deprecated).
+            thread.endRead(ts.snapshot, false);
             profiler::thread_id_t id = thread_it->first;
             if (!mainThreadExpired && m_mainThreadId.compare_exchange_weak(id, 0, std::memory_order_release, std::memory_order_acquire))
                 mainThreadExpired = true;
+            finishSpikeFrames(&thread);
             m_threads.erase(thread_it++);
             continue;
         }
 
-        if (expired == 1)
+        if (expired == 1 && _consume)
         {
+            // The thread is dead, so we can store the event into it's storage and capture data again
+            thread.endRead(ts.snapshot, false);
             EASY_FORCE_EVENT3(thread, endtime, "ThreadExpired", EASY_COLOR_THREAD_END);
-            ++num;
+            thread.beginRead(ts.snapshot, runtimeNames, _since);
         }
 
-        usedMemorySize += thread.blocks.usedMemorySize + thread.sync.usedMemorySize;
-        blocks_number += num;
+        usedMemorySize += ts.snapshot.memory();
+        blocks_number += ts.snapshot.size();
+        snapshots.push_back(std::move(ts));
         ++thread_it;
     }
 
+    // All blocks from snapshots reference descriptors registered before this point
+    const auto descriptorsCount = m_descriptors.size();
+
+    // ThreadStorage-s are removed only by this function under m_dumpSpin, so captured threads
+    // could be serialized without blocking registration of new threads.
+    m_spin.unlock();
+    spinLocked = false;
+
     // Write profiler signature and version
     write(_outputStream, EASY_PROFILER_SIGNATURE);
     write(_outputStream, EASY_PROFILER_VERSION);
     write(_outputStream, m_processId);
 
-    // Write CPU frequency to let GUI calculate real time value from CPU clocks
-#if defined(EASY_CHRONO_CLOCK) || defined(_WIN32)
-    write(_outputStream, m_cpuFrequency);
-#else
-    EASY_LOGMSG("Calculating CPU frequency\n");
-    const int64_t cpu_frequency = calculate_cpu_frequency();
-    write(_outputStream, cpu_frequency * 1000LL);
-    EASY_LOGMSG("Done calculating CPU frequency\n");
-
-    m_cpuFrequency.store(cpu_frequency, std::memory_order_release);
-#endif
+    // Write CPU frequency to let GUI calculate real time value from CPU clocks.
+    // Drift measurement also refines calibrated frequency, so it goes first.
+    const auto drift = m_clock.measureDrift();
+    EASY_LOGMSG("Clock frequency " << m_clock.frequency() << " Hz (error " << m_clock.error() << " ppm), drift during capture " << drift << " ppm\n");
+    (void)drift;
+    write(_outputStream, m_clock.frequency());
 
     // Write begin and end time
-    write(_outputStream, m_beginTime);
-    write(_outputStream, m_endTime);
+    write(_outputStream, std::max(m_beginTime, _since));
+    write(_outputStream, endtime);
 
     // Write blocks number and used memory size
     write(_outputStream, usedMemorySize);
-    write(_outputStream, m_descriptorsMemorySize);
+    write(_outputStream, descriptorsMemorySize(m_descriptors, descriptorsCount));
     write(_outputStream, blocks_number);
-    write(_outputStream, static_cast<uint32_t>(m_descriptors.size()));
-    write(_outputStream, static_cast<uint32_t>(m_threads.size()));
+    write(_outputStream, descriptorsCount);
+    write(_outputStream, static_cast<uint32_t>(snapshots.size()));
     write(_outputStream, static_cast<uint16_t>(0)); // Bookmarks count (they can be created by user in the UI)
-    write(_outputStream, static_cast<uint16_t>(0)); // padding
+    write(_outputStream, static_cast<uint16_t>(profiler::clock::resolvedSource()));
+    write(_outputStream, blockOverhead());
 
     // Write block descriptors
-    for (const auto descriptor : m_descriptors)
+    writeDescriptors(_outputStream, m_descriptors, descriptorsCount);
+
+    // Write run-time names referenced by blocks with interned names
+    writeRuntimeNames(_outputStream, runtimeNames);
+
+    const auto threadsCount = snapshots.size();
+    const auto serializeThread = [](const ThreadSnapshot& _ts, std::ostream& _stream)
     {
-        const auto name_size = descriptor->nameSize();
-        const auto filename_size = descriptor->filenameSize();
-        const auto size = static_cast<uint16_t>(sizeof(profiler::SerializedBlockDescriptor) + name_size + filename_size);
+        write(_stream, _ts.id);
 
-        write(_outputStream, size);
-        write<profiler::BaseBlockDescriptor>(_outputStream, *descriptor);
-        write(_outputStream, name_size);
-        write(_outputStream, descriptor->name(), name_size);
-        write(_outputStream, descriptor->filename(), filename_size);
-    }
+        const auto name_size = static_cast<uint16_t>(_ts.name.size() + 1);
+        write(_stream, name_size);
+        write(_stream, _ts.name.c_str(), name_size);
 
-    // Write blocks and context switch events for each thread
-    for (auto thread_it = m_threads.begin(), end = m_threads.end(); thread_it != end;)
+        write(_stream, _ts.snapshot.sync.size);
+        _ts.thread->sync.closedList.serialize(_ts.snapshot.sync, _stream);
+
+        write(_stream, _ts.snapshot.blocks.size);
+        _ts.thread->writeBlocks(_ts.snapshot, _stream);
+    };
+
+    // Starting worker threads is not worth it for small amount of data (e.g. while streaming frames)
+    const size_t workersCount = usedMemorySize < (4 << 20) ? 0
+        : std::min(threadsCount, static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1U)));
+
+    std::atomic<size_t> nextThread(0);
+    std::vector<std::future<void>> workers;
+    workers.reserve(workersCount);
+
+    const auto isStopped = [&] { return _async && m_stopDumping.load(std::memory_order_acquire); };
+    const auto waitWorkers = [&]
     {
-        if (_async && m_stopDumping.load(std::memory_order_acquire))
+        for (auto& worker : workers)
+            worker.wait();
+    };
+
+    // Size of each thread section is known in advance, so a file could be written by workers
+    // concurrently at precomputed offsets without buffering serialized threads in memory
+    std::vector<uint64_t> offsets;
+    if (workersCount != 0 && _filename != nullptr && _outputStream.flush())
+    {
+        const auto position = static_cast<int64_t>(_outputStream.tellp());
+        if (position >= 0)
         {
-            m_spin.unlock();
-            m_storedSpin.unlock();
-            if (_lockSpin)
-                m_dumpSpin.unlock();
-            return 0;
+            offsets.resize(threadsCount + 1);
+            offsets[0] = static_cast<uint64_t>(position);
+            for (size_t i = 0; i < threadsCount; ++i)
+                offsets[i + 1] = offsets[i] + snapshots[i].bytes();
         }
+    }
 
-        auto& thread = thread_it->second;
+    if (workersCount == 0)
+    {
+        // Threads are serialized right into the output stream, so memory usage does not depend on the captured size
+        for (; writtenThreads < threadsCount; ++writtenThreads)
+        {
+            if (isStopped())
+                return abortDumping();
+
+            serializeThread(snapshots[writtenThreads], _outputStream);
+            snapshots[writtenThreads].thread->endRead(snapshots[writtenThreads].snapshot, _consume);
+        }
+    }
+    else if (!offsets.empty())
+    {
+        std::atomic_bool failed(false);
+        const auto writeThreads = [&]
+        {
+            std::ofstream file(_filename, std::fstream::binary | std::fstream::in | std::fstream::out);
+            for (auto i = nextThread++; i < threadsCount && !isStopped(); i = nextThread++)
+            {
+                file.seekp(static_cast<std::streamoff>(offsets[i]));
+                serializeThread(snapshots[i], file);
 
-        write(_outputStream, thread_it->first);
+                if (!file || static_cast<uint64_t>(static_cast<int64_t>(file.tellp())) != offsets[i + 1])
+                {
+                    failed.store(true, std::memory_order_release);
+                    break;
+                }
+            }
+        };
 
-        const auto name_size = static_cast<uint16_t>(thread.name.size() + 1);
-        write(_outputStream, name_size);
-        write(_outputStream, name_size > 1 ? thread.name.c_str() : "", name_size);
+        for (size_t i = 0; i < workersCount; ++i)
+            workers.push_back(std::async(std::launch::async, writeThreads));
+        waitWorkers();
 
-        write(_outputStream, thread.sync.closedList.size());
-        if (!thread.sync.closedList.empty())
-            thread.sync.closedList.serialize(_outputStream);
+        if (failed.load(std::memory_order_acquire))
+        {
+            EASY_ERROR("Can not write threads into \"" << _filename << "\"\n");
+            return abortDumping();
+        }
 
-        write(_outputStream, thread.blocks.closedList.markedSize());
-        if (!thread.blocks.closedList.markedEmpty())
-            thread.blocks.closedList.serialize(_outputStream);
+        if (isStopped())
+            return abortDumping();
 
-        thread.clearClosed();
-        //t.blocks.openedList.clear();
-        thread.sync.openedList.clear();
+        for (; writtenThreads < threadsCount; ++writtenThreads)
+            snapshots[writtenThreads].thread->endRead(snapshots[writtenThreads].snapshot, _consume);
 
-        if (thread.expired.load(std::memory_order_acquire) != 0)
+        _outputStream.seekp(static_cast<std::streamoff>(offsets[threadsCount]));
+    }
+    else
+    {
+        // Workers serialize threads into independent buffers which are written into the output stream in order.
+        // Workers wait while too much serialized data is not written yet, so memory usage stays bounded.
+        // The thread which is written next is always serialized, so the writer never waits for a blocked worker.
+        EASY_CONSTEXPR uint64_t MaxBufferedBytes = 16 << 20;
+
+        std::unique_ptr<std::stringstream[]> buffers(new std::stringstream[threadsCount]);
+        std::vector<char> ready(threadsCount, 0);
+        std::mutex buffersMutex;
+        std::condition_variable buffersCondition;
+        uint64_t bufferedBytes = 0;
+        size_t nextWritten = 0; // Copy of writtenThreads guarded by buffersMutex
+
+        const auto serializeThreads = [&]
         {
-            // Remove expired thread after writing all profiled information
-            profiler::thread_id_t id = thread_it->first;
-            if (!mainThreadExpired && m_mainThreadId.compare_exchange_weak(id, 0, std::memory_order_release, std::memory_order_acquire))
-                mainThreadExpired = true;
-            m_threads.erase(thread_it++);
-        }
-        else
+            for (auto i = nextThread++; i < threadsCount; i = nextThread++)
+            {
+                const auto bytes = snapshots[i].bytes();
+                {
+                    std::unique_lock<std::mutex> lock(buffersMutex);
+                    buffersCondition.wait(lock, [&] {
+                        return i == nextWritten || bufferedBytes + bytes <= MaxBufferedBytes || isStopped();
+                    });
+                    bufferedBytes += bytes;
+                }
+
+                if (!isStopped())
+                    serializeThread(snapshots[i], buffers[i]);
+
+                {
+                    std::lock_guard<std::mutex> lock(buffersMutex);
+                    ready[i] = 1;
+                }
+                buffersCondition.notify_all();
+            }
+        };
+
+        for (size_t i = 0; i < workersCount; ++i)
+            workers.push_back(std::async(std::launch::async, serializeThreads));
+
+        for (; writtenThreads < threadsCount; ++writtenThreads)
         {
-            ++thread_it;
+            {
+                std::unique_lock<std::mutex> lock(buffersMutex);
+                buffersCondition.wait(lock, [&] { return ready[writtenThreads] != 0; });
+            }
+
+            if (isStopped())
+            {
+                buffersCondition.notify_all();
+                waitWorkers();
+                return abortDumping();
+            }
+
+            _outputStream << buffers[writtenThreads].rdbuf();
+            buffers[writtenThreads].str(std::string()); // Release memory as soon as possible
+
+            snapshots[writtenThreads].thread->endRead(snapshots[writtenThreads].snapshot, _consume);
+
+            {
+                std::lock_guard<std::mutex> lock(buffersMutex);
+                bufferedBytes -= snapshots[writtenThreads].bytes();
+                ++nextWritten;
+            }
+            buffersCondition.notify_all();
         }
     }
 
     // End of threads section
     write(_outputStream, EASY_PROFILER_SIGNATURE);
 
-    m_storedSpin.unlock();
-    m_spin.unlock();
+    // Not consumed data of expired threads would be written by the next dump
+    if (_consume)
+    {
+        m_spin.lock();
+        for (const auto& ts : snapshots)
+        {
+            ts.thread->sync.openedList.clear();
+
+            if (ts.expired != 0)
+            {
+                // Remove expired thread after writing all profiled information.
+                // Use thread state checked before capturing data: if the thread has finished
+                // after that then it's last blocks would be written next time.
+                profiler::thread_id_t id = ts.id;
+                if (!mainThreadExpired && m_mainThreadId.compare_exchange_weak(id, 0, std::memory_order_release, std::memory_order_acquire))
+                    mainThreadExpired = true;
+                finishSpikeFrames(ts.thread);
+                m_threads.erase(ts.id);
+            }
+        }
+        m_spin.unlock();
+    }
 
     if (_lockSpin)
         m_dumpSpin.unlock();
@@ -1156,7 +1830,7 @@ uint32_t ProfileManager::dumpBlocksToStream(std::ostream& _outputStream, bool _l
     return blocks_number;
 }
 
-uint32_t ProfileManager::dumpBlocksToFile(const char* _filename)
+uint32_t ProfileManager::dumpBlocksToFile(const char* _filename, bool _stopProfiling)
 {
     EASY_LOGMSG("dumpBlocksToFile(\"" << _filename << "\")...\n");
 
@@ -1167,8 +1841,17 @@ uint32_t ProfileManager::dumpBlocksToFile(const char* _filename)
         return 0;
     }
 
+    guard_lock_t lock(m_dumpSpin);
+
+    if (_stopProfiling && m_profilerStatus.exchange(false, std::memory_order_acq_rel))
+    {
+        EASY_LOGMSG("Disabled profiling\n");
+        disableEventTracer();
+        m_endTime = profiler::clock::now();
+    }
+
     // Write data directly to file
-    const auto blocksNumber = dumpBlocksToStream(outputFile, true, false);
+    const auto blocksNumber = dumpBlocksToStream(outputFile, false, false, 0, true, _filename);
 
     EASY_LOGMSG("Done dumpBlocksToFile()\n");
 
@@ -1190,30 +1873,32 @@ const char* ProfileManager::registerThread(const char* name, profiler::ThreadGua
     if (THIS_THREAD == nullptr)
         THIS_THREAD = &threadStorage(getCurrentThreadId());
 
-    THIS_THREAD->guarded = true;
-    if (!THIS_THREAD->named)
+    // Register thread itself even if an execution context is current
+    auto thisThread = THIS_THREAD_OWN != nullptr ? THIS_THREAD_OWN : THIS_THREAD;
+
+    thisThread->guarded = true;
+    if (!thisThread->named)
     {
-        THIS_THREAD->named = true;
-        THIS_THREAD->name = name;
+        thisThread->setName(name);
 
-        if (THIS_THREAD->name == "Main")
+        if (thisThread->name == "Main")
         {
             profiler::thread_id_t id = 0;
-            THIS_THREAD_IS_MAIN = m_mainThreadId.compare_exchange_weak(id, THIS_THREAD->id, std::memory_order_release, std::memory_order_acquire);
+            THIS_THREAD_IS_MAIN = m_mainThreadId.compare_exchange_weak(id, thisThread->id, std::memory_order_release, std::memory_order_acquire);
         }
 
 #ifdef EASY_CXX11_TLS_AVAILABLE
-        THIS_THREAD_GUARD.m_id = THIS_THREAD->id;
+        THIS_THREAD_GUARD.m_id = thisThread->id;
     }
 
     (void)threadGuard; // this is just to prevent from warning about unused variable
 #else
     }
 
-    threadGuard.m_id = THIS_THREAD->id;
+    threadGuard.m_id = thisThread->id;
 #endif
 
-    return THIS_THREAD->name.c_str();
+    return thisThread->name.c_str();
 }
 
 const char* ProfileManager::registerThread(const char* name)
@@ -1221,24 +1906,26 @@ const char* ProfileManager::registerThread(const char* name)
     if (THIS_THREAD == nullptr)
         THIS_THREAD = &threadStorage(getCurrentThreadId());
 
-    if (!THIS_THREAD->named)
+    // Register thread itself even if an execution context is current
+    auto thisThread = THIS_THREAD_OWN != nullptr ? THIS_THREAD_OWN : THIS_THREAD;
+
+    if (!thisThread->named)
     {
-        THIS_THREAD->named = true;
-        THIS_THREAD->name = name;
+        thisThread->setName(name);
 
-        if (THIS_THREAD->name == "Main")
+        if (thisThread->name == "Main")
         {
             profiler::thread_id_t id = 0;
-            THIS_THREAD_IS_MAIN = m_mainThreadId.compare_exchange_weak(id, THIS_THREAD->id, std::memory_order_release, std::memory_order_acquire);
+            THIS_THREAD_IS_MAIN = m_mainThreadId.compare_exchange_weak(id, thisThread->id, std::memory_order_release, std::memory_order_acquire);
         }
 
 #ifdef EASY_CXX11_TLS_AVAILABLE
-        THIS_THREAD->guarded = true;
-        THIS_THREAD_GUARD.m_id = THIS_THREAD->id;
+        thisThread->guarded = true;
+        THIS_THREAD_GUARD.m_id = thisThread->id;
 #endif
     }
 
-    return THIS_THREAD->name.c_str();
+    return thisThread->name.c_str();
 }
 
 void ProfileManager::setBlockStatus(profiler::block_id_t _id, profiler::EasyBlockStatus _status)
@@ -1246,13 +1933,132 @@ void ProfileManager::setBlockStatus(profiler::block_id_t _id, profiler::EasyBloc
     if (isEnabled())
         return; // Changing blocks statuses is restricted while profile session is active
 
-    guard_lock_t lock(m_storedSpin);
-    if (_id < m_descriptors.size())
+    auto desc = m_descriptors.get(_id);
+    if (desc != nullptr)
+        desc->m_status = _status;
+}
+
+void ProfileManager::setBlockSampling(profiler::block_id_t _id, uint32_t _sampling)
+{
+    if (isEnabled())
+        return; // Changing blocks sampling is restricted while profile session is active
+
+    auto desc = m_descriptors.get(_id);
+    if (desc != nullptr)
+        desc->m_sampling = _sampling;
+}
+
+void ProfileManager::setBlockPerfCounters(profiler::block_id_t _id, bool _enable)
+{
+    // Blocks take the flag from descriptor when they are created, so it could be changed at any time
+    auto desc = m_descriptors.get(_id);
+    if (desc != nullptr)
+        desc->m_perfCounters = _enable;
+}
+
+void ProfileManager::setAllocationTracking(bool _enable)
+{
+    // Blocks opened before the change are closed consistently as the flag is stored in block status
+    m_isAllocationTracking.store(_enable, std::memory_order_release);
+}
+
+void ProfileManager::trackAllocation(size_t _bytes)
+{
+    // This is called for every heap allocation, so it must not touch anything except thread-local counters
+    THIS_THREAD_ALLOCATED_BYTES += _bytes;
+    ++THIS_THREAD_ALLOCATIONS;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+ThreadStorage* ProfileManager::createExecutionContext(const char* _name)
+{
+    // Execution contexts never collide with OS thread ids
+    const profiler::thread_id_t id = EXECUTION_CONTEXT_ID_FLAG | (m_executionContextsCount.fetch_add(1, std::memory_order_relaxed) + 1);
+
+    guard_lock_t lock(m_spin);
+
+    auto& context = m_threads.emplace(std::piecewise_construct, std::forward_as_tuple(id), std::forward_as_tuple(id)).first->second;
+    context.setMemoryLimit(m_threadMemoryLimit.load(std::memory_order_acquire));
+    context.setPinned(m_isSpikePinned.load(std::memory_order_acquire));
+    context.setName(_name != nullptr && *_name != 0 ? _name : ("Context " + std::to_string(id & ~EXECUTION_CONTEXT_ID_FLAG)).c_str());
+    context.named = true;
+    context.guarded = true; // Context is expired only by destroyExecutionContext()
+    context.logical = true;
+
+    return &context;
+}
+
+void ProfileManager::switchExecutionContext(ThreadStorage* _context)
+{
+    if (THIS_THREAD == nullptr)
+        registerThread();
+
+    auto next = _context != nullptr ? _context : (THIS_THREAD_OWN != nullptr ? THIS_THREAD_OWN : THIS_THREAD);
+    if (next == THIS_THREAD)
+        return;
+
+    if (THIS_THREAD_OWN == nullptr)
+        THIS_THREAD_OWN = THIS_THREAD;
+
+    // Each context has it's own blocks stack and allocations counters, so switching is just swapping pointers
+    THIS_THREAD->suspendedBytes = THIS_THREAD_ALLOCATED_BYTES;
+    THIS_THREAD->suspendedAllocations = THIS_THREAD_ALLOCATIONS;
+    THIS_THREAD_ALLOCATED_BYTES = next->suspendedBytes;
+    THIS_THREAD_ALLOCATIONS = next->suspendedAllocations;
+
+    THIS_THREAD = next;
+    if (next == THIS_THREAD_OWN)
+        THIS_THREAD_OWN = nullptr;
+}
+
+ThreadStorage* ProfileManager::currentExecutionContext()
+{
+    return THIS_THREAD_OWN != nullptr ? THIS_THREAD : nullptr;
+}
+
+void ProfileManager::destroyExecutionContext(ThreadStorage* _context)
+{
+    if (_context == nullptr)
+        return;
+
+    if (_context == THIS_THREAD)
+        switchExecutionContext(nullptr);
+
+    if (!_context->blocks.openedList.empty())
     {
-        auto desc = m_descriptors[_id];
+        // Opened blocks may be already destroyed together with the coroutine frame, so they are not touched.
+        // Non-scoped blocks are owned by the context, so all of them are released here.
+        _context->blocks.openedList.clear();
+        _context->nonscopedBlocks.clear();
+        _context->perfCountersStack.clear();
+        _context->allocationsStack.clear();
+        _context->stackSize = 0;
+        _context->allowChildren = true;
+        _context->dropUnclosedFrame();
+    }
+
+    // Frames after a spike are not counted by destroyed context anymore
+    finishSpikeFrames(_context);
+
+    if (m_dumpSpin.try_lock())
+    {
+        guard_lock_t lock(m_spin);
+        if (_context->blocks.closedList.empty() && _context->sync.closedList.empty())
+        {
+            m_threads.erase(_context->id);
+            lock.unlock();
+            m_dumpSpin.unlock();
+            return;
+        }
+
         lock.unlock();
-        desc->m_status = _status;
+        m_dumpSpin.unlock();
     }
+
+    // Context contains profiled information or is being dumped right now: it will be removed by the next dump
+    _context->putMark();
+    _context->expired.store(2, std::memory_order_release);
 }
 
 void ProfileManager::startListen(uint16_t _port)
@@ -1279,6 +2085,107 @@ bool ProfileManager::isListening() const
 
 //////////////////////////////////////////////////////////////////////////
 
+uint32_t ProfileManager::registerGauge(const char* _name, profiler::gauge_reader_t _reader, const void* _source,
+                                       profiler::color_t _color)
+{
+    if (_name == nullptr || _reader == nullptr)
+        return 0;
+
+    // Gauges with the same name share one descriptor and differ by value id
+    const std::string uniqueId = std::string("EasyProfiler.Gauge:") + _name;
+    auto desc = addBlockDescriptor(profiler::ON, uniqueId.c_str(), _name, __FILE__, __LINE__,
+                                   profiler::BlockType::Value, _color, true);
+
+    guard_lock_t lock(m_gaugesSpin);
+
+    const auto id = ++m_lastGaugeId;
+    m_gauges.push_back(Gauge {desc, _reader, _source, id});
+
+    if (!m_gaugeSampler.joinable())
+    {
+        m_stopGaugeSampler.store(false, std::memory_order_release);
+        m_gaugeSampler = std::thread(&ProfileManager::sampleGauges, this);
+    }
+
+    return id;
+}
+
+void ProfileManager::unregisterGauge(uint32_t _gauge)
+{
+    std::thread::id samplerId;
+
+    {
+        guard_lock_t lock(m_gaugesSpin);
+
+        auto it = std::find_if(m_gauges.begin(), m_gauges.end(), [_gauge] (const Gauge& gauge) { return gauge.id == _gauge; });
+        if (it == m_gauges.end())
+            return;
+
+        m_gauges.erase(it);
+        samplerId = m_gaugeSampler.get_id();
+    }
+
+    // Wait for the sampling pass which could have copied the gauge before erase, so the reader is never called
+    // after return. Readers are called by the sampler thread itself, so do not wait if unregistering from a reader.
+    if (std::this_thread::get_id() != samplerId)
+        std::lock_guard<std::mutex> wait(m_gaugesReadMutex);
+}
+
+void ProfileManager::setGaugeSamplingRate(uint32_t _hz)
+{
+    m_gaugeSamplingRate.store(std::max(_hz, 1U), std::memory_order_release);
+}
+
+void ProfileManager::stopGaugeSampler()
+{
+    m_stopGaugeSampler.store(true, std::memory_order_release);
+    if (m_gaugeSampler.joinable())
+        m_gaugeSampler.join();
+}
+
+void ProfileManager::sampleGauges()
+{
+    EASY_THREAD_SCOPE("EasyProfiler.Gauges");
+
+    std::vector<Gauge> gauges;
+    auto next = std::chrono::steady_clock::now();
+
+    while (!m_stopGaugeSampler.load(std::memory_order_acquire))
+    {
+        const auto period = std::chrono::microseconds(1000000 / m_gaugeSamplingRate.load(std::memory_order_acquire));
+        next += period;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (next < now)
+            next = now + period; // Do not try to catch up missed samples
+        std::this_thread::sleep_until(next);
+
+        if (!isEnabled() || isStatisticsOnly())
+            continue;
+
+        // Readers are user code: call them outside of m_gaugesSpin to not block (un)registering gauges
+        std::lock_guard<std::mutex> readLock(m_gaugesReadMutex);
+
+        {
+            guard_lock_t lock(m_gaugesSpin);
+            gauges = m_gauges;
+        }
+
+        const auto timestamp = profiler::clock::now();
+        for (const auto& gauge : gauges)
+        {
+            if ((gauge.desc->m_status & profiler::ON) == 0)
+                continue;
+
+            const double value = gauge.reader(gauge.source);
+            THIS_THREAD->storeValue(timestamp, gauge.desc->id(), profiler::DataType::Double, &value, sizeof(value), false,
+                                    profiler::ValueId(gauge.source));
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 void ProfileManager::setContextSwitchLogFilename(const char* name)
 {
     m_csInfoFilename = name;
@@ -1291,27 +2198,108 @@ const char* ProfileManager::getContextSwitchLogFilename() const
 
 //////////////////////////////////////////////////////////////////////////
 
-#if defined(EASY_CHRONO_CLOCK) || defined(_WIN32)
-profiler::timestamp_t ProfileManager::ticks2ns(profiler::timestamp_t ticks) const
+profiler::timestamp_t ProfileManager::ticks2ns(profiler::timestamp_t ticks)
 {
-    return static_cast<profiler::timestamp_t>(ticks * 1000000000LL / m_cpuFrequency);
+    const profiler::timestamp_t frequency = m_clock.frequency();
+    return (ticks / frequency) * 1000000000ULL + (ticks % frequency) * 1000000000ULL / frequency;
 }
 
-profiler::timestamp_t ProfileManager::ticks2us(profiler::timestamp_t ticks) const
+profiler::timestamp_t ProfileManager::ticks2us(profiler::timestamp_t ticks)
 {
-    return static_cast<profiler::timestamp_t>(ticks * 1000000LL / m_cpuFrequency);
+    const profiler::timestamp_t frequency = m_clock.frequency();
+    return (ticks / frequency) * 1000000ULL + (ticks % frequency) * 1000000ULL / frequency;
 }
-#else
-profiler::timestamp_t ProfileManager::ticks2ns(profiler::timestamp_t ticks) const
+
+int64_t ProfileManager::clockFrequency()
 {
-    return static_cast<profiler::timestamp_t>(ticks / m_cpuFrequency.load(std::memory_order_acquire));
+    return m_clock.frequency();
 }
 
-profiler::timestamp_t ProfileManager::ticks2us(profiler::timestamp_t ticks) const
+double ProfileManager::clockFrequencyError() const
 {
-    return static_cast<profiler::timestamp_t>(ticks * 1000 / m_cpuFrequency.load(std::memory_order_acquire));
+    return m_clock.error();
+}
+
+double ProfileManager::clockDrift() const
+{
+    return m_clock.drift();
+}
+
+bool ProfileManager::setClockSource(profiler::ClockSource _source)
+{
+    if (_source == profiler::ClockSource::Auto)
+    {
+        _source = profiler::clock::choose();
+        EASY_LOGMSG("Clock source " << static_cast<int>(_source) << " has been chosen by self-test\n");
+    }
+    else if (!profiler::clock::isAvailable(_source))
+    {
+        return false;
+    }
+
+    guard_lock_t lock(m_dumpSpin);
+
+    // Timestamps of different sources could not be mixed in one capture
+    if (m_profilerStatus.load(std::memory_order_acquire))
+        return false;
+
+    profiler::clock::currentSource.store(static_cast<uint8_t>(_source), std::memory_order_release);
+    m_clock.reset(profiler::clock::exactFrequency(_source));
+    m_blockOverhead.store(0, std::memory_order_release);
+    updateSpikeThresholds();
+
+    return true;
+}
+
+profiler::ClockSource ProfileManager::clockSource() const
+{
+    return static_cast<profiler::ClockSource>(profiler::clock::currentSource.load(std::memory_order_acquire));
+}
+
+profiler::timestamp_t ProfileManager::measureBlockOverhead()
+{
+    // Repeat the work done by beginBlock()/endBlock() for empty blocks using a private storage.
+    // All of this work is included into duration of a parent block.
+    EASY_CONSTEXPR uint32_t BlocksCount = 2000;
+    EASY_CONSTEXPR int RoundsCount = 5;
+
+    ThreadStorage storage;
+    auto overhead = std::numeric_limits<profiler::timestamp_t>::max();
+    for (int round = 0; round < RoundsCount; ++round)
+    {
+        const auto begin = profiler::clock::now();
+        for (uint32_t i = 0; i < BlocksCount; ++i)
+        {
+            profiler::Block block(0ULL, 0, "");
+            block.start();
+            storage.blocks.openedList.emplace_back(block);
+            auto& top = storage.blocks.openedList.back().get();
+            top.finish();
+            storage.storeBlock(top);
+            storage.blocks.openedList.pop_back();
+        }
+        const auto end = profiler::clock::now();
+
+        // The minimum is the least affected by preemption
+        overhead = std::min(overhead, (end - begin) / BlocksCount);
+    }
+
+    return overhead;
+}
+
+profiler::timestamp_t ProfileManager::blockOverhead()
+{
+    // Measured on first request: ThreadStorage can not be used while ProfileManager is being constructed
+    auto overhead = m_blockOverhead.load(std::memory_order_acquire);
+    if (overhead == 0)
+    {
+        overhead = std::max(measureBlockOverhead(), profiler::timestamp_t(1));
+        m_blockOverhead.store(overhead, std::memory_order_release);
+        EASY_LOGMSG("Block overhead " << ticks2ns(overhead) << " ns\n");
+    }
+
+    return overhead;
 }
-#endif
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -1398,6 +2386,14 @@ void ProfileManager::listen(uint16_t _port)
 
     EASY_LOGMSG("Listening started\n");
 
+    EasySocket socket;
+    profiler::net::Message replyMessage(profiler::net::MessageType::Reply_Capturing_Started);
+
+    // Blocks are serialized directly into the socket by pieces of fixed size,
+    // so there is no need to store the whole capture in memory.
+    profiler::SocketOutputBuffer socketBuffer(socket, EASY_OPTION_SEND_BUFFER_SIZE);
+    std::ostream socketStream(&socketBuffer);
+
     std::stringstream os(std::ios_base::out | std::ios_base::binary);
     std::future<uint32_t> dumpingResult;
     bool dumping = false;
@@ -1406,11 +2402,13 @@ void ProfileManager::listen(uint16_t _port)
         dumping = false;
         m_stopDumping.store(true, std::memory_order_release);
         join(dumpingResult);
-        clear_sstream(os);
+        socketBuffer.discard();
+        socketStream.clear();
     };
 
-    EasySocket socket;
-    profiler::net::Message replyMessage(profiler::net::MessageType::Reply_Capturing_Started);
+    // Streaming mode: closed frames are sent periodically until Request_Stop_Streaming
+    bool streaming = false;
+    auto lastPartTime = std::chrono::steady_clock::now();
 
     socket.bind(_port);
     int bytes = 0;
@@ -1419,9 +2417,18 @@ void ProfileManager::listen(uint16_t _port)
         if (dumping)
             stopDumping();
 
+        if (streaming)
+        {
+            streaming = false;
+            socket.setReceiveTimeout(0);
+        }
+
         socket.listen();
         socket.accept();
 
+        socketBuffer.reset();
+        socketStream.clear();
+
         bool hasConnect = true;
 
         // Send reply
@@ -1440,13 +2447,39 @@ void ProfileManager::listen(uint16_t _port)
 
         while (hasConnect && !m_stopListen.load(std::memory_order_acquire))
         {
+            if (streaming && !dumping)
+            {
+                const auto now = std::chrono::steady_clock::now();
+                if (now - lastPartTime >= std::chrono::milliseconds(EASY_OPTION_STREAMING_INTERVAL))
+                {
+                    // Send frames closed since previous part. Threads are not stopped during dumping.
+                    lastPartTime = now;
+                    const auto sentSize = socketBuffer.sentSize();
+                    if (dumpBlocksToStream(socketStream, true, false) == 0 && socketBuffer.sentSize() == sentSize)
+                    {
+                        // Nothing to send
+                        socketBuffer.discard();
+                    }
+                    else
+                    {
+                        socketStream.flush();
+
+                        replyMessage.type = profiler::net::MessageType::Reply_Blocks_Part;
+                        hasConnect = socketBuffer.connected() && socketBuffer.send(&replyMessage, sizeof(replyMessage));
+                        if (!hasConnect)
+                            break;
+                    }
+                }
+            }
+
             if (dumping)
             {
                 if (!dumpingResult.valid())
                 {
                     dumping = false;
                     socket.setReceiveTimeout(0);
-                    clear_sstream(os);
+                    socketBuffer.discard();
+                    socketStream.clear();
                 }
 #if defined(__pnacl__) || defined(__native_client__)
                 else //will force a blocking call at std::future::get below -- the wait_for was not working on tizen.
@@ -1457,44 +2490,10 @@ void ProfileManager::listen(uint16_t _port)
                     dumping = false;
                     dumpingResult.get(); //blocking call if the result is not already ready
 
-                    const auto size = os.tellp();
-                    static const decltype(size) badSize = -1;
-                    if (size != badSize)
-                    {
-                        const profiler::net::DataMessage dm(static_cast<uint32_t>(size),
-                                                            profiler::net::MessageType::Reply_Blocks);
-
-                        const size_t packet_size = sizeof(dm) + dm.size;
-                        std::string sendbuf;
-                        sendbuf.reserve(packet_size + 1);
-
-                        if (sendbuf.capacity() >= packet_size) // check if there is enough memory
-                        {
-                            sendbuf.append((const char*) &dm, sizeof(dm));
-                            sendbuf += os.str(); // TODO: Avoid double-coping data from stringstream!
-                            clear_sstream(os);
-
-                            bytes = socket.send(sendbuf.c_str(), packet_size);
-                            hasConnect = bytes > 0;
-                            if (!hasConnect)
-                                break;
-                        }
-                        else
-                        {
-                            EASY_ERROR("Can not send blocks. Not enough memory for allocating " << packet_size
-                                                                                                << " bytes");
-                            clear_sstream(os);
-                        }
-                    }
-                    else
-                    {
-                        EASY_ERROR("Can not send blocks. Bad std::stringstream.tellp() == -1");
-                        clear_sstream(os);
-                    }
-
+                    // All blocks have been sent by dumping thread
                     replyMessage.type = profiler::net::MessageType::Reply_Blocks_End;
-                    bytes = socket.send(&replyMessage, sizeof(replyMessage));
-                    hasConnect = bytes > 0;
+                    hasConnect = socketBuffer.connected() && socketBuffer.send(&replyMessage, sizeof(replyMessage));
+                    socketStream.clear();
                     if (!hasConnect)
                         break;
 
@@ -1523,6 +2522,10 @@ void ProfileManager::listen(uint16_t _port)
 
                 case profiler::net::MessageType::Request_MainThread_FPS:
                 {
+                    // Receiver is not waiting for this reply while blocks are being sent
+                    if (dumping)
+                        break;
+
                     profiler::timestamp_t maxDuration = maxFrameDuration(), avgDuration = avgFrameDuration();
 
                     maxDuration = ticks2us(maxDuration);
@@ -1531,8 +2534,7 @@ void ProfileManager::listen(uint16_t _port)
                     const profiler::net::TimestampMessage reply(profiler::net::MessageType::Reply_MainThread_FPS,
                                                                 (uint32_t)maxDuration, (uint32_t)avgDuration);
 
-                    bytes = socket.send(&reply, sizeof(profiler::net::TimestampMessage));
-                    hasConnect = bytes > 0;
+                    hasConnect = socketBuffer.send(&reply, sizeof(profiler::net::TimestampMessage));
 
                     break;
                 }
@@ -1549,19 +2551,53 @@ void ProfileManager::listen(uint16_t _port)
                     {
                         enableEventTracer();
                         m_beginTime = t;
+                        m_clock.beginCapture();
                     }
                     m_dumpSpin.unlock();
 
                     replyMessage.type = profiler::net::MessageType::Reply_Capturing_Started;
-                    bytes = socket.send(&replyMessage, sizeof(replyMessage));
-                    hasConnect = bytes > 0;
+                    hasConnect = socketBuffer.send(&replyMessage, sizeof(replyMessage));
 
                     break;
                 }
 
+                case profiler::net::MessageType::Request_Start_Streaming:
+                {
+                    EASY_LOGMSG("receive MessageType::Request_Start_Streaming\n");
+
+                    if (dumping)
+                        break;
+
+                    profiler::timestamp_t t = 0;
+                    EASY_FORCE_EVENT(t, "StartCapture", EASY_COLOR_START, profiler::OFF);
+
+                    m_dumpSpin.lock();
+                    if (!m_profilerStatus.exchange(true, std::memory_order_acq_rel))
+                    {
+                        enableEventTracer();
+                        m_beginTime = t;
+                        m_clock.beginCapture();
+                    }
+                    m_dumpSpin.unlock();
+
+                    streaming = true;
+                    lastPartTime = std::chrono::steady_clock::now();
+                    socket.setReceiveTimeout(EASY_OPTION_STREAMING_INTERVAL);
+
+                    replyMessage.type = profiler::net::MessageType::Reply_Streaming_Started;
+                    hasConnect = socketBuffer.send(&replyMessage, sizeof(replyMessage));
+
+                    break;
+                }
+
+                case profiler::net::MessageType::Request_Stop_Streaming:
                 case profiler::net::MessageType::Request_Stop_Capture:
                 {
-                    EASY_LOGMSG("receive MessageType::Request_Stop_Capture\n");
+                    EASY_LOGMSG("receive MessageType::" << (message->type == profiler::net::MessageType::Request_Stop_Streaming
+                        ? "Request_Stop_Streaming\n" : "Request_Stop_Capture\n"));
+
+                    // The rest of streamed frames would be sent as usual Reply_Blocks message
+                    streaming = false;
 
                     if (dumping)
                         break;
@@ -1579,10 +2615,11 @@ void ProfileManager::listen(uint16_t _port)
                     socket.setReceiveTimeout(500); // We have to check if dumping ready or not
 
                     m_stopDumping.store(false, std::memory_order_release);
-                    dumpingResult = std::async(std::launch::async, [this, &os]
+                    dumpingResult = std::async(std::launch::async, [this, &socketStream]
                     {
-                        auto result = dumpBlocksToStream(os, false, true);
+                        auto result = dumpBlocksToStream(socketStream, false, true);
                         m_dumpSpin.unlock();
+                        socketStream.flush();
                         return result;
                     });
 
@@ -1601,23 +2638,12 @@ void ProfileManager::listen(uint16_t _port)
                     write(os, EASY_PROFILER_VERSION);
 
                     // Write block descriptors
-                    m_storedSpin.lock();
-                    write(os, static_cast<uint32_t>(m_descriptors.size()));
-                    write(os, m_descriptorsMemorySize);
-                    for (const auto descriptor : m_descriptors)
                     {
-                        const auto name_size = descriptor->nameSize();
-                        const auto filename_size = descriptor->filenameSize();
-                        const auto size = static_cast<uint16_t>(sizeof(profiler::SerializedBlockDescriptor)
-                                                                + name_size + filename_size);
-
-                        write(os, size);
-                        write<profiler::BaseBlockDescriptor>(os, *descriptor);
-                        write(os, name_size);
-                        write(os, descriptor->name(), name_size);
-                        write(os, descriptor->filename(), filename_size);
+                        const auto descriptorsCount = m_descriptors.size();
+                        write(os, descriptorsCount);
+                        write(os, descriptorsMemorySize(m_descriptors, descriptorsCount));
+                        writeDescriptors(os, m_descriptors, descriptorsCount);
                     }
-                    m_storedSpin.unlock();
                     // END of Write block descriptors.
 
                     const auto size = os.tellp();
@@ -1665,6 +2691,62 @@ void ProfileManager::listen(uint16_t _port)
                     break;
                 }
 
+                case profiler::net::MessageType::Change_Block_Sampling:
+                {
+                    auto data = reinterpret_cast<const profiler::net::BlockSamplingMessage*>(message);
+                    EASY_LOGMSG("receive MessageType::Change_Block_Sampling id=" << data->id << " sampling=" << data->sampling << std::endl);
+                    setBlockSampling(data->id, data->sampling);
+                    break;
+                }
+
+                case profiler::net::MessageType::Change_Block_Perf_Counters:
+                {
+                    auto data = reinterpret_cast<const profiler::net::BlockPerfCountersMessage*>(message);
+                    EASY_LOGMSG("receive MessageType::Change_Block_Perf_Counters id=" << data->id << " enable=" << data->enable << std::endl);
+                    setBlockPerfCounters(data->id, data->enable);
+                    break;
+                }
+
+                case profiler::net::MessageType::Request_Statistics:
+                {
+                    EASY_LOGMSG("receive MessageType::Request_Statistics\n");
+
+                    profiler::block_summaries_t statistics;
+                    gatherStatistics(statistics);
+
+                    write(os, static_cast<uint32_t>(statistics.size()));
+                    for (const auto& summary : statistics)
+                    {
+                        write(os, summary.id);
+                        write(os, summary.callsNumber);
+                        write(os, summary.totalDuration);
+                        write(os, summary.minDuration);
+                        write(os, summary.maxDuration);
+                        write(os, static_cast<uint16_t>(summary.histogram.size()));
+                        for (const auto& bucket : summary.histogram)
+                        {
+                            write(os, bucket.lowerBound);
+                            write(os, bucket.count);
+                        }
+                    }
+
+                    const auto data = os.str();
+                    clear_sstream(os);
+
+                    const profiler::net::DataMessage dm(static_cast<uint32_t>(data.size()),
+                                                        profiler::net::MessageType::Reply_Statistics);
+
+                    std::string sendbuf;
+                    sendbuf.reserve(sizeof(dm) + data.size());
+                    sendbuf.append(reinterpret_cast<const char*>(&dm), sizeof(dm));
+                    sendbuf += data;
+
+                    bytes = socket.send(sendbuf.c_str(), sendbuf.size());
+                    hasConnect = bytes > 0;
+
+                    break;
+                }
+
                 case profiler::net::MessageType::Change_Event_Tracing_Status:
                 {
                     auto data = reinterpret_cast<const profiler::net::BoolMessage*>(message);
@@ -1675,7 +2757,7 @@ void ProfileManager::listen(uint16_t _port)
 
                 case profiler::net::MessageType::Change_Event_Tracing_Priority:
                 {
-#if defined(_WIN32) || EASY_OPTION_LOG_ENABLED != 0
+#if defined(USE_TRACING) || EASY_OPTION_LOG_ENABLED != 0
                     auto data = reinterpret_cast<const profiler::net::BoolMessage*>(message);
 #endif
 
@@ -44,6 +44,7 @@ The Apache License, Version 2.0 (the "License");
 #define EASY_PROFILER_MANAGER_H
 
 #include <easy/details/profiler_public_types.h>
+#include <easy/details/arbitrary_value_public_types.h>
 
 #ifdef _WIN32
 // Do not move this include to other place!
@@ -52,11 +53,14 @@ The Apache License, Version 2.0 (the "License");
 #endif // _WIN32
 
 #include "spin_lock.h"
+#include "clock_calibration.h"
+#include "descriptor_registry.h"
 #include "hashed_cstr.h"
 #include "thread_storage.h"
 
 #include <atomic>
 #include <map>
+#include <mutex>
 #include <ostream>
 #include <unordered_map>
 #include <thread>
@@ -67,10 +71,17 @@ The Apache License, Version 2.0 (the "License");
 
 using processid_t = uint64_t;
 
+/** Internal bit of Block::m_status which is set if block's descriptor has sampling policy.
+
+It is never set in descriptor status. \sa ProfileManager::beginBlock */
+EASY_CONSTEXPR uint8_t SAMPLED_FLAG = 0x80;
+
 class BlockDescriptor;
+struct CSwitchEvent;
 
 namespace profiler {
     class ValueId;
+    struct BlockSummary;
 }
 
 class ProfileManager
@@ -84,45 +95,77 @@ class ProfileManager
     using atomic_timestamp_t    = std::atomic<profiler::timestamp_t>;
     using guard_lock_t          = profiler::guard_lock<profiler::spin_lock>;
     using map_of_threads_stacks = std::map<profiler::thread_id_t, ThreadStorage>;
-    using block_descriptors_t   = std::vector<BlockDescriptor*>;
-    using descriptors_map_t     = std::unordered_map<profiler::string_with_hash, profiler::block_id_t>;
 
     const processid_t                     m_processId;
 
-#if defined(EASY_CHRONO_CLOCK) || defined(_WIN32)
-    const int64_t                      m_cpuFrequency;
-#endif
-
+    ClockCalibration                          m_clock;
     map_of_threads_stacks                   m_threads;
-    block_descriptors_t                 m_descriptors;
-    descriptors_map_t                m_descriptorsMap;
-    uint64_t                  m_descriptorsMemorySize;
-
-#if !defined(EASY_CHRONO_CLOCK) && !defined(_WIN32)
-    std::atomic<int64_t>               m_cpuFrequency;
-#endif
+    DescriptorRegistry                  m_descriptors;
+    BlockDescriptor              m_overflowDescriptor; ///< Disabled descriptor shared by all blocks registered after m_descriptors is full
 
     profiler::timestamp_t                 m_beginTime;
     profiler::timestamp_t                   m_endTime;
     atomic_timestamp_t                     m_frameMax;
     atomic_timestamp_t                     m_frameAvg;
     atomic_timestamp_t                     m_frameCur;
+    atomic_timestamp_t                m_blockOverhead;
     profiler::spin_lock                        m_spin;
-    profiler::spin_lock                  m_storedSpin;
     profiler::spin_lock                    m_dumpSpin;
     std::atomic<profiler::thread_id_t> m_mainThreadId;
     std::atomic_bool                 m_profilerStatus;
     std::atomic_bool          m_isEventTracingEnabled;
+    std::atomic_bool          m_isEventTracerLaunched; ///< Context switches are captured by the event tracer instead of log-file
     std::atomic_bool             m_isAlreadyListening;
     std::atomic_bool                  m_frameMaxReset;
     std::atomic_bool                  m_frameAvgReset;
     std::atomic_bool                    m_stopDumping;
+    std::atomic<uint64_t>       m_threadMemoryLimit;
+    std::atomic_bool             m_isStatisticsOnly;
+    std::atomic<uint32_t>         m_statisticsEpoch;
+    std::atomic_bool          m_isAllocationTracking;
+    std::atomic<uint64_t>    m_executionContextsCount;
+    atomic_timestamp_t        m_spikeFrameThreshold; ///< Frame duration threshold in ticks
+    atomic_timestamp_t        m_spikeBlockThreshold; ///< Block duration threshold in ticks
+    atomic_timestamp_t      m_spikeFrameThresholdUs; ///< Frame duration threshold in microseconds as it has been set
+    atomic_timestamp_t      m_spikeBlockThresholdUs; ///< Block duration threshold in microseconds as it has been set
+    std::atomic<profiler::block_id_t> m_spikeBlockId;
+    std::atomic<uint32_t>       m_spikeFramesBefore;
+    std::atomic<uint32_t>        m_spikeFramesAfter;
+    std::atomic<uint32_t>           m_spikeCaptures;
+    std::atomic<ThreadStorage*>       m_spikeThread; ///< Thread counting frames after the spike
+    std::atomic_bool        m_isSpikeCaptureEnabled;
+    std::atomic_bool             m_isSpikeCapturing;
+    std::atomic_bool         m_isSpikeWriteRequested; ///< Spike capture is ready to be written by m_spikeWriter
+    std::atomic_bool                m_isSpikePinned; ///< Frames are not dropped in flight recorder mode until spike capture is written
+    std::atomic_bool              m_stopSpikeWriter;
+    profiler::spin_lock                   m_spikeSpin;
+    profiler::timestamp_t                m_spikeSince;
+    uint32_t                        m_spikeFramesLeft;
 
     std::string m_csInfoFilename = "/tmp/cs_profiling_info.log";
+    std::string m_spikeFilenamePrefix = "spike";
+
+    std::thread       m_spikeWriter; ///< Writes spike captures (started when spike capture is enabled for the first time)
 
     std::thread      m_listenThread;
     std::atomic_bool   m_stopListen;
 
+    struct Gauge
+    {
+        const profiler::BaseBlockDescriptor* desc;
+        profiler::gauge_reader_t           reader;
+        const void*                        source;
+        uint32_t                               id;
+    };
+
+    std::vector<Gauge>                  m_gauges; ///< Registered gauges (guarded by m_gaugesSpin)
+    profiler::spin_lock             m_gaugesSpin;
+    std::mutex                m_gaugesReadMutex; ///< Held by the sampler while calling gauge readers
+    uint32_t                        m_lastGaugeId;
+    std::atomic<uint32_t>     m_gaugeSamplingRate;
+    std::atomic_bool           m_stopGaugeSampler;
+    std::thread                    m_gaugeSampler;
+
 public:
 
     ProfileManager(const ProfileManager&)              = delete;
@@ -144,6 +187,7 @@ public:
 
     void storeValue(const profiler::BaseBlockDescriptor* _desc, profiler::DataType _type, const void* _data, uint16_t _size, bool _isArray, profiler::ValueId _vin);
     bool storeBlock(const profiler::BaseBlockDescriptor* _desc, const char* _runtimeName);
+    void storeFlow(uint64_t _id, profiler::FlowPointType _type);
     bool storeBlock(const profiler::BaseBlockDescriptor* _desc, const char* _runtimeName, profiler::timestamp_t _beginTime, profiler::timestamp_t _endTime);
     void beginBlock(profiler::Block& _block);
     void beginNonScopedBlock(const profiler::BaseBlockDescriptor* _desc, const char* _runtimeName);
@@ -160,21 +204,63 @@ public:
 
     void setEventTracingEnabled(bool _isEnable);
     bool isEventTracingEnabled() const;
-    uint32_t dumpBlocksToFile(const char* filename);
+    uint32_t dumpBlocksToFile(const char* filename, bool _stopProfiling);
     const char* registerThread(const char* name, profiler::ThreadGuard& threadGuard);
     const char* registerThread(const char* name);
 
+    void setFlightRecorderMemoryLimit(uint64_t _bytesPerThread);
+    uint64_t flightRecorderMemoryLimit() const;
+
+    bool setStatisticsOnly(bool _enable);
+    EASY_FORCE_INLINE bool isStatisticsOnly() const {
+        return m_isStatisticsOnly.load(std::memory_order_relaxed);
+    }
+    void gatherStatistics(std::vector<profiler::BlockSummary>& _statistics);
+
+    void setSpikeCapture(profiler::timestamp_t _frameThresholdUs, uint32_t _framesBefore, uint32_t _framesAfter, const char* _filenamePrefix);
+    void setSpikeCaptureBlock(profiler::block_id_t _id, profiler::timestamp_t _thresholdUs);
+    void setBlockPerfCounters(profiler::block_id_t _id, bool _enable);
+    uint32_t spikeCapturesCount() const;
+    void finishSpikeFrames(ThreadStorage* _thread);
+
+    void setAllocationTracking(bool _enable);
+    EASY_FORCE_INLINE bool isAllocationTracking() const {
+        return m_isAllocationTracking.load(std::memory_order_relaxed);
+    }
+    static void trackAllocation(size_t _bytes);
+
+    ThreadStorage* createExecutionContext(const char* _name);
+    void switchExecutionContext(ThreadStorage* _context);
+    static ThreadStorage* currentExecutionContext();
+    void destroyExecutionContext(ThreadStorage* _context);
+
+    bool setCrashRecoveryDirectory(const char* _directory);
+
     void setContextSwitchLogFilename(const char* name);
     const char* getContextSwitchLogFilename() const;
 
     void beginContextSwitch(profiler::thread_id_t _thread_id, profiler::timestamp_t _time, profiler::thread_id_t _target_thread_id, const char* _target_process, bool _lockSpin = true);
     void endContextSwitch(profiler::thread_id_t _thread_id, processid_t _process_id, profiler::timestamp_t _endtime, bool _lockSpin = true);
+    void storeContextSwitches(const CSwitchEvent* _events, size_t _count);
     void startListen(uint16_t _port);
     void stopListen();
     bool isListening() const;
 
-    profiler::timestamp_t ticks2ns(profiler::timestamp_t ticks) const;
-    profiler::timestamp_t ticks2us(profiler::timestamp_t ticks) const;
+    uint32_t registerGauge(const char* _name, profiler::gauge_reader_t _reader, const void* _source, profiler::color_t _color);
+    void unregisterGauge(uint32_t _gauge);
+    void setGaugeSamplingRate(uint32_t _hz);
+
+    profiler::timestamp_t ticks2ns(profiler::timestamp_t ticks);
+    profiler::timestamp_t ticks2us(profiler::timestamp_t ticks);
+
+    int64_t clockFrequency();
+    double clockFrequencyError() const;
+    double clockDrift() const;
+
+    bool setClockSource(profiler::ClockSource _source);
+    profiler::ClockSource clockSource() const;
+
+    profiler::timestamp_t blockOverhead();
 
     static bool isMainThread();
     static profiler::timestamp_t this_thread_frameTime(profiler::Duration _durationCast);
@@ -187,15 +273,32 @@ public:
 private:
 
     void listen(uint16_t _port);
+    void sampleGauges();
+    void stopGaugeSampler();
 
-    uint32_t dumpBlocksToStream(std::ostream& _outputStream, bool _lockSpin, bool _async);
+    // _filename is the name of the file _outputStream writes to (if any): large captures are written into it concurrently
+    uint32_t dumpBlocksToStream(std::ostream& _outputStream, bool _lockSpin, bool _async, profiler::timestamp_t _since = 0, bool _consume = true,
+                                const char* _filename = nullptr);
     void setBlockStatus(profiler::block_id_t _id, profiler::EasyBlockStatus _status);
+    void setBlockSampling(profiler::block_id_t _id, uint32_t _sampling);
 
     void registerThread();
 
+    static profiler::timestamp_t measureBlockOverhead();
+
     void beginFrame();
     void endFrame();
 
+    void checkSpike(profiler::timestamp_t _frameDuration);
+    void startSpikeWriter();
+    void stopSpikeWriter();
+    void writeSpikes();
+    void updateSpikeThresholds();
+    void pinSpikeFrames(bool _pinned);
+    void updateCrashRecoveryHeader();
+    bool readContextSwitchLog(profiler::timestamp_t _begin, profiler::timestamp_t _end, bool _async);
+    void writeSpikeCapture(profiler::timestamp_t _since);
+
     void enableEventTracer();
     void disableEventTracer();
 
@@ -50,9 +50,12 @@
 
 #include <easy/profiler.h>
 #include <easy/arbitrary_value.h>
+#include <easy/statistics.h>
 #include "profile_manager.h"
 #include "event_trace_win.h"
+#include "event_trace_linux.h"
 #include "current_time.h"
+#include "clock_source.h"
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -62,7 +65,7 @@
 # endif
 #endif
 
-#if defined(_WIN32) && !defined(_UWP)
+#if (defined(_WIN32) && !defined(_UWP)) || (defined(__linux__) && !defined(__ANDROID__))
 # define USE_TRACING
 #endif
 
@@ -146,6 +149,41 @@ PROFILER_API profiler::timestamp_t toMicroseconds(profiler::timestamp_t _ticks)
     return ProfileManager::instance().ticks2us(_ticks);
 }
 
+PROFILER_API int64_t clockFrequency()
+{
+    return ProfileManager::instance().clockFrequency();
+}
+
+PROFILER_API double clockFrequencyError()
+{
+    return ProfileManager::instance().clockFrequencyError();
+}
+
+PROFILER_API double clockDrift()
+{
+    return ProfileManager::instance().clockDrift();
+}
+
+PROFILER_API bool setClockSource(profiler::ClockSource _source)
+{
+    return ProfileManager::instance().setClockSource(_source);
+}
+
+PROFILER_API profiler::ClockSource clockSource()
+{
+    return ProfileManager::instance().clockSource();
+}
+
+PROFILER_API void testClockSource(profiler::ClockSource _source, profiler::ClockSourceInfo& _info)
+{
+    profiler::clock::test(_source, _info);
+}
+
+PROFILER_API profiler::timestamp_t blockOverhead()
+{
+    return ProfileManager::instance().blockOverhead();
+}
+
 PROFILER_API const profiler::BaseBlockDescriptor*
 registerDescription(profiler::EasyBlockStatus _status, const char* _autogenUniqueId, const char* _name,
                     const char* _filename, int _line, profiler::block_type_t _block_type, profiler::color_t _color,
@@ -176,11 +214,32 @@ PROFILER_API void storeValue(const profiler::BaseBlockDescriptor* _desc, profile
     ProfileManager::instance().storeValue(_desc, _type, _data, _size, _isArray, _vin);
 }
 
+PROFILER_API uint32_t registerGauge(const char* _name, profiler::gauge_reader_t _reader, const void* _source,
+                                   profiler::color_t _color)
+{
+    return ProfileManager::instance().registerGauge(_name, _reader, _source, _color);
+}
+
+PROFILER_API void unregisterGauge(uint32_t _gauge)
+{
+    ProfileManager::instance().unregisterGauge(_gauge);
+}
+
+PROFILER_API void setGaugeSamplingRate(uint32_t _hz)
+{
+    ProfileManager::instance().setGaugeSamplingRate(_hz);
+}
+
 PROFILER_API void storeEvent(const profiler::BaseBlockDescriptor* _desc, const char* _runtimeName)
 {
     ProfileManager::instance().storeBlock(_desc, _runtimeName);
 }
 
+PROFILER_API void storeFlow(uint64_t _id, profiler::FlowPointType _type)
+{
+    ProfileManager::instance().storeFlow(_id, _type);
+}
+
 PROFILER_API void storeBlock(const profiler::BaseBlockDescriptor* _desc, const char* _runtimeName,
                              profiler::timestamp_t _beginTime, profiler::timestamp_t _endTime)
 {
@@ -199,7 +258,12 @@ PROFILER_API void beginNonScopedBlock(const profiler::BaseBlockDescriptor* _desc
 
 PROFILER_API uint32_t dumpBlocksToFile(const char* filename)
 {
-    return ProfileManager::instance().dumpBlocksToFile(filename);
+    return ProfileManager::instance().dumpBlocksToFile(filename, true);
+}
+
+PROFILER_API uint32_t dumpSnapshotToFile(const char* filename)
+{
+    return ProfileManager::instance().dumpBlocksToFile(filename, false);
 }
 
 PROFILER_API const char* registerThreadScoped(const char* name, profiler::ThreadGuard& threadGuard)
@@ -237,6 +301,101 @@ PROFILER_API void setLowPriorityEventTracing(bool) { }
 PROFILER_API bool isLowPriorityEventTracing() { return false; }
 # endif
 
+PROFILER_API void setFlightRecorderMemoryLimit(uint64_t _bytesPerThread)
+{
+    ProfileManager::instance().setFlightRecorderMemoryLimit(_bytesPerThread);
+}
+
+PROFILER_API uint64_t flightRecorderMemoryLimit()
+{
+    return ProfileManager::instance().flightRecorderMemoryLimit();
+}
+
+PROFILER_API void setSpikeCapture(profiler::timestamp_t _frameThresholdUs, uint32_t _framesBefore, uint32_t _framesAfter, const char* _filenamePrefix)
+{
+    ProfileManager::instance().setSpikeCapture(_frameThresholdUs, _framesBefore, _framesAfter, _filenamePrefix);
+}
+
+PROFILER_API void setSpikeCaptureBlock(profiler::block_id_t _id, profiler::timestamp_t _thresholdUs)
+{
+    ProfileManager::instance().setSpikeCaptureBlock(_id, _thresholdUs);
+}
+
+PROFILER_API void setBlockPerfCounters(profiler::block_id_t _id, bool _enable)
+{
+    ProfileManager::instance().setBlockPerfCounters(_id, _enable);
+}
+
+PROFILER_API void setAllocationTracking(bool _enable)
+{
+    ProfileManager::instance().setAllocationTracking(_enable);
+}
+
+PROFILER_API bool isAllocationTrackingEnabled()
+{
+    return ProfileManager::instance().isAllocationTracking();
+}
+
+PROFILER_API void trackAllocation(size_t _bytes)
+{
+    ProfileManager::trackAllocation(_bytes);
+}
+
+PROFILER_API profiler::ExecutionContext* createExecutionContext(const char* _name)
+{
+    return reinterpret_cast<profiler::ExecutionContext*>(ProfileManager::instance().createExecutionContext(_name));
+}
+
+PROFILER_API void switchExecutionContext(profiler::ExecutionContext* _context)
+{
+    ProfileManager::instance().switchExecutionContext(reinterpret_cast<ThreadStorage*>(_context));
+}
+
+PROFILER_API profiler::ExecutionContext* currentExecutionContext()
+{
+    return reinterpret_cast<profiler::ExecutionContext*>(ProfileManager::currentExecutionContext());
+}
+
+PROFILER_API void destroyExecutionContext(profiler::ExecutionContext* _context)
+{
+    ProfileManager::instance().destroyExecutionContext(reinterpret_cast<ThreadStorage*>(_context));
+}
+
+PROFILER_API uint32_t spikeCapturesCount()
+{
+    return ProfileManager::instance().spikeCapturesCount();
+}
+
+PROFILER_API bool setStatisticsOnly(bool _enable)
+{
+    return ProfileManager::instance().setStatisticsOnly(_enable);
+}
+
+PROFILER_API bool isStatisticsOnly()
+{
+    return ProfileManager::instance().isStatisticsOnly();
+}
+
+PROFILER_API void gatherStatistics(profiler::block_summaries_t& _statistics)
+{
+    ProfileManager::instance().gatherStatistics(_statistics);
+}
+
+PROFILER_API void reserveStorageMemory(uint64_t _bytes)
+{
+    ChunkPool::instance().reserve(_bytes);
+}
+
+PROFILER_API uint64_t reservedStorageMemory()
+{
+    return ChunkPool::instance().memorySize();
+}
+
+PROFILER_API bool setCrashRecoveryDirectory(const char* _directory)
+{
+    return ProfileManager::instance().setCrashRecoveryDirectory(_directory);
+}
+
 PROFILER_API void setContextSwitchLogFilename(const char* name)
 {
     return ProfileManager::instance().setContextSwitchLogFilename(name);
@@ -302,6 +461,13 @@ PROFILER_API profiler::timestamp_t main_thread_frameTimeLocalAvg(profiler::Durat
 PROFILER_API profiler::timestamp_t now() { return 0; }
 PROFILER_API profiler::timestamp_t toNanoseconds(profiler::timestamp_t) { return 0; }
 PROFILER_API profiler::timestamp_t toMicroseconds(profiler::timestamp_t) { return 0; }
+PROFILER_API int64_t clockFrequency() { return 0; }
+PROFILER_API double clockFrequencyError() { return 0; }
+PROFILER_API double clockDrift() { return 0; }
+PROFILER_API bool setClockSource(profiler::ClockSource) { return false; }
+PROFILER_API profiler::ClockSource clockSource() { return profiler::ClockSource::Native; }
+PROFILER_API void testClockSource(profiler::ClockSource, profiler::ClockSourceInfo&) { }
+PROFILER_API profiler::timestamp_t blockOverhead() { return 0; }
 
 PROFILER_API const profiler::BaseBlockDescriptor* registerDescription(profiler::EasyBlockStatus, const char*,
                                                                       const char*, const char*, int,
@@ -319,7 +485,12 @@ PROFILER_API void storeValue(const profiler::BaseBlockDescriptor*, profiler::Dat
 {
 }
 
+PROFILER_API uint32_t registerGauge(const char*, profiler::gauge_reader_t, const void*, profiler::color_t) { return 0; }
+PROFILER_API void unregisterGauge(uint32_t) { }
+PROFILER_API void setGaugeSamplingRate(uint32_t) { }
+
 PROFILER_API void storeEvent(const profiler::BaseBlockDescriptor*, const char*) { }
+PROFILER_API void storeFlow(uint64_t, profiler::FlowPointType) { }
 PROFILER_API void storeBlock(const profiler::BaseBlockDescriptor*, const char*, profiler::timestamp_t,
                              profiler::timestamp_t)
 {
@@ -328,12 +499,32 @@ PROFILER_API void storeBlock(const profiler::BaseBlockDescriptor*, const char*,
 PROFILER_API void beginBlock(profiler::Block&) { }
 PROFILER_API void beginNonScopedBlock(const profiler::BaseBlockDescriptor*, const char*) { }
 PROFILER_API uint32_t dumpBlocksToFile(const char*) { return 0; }
+PROFILER_API uint32_t dumpSnapshotToFile(const char*) { return 0; }
 PROFILER_API const char* registerThreadScoped(const char*, profiler::ThreadGuard&) { return ""; }
 PROFILER_API const char* registerThread(const char*) { return ""; }
 PROFILER_API void setEventTracingEnabled(bool) { }
 PROFILER_API bool isEventTracingEnabled() { return false; }
 PROFILER_API void setLowPriorityEventTracing(bool) { }
 PROFILER_API bool isLowPriorityEventTracing(bool) { return false; }
+PROFILER_API void setFlightRecorderMemoryLimit(uint64_t) { }
+PROFILER_API uint64_t flightRecorderMemoryLimit() { return 0; }
+PROFILER_API void setSpikeCapture(profiler::timestamp_t, uint32_t, uint32_t, const char*) { }
+PROFILER_API void setSpikeCaptureBlock(profiler::block_id_t, profiler::timestamp_t) { }
+PROFILER_API void setBlockPerfCounters(profiler::block_id_t, bool) { }
+PROFILER_API void setAllocationTracking(bool) { }
+PROFILER_API bool isAllocationTrackingEnabled() { return false; }
+PROFILER_API void trackAllocation(size_t) { }
+PROFILER_API profiler::ExecutionContext* createExecutionContext(const char*) { return nullptr; }
+PROFILER_API void switchExecutionContext(profiler::ExecutionContext*) { }
+PROFILER_API profiler::ExecutionContext* currentExecutionContext() { return nullptr; }
+PROFILER_API void destroyExecutionContext(profiler::ExecutionContext*) { }
+PROFILER_API uint32_t spikeCapturesCount() { return 0; }
+PROFILER_API bool setStatisticsOnly(bool) { return false; }
+PROFILER_API bool isStatisticsOnly() { return false; }
+PROFILER_API void gatherStatistics(profiler::block_summaries_t& _statistics) { _statistics.clear(); }
+PROFILER_API void reserveStorageMemory(uint64_t) { }
+PROFILER_API uint64_t reservedStorageMemory() { return 0; }
+PROFILER_API bool setCrashRecoveryDirectory(const char*) { return false; }
 PROFILER_API void setContextSwitchLogFilename(const char*) { }
 PROFILER_API const char* getContextSwitchLogFilename() { return ""; }
 PROFILER_API void startListen(uint16_t) { }
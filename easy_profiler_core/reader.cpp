@@ -53,6 +53,7 @@
 #include <fstream>
 #include <iterator>
 #include <limits>
+#include <map>
 #include <unordered_map>
 #include <thread>
 
@@ -60,6 +61,7 @@
 #include <easy/profiler.h>
 
 #include "hashed_cstr.h"
+#include "compact_block.h"
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -75,6 +77,14 @@ EASY_CONSTEXPR uint32_t EASY_V_100 = EASY_VERSION_INT(1, 0, 0); ///< in v1.0.0 s
 EASY_CONSTEXPR uint32_t EASY_V_130 = EASY_VERSION_INT(1, 3, 0); ///< in v1.3.0 changed sizeof(thread_id_t) uint32_t -> uint64_t
 EASY_CONSTEXPR uint32_t EASY_V_200 = EASY_VERSION_INT(2, 0, 0); ///< in v2.0.0 file header was slightly rearranged
 EASY_CONSTEXPR uint32_t EASY_V_210 = EASY_VERSION_INT(2, 1, 0); ///< in v2.1.0 user bookmarks were added
+EASY_CONSTEXPR uint32_t EASY_V_220 = EASY_VERSION_INT(2, 2, 0); ///< in v2.2.0 run-time names table was added
+EASY_CONSTEXPR uint32_t EASY_V_230 = EASY_VERSION_INT(2, 3, 0); ///< in v2.3.0 blocks are stored using compact encoding
+EASY_CONSTEXPR uint32_t EASY_V_240 = EASY_VERSION_INT(2, 4, 0); ///< in v2.4.0 header padding is replaced with clock source
+EASY_CONSTEXPR uint32_t EASY_V_250 = EASY_VERSION_INT(2, 5, 0); ///< in v2.5.0 measured block overhead was added into header
+EASY_CONSTEXPR uint32_t EASY_V_260 = EASY_VERSION_INT(2, 6, 0); ///< in v2.6.0 sampling was added into block descriptor and dropped calls counters into blocks list
+EASY_CONSTEXPR uint32_t EASY_V_270 = EASY_VERSION_INT(2, 7, 0); ///< in v2.7.0 performance counters flag was added into block descriptor and counters into blocks list
+EASY_CONSTEXPR uint32_t EASY_V_280 = EASY_VERSION_INT(2, 8, 0); ///< in v2.8.0 allocations of blocks were added into blocks list
+EASY_CONSTEXPR uint32_t EASY_V_290 = EASY_VERSION_INT(2, 9, 0); ///< in v2.9.0 flow points were added into blocks list
 
 # undef EASY_VERSION_INT
 
@@ -237,6 +247,34 @@ using CsStatsMap = std::unordered_map<profiler::string_with_hash, profiler::Bloc
 
 //////////////////////////////////////////////////////////////////////////
 
+/** \brief Returns id for a block with run-time name.
+
+If block has runtime name then generate new id for such block.
+Blocks with the same name will have same id.
+*/
+static profiler::block_id_t generateId(IdMap& _identification_table, profiler::descriptors_list_t& _descriptors,
+                                       const profiler::SerializedBlock& _block)
+{
+    IdMap::key_type key(_block.name());
+    auto it = _identification_table.find(key);
+    if (it != _identification_table.end())
+    {
+        // There is already block with such name, use it's id
+        return it->second;
+    }
+
+    // There were no blocks with such name, generate new id and save it in the table for further usage.
+    auto id = static_cast<profiler::block_id_t>(_descriptors.size());
+    _identification_table.emplace(key, id);
+    if (_descriptors.capacity() == _descriptors.size())
+        _descriptors.reserve((_descriptors.size() * 3) >> 1);
+    _descriptors.push_back(_descriptors[_block.id()]);
+
+    return id;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 /** \brief Updates statistics for a profiler block.
 
 \param _stats_map Storage of statistics for blocks.
@@ -286,6 +324,11 @@ static profiler::BlockStatistics* update_statistics(StatsMap& _stats_map, const
 
         // average duration is calculated inside average_duration() method by dividing total_duration to the calls_number
 
+        if (_current.has_counters)
+            stats->add_counters(*_current.counters());
+        if (_current.has_allocations)
+            stats->add_allocations(*_current.allocations());
+
         return stats;
     }
 
@@ -301,6 +344,11 @@ static profiler::BlockStatistics* update_statistics(StatsMap& _stats_map, const
             stats->total_children_duration += _blocks[i].node->duration();
     }
 
+    if (_current.has_counters)
+        stats->add_counters(*_current.counters());
+    if (_current.has_allocations)
+        stats->add_allocations(*_current.allocations());
+
     return stats;
 }
 
@@ -369,6 +417,85 @@ static void update_statistics_recursive(StatsMap& _stats_map, profiler::BlocksTr
     }
 }
 
+static void shift_tree(profiler::blocks_t& _blocks, profiler::block_index_t _index, profiler::timestamp_t _delta)
+{
+    auto& tree = _blocks[_index];
+    auto t_begin = reinterpret_cast<profiler::timestamp_t*>(tree.node);
+    t_begin[0] -= _delta;
+    t_begin[1] -= _delta;
+    for (auto i : tree.children)
+        shift_tree(_blocks, i, _delta);
+}
+
+/** Returns the innermost block which contains _time (~0U if there is no such block).
+
+Children of each block (and of the thread) are sorted by begin time and do not overlap,
+so only one child on each level could contain the time.
+*/
+static profiler::block_index_t find_enclosing_block(const profiler::BlocksTree::children_t& _children, const profiler::blocks_t& _blocks,
+                                                    const profiler::descriptors_list_t& _descriptors, profiler::timestamp_t _time)
+{
+    profiler::block_index_t result = ~0U;
+    auto children = &_children;
+    while (!children->empty())
+    {
+        auto it = std::upper_bound(children->begin(), children->end(), _time,
+                                   [&_blocks](profiler::timestamp_t _value, profiler::block_index_t _index)
+        {
+            return _value < _blocks[_index].node->begin();
+        });
+
+        if (it == children->begin())
+            break;
+
+        const auto index = *--it;
+        const auto& block = _blocks[index];
+        if (block.node->end() < _time || _descriptors[block.node->id()]->type() != profiler::BlockType::Block)
+            break;
+
+        result = index;
+        children = &block.children;
+    }
+
+    return result;
+}
+
+/** Removes measured profiler overhead of nested blocks from the parent block.
+
+Each child is moved back by the overhead of its preceding siblings (with their nested blocks),
+so children stay inside the parent and do not overlap each other. Parent end is moved back by
+the overhead of all nested blocks.
+
+\param _nested Number of nested blocks for each already compensated block
+\param _overhead Cost of one block in nanoseconds
+*/
+static void compensate_overhead_of_children(profiler::blocks_t& _blocks, profiler::block_index_t _index,
+                                            std::vector<uint32_t>& _nested, double _overhead)
+{
+    auto& tree = _blocks[_index];
+    auto t_begin = reinterpret_cast<profiler::timestamp_t*>(tree.node);
+    auto t_end = t_begin + 1;
+
+    auto prev_end = *t_begin;
+    double shift = 0;
+    uint32_t nested = 0;
+    for (auto i : tree.children)
+    {
+        auto child = reinterpret_cast<const profiler::timestamp_t*>(_blocks[i].node);
+        const auto delta = std::min(static_cast<profiler::timestamp_t>(shift + 0.5), child[0] - prev_end);
+        if (delta != 0)
+            shift_tree(_blocks, i, delta);
+
+        prev_end = child[1];
+        nested += 1 + _nested[i];
+        shift = static_cast<double>(delta) + (1 + _nested[i]) * _overhead;
+    }
+
+    const auto delta = std::min(static_cast<profiler::timestamp_t>(shift + 0.5), *t_end - prev_end);
+    *t_end -= delta;
+    _nested[_index] = nested;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 static bool update_progress(std::atomic<int>& progress, int new_value, std::ostream& _log)
@@ -408,6 +535,42 @@ static bool tryReadMarker(std::istream& inStream)
     return tryReadMarker(inStream, marker);
 }
 
+/** Returns size of trailing BaseBlockDescriptor fields which are missing in descriptors of specified version.
+
+m_sampling was added in v2.6.0 and m_perfCounters in v2.7.0, both at the end of BaseBlockDescriptor. */
+static uint16_t missing_descriptor_fields_size(uint32_t version)
+{
+    if (version < EASY_V_260)
+        return static_cast<uint16_t>(sizeof(uint32_t) + sizeof(bool));
+    return static_cast<uint16_t>(version < EASY_V_270 ? sizeof(bool) : 0);
+}
+
+/** Returns additional memory size required to read descriptors of specified version. */
+static uint64_t descriptors_memory_growth(uint32_t version, uint32_t descriptors_count)
+{
+    return static_cast<uint64_t>(descriptors_count) * missing_descriptor_fields_size(version);
+}
+
+/** Reads serialized block descriptor of size sz and returns it's size in memory.
+
+Fields missing in descriptors of older versions are inserted with zero value. */
+static uint16_t read_descriptor(std::istream& inStream, char* data, uint16_t sz, uint32_t version)
+{
+    const auto missing = missing_descriptor_fields_size(version);
+    const auto offset = static_cast<uint16_t>(sizeof(profiler::BaseBlockDescriptor) - missing);
+    if (missing == 0 || sz < offset)
+    {
+        read(inStream, data, sz);
+        return sz;
+    }
+
+    read(inStream, data, offset);
+    memset(data + offset, 0, missing);
+    read(inStream, data + offset + missing, sz - offset);
+
+    return static_cast<uint16_t>(sz + missing);
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 struct EasyFileHeader
@@ -424,7 +587,8 @@ struct EasyFileHeader
     uint32_t descriptors_count = 0;
     uint32_t threads_count = 0;
     uint16_t bookmarks_count = 0;
-    uint16_t padding = 0;
+    uint16_t clock_source = 0; ///< profiler::ClockSource of timestamps (padding before v2.4.0)
+    profiler::timestamp_t block_overhead = 0; ///< Cost of one block in ticks (since v2.5.0)
 };
 
 static bool readHeader_v1(EasyFileHeader& _header, std::istream& inStream, std::ostream& _log)
@@ -533,19 +697,394 @@ static bool readHeader_v2_1(EasyFileHeader& _header, std::istream& inStream, std
     }
 
     read(inStream, _header.bookmarks_count);
-    read(inStream, _header.padding);
+    read(inStream, _header.clock_source);
 
-    if (_header.padding != 0)
+    if (_header.version < EASY_V_240 && _header.clock_source != 0)
     {
         _log << "Header padding != 0.\nFile corrupted.";
         return false;
     }
 
+    if (_header.clock_source >= static_cast<uint16_t>(profiler::ClockSource::Auto))
+    {
+        _log << "Unknown clock source " << _header.clock_source << ".\nFile corrupted.";
+        return false;
+    }
+
+    if (_header.version >= EASY_V_250)
+        read(inStream, _header.block_overhead);
+
     return true;
 }
 
 //////////////////////////////////////////////////////////////////////////
 
+template <class T>
+static bool readFromBuffer(const char*& _data, const char* _end, T& _value)
+{
+    if (static_cast<size_t>(_end - _data) < sizeof(T))
+        return false;
+    memcpy(&_value, _data, sizeof(T));
+    _data += sizeof(T);
+    return true;
+}
+
+template <class T>
+static void write(std::ostream& _outputStream, const T& _value)
+{
+    _outputStream.write((const char*)&_value, sizeof(T));
+}
+
+/** Copies threads sections of a streamed capture part replacing run-time name ids of blocks with the given ids.
+
+\retval false if threads sections are corrupted. */
+static bool joinThreads(const char* _data, const char* _end, uint32_t _threadsCount, uint32_t _version,
+                        const std::vector<uint32_t>& _nameIds, std::string& _output)
+{
+    const auto copy = [&_data, _end, &_output](size_t _size) -> bool
+    {
+        if (static_cast<size_t>(_end - _data) < _size)
+            return false;
+        _output.append(_data, _size);
+        _data += _size;
+        return true;
+    };
+
+    const char* size_data = nullptr;
+    uint16_t sz = 0;
+    uint32_t number = 0;
+
+    for (uint32_t t = 0; t < _threadsCount; ++t)
+    {
+        // Thread id and name
+        if (!copy(sizeof(profiler::thread_id_t)))
+            return false;
+
+        size_data = _data;
+        if (!readFromBuffer(size_data, _end, sz) || !copy(sizeof(sz) + sz))
+            return false;
+
+        // Context switches are copied as is
+        size_data = _data;
+        if (!readFromBuffer(size_data, _end, number) || !copy(sizeof(number)))
+            return false;
+
+        for (uint32_t i = 0; i < number; ++i)
+        {
+            size_data = _data;
+            if (!readFromBuffer(size_data, _end, sz) || sz == 0 || !copy(sizeof(sz) + sz))
+                return false;
+        }
+
+        size_data = _data;
+        if (!readFromBuffer(size_data, _end, number) || !copy(sizeof(number)))
+            return false;
+
+        for (uint32_t i = 0; i < number; ++i)
+        {
+            size_data = _data;
+            if (!readFromBuffer(size_data, _end, sz) || sz == 0 || static_cast<size_t>(_end - size_data) < sz)
+                return false;
+
+            const char* block_data = size_data;
+            if (_version >= EASY_V_230)
+            {
+                const auto tag = static_cast<uint8_t>(*block_data);
+                if ((tag & COMPACT_BLOCK) != 0 && (tag & COMPACT_INTERNED_NAME) != 0)
+                {
+                    // Delta of begin time does not depend on the base used for decoding/encoding here
+                    CompactBlock block;
+                    if (!decodeCompactBlock(block_data, block_data + sz, 0, block) || block.nameId >= _nameIds.size())
+                        return false;
+                    block.nameId = _nameIds[static_cast<size_t>(block.nameId)];
+
+                    char buffer[MAX_COMPACT_BLOCK_SIZE];
+                    const uint16_t size = encodeCompactBlock(buffer, block, 0);
+                    _output.append(reinterpret_cast<const char*>(&size), sizeof(size));
+                    _output.append(buffer, size);
+                    _data = block_data + sz;
+                    continue;
+                }
+            }
+            else if (_version >= EASY_V_220 && sz == sizeof(profiler::BaseBlockData) + sizeof(uint32_t))
+            {
+                profiler::block_id_t id = 0;
+                memcpy(&id, block_data + sizeof(profiler::timestamp_t) * 2, sizeof(id));
+                if ((id & profiler::INTERNED_NAME_FLAG) != 0)
+                {
+                    uint32_t name_index = 0;
+                    memcpy(&name_index, block_data + sizeof(profiler::BaseBlockData), sizeof(name_index));
+                    if (name_index >= _nameIds.size())
+                        return false;
+
+                    _output.append(_data, sizeof(sz) + sizeof(profiler::BaseBlockData));
+                    _output.append(reinterpret_cast<const char*>(&_nameIds[name_index]), sizeof(uint32_t));
+                    _data = block_data + sz;
+                    continue;
+                }
+            }
+
+            copy(sizeof(sz) + sz);
+        }
+    }
+
+    return _data == _end;
+}
+
+namespace profiler {
+
+    StreamedCapture::StreamedCapture() : m_maxSize(0)
+    {
+        clear();
+    }
+
+    bool StreamedCapture::append(const char* _data, uint64_t _size, std::ostream& _log)
+    {
+        const char* const end = _data + _size;
+
+        EasyFileHeader header;
+        if (!readFromBuffer(_data, end, header.signature) || header.signature != EASY_PROFILER_SIGNATURE)
+        {
+            _log << "Wrong signature " << header.signature << ".\nThis is not EasyProfiler stream.";
+            return false;
+        }
+
+        readFromBuffer(_data, end, header.version);
+        if (header.version < EASY_V_210 || (m_partsCount != 0 && header.version != m_version))
+        {
+            _log << "Incompatible stream part version: v"
+                 << (header.version >> 24) << "." << ((header.version & 0x00ff0000) >> 16) << "."
+                 << (header.version & 0x0000ffff);
+            return false;
+        }
+
+        if (!readFromBuffer(_data, end, header.pid) || !readFromBuffer(_data, end, header.cpu_frequency) ||
+            !readFromBuffer(_data, end, header.begin_time) || !readFromBuffer(_data, end, header.end_time) ||
+            !readFromBuffer(_data, end, header.memory_size) || !readFromBuffer(_data, end, header.descriptors_memory_size) ||
+            !readFromBuffer(_data, end, header.blocks_count) || !readFromBuffer(_data, end, header.descriptors_count) ||
+            !readFromBuffer(_data, end, header.threads_count) || !readFromBuffer(_data, end, header.bookmarks_count) ||
+            !readFromBuffer(_data, end, header.clock_source) ||
+            (header.version >= EASY_V_250 && !readFromBuffer(_data, end, header.block_overhead)))
+        {
+            _log << "Stream part header is too short.\nStream corrupted.";
+            return false;
+        }
+
+        // Find the end of descriptors section
+        const char* const descriptors = _data;
+        for (uint32_t i = 0; i < header.descriptors_count; ++i)
+        {
+            uint16_t sz = 0;
+            if (!readFromBuffer(_data, end, sz) || static_cast<uint64_t>(end - _data) < sz)
+            {
+                _log << "Bad descriptors section.\nStream corrupted.";
+                return false;
+            }
+            _data += sz;
+        }
+
+        const char* const descriptorsEnd = _data;
+
+        // Run-time names table follows descriptors. Ids of the part names in the joined table are
+        // assigned here, new names are added into the joined table only if the whole part is valid.
+        std::vector<uint32_t> nameIds;
+        std::vector<std::string> newNames;
+        if (header.version >= EASY_V_220)
+        {
+            uint32_t names_count = 0;
+            uint64_t names_memory_size = 0;
+            if (!readFromBuffer(_data, end, names_count) || !readFromBuffer(_data, end, names_memory_size))
+            {
+                _log << "Bad run-time names table.\nStream corrupted.";
+                return false;
+            }
+
+            nameIds.reserve(names_count);
+            for (uint32_t i = 0; i < names_count; ++i)
+            {
+                uint16_t sz = 0;
+                if (!readFromBuffer(_data, end, sz) || sz == 0 || static_cast<uint64_t>(end - _data) < sz)
+                {
+                    _log << "Bad run-time names table.\nStream corrupted.";
+                    return false;
+                }
+
+                std::string name(_data, sz);
+                _data += sz;
+
+                const auto it = m_nameIds.find(name);
+                if (it != m_nameIds.end())
+                {
+                    nameIds.push_back(it->second);
+                }
+                else
+                {
+                    nameIds.push_back(static_cast<uint32_t>(m_nameIds.size() + newNames.size()));
+                    newNames.push_back(std::move(name));
+                }
+            }
+        }
+
+        // Threads section is followed by the end mark
+        uint32_t marker = 0;
+        const char* mark = end - sizeof(marker);
+        if (mark < _data || !readFromBuffer(mark, end, marker) || marker != EASY_PROFILER_SIGNATURE)
+        {
+            _log << "Bad threads section end mark.\nStream corrupted.";
+            return false;
+        }
+
+        std::string threads;
+        if (!joinThreads(_data, end - sizeof(marker), header.threads_count, header.version, nameIds, threads))
+        {
+            _log << "Bad threads section.\nStream corrupted.";
+            return false;
+        }
+
+        for (auto& name : newNames)
+        {
+            const auto sz = static_cast<uint16_t>(name.size());
+            m_names.append(reinterpret_cast<const char*>(&sz), sizeof(sz));
+            m_names += name;
+            m_namesMemorySize += sz;
+
+            const auto id = static_cast<uint32_t>(m_nameIds.size());
+            m_nameIds.emplace(std::move(name), id);
+        }
+
+        if (m_partsCount == 0)
+        {
+            m_version = header.version;
+            m_pid = header.pid;
+            m_beginTime = header.begin_time;
+            m_clockSource = header.clock_source;
+        }
+
+        m_cpuFrequency = header.cpu_frequency;
+        m_blockOverhead = header.block_overhead;
+        m_endTime = header.end_time;
+
+        if (header.descriptors_count >= m_descriptorsCount)
+        {
+            m_descriptors.assign(descriptors, static_cast<size_t>(descriptorsEnd - descriptors));
+            m_descriptorsCount = header.descriptors_count;
+            m_descriptorsMemorySize = header.descriptors_memory_size;
+        }
+
+        m_threadsSize += threads.size();
+        m_memorySize += header.memory_size;
+        m_blocksCount += header.blocks_count;
+        m_threadsCount += header.threads_count;
+        ++m_partsCount;
+
+        Part part;
+        part.threads.swap(threads);
+        part.endTime = header.end_time;
+        part.memorySize = header.memory_size;
+        part.blocksCount = header.blocks_count;
+        part.threadsCount = header.threads_count;
+        m_parts.push_back(std::move(part));
+
+        while (m_maxSize != 0 && m_threadsSize > m_maxSize && m_parts.size() > 1)
+        {
+            const auto& oldest = m_parts.front();
+            m_beginTime = oldest.endTime;
+            m_threadsSize -= oldest.threads.size();
+            m_memorySize -= oldest.memorySize;
+            m_blocksCount -= oldest.blocksCount;
+            m_threadsCount -= oldest.threadsCount;
+            ++m_droppedPartsCount;
+            m_parts.pop_front();
+        }
+
+        return true;
+    }
+
+    void StreamedCapture::write(std::ostream& _outputStream) const
+    {
+        if (empty())
+            return;
+
+        ::write(_outputStream, EASY_PROFILER_SIGNATURE);
+        ::write(_outputStream, m_version);
+        ::write(_outputStream, m_pid);
+        ::write(_outputStream, m_cpuFrequency);
+        ::write(_outputStream, m_beginTime);
+        ::write(_outputStream, m_endTime);
+        ::write(_outputStream, m_memorySize);
+        ::write(_outputStream, m_descriptorsMemorySize);
+        ::write(_outputStream, m_blocksCount);
+        ::write(_outputStream, m_descriptorsCount);
+        ::write(_outputStream, m_threadsCount);
+        ::write(_outputStream, static_cast<uint16_t>(0)); // Bookmarks count
+        ::write(_outputStream, m_clockSource);
+        if (m_version >= EASY_V_250)
+            ::write(_outputStream, m_blockOverhead);
+
+        _outputStream.write(m_descriptors.data(), m_descriptors.size());
+
+        if (m_version >= EASY_V_220)
+        {
+            ::write(_outputStream, static_cast<uint32_t>(m_nameIds.size()));
+            ::write(_outputStream, m_namesMemorySize);
+            _outputStream.write(m_names.data(), m_names.size());
+        }
+
+        for (const auto& part : m_parts)
+            _outputStream.write(part.threads.data(), part.threads.size());
+
+        // End of threads section
+        ::write(_outputStream, EASY_PROFILER_SIGNATURE);
+    }
+
+    bool StreamedCapture::empty() const
+    {
+        return m_partsCount == 0 || m_threadsCount == 0;
+    }
+
+    void StreamedCapture::setMaxSize(uint64_t _size)
+    {
+        m_maxSize = _size;
+    }
+
+    uint32_t StreamedCapture::parts() const
+    {
+        return m_partsCount;
+    }
+
+    uint32_t StreamedCapture::droppedParts() const
+    {
+        return m_droppedPartsCount;
+    }
+
+    void StreamedCapture::clear()
+    {
+        m_descriptors.clear();
+        m_names.clear();
+        m_parts.clear();
+        m_nameIds.clear();
+        m_pid = 0;
+        m_cpuFrequency = 0;
+        m_blockOverhead = 0;
+        m_beginTime = 0;
+        m_endTime = 0;
+        m_memorySize = 0;
+        m_descriptorsMemorySize = 0;
+        m_namesMemorySize = 0;
+        m_threadsSize = 0;
+        m_version = 0;
+        m_blocksCount = 0;
+        m_descriptorsCount = 0;
+        m_threadsCount = 0;
+        m_partsCount = 0;
+        m_droppedPartsCount = 0;
+        m_clockSource = 0;
+    }
+
+} // end of namespace profiler.
+
+//////////////////////////////////////////////////////////////////////////
+
 extern "C" PROFILER_API profiler::block_index_t fillTreesFromFile(std::atomic<int>& progress, const char* filename,
                                                                   profiler::BeginEndTime& begin_end_time,
                                                                   profiler::SerializedData& serialized_blocks,
@@ -558,6 +1097,7 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromFile(std::atomic<in
                                                                   uint32_t& version,
                                                                   profiler::processid_t& pid,
                                                                   bool gather_statistics,
+                                                                  bool compensate_overhead,
                                                                   std::ostream& _log)
 {
     if (!update_progress(progress, 0, _log))
@@ -575,7 +1115,7 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromFile(std::atomic<in
     // Read data from file
     auto result = fillTreesFromStream(progress, inFile, begin_end_time, serialized_blocks, serialized_descriptors,
                                       descriptors, blocks, threaded_trees, bookmarks, descriptors_count, version, pid,
-                                      gather_statistics, _log);
+                                      gather_statistics, compensate_overhead, _log);
 
     return result;
 }
@@ -594,6 +1134,7 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
                                                                     uint32_t& version,
                                                                     profiler::processid_t& pid,
                                                                     bool gather_statistics,
+                                                                    bool compensate_overhead,
                                                                     std::ostream& _log)
 {
     EASY_FUNCTION(profiler::colors::Cyan);
@@ -650,9 +1191,9 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
     auto end_time = header.end_time;
 
     const auto memory_size = header.memory_size;
-    const auto descriptors_memory_size = header.descriptors_memory_size;
     const auto total_blocks_count = header.blocks_count;
     descriptors_count = header.descriptors_count;
+    const auto descriptors_memory_size = header.descriptors_memory_size + descriptors_memory_growth(version, descriptors_count);
 
     if (cpu_frequency != 0)
     {
@@ -685,7 +1226,7 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
         //}
 
         char* data = serialized_descriptors[i];
-        read(inStream, data, sz);
+        sz = read_descriptor(inStream, data, sz, version);
         auto descriptor = reinterpret_cast<profiler::SerializedBlockDescriptor*>(data);
         descriptors.push_back(descriptor);
 
@@ -696,10 +1237,54 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
         }
     }
 
+    // Read run-time names table
+    std::vector<char> runtime_names;
+    std::vector<uint64_t> runtime_name_offsets;
+    std::vector<profiler::block_id_t> runtime_name_ids; // Generated block ids for each run-time name
+    EASY_CONSTEXPR auto NoId = std::numeric_limits<profiler::block_id_t>::max();
+    if (version >= EASY_V_220)
+    {
+        uint32_t names_count = 0;
+        uint64_t names_memory_size = 0;
+        read(inStream, names_count);
+        read(inStream, names_memory_size);
+
+        runtime_names.resize(static_cast<size_t>(names_memory_size));
+        runtime_name_offsets.reserve(names_count + 1);
+        runtime_name_ids.assign(names_count, NoId);
+
+        uint64_t offset = 0;
+        while (!inStream.eof() && runtime_name_offsets.size() < names_count)
+        {
+            uint16_t sz = 0;
+            read(inStream, sz);
+            if (sz == 0 || offset + sz > names_memory_size)
+            {
+                _log << "Bad run-time names table.\nFile corrupted.";
+                return 0;
+            }
+
+            read(inStream, runtime_names.data() + offset, sz);
+            runtime_name_offsets.push_back(offset);
+            offset += sz;
+        }
+
+        runtime_name_offsets.push_back(offset);
+    }
+
     using PerThreadStats = std::unordered_map<profiler::thread_id_t, StatsMap, estd::hash<profiler::thread_id_t> >;
     PerThreadStats parent_statistics, frame_statistics;
+
+    // Numbers of calls dropped by sampling in stored frames (since v2.6.0)
+    struct DroppedCalls { profiler::block_index_t frame; profiler::block_id_t id; profiler::calls_number_t number; };
+    using PerThreadDroppedCalls = std::unordered_map<profiler::thread_id_t, std::vector<DroppedCalls>, estd::hash<profiler::thread_id_t> >;
+    PerThreadDroppedCalls frame_dropped_calls;
     IdMap identification_table;
 
+    // Block overhead is known only for captures since v2.5.0
+    const double block_overhead = compensate_overhead ? static_cast<double>(header.block_overhead) * conversion_factor : 0.;
+    std::vector<uint32_t> nested_blocks; // Number of nested blocks for each block (used only for overhead compensation)
+
     blocks.reserve(total_blocks_count);
     //olddata = append_regime ? serialized_blocks.data() : nullptr;
     serialized_blocks.set(memory_size);
@@ -708,7 +1293,9 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
     i = 0;
     uint32_t read_number = 0, threads_read_number = 0;
     profiler::block_index_t blocks_counter = 0;
+    uint32_t dropped_counters = 0, counters_records = 0, allocations_records = 0, flows_records = 0;
     std::vector<char> name;
+    std::vector<char> compact_block(MAX_COMPACT_BLOCK_SIZE);
 
     while (!inStream.eof() && threads_read_number++ < header.threads_count)
     {
@@ -809,6 +1396,8 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
             break;
 
         StatsMap per_thread_statistics;
+        profiler::timestamp_t previous_begin = 0; // Base for decoding compact blocks begin time
+        profiler::block_index_t counted_block = NoId; // Block which performance counters and allocations are stored right after it
 
         blocks_number_in_thread = 0;
         read(inStream, blocks_number_in_thread);
@@ -827,16 +1416,241 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
                 return 0;
             }
 
-            if (i + sz > memory_size)
+            char* data = serialized_blocks[i];
+            auto baseData = reinterpret_cast<profiler::SerializedBlock*>(data);
+            uint32_t name_index = NoId;
+
+            if (version >= EASY_V_230)
             {
-                _log << "File corrupted.\nActual blocks data size > size pointed in file.";
-                return 0;
+                if (compact_block.size() < sz)
+                    compact_block.resize(sz);
+                read(inStream, compact_block.data(), sz);
+
+                const auto tag = static_cast<uint8_t>(compact_block[0]);
+                if (tag & COMPACT_COUNTERS)
+                {
+                    // Performance counters of the previous block
+                    profiler::PerfCounters counters;
+                    if (!decodeCompactCounters(compact_block.data(), compact_block.data() + sz, counters))
+                    {
+                        _log << "Bad performance counters.\nFile corrupted.";
+                        return 0;
+                    }
+
+                    ++counters_records;
+                    if (counted_block != NoId && !blocks[counted_block].has_counters && !blocks[counted_block].has_allocations &&
+                        i + sizeof(profiler::PerfCounters) <= memory_size)
+                    {
+                        memcpy(data, &counters, sizeof(profiler::PerfCounters));
+                        i += sizeof(profiler::PerfCounters);
+
+                        auto& tree = blocks[counted_block];
+                        tree.has_counters = true;
+                        if (tree.per_thread_stats != nullptr)
+                            tree.per_thread_stats->add_counters(counters);
+                    }
+
+                    continue; // allocations of the same block may follow
+                }
+
+                if (tag & COMPACT_ALLOCATIONS)
+                {
+                    if (version < EASY_V_280)
+                    {
+                        _log << "Unexpected allocations record in file of version < 2.8.0.\nFile corrupted.";
+                        return 0;
+                    }
+
+                    // Allocations of the previous block (stored after it's performance counters if any)
+                    profiler::Allocations allocations;
+                    if (!decodeCompactAllocations(compact_block.data(), compact_block.data() + sz, allocations))
+                    {
+                        _log << "Bad allocations.\nFile corrupted.";
+                        return 0;
+                    }
+
+                    ++allocations_records;
+                    if (counted_block != NoId && !blocks[counted_block].has_allocations &&
+                        i + sizeof(profiler::Allocations) <= memory_size)
+                    {
+                        memcpy(data, &allocations, sizeof(profiler::Allocations));
+                        i += sizeof(profiler::Allocations);
+
+                        auto& tree = blocks[counted_block];
+                        tree.has_allocations = true;
+                        if (tree.per_thread_stats != nullptr)
+                            tree.per_thread_stats->add_allocations(allocations);
+                    }
+
+                    counted_block = NoId;
+                    continue;
+                }
+
+                counted_block = NoId;
+                if ((tag & COMPACT_FLOW) == COMPACT_FLOW)
+                {
+                    if (version < EASY_V_290)
+                    {
+                        _log << "Unexpected flow point record in file of version < 2.9.0.\nFile corrupted.";
+                        return 0;
+                    }
+
+                    // Flow point belongs to a block which has not been read yet, it is found by time after reading all blocks
+                    profiler::FlowPoint point;
+                    if (!decodeCompactFlow(compact_block.data(), compact_block.data() + sz, point.type, point.id, point.time))
+                    {
+                        _log << "Bad flow point.\nFile corrupted.";
+                        return 0;
+                    }
+
+                    ++flows_records;
+                    if (cpu_frequency != 0)
+                    {
+                        EASY_CONVERT_TO_NANO(point.time, cpu_frequency, conversion_factor);
+                    }
+
+                    if (point.time >= begin_time)
+                    {
+                        point.block = ~0U;
+                        root.flows.push_back(point);
+                    }
+
+                    continue;
+                }
+
+                if (tag & COMPACT_DROPPED)
+                {
+                    // Number of calls dropped by sampling during the last frame
+                    const char* counter = compact_block.data() + 1;
+                    uint64_t id = 0, number = 0;
+                    if (!readVarint(counter, compact_block.data() + sz, id) || !readVarint(counter, compact_block.data() + sz, number) ||
+                        id >= descriptors.size())
+                    {
+                        _log << "Bad dropped calls counter.\nFile corrupted.";
+                        return 0;
+                    }
+
+                    ++dropped_counters;
+                    if (gather_statistics)
+                    {
+                        // Run-time named blocks have generated ids, so only blocks without run-time name are matched here
+                        const auto it = per_thread_statistics.find(static_cast<profiler::block_id_t>(id));
+                        if (it != per_thread_statistics.end())
+                            it->second->dropped_number += static_cast<profiler::calls_number_t>(number);
+
+                        if ((tag & COMPACT_FRAME) != 0 && !root.children.empty())
+                        {
+                            frame_dropped_calls[thread_id].push_back(DroppedCalls {
+                                root.children.back(), static_cast<profiler::block_id_t>(id), static_cast<profiler::calls_number_t>(number)
+                            });
+                        }
+                    }
+
+                    continue;
+                }
+
+                if ((tag & COMPACT_BLOCK) == 0)
+                {
+                    // Arbitrary value is stored as is right after the tag
+                    if (i + sz - 1 > memory_size || sz <= sizeof(profiler::ArbitraryValue))
+                    {
+                        _log << "File corrupted.\nActual blocks data size > size pointed in file.";
+                        return 0;
+                    }
+
+                    memcpy(data, compact_block.data() + 1, sz - 1u);
+                    i += sz - 1;
+                }
+                else
+                {
+                    CompactBlock block;
+                    if (!decodeCompactBlock(compact_block.data(), compact_block.data() + sz, previous_begin, block))
+                    {
+                        _log << "Bad compact block.\nFile corrupted.";
+                        return 0;
+                    }
+
+                    previous_begin = block.begin;
+
+                    const char* name = nullptr;
+                    uint64_t name_size = 1;
+                    if (tag & COMPACT_INTERNED_NAME)
+                    {
+                        if (block.nameId >= runtime_name_ids.size())
+                        {
+                            _log << "Bad run-time name index == " << block.nameId << ".\nFile corrupted.";
+                            return 0;
+                        }
+
+                        name_index = static_cast<uint32_t>(block.nameId);
+                        name = runtime_names.data() + runtime_name_offsets[name_index];
+                        name_size = runtime_name_offsets[name_index + 1] - runtime_name_offsets[name_index];
+                    }
+                    else if (tag & COMPACT_INLINE_NAME)
+                    {
+                        name = block.name;
+                        name_size = block.nameLength + 1;
+                    }
+
+                    if (i + sizeof(profiler::BaseBlockData) + name_size > memory_size)
+                    {
+                        _log << "File corrupted.\nActual blocks data size > size pointed in file.";
+                        return 0;
+                    }
+
+                    ::new (data) profiler::BaseBlockData(block.begin, block.end, block.id);
+                    if (name != nullptr)
+                        memcpy(data + sizeof(profiler::BaseBlockData), name, static_cast<size_t>(name_size));
+                    else
+                        data[sizeof(profiler::BaseBlockData)] = 0;
+                    i += sizeof(profiler::BaseBlockData) + name_size;
+                }
+            }
+            else
+            {
+                if (i + sizeof(profiler::BaseBlockData) > memory_size || sz < sizeof(profiler::BaseBlockData))
+                {
+                    _log << "File corrupted.\nActual blocks data size > size pointed in file.";
+                    return 0;
+                }
+
+                read(inStream, data, sizeof(profiler::BaseBlockData));
+
+                if (version >= EASY_V_220 && (baseData->id() & profiler::INTERNED_NAME_FLAG) != 0)
+                {
+                    // Block has interned run-time name: expand the name from the names table
+                    read(inStream, name_index);
+                    if (sz != sizeof(profiler::BaseBlockData) + sizeof(name_index) || name_index >= runtime_name_ids.size())
+                    {
+                        _log << "Bad run-time name index == " << name_index << ".\nFile corrupted.";
+                        return 0;
+                    }
+
+                    const auto name_offset = runtime_name_offsets[name_index];
+                    const auto name_size = runtime_name_offsets[name_index + 1] - name_offset;
+                    if (i + sizeof(profiler::BaseBlockData) + name_size > memory_size)
+                    {
+                        _log << "File corrupted.\nActual blocks data size > size pointed in file.";
+                        return 0;
+                    }
+
+                    memcpy(data + sizeof(profiler::BaseBlockData), runtime_names.data() + name_offset, static_cast<size_t>(name_size));
+                    baseData->setId(baseData->id() & ~profiler::INTERNED_NAME_FLAG);
+                    i += sizeof(profiler::BaseBlockData) + name_size;
+                }
+                else
+                {
+                    if (i + sz > memory_size)
+                    {
+                        _log << "File corrupted.\nActual blocks data size > size pointed in file.";
+                        return 0;
+                    }
+
+                    read(inStream, data + sizeof(profiler::BaseBlockData), sz - sizeof(profiler::BaseBlockData));
+                    i += sz;
+                }
             }
 
-            char* data = serialized_blocks[i];
-            read(inStream, data, sz);
-            i += sz;
-            auto baseData = reinterpret_cast<profiler::SerializedBlock*>(data);
             if (baseData->id() >= descriptors_count)
             {
                 _log << "Bad block id == " << baseData->id();
@@ -868,29 +1682,19 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
                 profiler::BlocksTree& tree = blocks.back();
                 tree.node = baseData;
                 const auto block_index = blocks_counter++;
+                counted_block = block_index;
 
-                if (*tree.node->name() != 0)
+                if (name_index != NoId)
                 {
-                    // If block has runtime name then generate new id for such block.
-                    // Blocks with the same name will have same id.
-
-                    IdMap::key_type key(tree.node->name());
-                    auto it = identification_table.find(key);
-                    if (it != identification_table.end())
-                    {
-                        // There is already block with such name, use it's id
-                        baseData->setId(it->second);
-                    }
-                    else
-                    {
-                        // There were no blocks with such name, generate new id and save it in the table for further usage.
-                        auto id = static_cast<profiler::block_id_t>(descriptors.size());
-                        identification_table.emplace(key, id);
-                        if (descriptors.capacity() == descriptors.size())
-                            descriptors.reserve((descriptors.size() * 3) >> 1);
-                        descriptors.push_back(descriptors[baseData->id()]);
-                        baseData->setId(id);
-                    }
+                    // Interned run-time name: id is generated once per name, no need to hash the name for each block
+                    auto& id = runtime_name_ids[name_index];
+                    if (id == NoId)
+                        id = generateId(identification_table, descriptors, *baseData);
+                    baseData->setId(id);
+                }
+                else if (*tree.node->name() != 0)
+                {
+                    baseData->setId(generateId(identification_table, descriptors, *baseData));
                 }
 
                 if (!root.children.empty())
@@ -911,6 +1715,13 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
                         root.children.erase(lower, root.children.end());
                         EASY_END_BLOCK;
 
+                        if (block_overhead > 0)
+                        {
+                            EASY_BLOCK("Compensate overhead", profiler::colors::Orange);
+                            nested_blocks.resize(blocks.size());
+                            compensate_overhead_of_children(blocks, block_index, nested_blocks, block_overhead);
+                        }
+
                         if (gather_statistics)
                         {
                             EASY_BLOCK("Gather statistic within parent", profiler::colors::Magenta);
@@ -974,14 +1785,22 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
         }
     }
 
-    if (total_blocks_count != blocks_counter)
+    const auto records_count = blocks_counter + dropped_counters + counters_records + allocations_records + flows_records;
+    if (total_blocks_count != records_count)
     {
-        _log << "Read blocks count: " << blocks_counter
+        _log << "Read blocks count: " << records_count
              << "\ndoes not match blocks count\nstored in header: " << total_blocks_count
              << ".\nFile corrupted.";
         return 0;
     }
 
+    for (auto& it : threaded_trees)
+    {
+        auto& root = it.second;
+        for (auto& point : root.flows)
+            point.block = find_enclosing_block(root.children, blocks, descriptors, point.time);
+    }
+
     if (!inStream.eof() && version >= EASY_V_210)
     {
         if (!tryReadMarker(inStream))
@@ -1074,6 +1893,7 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
 
             auto& per_frame_statistics = frame_statistics[root.thread_id];
             auto& per_parent_statistics = parent_statistics[it.first];
+            auto& dropped_calls = frame_dropped_calls[it.first];
             per_parent_statistics.clear();
 
             statistics_threads.emplace_back(std::thread([&] (profiler::BlocksTreeRoot& _root)
@@ -1084,6 +1904,7 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
                 //});
 
                 profiler::block_index_t cs_index = 0;
+                size_t dropped_index = 0;
                 for (auto child_index : _root.children)
                 {
                     auto& frame = blocks[child_index];
@@ -1096,6 +1917,15 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
                     per_frame_statistics.clear();
                     update_statistics_recursive(per_frame_statistics, frame, child_index, child_index, blocks);
 
+                    // Frames indices are increasing, frame could be missed only if it has become a child of another block
+                    for (; dropped_index < dropped_calls.size() && dropped_calls[dropped_index].frame <= child_index; ++dropped_index)
+                    {
+                        const auto& dropped = dropped_calls[dropped_index];
+                        const auto stats = dropped.frame == child_index ? per_frame_statistics.find(dropped.id) : per_frame_statistics.end();
+                        if (stats != per_frame_statistics.end())
+                            stats->second->dropped_number += dropped.number;
+                    }
+
                     if (cs_index < _root.sync.size())
                     {
                         CsStatsMap frame_stats_cs;
@@ -1169,6 +1999,109 @@ extern "C" PROFILER_API profiler::block_index_t fillTreesFromStream(std::atomic<
 
 //////////////////////////////////////////////////////////////////////////
 
+extern "C" PROFILER_API void fillFlows(const profiler::thread_blocks_tree_t& threaded_trees, profiler::flows_t& flows)
+{
+    struct ThreadFlowPoint
+    {
+        const profiler::FlowPoint* point;
+        profiler::thread_id_t     thread;
+    };
+
+    std::vector<ThreadFlowPoint> points;
+    for (const auto& it : threaded_trees)
+    {
+        for (const auto& point : it.second.flows)
+            points.push_back(ThreadFlowPoint {&point, it.first});
+    }
+
+    // Begin point goes first if both points of a flow have the same time
+    std::sort(points.begin(), points.end(), [](const ThreadFlowPoint& _left, const ThreadFlowPoint& _right)
+    {
+        if (_left.point->id != _right.point->id)
+            return _left.point->id < _right.point->id;
+        if (_left.point->time != _right.point->time)
+            return _left.point->time < _right.point->time;
+        return _left.point->type < _right.point->type;
+    });
+
+    flows.clear();
+    bool opened = false; // True if the last flow has begin point only
+    for (const auto& p : points)
+    {
+        const auto& point = *p.point;
+        if (!opened || flows.back().id != point.id || point.type == profiler::FlowPointType::Begin)
+        {
+            flows.emplace_back();
+            flows.back().id = point.id;
+        }
+
+        auto& flow = flows.back();
+        if (point.type == profiler::FlowPointType::Begin)
+        {
+            flow.begin_thread = p.thread;
+            flow.begin_block = point.block;
+            flow.begin_time = point.time;
+            opened = true;
+        }
+        else
+        {
+            flow.end_thread = p.thread;
+            flow.end_block = point.block;
+            flow.end_time = point.time;
+            opened = false;
+        }
+    }
+}
+
+extern "C" PROFILER_API void fillFlowStatistics(const profiler::flows_t& flows, const profiler::blocks_t& blocks,
+                                                profiler::flow_statistics_t& statistics)
+{
+    const auto blockId = [&blocks](profiler::block_index_t _index)
+    {
+        return _index < blocks.size() ? blocks[_index].node->id() : ~0U;
+    };
+
+    std::map<std::pair<profiler::block_id_t, profiler::block_id_t>, std::vector<profiler::timestamp_t> > latencies;
+    for (const auto& flow : flows)
+    {
+        if (flow.complete())
+            latencies[std::make_pair(blockId(flow.begin_block), blockId(flow.end_block))].push_back(flow.latency());
+    }
+
+    statistics.clear();
+    statistics.reserve(latencies.size());
+    for (auto& it : latencies)
+    {
+        auto& values = it.second;
+        std::sort(values.begin(), values.end());
+
+        // Nearest-rank percentile
+        const auto percentile = [&values](uint32_t _percent)
+        {
+            const auto rank = (values.size() * _percent + 99) / 100;
+            return values[rank != 0 ? rank - 1 : 0];
+        };
+
+        profiler::timestamp_t total = 0;
+        for (auto value : values)
+            total += value;
+
+        profiler::FlowStatistics stats;
+        stats.begin_id = it.first.first;
+        stats.end_id = it.first.second;
+        stats.flows_number = static_cast<uint32_t>(values.size());
+        stats.min_latency = values.front();
+        stats.max_latency = values.back();
+        stats.average_latency = total / values.size();
+        stats.median_latency = percentile(50);
+        stats.p90_latency = percentile(90);
+        stats.p99_latency = percentile(99);
+        statistics.push_back(stats);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 extern "C" PROFILER_API bool readDescriptionsFromStream(std::atomic<int>& progress, std::istream& inStream,
                                                         profiler::SerializedData& serialized_descriptors,
                                                         profiler::descriptors_list_t& descriptors,
@@ -1211,6 +2144,8 @@ extern "C" PROFILER_API bool readDescriptionsFromStream(std::atomic<int>& progre
         return false;
     }
 
+    descriptors_memory_size += descriptors_memory_growth(version, descriptors_count);
+
     descriptors.reserve(descriptors_count);
     //const char* olddata = append_regime ? serialized_descriptors.data() : nullptr;
     serialized_descriptors.set(descriptors_memory_size);
@@ -1228,7 +2163,7 @@ extern "C" PROFILER_API bool readDescriptionsFromStream(std::atomic<int>& progre
             return false;
         }
 
-        if (i + sz > descriptors_memory_size)
+        if (i + sz + descriptors_memory_growth(version, 1) > descriptors_memory_size)
         {
             _log << "Exceeded memory size.\npos: " << i << "\nsize: " << sz
                  << "\nnext pos: " << i + sz
@@ -1238,7 +2173,7 @@ extern "C" PROFILER_API bool readDescriptionsFromStream(std::atomic<int>& progre
         }
 
         char* data = serialized_descriptors[i];
-        read(inStream, data, sz);
+        sz = read_descriptor(inStream, data, sz, version);
         auto descriptor = reinterpret_cast<profiler::SerializedBlockDescriptor*>(data);
         descriptors.push_back(descriptor);
 
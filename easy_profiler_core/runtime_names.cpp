@@ -0,0 +1,150 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#include <string.h>
+#include <utility>
+#include "runtime_names.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+static uint64_t hashString(const char* _str, uint16_t _length)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint16_t i = 0; i < _length; ++i)
+    {
+        hash ^= static_cast<unsigned char>(_str[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+RuntimeNames::RuntimeNames() : m_memorySize(0)
+{
+
+}
+
+bool RuntimeNames::find(const char* _name, uint16_t _length, uint32_t& _id) const
+{
+    if (m_table.empty())
+        return false;
+
+    const auto index = m_table[slot(_name, _length, hashString(_name, _length))];
+    if (index == 0)
+        return false;
+
+    _id = index - 1;
+    return true;
+}
+
+uint32_t RuntimeNames::intern(const char* _name, uint16_t _length)
+{
+    if (m_table.empty())
+        rehash(64);
+
+    const auto hash = hashString(_name, _length);
+    const auto i = slot(_name, _length, hash);
+    if (m_table[i] != 0)
+        return m_table[i] - 1;
+
+    const auto id = static_cast<uint32_t>(m_names.size());
+    m_names.emplace_back(_name, _length);
+    m_hashes.push_back(hash);
+    m_memorySize += _length + 1;
+    m_table[i] = id + 1;
+
+    // Keep load factor not greater than 0.5
+    if (m_names.size() * 2 > m_table.size())
+        rehash(m_table.size() * 2);
+
+    return id;
+}
+
+void RuntimeNames::clear()
+{
+    m_names.clear();
+    m_hashes.clear();
+    m_table.assign(m_table.size(), 0);
+    m_memorySize = 0;
+}
+
+void RuntimeNames::swap(RuntimeNames& _another)
+{
+    m_names.swap(_another.m_names);
+    m_hashes.swap(_another.m_hashes);
+    m_table.swap(_another.m_table);
+    std::swap(m_memorySize, _another.m_memorySize);
+}
+
+size_t RuntimeNames::slot(const char* _name, uint16_t _length, uint64_t _hash) const
+{
+    // Linear probing: returns slot of the name or the first empty slot
+    const auto mask = m_table.size() - 1;
+
+    auto i = static_cast<size_t>(_hash) & mask;
+    for (; m_table[i] != 0; i = (i + 1) & mask)
+    {
+        const auto id = m_table[i] - 1;
+        const auto& name = m_names[id];
+        if (m_hashes[id] == _hash && name.size() == _length && memcmp(name.data(), _name, _length) == 0)
+            break;
+    }
+
+    return i;
+}
+
+void RuntimeNames::rehash(size_t _tableSize)
+{
+    m_table.assign(_tableSize, 0);
+
+    const auto mask = _tableSize - 1;
+    for (uint32_t id = 0, size = static_cast<uint32_t>(m_names.size()); id < size; ++id)
+    {
+        auto slot = static_cast<size_t>(m_hashes[id]) & mask;
+        while (m_table[slot] != 0)
+            slot = (slot + 1) & mask;
+        m_table[slot] = id + 1;
+    }
+}
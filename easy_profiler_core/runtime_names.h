@@ -0,0 +1,121 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+    * MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is furnished
+    to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+    INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+    PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+    LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+    USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+    You may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_RUNTIME_NAMES_H
+#define EASY_PROFILER_RUNTIME_NAMES_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <easy/details/easy_compiler_support.h>
+
+/** Table of interned run-time block names.
+
+Each distinct name is stored only once and is referenced by its index.
+Indices are never changed or reused until clear(), so blocks may store a 4-byte index instead of a copy of the name.
+
+Lookup does not allocate memory: the table is an open-addressing hash-table of indices
+into the array of stored names.
+
+\note The table is not thread-safe.
+*/
+class RuntimeNames EASY_FINAL
+{
+    std::vector<std::string>   m_names; ///< Interned names (index is the name id)
+    std::vector<uint64_t>     m_hashes; ///< Hashes of interned names
+    std::vector<uint32_t>      m_table; ///< Hash-table of (name id + 1), 0 means empty slot
+    uint64_t              m_memorySize; ///< Summary size of all names including trailing '\0'
+
+public:
+
+    RuntimeNames(const RuntimeNames&) = delete;
+    RuntimeNames& operator = (const RuntimeNames&) = delete;
+
+    RuntimeNames();
+
+    /** Looks for the name without modifying the table.
+
+    \param _name Name to be found
+    \param _length Length of the name without trailing '\0'
+    \param _id Found name id
+
+    \retval false if there is no such name in the table. */
+    bool find(const char* _name, uint16_t _length, uint32_t& _id) const;
+
+    /** Returns id of the name adding it into the table if needed.
+
+    \param _name Name to be interned
+    \param _length Length of the name without trailing '\0' */
+    uint32_t intern(const char* _name, uint16_t _length);
+
+    /** Removes all names keeping allocated memory of the hash-table. */
+    void clear();
+
+    /** Exchanges contents of two tables. */
+    void swap(RuntimeNames& _another);
+
+    /** Returns number of interned names. */
+    uint32_t size() const
+    {
+        return static_cast<uint32_t>(m_names.size());
+    }
+
+    /** Returns summary size of all names including trailing '\0' characters. */
+    uint64_t memorySize() const
+    {
+        return m_memorySize;
+    }
+
+    /** Returns name by id. */
+    const std::string& name(uint32_t _id) const
+    {
+        return m_names[_id];
+    }
+
+private:
+
+    size_t slot(const char* _name, uint16_t _length, uint64_t _hash) const;
+    void rehash(size_t _tableSize);
+
+}; // END of class RuntimeNames.
+
+#endif // EASY_PROFILER_RUNTIME_NAMES_H
@@ -0,0 +1,182 @@
+/**
+Lightweight profiler library for c++
+Copyright(C) 2016-2018  Sergey Yagovtsev, Victor Zarubkin
+
+Licensed under either of
+	* MIT license (LICENSE.MIT or http://opensource.org/licenses/MIT)
+    * Apache License, Version 2.0, (LICENSE.APACHE or http://www.apache.org/licenses/LICENSE-2.0)
+at your option.
+
+The MIT License
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights 
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies 
+	of the Software, and to permit persons to whom the Software is furnished 
+	to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all 
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+	INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+	PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE 
+	LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+	TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE 
+	USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+The Apache License, Version 2.0 (the "License");
+	You may not use this file except in compliance with the License.
+	You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+	Unless required by applicable law or agreed to in writing, software
+	distributed under the License is distributed on an "AS IS" BASIS,
+	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	See the License for the specific language governing permissions and
+	limitations under the License.
+
+**/
+
+#ifndef EASY_PROFILER_SOCKET_OUTPUT_BUFFER_H
+#define EASY_PROFILER_SOCKET_OUTPUT_BUFFER_H
+
+#include <atomic>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+#include <string.h>
+
+#include <easy/easy_net.h>
+#include <easy/easy_socket.h>
+
+namespace profiler {
+
+    /** Output stream buffer which sends all written data over socket.
+
+    Data is accumulated in a buffer of fixed size and every time the buffer is full it's contents
+    are sent as one Reply_Blocks message. Receiver joins data of all such messages.
+    This allows to send a capture without storing it in memory entirely.
+
+    send() could be used by other thread to send separate messages while data is being written.
+    */
+    class SocketOutputBuffer EASY_FINAL : public std::streambuf
+    {
+        EasySocket&                      m_socket; ///< Connected socket
+        std::vector<char>                m_buffer; ///< Buffer with space reserved for a message header at the beginning
+        std::mutex                    m_sendMutex; ///< Prevents messages from interleaving
+        uint64_t                       m_sentSize; ///< Number of data bytes sent since last reset()
+        std::atomic_bool              m_connected; ///< false if sending has failed
+
+    public:
+
+        SocketOutputBuffer(EasySocket& _socket, size_t _capacity)
+            : m_socket(_socket)
+            , m_buffer(sizeof(profiler::net::DataMessage) + _capacity)
+            , m_sentSize(0)
+            , m_connected(true)
+        {
+            discard();
+        }
+
+        SocketOutputBuffer(const SocketOutputBuffer&) = delete;
+        SocketOutputBuffer& operator = (const SocketOutputBuffer&) = delete;
+
+        /** Prepares buffer for a new connection. */
+        void reset()
+        {
+            discard();
+            m_sentSize = 0;
+            m_connected.store(true, std::memory_order_release);
+        }
+
+        bool connected() const
+        {
+            return m_connected.load(std::memory_order_acquire);
+        }
+
+        /** Returns number of data bytes sent since last reset(). Buffered data is not counted. */
+        uint64_t sentSize() const
+        {
+            return m_sentSize;
+        }
+
+        /** Drops buffered data which has not been sent yet. */
+        void discard()
+        {
+            setp(m_buffer.data() + sizeof(profiler::net::DataMessage), m_buffer.data() + m_buffer.size());
+        }
+
+        /** Sends a separate message. Buffered data is not flushed. */
+        bool send(const void* _message, size_t _size)
+        {
+            std::lock_guard<std::mutex> lock(m_sendMutex);
+            return sendAll(static_cast<const char*>(_message), _size);
+        }
+
+    protected:
+
+        int_type overflow(int_type _ch) override
+        {
+            if (!flushBuffer())
+                return traits_type::eof();
+
+            if (!traits_type::eq_int_type(_ch, traits_type::eof()))
+            {
+                *pptr() = traits_type::to_char_type(_ch);
+                pbump(1);
+            }
+
+            return traits_type::not_eof(_ch);
+        }
+
+        int sync() override
+        {
+            return flushBuffer() ? 0 : -1;
+        }
+
+    private:
+
+        bool flushBuffer()
+        {
+            const auto size = static_cast<uint32_t>(pptr() - pbase());
+            if (size != 0 && connected())
+            {
+                const profiler::net::DataMessage dm(size, profiler::net::MessageType::Reply_Blocks);
+                memcpy(m_buffer.data(), &dm, sizeof(dm));
+
+                std::lock_guard<std::mutex> lock(m_sendMutex);
+                sendAll(m_buffer.data(), sizeof(dm) + size);
+            }
+
+            m_sentSize += size;
+            discard();
+
+            return connected();
+        }
+
+        bool sendAll(const char* _data, size_t _size)
+        {
+            while (_size != 0 && connected())
+            {
+                const int bytes = m_socket.send(_data, _size);
+                if (bytes <= 0)
+                {
+                    m_connected.store(false, std::memory_order_release);
+                    break;
+                }
+
+                _data += bytes;
+                _size -= static_cast<size_t>(bytes);
+            }
+
+            return connected();
+        }
+
+    }; // END of class SocketOutputBuffer.
+
+} // END of namespace profiler.
+
+#endif // EASY_PROFILER_SOCKET_OUTPUT_BUFFER_H
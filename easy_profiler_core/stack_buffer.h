@@ -135,6 +135,12 @@ public:
         m_overflow.pop_back();
     }
 
+    void clear()
+    {
+        while (m_size != 0 || !m_overflow.empty())
+            pop();
+    }
+
 }; // END of class StackBuffer.
 
 #endif // EASY_PROFILER_STACK_BUFFER_H
@@ -43,6 +43,17 @@ The Apache License, Version 2.0 (the "License");
 #include "thread_storage.h"
 #include "current_thread.h"
 #include "current_time.h"
+#include "compact_block.h"
+#include "crash_recovery.h"
+
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
+#if EASY_OPTION_MEASURE_STORAGE_EXPAND != 0
+# include "profile_manager.h"
+extern const profiler::color_t EASY_COLOR_INTERNAL_EVENT;
+#endif
 
 static profiler::vin_t ptr2vin(const void* ptr)
 {
@@ -55,30 +66,67 @@ static profiler::vin_t ptr2vin(const void* ptr)
     return static_cast<profiler::vin_t>(reinterpret_cast<uintptr_t>(ptr));
 }
 
-ThreadStorage::ThreadStorage()
+ThreadStorage::ThreadStorage() : ThreadStorage(getCurrentThreadId())
+{
+
+}
+
+ThreadStorage::ThreadStorage(profiler::thread_id_t _id)
     : nonscopedBlocks(16)
     , frameStartTime(0)
-    , id(getCurrentThreadId())
+    , crashRecord(nullptr)
+    , id(_id)
+    , lastBlockBegin(0)
+    , namesFirstId(0)
+    , suspendedBytes(0)
+    , suspendedAllocations(0)
+    , statisticsEpoch(0)
+    , frameHistoryIndex(0)
     , stackSize(0)
     , allowChildren(true)
+    , chained(false)
     , named(false)
     , guarded(false)
+    , logical(false)
     , frameOpened(false)
+    , spikeBlockHit(false)
 {
     expired = ATOMIC_VAR_INIT(0);
+    namesGeneration = ATOMIC_VAR_INIT(0);
+    consumedNamesGeneration = ATOMIC_VAR_INIT(0);
+
+    auto& crashRecovery = CrashRecovery::instance();
+    if (crashRecovery.isOpened())
+    {
+        crashRecord = crashRecovery.addThread(id);
+        if (crashRecord != nullptr)
+            blocks.closedList.set_persistent(&crashRecord->blocks);
+    }
 }
 
-void ThreadStorage::storeValue(profiler::timestamp_t _timestamp, profiler::block_id_t _id, profiler::DataType _type, const void* _data, uint16_t _size, bool _isArray, profiler::ValueId _vin)
+ThreadStorage::~ThreadStorage()
 {
-    const uint16_t serializedDataSize = _size + static_cast<uint16_t>(sizeof(profiler::ArbitraryValue));
-    void* data = blocks.closedList.allocate(serializedDataSize);
+    if (crashRecord != nullptr)
+        CrashRecovery::instance().removeThread(*crashRecord);
+}
 
-    ::new (data) profiler::ArbitraryValue(_timestamp, ptr2vin(_vin.m_id), _id, _size, _type, _isArray);
+void ThreadStorage::setName(const char* _name)
+{
+    named = true;
+    name = _name;
 
-    char* cdata = reinterpret_cast<char*>(data);
-    memcpy(cdata + sizeof(profiler::ArbitraryValue), _data, _size);
+    if (crashRecord != nullptr)
+        CrashRecovery::instance().setThreadName(*crashRecord, name);
+}
 
-    blocks.frameMemorySize += serializedDataSize;
+void ThreadStorage::storeValue(profiler::timestamp_t _timestamp, profiler::block_id_t _id, profiler::DataType _type, const void* _data, uint16_t _size, bool _isArray, profiler::ValueId _vin)
+{
+    const uint16_t serializedDataSize = 1 + _size + static_cast<uint16_t>(sizeof(profiler::ArbitraryValue));
+    char* data = reinterpret_cast<char*>(blocks.closedList.allocate(serializedDataSize));
+
+    *data++ = static_cast<char>(COMPACT_VALUE);
+    ::new (data) profiler::ArbitraryValue(_timestamp, ptr2vin(_vin.m_id), _id, _size, _type, _isArray);
+    memcpy(data + sizeof(profiler::ArbitraryValue), _data, _size);
 
     putMarkIfEmpty();
 }
@@ -86,33 +134,40 @@ void ThreadStorage::storeValue(profiler::timestamp_t _timestamp, profiler::block
 void ThreadStorage::storeBlock(const profiler::Block& block)
 {
 #if EASY_OPTION_MEASURE_STORAGE_EXPAND != 0
-    EASY_LOCAL_STATIC_PTR(const BaseBlockDescriptor*, desc, \
-                          MANAGER.addBlockDescriptor(EASY_OPTION_STORAGE_EXPAND_BLOCKS_ON ? profiler::ON : profiler::OFF, EASY_UNIQUE_LINE_ID, "EasyProfiler.ExpandStorage", \
+    EASY_LOCAL_STATIC_PTR(const profiler::BaseBlockDescriptor*, desc, \
+                          ProfileManager::instance().addBlockDescriptor(EASY_OPTION_STORAGE_EXPAND_BLOCKS_ON ? profiler::ON : profiler::OFF, EASY_UNIQUE_LINE_ID, "EasyProfiler.ExpandStorage", \
                                                      __FILE__, __LINE__, profiler::BlockType::Block, EASY_COLOR_INTERNAL_EVENT));
 
     EASY_THREAD_LOCAL static profiler::timestamp_t beginTime = 0ULL;
     EASY_THREAD_LOCAL static profiler::timestamp_t endTime = 0ULL;
 #endif
 
-    const uint16_t nameLength = static_cast<uint16_t>(strlen(block.name()));
+    char buffer[MAX_COMPACT_BLOCK_SIZE];
 #if EASY_OPTION_MEASURE_STORAGE_EXPAND == 0
     const 
 #endif
-    uint16_t serializedDataSize = static_cast<uint16_t>(sizeof(profiler::BaseBlockData) + nameLength + 1);
+    uint16_t serializedDataSize = encodeBlock(buffer, block, chained);
 
 #if EASY_OPTION_MEASURE_STORAGE_EXPAND != 0
-    const bool expanded = (desc->m_status & profiler::ON) && blocks.closedList.need_expand(serializedDataSize);
+    // Chunks are usually taken from ChunkPool without allocations, so only the pool growth is worth to be shown
+    bool expanded = (desc->m_status & profiler::ON) && blocks.closedList.need_expand(serializedDataSize);
+    const uint64_t poolMemory = expanded ? ChunkPool::instance().memorySize() : 0;
     if (expanded) beginTime = profiler::clock::now();
 #endif
 
     void* data = blocks.closedList.allocate(serializedDataSize);
 
 #if EASY_OPTION_MEASURE_STORAGE_EXPAND != 0
-    if (expanded) endTime = profiler::clock::now();
+    if (expanded)
+    {
+        endTime = profiler::clock::now();
+        expanded = ChunkPool::instance().memorySize() != poolMemory;
+    }
 #endif
 
-    ::new (data) profiler::SerializedBlock(block, nameLength);
-    blocks.frameMemorySize += serializedDataSize;
+    memcpy(data, buffer, serializedDataSize);
+    lastBlockBegin = block.begin();
+    chained = true;
 
 #if EASY_OPTION_MEASURE_STORAGE_EXPAND != 0
     if (expanded)
@@ -120,22 +175,122 @@ void ThreadStorage::storeBlock(const profiler::Block& block)
         profiler::Block b(beginTime, desc->id(), "");
         b.finish(endTime);
 
-        serializedDataSize = static_cast<uint16_t>(sizeof(profiler::BaseBlockData) + 1);
+        serializedDataSize = encodeBlock(buffer, b, true);
         data = blocks.closedList.allocate(serializedDataSize);
-        ::new (data) profiler::SerializedBlock(b, 0);
-        blocks.frameMemorySize += serializedDataSize;
+        memcpy(data, buffer, serializedDataSize);
+        lastBlockBegin = b.begin();
     }
 #endif
 }
 
 void ThreadStorage::storeBlockForce(const profiler::Block& block)
 {
-    const uint16_t nameLength = static_cast<uint16_t>(strlen(block.name()));
-    const uint16_t serializedDataSize = static_cast<uint16_t>(sizeof(profiler::BaseBlockData) + nameLength + 1);
+    char buffer[MAX_COMPACT_BLOCK_SIZE];
+    const uint16_t serializedDataSize = encodeBlock(buffer, block, false);
 
     void* data = blocks.closedList.marked_allocate(serializedDataSize);
-    ::new (data) profiler::SerializedBlock(block, nameLength);
-    blocks.usedMemorySize += serializedDataSize;
+    memcpy(data, buffer, serializedDataSize);
+
+    // Block has been stored right after the last mark
+    chained = false;
+}
+
+uint16_t ThreadStorage::encodeBlock(char* _buffer, const profiler::Block& _block, bool _chained)
+{
+    CompactBlock block;
+    block.begin = _block.begin();
+    block.end = _block.end();
+    block.id = _block.id();
+
+    // The first block after the mark is a possible start of reading (or the first block left
+    // after dropping the oldest frames in ring mode), so its begin time is stored as is
+    if (!_chained)
+        block.tag |= COMPACT_ABSOLUTE;
+
+    const auto nameLength = static_cast<uint16_t>(strlen(_block.name()));
+    if (nameLength != 0)
+    {
+        // Run-time name is stored only once in runtimeNames, block stores the name id instead of a copy of the name
+        block.tag |= COMPACT_INTERNED_NAME;
+        block.nameId = internName(_block.name(), nameLength);
+    }
+
+    return encodeCompactBlock(_buffer, block, lastBlockBegin);
+}
+
+uint32_t ThreadStorage::internName(const char* _name, uint16_t _length)
+{
+    // Ids of runtimeNames follow ids of previousNames, so ids are never reused after names reset
+    const uint32_t firstId = namesFirstId + previousNames.size();
+
+    uint32_t nameId = 0;
+    if (runtimeNames.find(_name, _length, nameId))
+        return firstId + nameId;
+
+    // Only new names are added under the lock, beginRead() may be reading names at this moment
+    profiler::guard_lock<profiler::spin_lock> lock(runtimeNamesSpin);
+    nameId = runtimeNames.intern(_name, _length);
+
+    // The name is journaled before the block which uses it could be published
+    if (crashRecord != nullptr)
+        CrashRecovery::instance().journalName(*crashRecord, _name, _length);
+
+    return firstId + nameId;
+}
+
+const std::string& ThreadStorage::runtimeName(uint32_t _id) const
+{
+    const auto index = _id - namesFirstId;
+    return index < previousNames.size() ? previousNames.name(index) : runtimeNames.name(index - previousNames.size());
+}
+
+void ThreadStorage::resetNames()
+{
+    // Blocks referencing previousNames have been consumed, so they are released.
+    // Names of blocks stored since the last reset are kept until these blocks are consumed too.
+    profiler::guard_lock<profiler::spin_lock> lock(runtimeNamesSpin);
+    namesFirstId += previousNames.size();
+    previousNames.clear();
+    previousNames.swap(runtimeNames);
+    namesGeneration.store(namesGeneration.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void ThreadStorage::accumulate(profiler::block_id_t _id, profiler::timestamp_t _duration, uint32_t _epoch)
+{
+    if (statisticsEpoch != _epoch)
+    {
+        // Profiler has been enabled again: statistics of the previous capture are dropped
+        profiler::guard_lock<profiler::spin_lock> lock(accumulatorsSpin);
+        for (auto& accumulator : accumulators)
+            accumulator.reset();
+        statisticsEpoch = _epoch;
+    }
+
+    if (_id >= accumulators.size() || !accumulators[_id].histogram)
+    {
+        // Only reallocation is guarded, mergeStatistics() may be reading accumulators at this moment
+        profiler::guard_lock<profiler::spin_lock> lock(accumulatorsSpin);
+        if (_id >= accumulators.size())
+            accumulators.resize(static_cast<size_t>(_id) + 1);
+        accumulators[_id].histogram.reset(new uint64_t[HISTOGRAM_SIZE]());
+    }
+
+    accumulators[_id].add(_duration);
+}
+
+void ThreadStorage::mergeStatistics(std::vector<BlockAccumulator>& _statistics, uint32_t _epoch)
+{
+    // Values are read while the thread keeps updating them,
+    // so statistics of the blocks being closed at this moment could be slightly inconsistent
+    profiler::guard_lock<profiler::spin_lock> lock(accumulatorsSpin);
+    if (statisticsEpoch != _epoch)
+        return;
+
+    if (_statistics.size() < accumulators.size())
+        _statistics.resize(accumulators.size());
+
+    for (size_t id = 0, size = accumulators.size(); id < size; ++id)
+        _statistics[id].merge(accumulators[id]);
 }
 
 void ThreadStorage::storeCSwitch(const CSwitchBlock& block)
@@ -145,13 +300,40 @@ void ThreadStorage::storeCSwitch(const CSwitchBlock& block)
 
     void* data = sync.closedList.allocate(serializedDataSize);
     ::new (data) profiler::SerializedCSwitch(block, nameLength);
-    sync.usedMemorySize += serializedDataSize;
+
+    // Each context switch event is a separate frame
+    sync.closedList.put_mark();
 }
 
-void ThreadStorage::clearClosed()
+void ThreadStorage::beginCSwitch(profiler::timestamp_t _time, profiler::thread_id_t _targetThreadId, const char* _targetName)
 {
-    blocks.clearClosed();
-    sync.clearClosed();
+    // Dirty hack: _targetThreadId will be written to the field "block_id_t m_id"
+    // and will be available calling method id().
+    sync.openedList.emplace_back(_time, _targetThreadId, _targetName);
+}
+
+void ThreadStorage::endCSwitch(profiler::timestamp_t _time)
+{
+    if (sync.openedList.empty())
+        return;
+
+    CSwitchBlock& lastBlock = sync.openedList.back();
+    lastBlock.m_end = _time;
+
+    storeCSwitch(lastBlock);
+    sync.openedList.pop_back();
+}
+
+void ThreadStorage::setMemoryLimit(uint64_t _bytes)
+{
+    blocks.setMemoryLimit(_bytes);
+    sync.setMemoryLimit(_bytes);
+}
+
+void ThreadStorage::setPinned(bool _pinned)
+{
+    blocks.closedList.set_pinned(_pinned);
+    sync.closedList.set_pinned(_pinned);
 }
 
 void ThreadStorage::popSilent()
@@ -160,12 +342,345 @@ void ThreadStorage::popSilent()
     {
         profiler::Block& top = blocks.openedList.back();
         top.m_end = top.m_begin;
+        if ((top.m_status & (profiler::ON | COUNTERS_FLAG)) == (profiler::ON | COUNTERS_FLAG))
+            perfCountersStack.pop_back();
+        if ((top.m_status & (profiler::ON | ALLOCATIONS_FLAG)) == (profiler::ON | ALLOCATIONS_FLAG))
+            allocationsStack.pop_back();
         if (!top.m_isScoped)
             nonscopedBlocks.pop();
         blocks.openedList.pop_back();
     }
 }
 
+void ThreadStorage::dropUnclosedFrame()
+{
+    blocks.closedList.drop_unmarked();
+    chained = false;
+    clearDropped();
+}
+
+void ThreadStorage::clearDropped()
+{
+    for (auto id : droppedIds)
+        sampledCalls[id].dropped = 0;
+    droppedIds.clear();
+}
+
+bool ThreadStorage::sample(profiler::block_id_t _id, uint32_t _sampling)
+{
+    if (_sampling < 2)
+        return true;
+
+    if (_id >= sampledCalls.size())
+        sampledCalls.resize(static_cast<size_t>(_id) + 1);
+
+    // Every _sampling-th call is stored starting from the first one
+    auto& counters = sampledCalls[_id];
+    if (counters.calls++ % _sampling == 0)
+        return true;
+
+    if (counters.dropped++ == 0)
+        droppedIds.push_back(_id);
+
+    return false;
+}
+
+void ThreadStorage::storeDropped(bool _frameStored)
+{
+    const auto tag = static_cast<char>(_frameStored ? (COMPACT_DROPPED | COMPACT_FRAME) : COMPACT_DROPPED);
+
+    for (auto id : droppedIds)
+    {
+        auto& counters = sampledCalls[id];
+
+        char buffer[1 + MAX_VARINT_SIZE * 2];
+        char* data = buffer;
+        *data++ = tag;
+        data = writeVarint(data, id);
+        data = writeVarint(data, counters.dropped);
+
+        const auto size = static_cast<uint16_t>(data - buffer);
+        memcpy(blocks.closedList.allocate(size), buffer, size);
+
+        counters.dropped = 0;
+    }
+
+    droppedIds.clear();
+}
+
+bool ThreadStorage::beginCounters()
+{
+    // Counters are bound to the OS thread which has opened them while execution context may migrate between threads
+    if (logical || !perfCounters.open())
+        return false;
+
+    perfCountersStack.emplace_back();
+    perfCounters.read(perfCountersStack.back());
+    return true;
+}
+
+void ThreadStorage::endCounters(profiler::PerfCounters& _deltas)
+{
+    perfCounters.read(_deltas);
+
+    const auto& begin = perfCountersStack.back();
+    for (int i = 0; i < profiler::PERF_COUNTERS_NUMBER; ++i)
+        _deltas.values[i] -= begin.values[i];
+
+    perfCountersStack.pop_back();
+}
+
+void ThreadStorage::storeCounters(const profiler::PerfCounters& _deltas)
+{
+    char buffer[MAX_COMPACT_COUNTERS_SIZE];
+    const auto size = encodeCompactCounters(buffer, _deltas);
+    memcpy(blocks.closedList.allocate(size), buffer, size);
+}
+
+void ThreadStorage::beginAllocations(uint64_t _bytes, uint64_t _count)
+{
+    allocationsStack.emplace_back();
+    auto& opened = allocationsStack.back();
+    opened.bytes = _bytes;
+    opened.count = _count;
+}
+
+bool ThreadStorage::endAllocations(uint64_t _bytes, uint64_t _count, profiler::Allocations& _allocations)
+{
+    const auto& opened = allocationsStack.back();
+    _allocations.bytes = _bytes - opened.bytes;
+    _allocations.count = _count - opened.count;
+    _allocations.self_bytes = _allocations.bytes - opened.childrenBytes;
+    _allocations.self_count = _allocations.count - opened.childrenCount;
+    allocationsStack.pop_back();
+
+    if (!allocationsStack.empty())
+    {
+        // Allocations of this block are not the self allocations of the parent
+        auto& parent = allocationsStack.back();
+        parent.childrenBytes += _allocations.bytes;
+        parent.childrenCount += _allocations.count;
+    }
+
+    return _allocations.count != 0;
+}
+
+void ThreadStorage::storeAllocations(const profiler::Allocations& _allocations)
+{
+    char buffer[MAX_COMPACT_ALLOCATIONS_SIZE];
+    const auto size = encodeCompactAllocations(buffer, _allocations);
+    memcpy(blocks.closedList.allocate(size), buffer, size);
+}
+
+void ThreadStorage::storeFlow(profiler::timestamp_t _time, uint64_t _id, profiler::FlowPointType _type)
+{
+    char buffer[MAX_COMPACT_FLOW_SIZE];
+    const auto size = encodeCompactFlow(buffer, _type, _id, _time);
+    memcpy(blocks.closedList.allocate(size), buffer, size);
+    putMarkIfEmpty();
+}
+
+void ThreadStorage::beginRead(Snapshot& _snapshot, RuntimeNames& _names, profiler::timestamp_t _since)
+{
+    // Names are reset only at the end of a frame, so all blocks stored before the last reset are captured
+    _snapshot.namesGeneration = namesGeneration.load(std::memory_order_acquire);
+
+    blocks.closedList.begin_read(_snapshot.blocks);
+    sync.closedList.begin_read(_snapshot.sync);
+
+    if (_since != 0)
+    {
+        // Skip frames begun before _since. The first block of each frame has absolute begin time,
+        // so data could be decoded starting from it.
+        decltype(blocks.closedList)::skip_until(_snapshot.blocks, [_since](const char* _data, uint16_t _payloadSize)
+        {
+            const char* payload = _data + sizeof(uint16_t);
+            const auto tag = static_cast<uint8_t>(*payload);
+            if ((tag & COMPACT_BLOCK) == 0 || (tag & COMPACT_ABSOLUTE) == 0)
+                return false;
+
+            CompactBlock block;
+            decodeCompactBlock(payload, payload + _payloadSize, 0, block);
+            return block.begin >= _since;
+        });
+
+        decltype(sync.closedList)::skip_until(_snapshot.sync, [_since](const char* _data, uint16_t)
+        {
+            return reinterpret_cast<const profiler::SerializedCSwitch*>(_data + sizeof(uint16_t))->begin() >= _since;
+        });
+    }
+
+    {
+        // Names of captured blocks have been added before these blocks were closed, so all of them are here
+        profiler::guard_lock<profiler::spin_lock> lock(runtimeNamesSpin);
+        _snapshot.firstNameId = namesFirstId;
+        _snapshot.nameIds.assign(previousNames.size() + runtimeNames.size(), 0);
+    }
+
+    // Blocks are decoded while reading, so the reader needs more memory.
+    // References of each run-time name are counted in nameIds first.
+    _snapshot.blocksMemory = 0;
+    _snapshot.blocksBytes = _snapshot.blocks.memory + _snapshot.blocks.size * sizeof(uint16_t);
+    blocks.closedList.read(_snapshot.blocks, [&_snapshot](const char* _data, uint16_t _payloadSize)
+    {
+        const char* payload = _data + sizeof(uint16_t);
+        const auto tag = static_cast<uint8_t>(*payload);
+
+        if (tag & COMPACT_DROPPED)
+            return; // dropped calls counter and flow points are not stored in blocks memory by reader
+
+        if (tag & COMPACT_COUNTERS)
+        {
+            _snapshot.blocksMemory += sizeof(profiler::PerfCounters); // counters are decoded right after the block
+            return;
+        }
+
+        if (tag & COMPACT_ALLOCATIONS)
+        {
+            _snapshot.blocksMemory += sizeof(profiler::Allocations); // allocations are decoded right after the block
+            return;
+        }
+
+        if ((tag & COMPACT_BLOCK) == 0)
+        {
+            _snapshot.blocksMemory += _payloadSize - 1; // arbitrary value without tag
+            return;
+        }
+
+        _snapshot.blocksMemory += sizeof(profiler::BaseBlockData) + 1;
+        if (tag & COMPACT_INTERNED_NAME)
+        {
+            CompactBlock block;
+            decodeCompactBlock(payload, payload + _payloadSize, 0, block);
+            ++_snapshot.nameIds[static_cast<uint32_t>(block.nameId) - _snapshot.firstNameId];
+        }
+    });
+
+    // Only names referenced by captured blocks are written into the names table of the dump.
+    // Names could have been reset since nameIds were allocated, but referenced names are still here.
+    profiler::guard_lock<profiler::spin_lock> lock(runtimeNamesSpin);
+    for (uint32_t index = 0, size = static_cast<uint32_t>(_snapshot.nameIds.size()); index < size; ++index)
+    {
+        auto& nameId = _snapshot.nameIds[index];
+        if (nameId == 0)
+            continue;
+
+        const auto& name = runtimeName(_snapshot.firstNameId + index);
+        const auto references = static_cast<uint64_t>(nameId);
+        _snapshot.blocksMemory += references * name.size();
+        nameId = _names.intern(name.c_str(), static_cast<uint16_t>(name.size()));
+
+        // writeBlocks() re-encodes name ids, so the encoded size of these blocks changes
+        _snapshot.blocksBytes += references * varintSize(nameId);
+        _snapshot.blocksBytes -= references * varintSize(_snapshot.firstNameId + index);
+    }
+}
+
+void ThreadStorage::endRead(const Snapshot& _snapshot, bool _consumed)
+{
+    blocks.closedList.end_read(_snapshot.blocks, _consumed);
+    sync.closedList.end_read(_snapshot.sync, _consumed);
+
+    // Names interned before the captured reset are not referenced anymore (see putMark())
+    if (_consumed)
+        consumedNamesGeneration.store(_snapshot.namesGeneration, std::memory_order_release);
+}
+
+void ThreadStorage::writeBlocks(const Snapshot& _snapshot, std::ostream& _outputStream) const
+{
+    if (_snapshot.nameIds.empty())
+    {
+        blocks.closedList.serialize(_snapshot.blocks, _outputStream);
+        return;
+    }
+
+    blocks.closedList.read(_snapshot.blocks, [&_snapshot, &_outputStream](const char* _data, uint16_t _payloadSize)
+    {
+        const char* payload = _data + sizeof(uint16_t);
+        if ((static_cast<uint8_t>(*payload) & COMPACT_INTERNED_NAME) == 0)
+        {
+            _outputStream.write(_data, sizeof(uint16_t) + _payloadSize);
+            return;
+        }
+
+        // Replace thread-local name id with the id in the names table of the dump.
+        // Delta of begin time does not depend on the base used for decoding/encoding here.
+        CompactBlock block;
+        decodeCompactBlock(payload, payload + _payloadSize, 0, block);
+        block.nameId = _snapshot.nameIds[static_cast<uint32_t>(block.nameId) - _snapshot.firstNameId];
+
+        char buffer[sizeof(uint16_t) + MAX_COMPACT_BLOCK_SIZE];
+        const uint16_t size = encodeCompactBlock(buffer + sizeof(uint16_t), block, 0);
+        unaligned_store16(buffer, size);
+
+        _outputStream.write(buffer, sizeof(uint16_t) + size);
+    });
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void BlockAccumulator::add(profiler::timestamp_t _duration)
+{
+    if (calls++ == 0 || _duration < min)
+        min = _duration;
+    if (_duration > max)
+        max = _duration;
+    total += _duration;
+    ++histogram[histogramIndex(_duration)];
+}
+
+void BlockAccumulator::merge(const BlockAccumulator& _another)
+{
+    if (_another.calls == 0)
+        return;
+
+    if (calls == 0 || _another.min < min)
+        min = _another.min;
+    if (_another.max > max)
+        max = _another.max;
+    calls += _another.calls;
+    total += _another.total;
+
+    if (!histogram)
+        histogram.reset(new uint64_t[HISTOGRAM_SIZE]());
+    for (uint16_t i = 0; i < HISTOGRAM_SIZE; ++i)
+        histogram[i] += _another.histogram[i];
+}
+
+void BlockAccumulator::reset()
+{
+    calls = 0;
+    total = min = max = 0;
+    if (histogram)
+        memset(histogram.get(), 0, HISTOGRAM_SIZE * sizeof(uint64_t));
+}
+
+uint16_t BlockAccumulator::histogramIndex(profiler::timestamp_t _duration)
+{
+    if (_duration < 4)
+        return static_cast<uint16_t>(_duration);
+
+    // Index of the highest set bit selects power of 2, next 2 bits select one of 4 sub-buckets
+#ifdef _MSC_VER
+    unsigned long log2 = 0;
+    _BitScanReverse64(&log2, _duration);
+#else
+    const auto log2 = static_cast<unsigned>(63 - __builtin_clzll(_duration));
+#endif
+
+    return static_cast<uint16_t>((log2 - 1) * 4 + ((_duration >> (log2 - 2)) & 3));
+}
+
+profiler::timestamp_t BlockAccumulator::histogramLowerBound(uint16_t _index)
+{
+    if (_index < 4)
+        return _index;
+
+    return static_cast<profiler::timestamp_t>(4 + (_index & 3)) << (_index / 4 - 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 void ThreadStorage::beginFrame()
 {
     if (!frameOpened)
@@ -184,8 +699,16 @@ profiler::timestamp_t ThreadStorage::endFrame()
 void ThreadStorage::putMark()
 {
     blocks.closedList.put_mark();
-    blocks.usedMemorySize += blocks.frameMemorySize;
-    blocks.frameMemorySize = 0;
+    chained = false;
+
+    // All stored blocks are closed here. If blocks referencing previousNames have been consumed then
+    // names are reset, so each distinct run-time name lives only until blocks using it are consumed.
+    // Crash recovery journal identifies names by their order, so they are never reset while it is enabled.
+    if (runtimeNames.size() != 0 && crashRecord == nullptr &&
+        consumedNamesGeneration.load(std::memory_order_acquire) == namesGeneration.load(std::memory_order_relaxed))
+    {
+        resetNames();
+    }
 }
 
 void ThreadStorage::putMarkIfEmpty()
@@ -50,8 +50,16 @@ The Apache License, Version 2.0 (the "License");
 #include <string>
 #include <atomic>
 #include <functional>
+#include <memory>
 #include "stack_buffer.h"
 #include "chunk_allocator.h"
+#include "runtime_names.h"
+#include "spin_lock.h"
+#include "perf_counters.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+struct CrashThreadRecord;
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -62,13 +70,9 @@ struct BlocksList
 
     std::vector<T>            openedList;
     chunk_allocator<N>        closedList;
-    uint64_t          usedMemorySize = 0;
-    uint64_t         frameMemorySize = 0;
 
-    void clearClosed() {
-        //closedList.clear();
-        usedMemorySize = 0;
-        frameMemorySize = 0;
+    void setMemoryLimit(uint64_t _bytes) {
+        closedList.set_max_chunks(static_cast<uint32_t>((_bytes + N - 1) / N));
     }
 
 private:
@@ -92,34 +96,149 @@ public:
 
 //////////////////////////////////////////////////////////////////////////
 
-EASY_CONSTEXPR uint16_t SIZEOF_BLOCK = sizeof(profiler::BaseBlockData) + 1 + sizeof(uint16_t); // SerializedBlock stores BaseBlockData + at least 1 character for name ('\0') + 2 bytes for size of serialized data
+EASY_CONSTEXPR uint16_t SIZEOF_BLOCK = sizeof(profiler::BaseBlockData) + 1 + sizeof(uint16_t); // Size of not encoded SerializedBlock (BaseBlockData + '\0' + 2 bytes for size of serialized data), compact blocks are usually 2-3 times smaller
 EASY_CONSTEXPR uint16_t SIZEOF_CSWITCH = sizeof(profiler::CSwitchEvent) + 1 + sizeof(uint16_t); // SerializedCSwitch also stores additional 4 bytes to be able to save 64-bit thread_id
 
-static_assert((int)SIZEOF_BLOCK * 128 < 65536, "Chunk size for profiler::Block must be less than 65536");
-static_assert((int)SIZEOF_CSWITCH * 128 < 65536, "Chunk size for CSwitchBlock must be less than 65536");
+EASY_CONSTEXPR uint16_t CHUNK_SIZE = static_cast<uint16_t>(ChunkPool::SLOT_SIZE - 64); // Chunk fills ChunkPool slot leaving space for the chunk header
+
+static_assert((int)SIZEOF_BLOCK * 128 < (int)CHUNK_SIZE, "Chunk size must be enough to store at least 128 profiler::Block");
+static_assert((int)SIZEOF_CSWITCH * 128 < (int)CHUNK_SIZE, "Chunk size must be enough to store at least 128 CSwitchBlock");
+
+/** Internal bit of Block::m_status which is set if performance counters have been read at the begin of this block.
+
+It is never set in descriptor status. \sa ProfileManager::beginBlock, BaseBlockDescriptor::perfCounters */
+EASY_CONSTEXPR uint8_t COUNTERS_FLAG = 0x40;
+
+/** Internal bit of Block::m_status which is set if allocations of this block are tracked.
+
+It is never set in descriptor status. \sa ProfileManager::beginBlock, profiler::trackAllocation */
+EASY_CONSTEXPR uint8_t ALLOCATIONS_FLAG = 0x20;
+
+EASY_CONSTEXPR uint16_t HISTOGRAM_SIZE = 252; ///< Number of log-scaled buckets covering all 64-bit durations (4 buckets per power of 2)
+
+/** Statistics of one block accumulated in statistics-only mode. Durations are in ticks. */
+struct BlockAccumulator
+{
+    uint64_t                        calls = 0;
+    profiler::timestamp_t           total = 0;
+    profiler::timestamp_t             min = 0;
+    profiler::timestamp_t             max = 0;
+    std::unique_ptr<uint64_t[]> histogram; ///< HISTOGRAM_SIZE counters allocated on the first call
+
+    void add(profiler::timestamp_t _duration);
+    void merge(const BlockAccumulator& _another);
+    void reset();
+
+    static uint16_t histogramIndex(profiler::timestamp_t _duration);
+    static profiler::timestamp_t histogramLowerBound(uint16_t _index);
+};
+
+//////////////////////////////////////////////////////////////////////////
 
 struct ThreadStorage EASY_FINAL
 {
-    StackBuffer<NonscopedBlock>                                                 nonscopedBlocks;
-    BlocksList<std::reference_wrapper<profiler::Block>, SIZEOF_BLOCK * (uint16_t)128U>   blocks;
-    BlocksList<CSwitchBlock, SIZEOF_CSWITCH * (uint16_t)128U>                              sync;
+    using blocks_list_t = BlocksList<std::reference_wrapper<profiler::Block>, CHUNK_SIZE>;
+    using sync_list_t = BlocksList<CSwitchBlock, CHUNK_SIZE>;
+
+    /** Closed blocks and context switch events captured for serialization.
+
+    \sa beginRead, endRead
+    */
+    struct Snapshot
+    {
+        decltype(blocks_list_t::closedList)::snapshot blocks;
+        decltype(sync_list_t::closedList)::snapshot     sync;
+        std::vector<uint32_t>                    nameIds; ///< Ids of referenced run-time names in the names table of the dump indexed by (name id - firstNameId)
+        uint64_t                            blocksMemory = 0; ///< Memory size of blocks after expanding interned run-time names
+        uint64_t                             blocksBytes = 0; ///< Number of bytes written by writeBlocks()
+        uint32_t                             firstNameId = 0; ///< Id of the first run-time name which could be referenced by captured blocks
+        uint32_t                         namesGeneration = 0; ///< Number of run-time names resets done before capturing blocks
+
+        uint32_t size() const { return blocks.size + sync.size; }
+        uint64_t memory() const { return blocksMemory + sync.memory; }
+    };
+
+    /** Counters of blocks with sampling policy (see BaseBlockDescriptor::sampling()). */
+    struct SampledCalls
+    {
+        uint32_t   calls = 0; ///< Number of calls checked by sample()
+        uint32_t dropped = 0; ///< Number of calls dropped during current frame
+    };
+
+    /** Allocations of the opened block with ALLOCATIONS_FLAG. */
+    struct OpenedAllocations
+    {
+        uint64_t         bytes = 0; ///< Thread allocated bytes at the begin of the block
+        uint64_t         count = 0; ///< Thread number of allocations at the begin of the block
+        uint64_t childrenBytes = 0; ///< Inclusive bytes of closed child blocks with ALLOCATIONS_FLAG
+        uint64_t childrenCount = 0; ///< Inclusive number of allocations of closed child blocks with ALLOCATIONS_FLAG
+    };
+
+    StackBuffer<NonscopedBlock> nonscopedBlocks;
+    blocks_list_t                        blocks;
+    sync_list_t                            sync;
+
+    RuntimeNames            runtimeNames; ///< Interned run-time names of blocks stored by this thread since the last names reset
+    RuntimeNames           previousNames; ///< Run-time names interned before the last names reset (may be referenced by not consumed blocks)
+    std::atomic<uint32_t> namesGeneration; ///< Number of run-time names resets \sa resetNames
+    std::atomic<uint32_t> consumedNamesGeneration; ///< Blocks stored before reset with this number have been consumed by a dump
+    std::vector<SampledCalls> sampledCalls; ///< Sampling counters indexed by block id
+    std::vector<profiler::block_id_t> droppedIds; ///< Ids of blocks dropped by sampling during current frame
+    std::vector<BlockAccumulator> accumulators; ///< Statistics indexed by block id (used in statistics-only mode)
+    std::vector<profiler::timestamp_t> frameHistory; ///< Ring of recent frames start times (used by spike capture only)
+    std::vector<profiler::PerfCounters> perfCountersStack; ///< Values of performance counters at the begin of opened blocks with COUNTERS_FLAG
+    ThreadPerfCounters          perfCounters; ///< Performance counters of this thread (opened by the first block with COUNTERS_FLAG)
+    std::vector<OpenedAllocations> allocationsStack; ///< Allocations of opened blocks with ALLOCATIONS_FLAG
+    profiler::spin_lock   accumulatorsSpin; ///< Guards accumulators from being read while they are reallocated or reset
+    profiler::spin_lock runtimeNamesSpin; ///< Guards runtimeNames from being read while a new name is added
 
     std::string                     name; ///< Thread name
+    CrashThreadRecord*       crashRecord; ///< Crash-survivable record of this thread (nullptr if crash recovery is disabled)
     profiler::timestamp_t frameStartTime; ///< Current frame start time. Used to calculate FPS.
     const profiler::thread_id_t       id; ///< Thread ID
     std::atomic<char>            expired; ///< Is thread expired
+    profiler::timestamp_t lastBlockBegin; ///< Begin time of the last stored block. Used for delta encoding of the next block begin time.
+    uint32_t            namesFirstId; ///< Id of the first name of previousNames (ids of runtimeNames follow them)
+    uint64_t          suspendedBytes; ///< Bytes allocated by this execution context before it has been switched out \sa ProfileManager::switchExecutionContext
+    uint64_t    suspendedAllocations; ///< Number of allocations made by this execution context before it has been switched out
+    uint32_t             statisticsEpoch; ///< Statistics-only capture which accumulators belong to \sa accumulate
+    uint32_t         frameHistoryIndex; ///< Position of the next frame start time in frameHistory
     int32_t                    stackSize; ///< Current thread stack depth. Used when switching profiler state to begin collecting blocks only when new frame would be opened.
     bool                   allowChildren; ///< False if one of previously opened blocks has OFF_RECURSIVE or ON_WITHOUT_CHILDREN status
+    bool                         chained; ///< True if a block has been stored after the last mark, so the next block begin time is stored as delta
     bool                           named; ///< True if thread name was set
     bool                         guarded; ///< True if thread has been registered using ThreadGuard
+    bool                         logical; ///< True if this is an execution context (fiber, coroutine) rather than an OS thread
     bool                     frameOpened; ///< Is new frame opened (this does not depend on profiling status) \sa profiledFrameOpened
+    bool                    spikeBlockHit; ///< True if the block watched by spike capture has exceeded its threshold during current frame
 
     void storeValue(profiler::timestamp_t _timestamp, profiler::block_id_t _id, profiler::DataType _type, const void* _data, uint16_t _size, bool _isArray, profiler::ValueId _vin);
     void storeBlock(const profiler::Block& _block);
     void storeBlockForce(const profiler::Block& _block);
     void storeCSwitch(const CSwitchBlock& _block);
-    void clearClosed();
+    void beginCSwitch(profiler::timestamp_t _time, profiler::thread_id_t _targetThreadId, const char* _targetName);
+    void endCSwitch(profiler::timestamp_t _time);
     void popSilent();
+    void dropUnclosedFrame();
+    bool sample(profiler::block_id_t _id, uint32_t _sampling);
+    void storeDropped(bool _frameStored);
+    bool beginCounters();
+    void endCounters(profiler::PerfCounters& _deltas);
+    void storeCounters(const profiler::PerfCounters& _deltas);
+    void beginAllocations(uint64_t _bytes, uint64_t _count);
+    bool endAllocations(uint64_t _bytes, uint64_t _count, profiler::Allocations& _allocations);
+    void storeAllocations(const profiler::Allocations& _allocations);
+    void storeFlow(profiler::timestamp_t _time, uint64_t _id, profiler::FlowPointType _type);
+    void clearDropped();
+    void accumulate(profiler::block_id_t _id, profiler::timestamp_t _duration, uint32_t _epoch);
+    void mergeStatistics(std::vector<BlockAccumulator>& _statistics, uint32_t _epoch);
+
+    void beginRead(Snapshot& _snapshot, RuntimeNames& _names, profiler::timestamp_t _since = 0);
+    void endRead(const Snapshot& _snapshot, bool _consumed);
+    void writeBlocks(const Snapshot& _snapshot, std::ostream& _outputStream) const;
+    void setMemoryLimit(uint64_t _bytes);
+    void setPinned(bool _pinned);
+    void setName(const char* _name);
 
     void beginFrame();
     profiler::timestamp_t endFrame();
@@ -127,9 +246,18 @@ struct ThreadStorage EASY_FINAL
     void putMarkIfEmpty();
 
     ThreadStorage();
+    explicit ThreadStorage(profiler::thread_id_t _id);
+    ~ThreadStorage();
     ThreadStorage(const ThreadStorage&) = delete;
     ThreadStorage(ThreadStorage&&) = delete;
 
+private:
+
+    uint16_t encodeBlock(char* _buffer, const profiler::Block& _block, bool _chained);
+    uint32_t internName(const char* _name, uint16_t _length);
+    const std::string& runtimeName(uint32_t _id) const;
+    void resetNames();
+
 }; // END of struct ThreadStorage.
 
 //////////////////////////////////////////////////////////////////////////
@@ -57,6 +57,7 @@
 #include <easy/profiler.h>
 
 #include "alignment_helpers.h"
+#include "compact_block.h"
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -104,6 +105,7 @@ struct BlocksAndCSwitchesRange
     BlocksMemoryAndCount cswitchesMemoryAndCount;
     BlocksRange                           blocks;
     BlocksRange                        cswitches;
+    BlocksRange                            flows;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -183,6 +185,24 @@ static BlocksRange findRange(const profiler::BlocksTree::children_t& children, p
     return range;
 }
 
+static BlocksRange findRange(const profiler::flow_points_t& flows, profiler::timestamp_t beginTime, profiler::timestamp_t endTime)
+{
+    const auto first_it = std::lower_bound(flows.begin(), flows.end(), beginTime,
+                                           [](const profiler::FlowPoint& element, profiler::timestamp_t value)
+    {
+        return element.time < value;
+    });
+
+    const auto last_it = std::upper_bound(first_it, flows.end(), endTime,
+                                          [](profiler::timestamp_t value, const profiler::FlowPoint& element)
+    {
+        return value < element.time;
+    });
+
+    return BlocksRange(static_cast<profiler::block_index_t>(std::distance(flows.begin(), first_it)),
+                       static_cast<profiler::block_index_t>(std::distance(flows.begin(), last_it)));
+}
+
 static BlocksRange findRange(const profiler::bookmarks_t& bookmarks, profiler::timestamp_t beginTime, profiler::timestamp_t endTime)
 {
     const auto size = static_cast<profiler::block_index_t>(bookmarks.size());
@@ -264,6 +284,19 @@ static BlocksMemoryAndCount calculateUsedMemoryAndBlocksCount(const profiler::Bl
             memoryAndCount += childrenMemoryAndCount;
             memoryAndCount.usedMemorySize += usedMemorySize;
             ++memoryAndCount.blocksCount;
+
+            if (child.has_counters)
+            {
+                // Performance counters are stored as a separate element of blocks list
+                memoryAndCount.usedMemorySize += sizeof(profiler::PerfCounters);
+                ++memoryAndCount.blocksCount;
+            }
+
+            if (child.has_allocations)
+            {
+                memoryAndCount.usedMemorySize += sizeof(profiler::Allocations);
+                ++memoryAndCount.blocksCount;
+            }
         }
     }
     else
@@ -284,7 +317,8 @@ static BlocksMemoryAndCount calculateUsedMemoryAndBlocksCount(const profiler::Bl
 
 static void serializeBlocks(std::ostream& output, std::vector<char>& buffer,
                             const profiler::BlocksTree::children_t& children, const BlocksRange& range,
-                            const profiler::block_getter_fn& getter, const profiler::descriptors_list_t& descriptors)
+                            const profiler::block_getter_fn& getter, const profiler::descriptors_list_t& descriptors,
+                            profiler::timestamp_t& previousBegin)
 {
     for (auto i = range.begin; i < range.end; ++i)
     {
@@ -292,7 +326,7 @@ static void serializeBlocks(std::ostream& output, std::vector<char>& buffer,
 
         // Serialize children
         const BlocksRange childRange(0, static_cast<profiler::block_index_t>(child.children.size()));
-        serializeBlocks(output, buffer, child.children, childRange, getter, descriptors);
+        serializeBlocks(output, buffer, child.children, childRange, getter, descriptors, previousBegin);
 
         // Serialize self
         const auto& desc = *descriptors[child.node->id()];
@@ -300,25 +334,47 @@ static void serializeBlocks(std::ostream& output, std::vector<char>& buffer,
 
         if (desc.type() == profiler::BlockType::Value)
         {
-            usedMemorySize = static_cast<uint16_t>(sizeof(profiler::ArbitraryValue)) + child.value->data_size();
+            usedMemorySize = 1 + static_cast<uint16_t>(sizeof(profiler::ArbitraryValue)) + child.value->data_size();
             buffer.resize(usedMemorySize + sizeof(uint16_t));
             unaligned_store16(buffer.data(), usedMemorySize);
-            memcpy(buffer.data() + sizeof(uint16_t), child.value, static_cast<size_t>(usedMemorySize));
+            buffer[sizeof(uint16_t)] = static_cast<char>(COMPACT_VALUE);
+            memcpy(buffer.data() + sizeof(uint16_t) + 1, child.value, static_cast<size_t>(usedMemorySize - 1));
         }
         else
         {
-            usedMemorySize = static_cast<uint16_t>(sizeof(profiler::SerializedBlock)
-                                                   + strlen(child.node->name()) + 1);
-
-            buffer.resize(usedMemorySize + sizeof(uint16_t));
+            // Begin time of the first block of a thread is a delta from 0
+            CompactBlock block;
+            block.begin = child.node->begin();
+            block.end = child.node->end();
+            block.id = desc.id(); // This block id could be dynamic. Restore it's value like it was before in the input .prof file
+            block.name = child.node->name();
+            block.nameLength = static_cast<uint16_t>(strlen(block.name));
+            if (block.nameLength != 0)
+                block.tag |= COMPACT_INLINE_NAME;
+
+            buffer.resize(sizeof(uint16_t) + MAX_COMPACT_BLOCK_SIZE + block.nameLength + 1);
+            usedMemorySize = encodeCompactBlock(buffer.data() + sizeof(uint16_t), block, previousBegin);
             unaligned_store16(buffer.data(), usedMemorySize);
-            memcpy(buffer.data() + sizeof(uint16_t), child.node, static_cast<size_t>(usedMemorySize));
+            buffer.resize(usedMemorySize + sizeof(uint16_t));
 
-            if (child.node->id() != desc.id())
+            previousBegin = block.begin;
+
+            if (child.has_counters)
             {
-                // This block id is dynamic. Restore it's value like it was before in the input .prof file
-                auto block = reinterpret_cast<profiler::SerializedBlock*>(buffer.data() + sizeof(uint16_t));
-                block->setId(desc.id());
+                const auto size = buffer.size();
+                buffer.resize(size + sizeof(uint16_t) + MAX_COMPACT_COUNTERS_SIZE);
+                const auto countersSize = encodeCompactCounters(buffer.data() + size + sizeof(uint16_t), *child.counters());
+                unaligned_store16(buffer.data() + size, countersSize);
+                buffer.resize(size + sizeof(uint16_t) + countersSize);
+            }
+
+            if (child.has_allocations)
+            {
+                const auto size = buffer.size();
+                buffer.resize(size + sizeof(uint16_t) + MAX_COMPACT_ALLOCATIONS_SIZE);
+                const auto allocationsSize = encodeCompactAllocations(buffer.data() + size + sizeof(uint16_t), *child.allocations());
+                unaligned_store16(buffer.data() + size, allocationsSize);
+                buffer.resize(size + sizeof(uint16_t) + allocationsSize);
             }
         }
 
@@ -326,6 +382,22 @@ static void serializeBlocks(std::ostream& output, std::vector<char>& buffer,
     }
 }
 
+static void serializeFlows(std::ostream& output, std::vector<char>& buffer,
+                           const profiler::flow_points_t& flows, const BlocksRange& range)
+{
+    for (auto i = range.begin; i < range.end; ++i)
+    {
+        const auto& point = flows[i];
+
+        // Flow points are linked with blocks by time, so they could be written before all blocks
+        buffer.resize(sizeof(uint16_t) + MAX_COMPACT_FLOW_SIZE);
+        const auto usedMemorySize = encodeCompactFlow(buffer.data() + sizeof(uint16_t), point.type, point.id, point.time);
+        unaligned_store16(buffer.data(), usedMemorySize);
+
+        write(output, buffer.data(), sizeof(uint16_t) + usedMemorySize);
+    }
+}
+
 static void serializeContextSwitches(std::ostream& output, std::vector<char>& buffer,
                                      const profiler::BlocksTree::children_t& children, const BlocksRange& range,
                                      const profiler::block_getter_fn& getter)
@@ -455,8 +527,15 @@ extern "C" PROFILER_API profiler::block_index_t writeTreesToStream(std::atomic<i
 
         if (range.blocksMemoryAndCount.blocksCount != 0)
         {
-            beginTime = std::min(beginTime, block_getter(tree.children[range.blocks.begin]).node->begin());
-            endTime = std::max(endTime, block_getter(tree.children[range.blocks.end - 1]).node->end());
+            const auto framesBegin = block_getter(tree.children[range.blocks.begin]).node->begin();
+            const auto framesEnd = block_getter(tree.children[range.blocks.end - 1]).node->end();
+            beginTime = std::min(beginTime, framesBegin);
+            endTime = std::max(endTime, framesEnd);
+
+            // Flow points of saved frames
+            range.flows = findRange(tree.flows, framesBegin, framesEnd);
+            range.blocksMemoryAndCount.blocksCount += range.flows.end - range.flows.begin;
+            total.blocksCount += range.flows.end - range.flows.begin;
         }
 
         range.cswitchesMemoryAndCount = calculateUsedMemoryAndBlocksCount(tree.sync, range.cswitches, block_getter,
@@ -517,11 +596,18 @@ extern "C" PROFILER_API profiler::block_index_t writeTreesToStream(std::atomic<i
     write(str, bookmarksCount);
     write(str, static_cast<uint16_t>(0)); // padding
 
+    // write 0 because block overhead of the saved blocks may have been already compensated by reader
+    write<profiler::timestamp_t>(str, 0ULL); // Block overhead
+
     std::vector<char> buffer;
 
     // Serialize all descriptors
     serializeDescriptors(str, buffer, descriptors, descriptors_count);
 
+    // Run-time names are stored right in blocks, so names table is empty
+    write(str, static_cast<uint32_t>(0)); // names count
+    write(str, static_cast<uint64_t>(0)); // names memory size
+
     // Serialize all blocks
     i = 0;
     for (const auto& kv : trees)
@@ -543,7 +629,12 @@ extern "C" PROFILER_API profiler::block_index_t writeTreesToStream(std::atomic<i
         // Serialize blocks
         write(str, range.blocksMemoryAndCount.blocksCount);
         if (range.blocksMemoryAndCount.blocksCount != 0)
-            serializeBlocks(str, buffer, tree.children, range.blocks, block_getter, descriptors);
+        {
+            serializeFlows(str, buffer, tree.flows, range.flows);
+
+            profiler::timestamp_t previousBegin = 0;
+            serializeBlocks(str, buffer, tree.children, range.blocks, block_getter, descriptors, previousBegin);
+        }
 
         if (!update_progress_write(progress, 40 + 57 / static_cast<int>(trees.size() - i), log))
             return 0;
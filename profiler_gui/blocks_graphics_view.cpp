@@ -641,9 +641,60 @@ void ForegroundItem::paint(QPainter* _painter, const QStyleOptionGraphicsItem*,
         _painter->drawLine(QPointF(pos, 0), QPointF(pos, visibleSceneRect.height()));
     }
 
+    paintFlows(_painter, sceneView, visibleSceneRect);
+
     _painter->restore();
 }
 
+void ForegroundItem::paintFlows(QPainter* _painter, const BlocksGraphicsView* _view, const QRectF& _visibleSceneRect) const
+{
+    // Draw arrows for flows which begin or end in the selected block
+    const auto selected = EASY_GLOBALS.selected_block;
+    if (selected >= EASY_GLOBALS.gui_blocks.size() || EASY_GLOBALS.flows.empty())
+        return;
+
+    const auto& items = _view->getItems();
+    const auto half_row = EASY_GLOBALS.size.graphics_row_height * 0.5;
+    const auto arrow = px(6);
+
+    // Returns flow point position in visible region coordinates
+    auto point = [&](::profiler::block_index_t block, ::profiler::timestamp_t time) -> QPointF
+    {
+        const auto& guiblock = EASY_GLOBALS.gui_blocks[block];
+        const auto thread_item = items[guiblock.graphics_item];
+        const qreal x = (PROF_MICROSECONDS(time - EASY_GLOBALS.begin_time) - _view->offset()) * _view->scale();
+        const qreal y = thread_item->levelY(guiblock.graphics_item_level) - _visibleSceneRect.top() + half_row;
+        return QPointF(x, y);
+    };
+
+    QPen pen(Qt::black);
+    pen.setWidth(px(2));
+    _painter->setPen(pen);
+    _painter->setBrush(Qt::black);
+
+    for (const auto& flow : EASY_GLOBALS.flows)
+    {
+        if (!flow.complete() || (flow.begin_block != selected && flow.end_block != selected))
+            continue;
+
+        if (flow.begin_block >= EASY_GLOBALS.gui_blocks.size() || flow.end_block >= EASY_GLOBALS.gui_blocks.size())
+            continue;
+
+        const auto from = point(flow.begin_block, flow.begin_time);
+        const auto to = point(flow.end_block, flow.end_time);
+        _painter->drawLine(from, to);
+
+        const auto angle = atan2(to.y() - from.y(), to.x() - from.x());
+        const QPointF head[] = {
+            to,
+            to - QPointF(cos(angle - 0.5) * arrow, sin(angle - 0.5) * arrow),
+            to - QPointF(cos(angle + 0.5) * arrow, sin(angle + 0.5) * arrow)
+        };
+
+        _painter->drawPolygon(head, 3);
+    }
+}
+
 void ForegroundItem::onBookmarkChanged(size_t index)
 {
     m_bookmark = index;
@@ -655,6 +706,11 @@ void ForegroundItem::onMoved()
     update();
 }
 
+void ForegroundItem::onSelectedBlockChanged(uint32_t)
+{
+    update();
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 BlocksGraphicsView::BlocksGraphicsView(QWidget* _parent)
@@ -972,6 +1028,7 @@ void BlocksGraphicsView::setTree(const profiler::thread_blocks_tree_t& _blocksTr
     indicator->setBoundingRect(0, 0, m_sceneWidth, y);
     connect(m_backgroundItem, &BackgroundItem::bookmarkChanged, indicator, &ForegroundItem::onBookmarkChanged);
     connect(m_backgroundItem, &BackgroundItem::moved, indicator, &ForegroundItem::onMoved);
+    connect(&EASY_GLOBALS.events, &profiler_gui::GlobalSignals::selectedBlockChanged, indicator, &ForegroundItem::onSelectedBlockChanged);
     scene()->addItem(indicator);
 
     // Setting flags
@@ -168,6 +168,11 @@ public slots:
 
     void onBookmarkChanged(size_t index);
     void onMoved();
+    void onSelectedBlockChanged(uint32_t);
+
+private:
+
+    void paintFlows(QPainter* _painter, const BlocksGraphicsView* _view, const QRectF& _visibleSceneRect) const;
 };
 
 //////////////////////////////////////////////////////////////////////////
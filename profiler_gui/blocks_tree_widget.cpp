@@ -126,7 +126,17 @@ const bool SIMPLIFIED_REGIME_COLUMNS[COL_COLUMNS_NUMBER] = {
     false, //COL_AVERAGE_PER_PARENT,
     false, //COL_NCALLS_PER_PARENT,
     true, //COL_ACTIVE_TIME,
-    true //COL_ACTIVE_PERCENT,
+    true, //COL_ACTIVE_PERCENT,
+    false, //COL_TASK_CLOCK_PER_THREAD,
+    false, //COL_PAGE_FAULTS_PER_THREAD,
+    false, //COL_CONTEXT_SWITCHES_PER_THREAD,
+    false, //COL_CPU_MIGRATIONS_PER_THREAD,
+    false, //COL_CYCLES_PER_THREAD,
+    false, //COL_INSTRUCTIONS_PER_THREAD,
+    false, //COL_ALLOCATED_BYTES_PER_THREAD,
+    false, //COL_ALLOCATED_SELF_BYTES_PER_THREAD,
+    false, //COL_ALLOCATIONS_PER_THREAD,
+    false //COL_ALLOCATIONS_SELF_PER_THREAD,
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -197,6 +207,20 @@ BlocksTreeWidget::BlocksTreeWidget(QWidget* _parent)
     header_item->setText(COL_ACTIVE_TIME, "Active time");
     header_item->setText(COL_ACTIVE_PERCENT, "Active %");
 
+    for (int i = 0; i < profiler::PERF_COUNTERS_NUMBER; ++i)
+    {
+        const int column = COL_TASK_CLOCK_PER_THREAD + i;
+        header_item->setText(column, QString("Avg %1 / Thread").arg(profiler::perfCounterName(static_cast<profiler::PerfCounter>(i))));
+        header_item->setToolTip(column, "Average value of performance counter per call.\nCounters are sampled only for blocks\nenabled by profiler::setBlockPerfCounters()");
+    }
+
+    header_item->setText(COL_ALLOCATED_BYTES_PER_THREAD, "Allocated / Thread");
+    header_item->setText(COL_ALLOCATED_SELF_BYTES_PER_THREAD, "Self allocated / Thread");
+    header_item->setText(COL_ALLOCATIONS_PER_THREAD, "N allocs / Thread");
+    header_item->setText(COL_ALLOCATIONS_SELF_PER_THREAD, "N self allocs / Thread");
+    for (int i = COL_ALLOCATED_BYTES_PER_THREAD; i <= COL_ALLOCATIONS_SELF_PER_THREAD; ++i)
+        header_item->setToolTip(i, "Heap allocations of all calls (self columns exclude children).\nAllocations are tracked only if application\nis linked with easy_profiler_alloc_hooks");
+
     auto color = QColor::fromRgb(profiler::colors::DeepOrange900);
     header_item->setForeground(COL_MIN_PER_THREAD, color);
     header_item->setForeground(COL_MAX_PER_THREAD, color);
@@ -204,6 +228,8 @@ BlocksTreeWidget::BlocksTreeWidget(QWidget* _parent)
     header_item->setForeground(COL_NCALLS_PER_THREAD, color);
     header_item->setForeground(COL_PERCENT_SUM_PER_THREAD, color);
     header_item->setForeground(COL_DURATION_SUM_PER_THREAD, color);
+    for (int i = COL_TASK_CLOCK_PER_THREAD; i <= COL_ALLOCATIONS_SELF_PER_THREAD; ++i)
+        header_item->setForeground(i, color);
 
     color = QColor::fromRgb(profiler::colors::Blue900);
     header_item->setForeground(COL_MIN_PER_FRAME, color);
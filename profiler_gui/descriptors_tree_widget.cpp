@@ -53,6 +53,8 @@
 *                   : limitations under the License.
 ************************************************************************/
 
+#include <algorithm>
+#include <limits>
 #include <QMenu>
 #include <QAction>
 #include <QActionGroup>
@@ -67,6 +69,7 @@
 #include <QToolBar>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
+#include <QInputDialog>
 #include <QSplitter>
 #include <QVariant>
 #include <QTimer>
@@ -336,6 +339,22 @@ void DescriptorsTreeWidget::contextMenuEvent(QContextMenuEvent* _event)
         submenu->setEnabled(EASY_GLOBALS.connected);
         if (!EASY_GLOBALS.connected)
             submenu->setTitle(QString("%1 (connection needed)").arg(submenu->title()));
+
+        action = menu.addAction(desc.sampling() > 1 ? QString("Sampling (1 of %1)...").arg(desc.sampling()) : QString("Sampling..."));
+        action->setToolTip("Store only 1 of N calls of this block.\nNumber of dropped calls is used\nto estimate block statistics.");
+        action->setEnabled(EASY_GLOBALS.connected);
+        if (!EASY_GLOBALS.connected)
+            action->setText(QString("%1 (connection needed)").arg(action->text()));
+        connect(action, &QAction::triggered, this, &This::onBlockSamplingChangeClicked);
+
+        action = menu.addAction("Performance counters");
+        action->setCheckable(true);
+        action->setChecked(desc.perfCounters());
+        action->setToolTip("Sample task-clock, page-faults, context-switches, etc.\nat the begin and at the end of this block (Linux only).");
+        action->setEnabled(EASY_GLOBALS.connected);
+        if (!EASY_GLOBALS.connected)
+            action->setText(QString("%1 (connection needed)").arg(action->text()));
+        connect(action, &QAction::triggered, this, &This::onBlockPerfCountersChangeClicked);
     }
 
     menu.exec(QCursor::pos());
@@ -556,6 +575,42 @@ void DescriptorsTreeWidget::onBlockStatusChangeClicked(bool _checked)
     }
 }
 
+void DescriptorsTreeWidget::onBlockSamplingChangeClicked(bool)
+{
+    if (!EASY_GLOBALS.connected)
+        return;
+
+    auto item = currentItem();
+    if (item == nullptr || item->parent() == nullptr)
+        return;
+
+    auto& desc = easyDescriptor(static_cast<DescriptorsTreeItem*>(item)->desc());
+
+    bool ok = false;
+    const auto sampling = QInputDialog::getInt(this, "Block sampling", "Store only 1 of N calls (1 means all calls):",
+                                               static_cast<int>(std::max(desc.sampling(), 1U)), 1,
+                                               std::numeric_limits<int>::max(), 1, &ok);
+    if (!ok)
+        return;
+
+    desc.setSampling(static_cast<uint32_t>(sampling));
+    emit EASY_GLOBALS.events.blockSamplingChanged(desc.id(), desc.sampling());
+}
+
+void DescriptorsTreeWidget::onBlockPerfCountersChangeClicked(bool _checked)
+{
+    if (!EASY_GLOBALS.connected)
+        return;
+
+    auto item = currentItem();
+    if (item == nullptr || item->parent() == nullptr)
+        return;
+
+    auto& desc = easyDescriptor(static_cast<DescriptorsTreeItem*>(item)->desc());
+    desc.setPerfCounters(_checked);
+    emit EASY_GLOBALS.events.blockPerfCountersChanged(desc.id(), _checked);
+}
+
 void DescriptorsTreeWidget::onBlockStatusChange(::profiler::block_id_t _id, ::profiler::EasyBlockStatus _status)
 {
     if (m_bLocked)
@@ -164,6 +164,8 @@ public slots:
 private slots:
 
     void onBlockStatusChangeClicked(bool);
+    void onBlockSamplingChangeClicked(bool);
+    void onBlockPerfCountersChangeClicked(bool _checked);
     void onCurrentItemChange(QTreeWidgetItem* _item, QTreeWidgetItem* _prev);
     void onItemExpand(QTreeWidgetItem* _item);
     void onDoubleClick(QTreeWidgetItem* _item, int _column);
@@ -104,6 +104,7 @@ namespace profiler_gui {
         , hex_thread_id(false)
         , enable_event_markers(true)
         , enable_statistics(true)
+        , compensate_overhead(false)
         , enable_zero_length(true)
         , add_zero_blocks_to_hierarchy(false)
         , draw_graphics_items_borders(true)
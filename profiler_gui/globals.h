@@ -197,6 +197,7 @@ namespace profiler_gui {
         ::profiler::thread_blocks_tree_t profiler_blocks; ///< Profiler blocks tree loaded from file
         ::profiler::descriptors_list_t       descriptors; ///< Profiler block descriptors list
         ::profiler::bookmarks_t                bookmarks; ///< User bookmarks
+        ::profiler::flows_t                        flows; ///< Flows linking blocks of different threads (see EASY_FLOW_BEGIN)
         EasyBlocks                            gui_blocks; ///< Profiler graphics blocks builded by GUI
 
         QString                                    theme; ///< Current UI theme name
@@ -234,6 +235,7 @@ namespace profiler_gui {
         bool                               hex_thread_id; ///< Use hex view for thread-id instead of decimal
         bool                        enable_event_markers; ///< Enable event indicators painting (These are narrow rectangles at the bottom of each thread)
         bool                           enable_statistics; ///< Enable gathering and using statistics (Disable if you want to consume less memory)
+        bool                         compensate_overhead; ///< Subtract measured profiler overhead of nested blocks from parent blocks durations
         bool                          enable_zero_length; ///< Enable zero length blocks (if true, then such blocks will have width == 1 pixel on each scale)
         bool                add_zero_blocks_to_hierarchy; ///< Enable adding zero blocks into hierarchy tree
         bool                 draw_graphics_items_borders; ///< Draw borders for graphics blocks or not
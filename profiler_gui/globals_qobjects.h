@@ -82,6 +82,8 @@ namespace profiler_gui {
         void selectedBlockIdChanged(::profiler::block_id_t _id);
         void itemsExpandStateChanged();
         void blockStatusChanged(::profiler::block_id_t _id, ::profiler::EasyBlockStatus _status);
+        void blockSamplingChanged(::profiler::block_id_t _id, uint32_t _sampling);
+        void blockPerfCountersChanged(::profiler::block_id_t _id, bool _enable);
         void connectionChanged(bool _connected);
         void blocksRefreshRequired(bool);
         void expectedFrameTimeChanged();
@@ -125,6 +125,7 @@
 
 const int LOADER_TIMER_INTERVAL = 40;
 const auto NETWORK_CACHE_FILE = "easy_profiler_stream.cache";
+const uint64_t MAX_STREAMED_CAPTURE_SIZE = 256ULL << 20; ///< Oldest streamed parts are dropped above this size
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -386,6 +387,9 @@ MainWindow::MainWindow() : Parent(), m_theme("default"), m_lastAddress("localhos
     toolbar->addAction(QIcon(imagePath("list")), tr("Blocks"), this, SLOT(onEditBlocksClicked(bool)));
     m_captureAction = toolbar->addAction(QIcon(imagePath("start")), tr("Capture"), this, SLOT(onCaptureClicked(bool)));
     m_captureAction->setEnabled(false);
+    m_streamAction = toolbar->addAction(QIcon(imagePath("play")), tr("Stream"), this, SLOT(onStreamClicked(bool)));
+    m_streamAction->setToolTip(tr("Receive closed frames continuously while the application is running"));
+    m_streamAction->setEnabled(false);
 
     toolbar->addSeparator();
     m_connectAction = toolbar->addAction(QIcon(imagePath("connect")), tr("Connect"), this, SLOT(onConnectClicked(bool)));
@@ -462,6 +466,12 @@ MainWindow::MainWindow() : Parent(), m_theme("default"), m_lastAddress("localhos
         action->setIcon(QIcon(imagePath("stats-off")));
     }
 
+    action = menu->addAction("Compensate profiler overhead");
+    action->setToolTip("Subtract measured profiler overhead of nested blocks\nfrom durations of parent blocks.\nAvailable for captures made by profiler v2.5.0 or later.");
+    action->setCheckable(true);
+    action->setChecked(EASY_GLOBALS.compensate_overhead);
+    connect(action, &QAction::triggered, this, &This::onCompensateOverheadChange);
+
 
     action = menu->addAction("Only frames on histogram");
     action->setToolTip("Display only top-level blocks on histogram.");
@@ -898,6 +908,8 @@ MainWindow::MainWindow() : Parent(), m_theme("default"), m_lastAddress("localhos
 
     using profiler_gui::GlobalSignals;
     connect(&EASY_GLOBALS.events, &GlobalSignals::blockStatusChanged, this, &This::onBlockStatusChange);
+    connect(&EASY_GLOBALS.events, &GlobalSignals::blockSamplingChanged, this, &This::onBlockSamplingChange);
+    connect(&EASY_GLOBALS.events, &GlobalSignals::blockPerfCountersChanged, this, &This::onBlockPerfCountersChange);
     connect(&EASY_GLOBALS.events, &GlobalSignals::blocksRefreshRequired, this, &This::onGetBlockDescriptionsClicked);
     connect(&EASY_GLOBALS.events, &GlobalSignals::selectValue, this, &This::onSelectValue);
 }
@@ -1263,6 +1275,7 @@ void MainWindow::clear()
     EASY_GLOBALS.profiler_blocks.clear();
     EASY_GLOBALS.descriptors.clear();
     EASY_GLOBALS.gui_blocks.clear();
+    EASY_GLOBALS.flows.clear();
 
     m_serializedBlocks.clear();
     m_serializedDescriptors.clear();
@@ -1358,6 +1371,20 @@ void MainWindow::onEnableDisableStatistics(bool _checked)
     }
 }
 
+void MainWindow::onCompensateOverheadChange(bool _checked)
+{
+    EASY_GLOBALS.compensate_overhead = _checked;
+
+    // Overhead is compensated by reader, so reload current capture to show raw or compensated values
+    if (m_serializedBlocks.empty() || m_reader.isLoading())
+        return;
+
+    if (m_bNetworkFileRegime)
+        loadFile(QString(NETWORK_CACHE_FILE));
+    else if (!m_lastFiles.empty())
+        loadFile(m_lastFiles.front());
+}
+
 void MainWindow::onCollapseItemsAfterCloseChanged(bool _checked)
 {
     EASY_GLOBALS.collapse_items_on_tree_close = _checked;
@@ -1681,6 +1708,10 @@ void MainWindow::loadSettings()
     if (!flag.isNull())
         EASY_GLOBALS.enable_statistics = flag.toBool();
 
+    flag = settings.value("compensate_overhead");
+    if (!flag.isNull())
+        EASY_GLOBALS.compensate_overhead = flag.toBool();
+
     QString encoding = settings.value("encoding", "UTF-8").toString();
     auto default_codec_mib = QTextCodec::codecForName(encoding.toStdString().c_str())->mibEnum();
     auto default_codec = QTextCodec::codecForMib(default_codec_mib);
@@ -1777,6 +1808,7 @@ void MainWindow::saveSettingsAndGeometry()
     settings.setValue("use_decorated_thread_name", EASY_GLOBALS.use_decorated_thread_name);
     settings.setValue("hex_thread_id", EASY_GLOBALS.hex_thread_id);
     settings.setValue("enable_statistics", EASY_GLOBALS.enable_statistics);
+    settings.setValue("compensate_overhead", EASY_GLOBALS.compensate_overhead);
     settings.setValue("fps_timer_interval", EASY_GLOBALS.fps_timer_interval);
     settings.setValue("max_fps_history", EASY_GLOBALS.max_fps_history);
     settings.setValue("fps_widget_line_width", EASY_GLOBALS.fps_widget_line_width);
@@ -1822,6 +1854,7 @@ void MainWindow::setDisconnected(bool _showMessage)
 
     EASY_GLOBALS.connected = false;
     m_captureAction->setEnabled(false);
+    m_streamAction->setEnabled(false);
     m_connectAction->setIcon(QIcon(imagePath("connect")));
     m_connectAction->setText(tr("Connect"));
 
@@ -1875,6 +1908,36 @@ void MainWindow::checkFrameTimeReady()
 
 void MainWindow::onListenerTimerTimeout()
 {
+    if (m_listener.regime() == ListenerRegime::Streaming)
+    {
+        std::stringstream stream;
+
+        if (m_listener.captured() || !m_listener.connected())
+        {
+            // Streaming finished: all parts have been received or connection was lost
+            if (m_listenerTimer.isActive())
+                m_listenerTimer.stop();
+
+            m_listener.finalizeCapture();
+
+            m_streamAction->setIcon(QIcon(imagePath("play")));
+            m_streamAction->setText(tr("Stream"));
+            m_streamAction->setEnabled(EASY_GLOBALS.connected);
+            m_captureAction->setEnabled(EASY_GLOBALS.connected);
+
+            if (m_listener.takeStreamedCapture(stream))
+                readStream(stream);
+        }
+        else if (!m_readerTimer.isActive() && m_listener.takeStreamedCapture(stream))
+        {
+            // Reload all received frames without progress dialog to not disturb user
+            m_readerTimer.start();
+            m_reader.load(stream);
+        }
+
+        return;
+    }
+
     if (!m_listener.connected())
     {
         if (m_listener.regime() == ListenerRegime::Capture_Receive)
@@ -2088,6 +2151,9 @@ void MainWindow::onLoadingFinish(profiler::block_index_t& _nblocks)
         EASY_GLOBALS.descriptors.swap(descriptors);
         EASY_GLOBALS.bookmarks.swap(bookmarks);
 
+        EASY_GLOBALS.flows.clear();
+        ::profiler::fillFlows(EASY_GLOBALS.profiler_blocks, EASY_GLOBALS.flows);
+
         EASY_GLOBALS.gui_blocks.clear();
         EASY_GLOBALS.gui_blocks.resize(_nblocks);
         memset(EASY_GLOBALS.gui_blocks.data(), 0, sizeof(profiler_gui::EasyBlock) * _nblocks);
@@ -2248,17 +2314,17 @@ void FileReader::load(const QString& _filename)
     m_isSnapshot = false;
     m_filename = _filename;
 
-    m_thread = std::thread([this](bool _enableStatistics)
+    m_thread = std::thread([this](bool _enableStatistics, bool _compensateOverhead)
     {
         m_size.store(fillTreesFromFile(m_progress, m_filename.toStdString().c_str(), m_beginEndTime, m_serializedBlocks,
                                        m_serializedDescriptors, m_descriptors, m_blocks, m_blocksTree,
                                        m_bookmarks, m_descriptorsNumberInFile, m_version, m_pid,
-                                       _enableStatistics, m_errorMessage), std::memory_order_release);
+                                       _enableStatistics, _compensateOverhead, m_errorMessage), std::memory_order_release);
 
         m_progress.store(100, std::memory_order_release);
         m_bDone.store(true, std::memory_order_release);
 
-    }, EASY_GLOBALS.enable_statistics);
+    }, EASY_GLOBALS.enable_statistics, EASY_GLOBALS.compensate_overhead);
 }
 
 void FileReader::load(std::stringstream& _stream)
@@ -2280,7 +2346,7 @@ void FileReader::load(std::stringstream& _stream)
     m_stream.swap(_stream);
 #endif
 
-    m_thread = std::thread([this](bool _enableStatistics)
+    m_thread = std::thread([this](bool _enableStatistics, bool _compensateOverhead)
     {
         std::ofstream cache_file(NETWORK_CACHE_FILE, std::fstream::binary);
         if (cache_file.is_open())
@@ -2291,12 +2357,12 @@ void FileReader::load(std::stringstream& _stream)
 
         m_size.store(fillTreesFromStream(m_progress, m_stream, m_beginEndTime, m_serializedBlocks, m_serializedDescriptors,
                                          m_descriptors, m_blocks, m_blocksTree, m_bookmarks, m_descriptorsNumberInFile,
-                                         m_version, m_pid, _enableStatistics, m_errorMessage), std::memory_order_release);
+                                         m_version, m_pid, _enableStatistics, _compensateOverhead, m_errorMessage), std::memory_order_release);
 
         m_progress.store(100, std::memory_order_release);
         m_bDone.store(true, std::memory_order_release);
 
-    }, EASY_GLOBALS.enable_statistics);
+    }, EASY_GLOBALS.enable_statistics, EASY_GLOBALS.compensate_overhead);
 }
 
 void FileReader::save(const QString& _filename, profiler::timestamp_t _beginTime, profiler::timestamp_t _endTime,
@@ -2547,6 +2613,7 @@ void MainWindow::onConnectClicked(bool)
     qInfo() << "Connected successfully";
     EASY_GLOBALS.connected = true;
     m_captureAction->setEnabled(true);
+    m_streamAction->setEnabled(true);
     m_connectAction->setIcon(QIcon(imagePath("connected")));
     m_connectAction->setText(tr("Disconnect"));
 
@@ -2591,7 +2658,8 @@ void MainWindow::onCaptureClicked(bool)
 
     if (m_listener.regime() != ListenerRegime::Idle)
     {
-        if (m_listener.regime() == ListenerRegime::Capture || m_listener.regime() == ListenerRegime::Capture_Receive)
+        if (m_listener.regime() == ListenerRegime::Capture || m_listener.regime() == ListenerRegime::Capture_Receive ||
+            m_listener.regime() == ListenerRegime::Streaming)
         {
             Dialog::warning(this, "Warning",
                 "Already capturing frames.\nFinish old capturing session first.", QMessageBox::Close);
@@ -2643,6 +2711,56 @@ void MainWindow::onCaptureClicked(bool)
     m_listenerDialog->show();
 }
 
+void MainWindow::onStreamClicked(bool)
+{
+    if (!EASY_GLOBALS.connected)
+    {
+        Dialog::warning(this, "Warning", "No connection with profiling app", QMessageBox::Close);
+        return;
+    }
+
+    if (m_listener.regime() == ListenerRegime::Streaming)
+    {
+        // The rest of frames would be received and loaded by onListenerTimerTimeout()
+        m_listener.stopStreaming();
+        m_streamAction->setEnabled(false);
+        return;
+    }
+
+    if (m_listener.regime() != ListenerRegime::Idle)
+    {
+        Dialog::warning(this, "Warning",
+            "Already capturing frames.\nFinish old capturing session first.", QMessageBox::Close);
+        return;
+    }
+
+    if (!m_listener.startStreaming())
+    {
+        // Connection lost. Try to restore connection.
+
+        profiler::net::EasyProfilerStatus reply(false, false, false);
+        if (!m_listener.connect(m_lastAddress.toStdString().c_str(), m_lastPort, reply))
+        {
+            m_listener.closeSocket();
+            setDisconnected();
+            return;
+        }
+
+        if (!m_listener.startStreaming())
+        {
+            m_listener.closeSocket();
+            setDisconnected();
+            return;
+        }
+    }
+
+    m_streamAction->setIcon(QIcon(imagePath("stop")));
+    m_streamAction->setText(tr("Stop streaming"));
+    m_captureAction->setEnabled(false);
+
+    m_listenerTimer.start(250);
+}
+
 void MainWindow::onGetBlockDescriptionsClicked(bool)
 {
     if (!EASY_GLOBALS.connected)
@@ -2802,6 +2920,18 @@ void MainWindow::onBlockStatusChange(profiler::block_id_t _id, profiler::EasyBlo
         m_listener.send(profiler::net::BlockStatusMessage(_id, static_cast<uint8_t>(_status)));
 }
 
+void MainWindow::onBlockSamplingChange(profiler::block_id_t _id, uint32_t _sampling)
+{
+    if (EASY_GLOBALS.connected)
+        m_listener.send(profiler::net::BlockSamplingMessage(_id, _sampling));
+}
+
+void MainWindow::onBlockPerfCountersChange(profiler::block_id_t _id, bool _enable)
+{
+    if (EASY_GLOBALS.connected)
+        m_listener.send(profiler::net::BlockPerfCountersMessage(_id, _enable));
+}
+
 void MainWindow::onSelectValue(profiler::thread_id_t _thread_id, uint32_t _value_index, const profiler::ArbitraryValue& _value)
 {
     onEditBlocksClicked(true);
@@ -2840,8 +2970,12 @@ SocketListener::SocketListener() : m_receivedSize(0), m_port(0), m_regime(Listen
     m_bStopReceive = false;
     m_bFrameTimeReady = false;
     m_bCaptureReady = false;
+    m_bStreamUpdated = false;
     m_frameMax = 0;
     m_frameAvg = 0;
+
+    // All received frames are reloaded on each update, so only the latest ones are kept
+    m_streamedCapture.setMaxSize(MAX_STREAMED_CAPTURE_SIZE);
 }
 
 SocketListener::~SocketListener()
@@ -3102,6 +3236,66 @@ void SocketListener::requestBlocksDescription()
     m_regime = ListenerRegime::Idle;
 }
 
+bool SocketListener::startStreaming()
+{
+    if (m_thread.joinable())
+    {
+        m_bInterrupt.store(true, std::memory_order_release);
+        m_thread.join();
+        m_bInterrupt.store(false, std::memory_order_release);
+    }
+
+    clearData();
+
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_streamedCapture.clear();
+    }
+
+    m_bStreamUpdated.store(false, std::memory_order_release);
+
+    profiler::net::Message request(profiler::net::MessageType::Request_Start_Streaming);
+    m_easySocket.send(&request, sizeof(request));
+
+    if (m_easySocket.isDisconnected())
+    {
+        m_bConnected.store(false, std::memory_order_release);
+        return false;
+    }
+
+    m_regime = ListenerRegime::Streaming;
+    m_bCaptureReady.store(false, std::memory_order_release);
+    m_thread = std::thread(&SocketListener::listenStreaming, this);
+
+    return true;
+}
+
+void SocketListener::stopStreaming()
+{
+    if (m_regime != ListenerRegime::Streaming)
+        return;
+
+    // Listening thread continues receiving until Reply_Blocks_End
+    profiler::net::Message request(profiler::net::MessageType::Request_Stop_Streaming);
+    m_easySocket.send(&request, sizeof(request));
+
+    if (m_easySocket.isDisconnected())
+        m_bConnected.store(false, std::memory_order_release);
+}
+
+bool SocketListener::takeStreamedCapture(std::stringstream& _stream)
+{
+    if (!m_bStreamUpdated.exchange(false, std::memory_order_acq_rel))
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    if (m_streamedCapture.empty())
+        return false;
+
+    m_streamedCapture.write(_stream);
+    return true;
+}
+
 bool SocketListener::frameTime(uint32_t& _maxTime, uint32_t& _avgTime)
 {
     if (m_bFrameTimeReady.exchange(false, std::memory_order_acquire))
@@ -3143,6 +3337,36 @@ bool SocketListener::requestFrameTime()
 
 //////////////////////////////////////////////////////////////////////////
 
+bool SocketListener::receiveMessageHeader(char* _buffer, int _bufferSize, int& _seek, int& _bytes, int _headerSize)
+{
+    // Data messages are received by pieces, so a message header may be split between two pieces.
+    // Move the beginning of the header to the buffer start and receive the rest of it.
+    while ((_bytes - _seek) < _headerSize)
+    {
+        const int rest = _bytes - _seek;
+        if (rest > 0 && _seek != 0)
+            memmove(_buffer, _buffer + _seek, rest);
+
+        _seek = 0;
+        _bytes = rest;
+
+        if (m_bInterrupt.load(std::memory_order_acquire))
+            return false;
+
+        const int received = m_easySocket.receive(_buffer + rest, _bufferSize - rest);
+        if (received == 0 || (received == -1 && m_easySocket.isDisconnected()))
+        {
+            m_bConnected.store(false, std::memory_order_release);
+            return false;
+        }
+
+        if (received > 0)
+            _bytes += received;
+    }
+
+    return true;
+}
+
 void SocketListener::listenCapture()
 {
     EASY_STATIC_CONSTEXPR int buffer_size = 8 * 1024 * 1024;
@@ -3161,30 +3385,9 @@ void SocketListener::listenCapture()
             m_bStopReceive.store(false, std::memory_order_release);
         }
 
-        if ((bytes - seek) == 0)
-        {
-            bytes = m_easySocket.receive(buffer, buffer_size);
-
-            if (bytes == -1)
-            {
-                if (m_easySocket.isDisconnected())
-                {
-                    m_bConnected.store(false, std::memory_order_release);
-                    isListen = false;
-                    disconnected = true;
-                }
-
-                seek = 0;
-                bytes = 0;
-
-                continue;
-            }
-
-            seek = 0;
-        }
-
-        if (bytes == 0)
+        if (!receiveMessageHeader(buffer, buffer_size, seek, bytes, sizeof(profiler::net::Message)))
         {
+            disconnected = !connected();
             isListen = false;
             break;
         }
@@ -3233,11 +3436,22 @@ void SocketListener::listenCapture()
 
                 case profiler::net::MessageType::Reply_Blocks:
                 {
-                    qInfo() << "Receive MessageType::Reply_Blocks";
+                    if (m_receivedSize == 0)
+                    {
+                        qInfo() << "Receive MessageType::Reply_Blocks";
+                        timeBegin = std::chrono::system_clock::now();
+                    }
 
+                    // Blocks are sent by pieces: each Reply_Blocks message contains next piece of data
+                    if (!receiveMessageHeader(buffer, buffer_size, seek, bytes, sizeof(profiler::net::DataMessage)))
+                    {
+                        disconnected = !connected();
+                        isListen = false;
+                        break;
+                    }
+
+                    auto dm = reinterpret_cast<const profiler::net::DataMessage*>(buffer + seek);
                     seek += sizeof(profiler::net::DataMessage);
-                    auto dm = (profiler::net::DataMessage*)message;
-                    timeBegin = std::chrono::system_clock::now();
 
                     int neededSize = dm->size;
 
@@ -3270,9 +3484,11 @@ void SocketListener::listenCapture()
                                 isListen = false;
                                 disconnected = true;
                                 neededSize = 0;
+                                seek = bytes = 0;
+                                break;
                             }
 
-                            break;
+                            continue;
                         }
 
                         buf = buffer;
@@ -3309,6 +3525,129 @@ void SocketListener::listenCapture()
     m_bCaptureReady.store(true, std::memory_order_release);
 }
 
+void SocketListener::listenStreaming()
+{
+    EASY_STATIC_CONSTEXPR int buffer_size = 8 * 1024 * 1024;
+
+    char* buffer = new char[buffer_size];
+    int seek = 0, bytes = 0;
+    std::string part;
+
+    // Each part is a complete capture of frames closed since previous part.
+    // It is sent as a sequence of Reply_Blocks messages followed by Reply_Blocks_Part
+    // (or Reply_Blocks_End for the last part).
+    const auto finishPart = [this, &part]
+    {
+        if (part.empty())
+            return;
+
+        std::stringstream errorMessage;
+
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        const auto droppedParts = m_streamedCapture.droppedParts();
+        if (m_streamedCapture.append(part.data(), part.size(), errorMessage))
+        {
+            m_bStreamUpdated.store(true, std::memory_order_release);
+            if (droppedParts == 0 && m_streamedCapture.droppedParts() != 0)
+                qInfo() << "Streamed capture exceeds" << static_cast<int>(MAX_STREAMED_CAPTURE_SIZE >> 20) << "MB, the oldest frames are dropped";
+        }
+        else
+        {
+            qWarning() << "Bad stream part: " << errorMessage.str().c_str();
+        }
+
+        part.clear();
+    };
+
+    bool isListen = true;
+    while (isListen && !m_bInterrupt.load(std::memory_order_acquire))
+    {
+        if (!receiveMessageHeader(buffer, buffer_size, seek, bytes, sizeof(profiler::net::Message)))
+            break;
+
+        auto message = reinterpret_cast<const profiler::net::Message*>(buffer + seek);
+        if (!message->isEasyNetMessage())
+        {
+            seek = bytes = 0;
+            continue;
+        }
+
+        switch (message->type)
+        {
+            case profiler::net::MessageType::Reply_Streaming_Started:
+            {
+                qInfo() << "Receive MessageType::Reply_Streaming_Started";
+                seek += sizeof(profiler::net::Message);
+                break;
+            }
+
+            case profiler::net::MessageType::Reply_Blocks_Part:
+            {
+                seek += sizeof(profiler::net::Message);
+                finishPart();
+                break;
+            }
+
+            case profiler::net::MessageType::Reply_Blocks_End:
+            {
+                qInfo() << "Receive MessageType::Reply_Blocks_End";
+                seek += sizeof(profiler::net::Message);
+                finishPart();
+                isListen = false;
+                break;
+            }
+
+            case profiler::net::MessageType::Reply_Blocks:
+            {
+                if (!receiveMessageHeader(buffer, buffer_size, seek, bytes, sizeof(profiler::net::DataMessage)))
+                {
+                    isListen = false;
+                    break;
+                }
+
+                int neededSize = reinterpret_cast<const profiler::net::DataMessage*>(buffer + seek)->size;
+                seek += sizeof(profiler::net::DataMessage);
+
+                const int bytesNumber = std::min(neededSize, bytes - seek);
+                part.append(buffer + seek, bytesNumber);
+                neededSize -= bytesNumber;
+                seek += bytesNumber;
+
+                while (neededSize > 0)
+                {
+                    bytes = m_easySocket.receive(buffer, buffer_size);
+
+                    if (bytes <= 0)
+                    {
+                        if (bytes == 0 || m_easySocket.isDisconnected())
+                        {
+                            m_bConnected.store(false, std::memory_order_release);
+                            isListen = false;
+                            break;
+                        }
+
+                        continue;
+                    }
+
+                    seek = std::min(bytes, neededSize);
+                    part.append(buffer, seek);
+                    neededSize -= seek;
+                }
+
+                break;
+            }
+
+            default:
+                seek += sizeof(profiler::net::Message);
+                break;
+        }
+    }
+
+    delete [] buffer;
+
+    m_bCaptureReady.store(true, std::memory_order_release);
+}
+
 void SocketListener::listenDescription()
 {
     EASY_STATIC_CONSTEXPR int buffer_size = 8 * 1024 * 1024;
@@ -55,6 +55,7 @@
 #define EASY_PROFILER_GUI__MAIN_WINDOW__H
 
 #include <atomic>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -158,7 +159,8 @@ enum class ListenerRegime : uint8_t
     Idle = 0,
     Capture,
     Capture_Receive,
-    Descriptors
+    Descriptors,
+    Streaming
 };
 
 class SocketListener Q_DECL_FINAL
@@ -176,6 +178,9 @@ class SocketListener Q_DECL_FINAL
     std::atomic_bool    m_bStopReceive; ///<
     std::atomic_bool   m_bCaptureReady; ///<
     std::atomic_bool m_bFrameTimeReady; ///<
+    std::atomic_bool  m_bStreamUpdated; ///< New parts have been received since last takeStreamedCapture()
+    std::mutex           m_streamMutex; ///< Guards m_streamedCapture
+    profiler::StreamedCapture m_streamedCapture; ///< Parts received in streaming regime
     ListenerRegime            m_regime; ///<
 
 public:
@@ -203,6 +208,10 @@ public:
     void finalizeCapture();
     void requestBlocksDescription();
 
+    bool startStreaming();
+    void stopStreaming();
+    bool takeStreamedCapture(std::stringstream& _stream);
+
     bool frameTime(uint32_t& _maxTime, uint32_t& _avgTime);
     bool requestFrameTime();
 
@@ -216,6 +225,9 @@ private:
     void listenCapture();
     void listenDescription();
     void listenFrameTime();
+    void listenStreaming();
+
+    bool receiveMessageHeader(char* _buffer, int _bufferSize, int& _seek, int& _bytes, int _headerSize);
 
 }; // END of class SocketListener.
 
@@ -294,6 +306,7 @@ protected:
     class QAction*   m_deleteAction = nullptr;
 
     class QAction*              m_captureAction = nullptr;
+    class QAction*               m_streamAction = nullptr;
     class QAction*              m_connectAction = nullptr;
     class QAction*   m_eventTracingEnableAction = nullptr;
     class QAction* m_eventTracingPriorityAction = nullptr;
@@ -329,6 +342,7 @@ protected slots:
     void onRulerTextPosChanged(bool);
     void onUnitsChanged(bool);
     void onEnableDisableStatistics(bool);
+    void onCompensateOverheadChange(bool);
     void onCollapseItemsAfterCloseChanged(bool);
     void onAllItemsExpandedByDefaultChange(bool);
     void onBindExpandStatusChange(bool);
@@ -350,6 +364,7 @@ protected slots:
     void onDescTreeDialogClose(int);
     void onListenerDialogClose(int);
     void onCaptureClicked(bool);
+    void onStreamClicked(bool);
     void onGetBlockDescriptionsClicked(bool);
     void onConnectClicked(bool);
     void onEventTracingPriorityChange(bool _checked);
@@ -362,6 +377,8 @@ protected slots:
     void onLeftWindowHeaderPosition(bool _checked);
 
     void onBlockStatusChange(profiler::block_id_t _id, profiler::EasyBlockStatus _status);
+    void onBlockSamplingChange(profiler::block_id_t _id, uint32_t _sampling);
+    void onBlockPerfCountersChange(profiler::block_id_t _id, bool _enable);
 
     void onSelectValue(profiler::thread_id_t _thread_id, uint32_t _value_index, const profiler::ArbitraryValue& _value);
 
@@ -105,6 +105,18 @@ EASY_CONSTEXPR int ColumnBit[COL_COLUMNS_NUMBER] = {
 
     , 16 //    COL_ACTIVE_TIME,
     , -1 //    COL_ACTIVE_PERCENT,
+
+    , -1 //    COL_TASK_CLOCK_PER_THREAD,
+    , -1 //    COL_PAGE_FAULTS_PER_THREAD,
+    , -1 //    COL_CONTEXT_SWITCHES_PER_THREAD,
+    , -1 //    COL_CPU_MIGRATIONS_PER_THREAD,
+    , -1 //    COL_CYCLES_PER_THREAD,
+    , -1 //    COL_INSTRUCTIONS_PER_THREAD,
+
+    , -1 //    COL_ALLOCATED_BYTES_PER_THREAD,
+    , -1 //    COL_ALLOCATED_SELF_BYTES_PER_THREAD,
+    , -1 //    COL_ALLOCATIONS_PER_THREAD,
+    , -1 //    COL_ALLOCATIONS_SELF_PER_THREAD,
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -154,6 +166,11 @@ bool TreeWidgetItem::operator < (const Parent& _other) const
         }
 
         case COL_ACTIVE_PERCENT:
+        case COL_PAGE_FAULTS_PER_THREAD:
+        case COL_CONTEXT_SWITCHES_PER_THREAD:
+        case COL_CPU_MIGRATIONS_PER_THREAD:
+        case COL_CYCLES_PER_THREAD:
+        case COL_INSTRUCTIONS_PER_THREAD:
         {
             return data(col, Qt::UserRole).toDouble() < _other.data(col, Qt::UserRole).toDouble();
         }
@@ -108,6 +108,20 @@ enum EasyColumnsIndexes
     COL_ACTIVE_TIME,
     COL_ACTIVE_PERCENT,
 
+    // Average values of performance counters per thread (in order of profiler::PerfCounter)
+    COL_TASK_CLOCK_PER_THREAD,
+    COL_PAGE_FAULTS_PER_THREAD,
+    COL_CONTEXT_SWITCHES_PER_THREAD,
+    COL_CPU_MIGRATIONS_PER_THREAD,
+    COL_CYCLES_PER_THREAD,
+    COL_INSTRUCTIONS_PER_THREAD,
+
+    // Heap allocations per thread (see profiler::setAllocationTracking)
+    COL_ALLOCATED_BYTES_PER_THREAD,
+    COL_ALLOCATED_SELF_BYTES_PER_THREAD,
+    COL_ALLOCATIONS_PER_THREAD,
+    COL_ALLOCATIONS_SELF_PER_THREAD,
+
     COL_COLUMNS_NUMBER
 };
 
@@ -75,6 +75,57 @@
 #define EASY_INIT_ATOMIC(v) {v}
 #endif
 
+/** Fills columns with average values of performance counters sampled for the block (see BaseBlockDescriptor::perfCounters()). */
+static void setPerfCounters(TreeWidgetItem* _item, const ::profiler::BlockStatistics& _stats, ::profiler_gui::TimeUnits _units)
+{
+    for (int i = 0; i < ::profiler::PERF_COUNTERS_NUMBER; ++i)
+    {
+        if ((_stats.counters_mask & (1 << i)) == 0)
+            continue;
+
+        const auto counter = static_cast<::profiler::PerfCounter>(i);
+        const int column = COL_TASK_CLOCK_PER_THREAD + i;
+        const auto value = _stats.average_counter(counter);
+
+        if (counter == ::profiler::PERF_TASK_CLOCK)
+        {
+            _item->setTimeSmart(column, _units, static_cast<::profiler::timestamp_t>(value + 0.5));
+        }
+        else
+        {
+            _item->setData(column, Qt::UserRole, value);
+            _item->setText(column, QString::number(value, 'f', 1));
+        }
+    }
+}
+
+static QString memorySizeString(uint64_t _bytes)
+{
+    if (_bytes < 1024)
+        return QString("%1 B").arg(_bytes);
+    if (_bytes < 1024 * 1024)
+        return QString("%1 KB").arg(static_cast<double>(_bytes) / 1024., 0, 'f', 1);
+    if (_bytes < 1024 * 1024 * 1024)
+        return QString("%1 MB").arg(static_cast<double>(_bytes) / (1024. * 1024.), 0, 'f', 1);
+    return QString("%1 GB").arg(static_cast<double>(_bytes) / (1024. * 1024. * 1024.), 0, 'f', 1);
+}
+
+/** Fills columns with heap allocations of the block (see profiler::setAllocationTracking()). */
+static void setAllocations(TreeWidgetItem* _item, const ::profiler::BlockStatistics& _stats)
+{
+    if (_stats.allocations_number == 0)
+        return;
+
+    _item->setData(COL_ALLOCATED_BYTES_PER_THREAD, Qt::UserRole, static_cast<quint64>(_stats.allocated_bytes));
+    _item->setText(COL_ALLOCATED_BYTES_PER_THREAD, memorySizeString(_stats.allocated_bytes));
+    _item->setData(COL_ALLOCATED_SELF_BYTES_PER_THREAD, Qt::UserRole, static_cast<quint64>(_stats.allocated_self_bytes));
+    _item->setText(COL_ALLOCATED_SELF_BYTES_PER_THREAD, memorySizeString(_stats.allocated_self_bytes));
+    _item->setData(COL_ALLOCATIONS_PER_THREAD, Qt::UserRole, static_cast<quint64>(_stats.allocations_number));
+    _item->setText(COL_ALLOCATIONS_PER_THREAD, QString::number(_stats.allocations_number));
+    _item->setData(COL_ALLOCATIONS_SELF_PER_THREAD, Qt::UserRole, static_cast<quint64>(_stats.allocations_self_number));
+    _item->setText(COL_ALLOCATIONS_SELF_PER_THREAD, QString::number(_stats.allocations_self_number));
+}
+
 TreeWidgetLoader::TreeWidgetLoader()
     : m_bDone(EASY_INIT_ATOMIC(false))
     , m_bInterrupt(EASY_INIT_ATOMIC(false))
@@ -418,6 +469,8 @@ void TreeWidgetLoader::setTreeInternal2(const ::profiler::timestamp_t& _beginTim
 
             item->setData(COL_NCALLS_PER_THREAD, Qt::UserRole, per_thread_stats->calls_number);
             item->setText(COL_NCALLS_PER_THREAD, QString::number(per_thread_stats->calls_number));
+            setPerfCounters(item, *per_thread_stats, _units);
+            setAllocations(item, *per_thread_stats);
 
             percentage_per_thread = ::profiler_gui::percent(per_thread_stats->total_duration, block.root->profiled_time);
             item->setData(COL_PERCENT_SUM_PER_THREAD, Qt::UserRole, percentage_per_thread);
@@ -667,6 +720,8 @@ size_t TreeWidgetLoader::setTreeInternal(const ::profiler::BlocksTreeRoot& _thre
 
             item->setData(COL_NCALLS_PER_THREAD, Qt::UserRole, per_thread_stats->calls_number);
             item->setText(COL_NCALLS_PER_THREAD, QString::number(per_thread_stats->calls_number));
+            setPerfCounters(item, *per_thread_stats, _units);
+            setAllocations(item, *per_thread_stats);
 
             auto percentage_per_thread = ::profiler_gui::percent(per_thread_stats->total_duration, _threadRoot.profiled_time);
             item->setData(COL_PERCENT_SUM_PER_THREAD, Qt::UserRole, percentage_per_thread);
@@ -936,6 +991,8 @@ size_t TreeWidgetLoader::setTreeInternalPlain(const ::profiler::BlocksTreeRoot&
             item->setTimeSmart(COL_DURATION_SUM_PER_THREAD, _units, per_thread_stats->total_duration);
             item->setData(COL_NCALLS_PER_THREAD, Qt::UserRole, per_thread_stats->calls_number);
             item->setText(COL_NCALLS_PER_THREAD, QString::number(per_thread_stats->calls_number));
+            setPerfCounters(item, *per_thread_stats, _units);
+            setAllocations(item, *per_thread_stats);
 
             auto percentage_per_thread = ::profiler_gui::percent(per_thread_stats->total_duration, _threadRoot.profiled_time);
             item->setData(COL_PERCENT_SUM_PER_THREAD, Qt::UserRole, percentage_per_thread);
@@ -122,7 +122,7 @@ int main(int argc, char* argv[])
 
     auto blocks_counter = fillTreesFromFile(filename.c_str(), beginEndTime, serialized_blocks, serialized_descriptors,
                                             descriptors, blocks, threaded_trees, bookmarks, descriptorsNumberInFile,
-                                            version, pid, true, errorMessage);
+                                            version, pid, true, false, errorMessage);
     if (blocks_counter == 0)
         std::cout << "Can not read blocks from file " << filename.c_str() << "\nReason: " << errorMessage.str();
 
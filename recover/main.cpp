@@ -0,0 +1,37 @@
+///std
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <easy/reader.h>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argv[1] == nullptr)
+    {
+        std::cout << "Usage: " << argv[0] << " CAPTURE_DIRECTORY [OUTPUT_PROF_FILE]\n"
+                                             "where:\n"
+                                             "CAPTURE_DIRECTORY (easy_capture_<pid> directory left by a crashed process) // Required\n"
+                                             "OUTPUT_PROF_FILE (if not specified then CAPTURE_DIRECTORY.prof) // Optional\n";
+        return 1;
+    }
+
+    std::string directory = argv[1];
+    while (directory.size() > 1 && directory.back() == '/')
+        directory.pop_back();
+
+    const std::string filename = argc > 2 && argv[2] ? std::string(argv[2]) : directory + ".prof";
+
+    std::stringstream log;
+    const auto blocksNumber = recoverCrashCapture(directory.c_str(), filename.c_str(), log);
+
+    const auto messages = log.str();
+    if (!messages.empty())
+        std::cerr << messages << std::endl;
+
+    if (blocksNumber == 0)
+        return 1;
+
+    std::cout << "Recovered " << blocksNumber << " blocks into \"" << filename << "\"\n";
+
+    return 0;
+}
@@ -0,0 +1,204 @@
+// Checks that context switches of sample threads appear in the dump.
+//
+// Usage: profiler_sample_event_tracing [context switch log-file]
+//
+// Context switches are traced by perf events if kernel.perf_event_paranoid allows it. Otherwise they are read
+// from the log-file written by scripts/context_switch_logger_binary.stp. If the log-file is not specified
+// the sample writes it itself from the sleeps of its threads, so the fallback path can be checked without stap.
+// Returns 0 if every worker thread has context switch events in the dump.
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <mutex>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <easy/profiler.h>
+#include <easy/reader.h>
+
+static const int THREADS = 4;
+static const int FRAMES = 50;
+static const char* const DUMP_FILENAME = "event_tracing.prof";
+static const char* const LOG_FILENAME = "event_tracing_cs.log";
+
+// Binary log layout written by scripts/context_switch_logger_binary.stp (see easy_profiler_core/cswitch_log.h)
+#pragma pack(push, 1)
+struct LogHeader
+{
+    uint64_t  signature;
+    uint32_t    version;
+    uint32_t recordSize;
+};
+
+struct LogRecord
+{
+    uint64_t      timestamp;
+    uint64_t     threadFrom;
+    uint64_t       threadTo;
+    uint32_t    processFrom;
+    uint32_t      processTo;
+    char     targetName[16];
+};
+#pragma pack(pop)
+
+struct Sleep
+{
+    uint64_t thread;
+    uint64_t begin;
+    uint64_t end;
+};
+
+std::mutex sleepsMutex;
+std::vector<Sleep> sleeps;
+
+static int perfEventParanoid()
+{
+    int value = 2;
+    std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+    file >> value;
+    return value;
+}
+
+void worker(int _index)
+{
+    const std::string name = "Worker " + std::to_string(_index);
+    EASY_THREAD(name.c_str());
+
+    const auto thread = static_cast<uint64_t>(syscall(SYS_gettid));
+    std::vector<Sleep> local;
+
+    for (int i = 0; i < FRAMES; ++i)
+    {
+        EASY_BLOCK("Frame");
+
+        {
+            EASY_BLOCK("Work", profiler::colors::Green);
+            volatile double x = 0;
+            for (int j = 0; j < 10000; ++j)
+                x += j * 0.5;
+        }
+
+        EASY_BLOCK("Sleep", profiler::colors::Blue);
+        const auto begin = profiler::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        local.push_back(Sleep {thread, begin, profiler::now()});
+    }
+
+    std::lock_guard<std::mutex> lock(sleepsMutex);
+    sleeps.insert(sleeps.end(), local.begin(), local.end());
+}
+
+// Writes the log as the stap script would do: a thread is switched to idle when it falls asleep
+// and back when it wakes up.
+static bool writeLog(const char* _filename)
+{
+    std::ofstream file(_filename, std::fstream::binary);
+    if (!file.is_open())
+        return false;
+
+    const LogHeader header = {0x3157534359534145ULL /* "EASYCSW1" */, 1, sizeof(LogRecord)};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const auto pid = static_cast<uint32_t>(getpid());
+    for (const auto& sleep : sleeps)
+    {
+        LogRecord record;
+        memset(&record, 0, sizeof(record));
+
+        record.timestamp = sleep.begin;
+        record.threadFrom = sleep.thread;
+        record.processFrom = pid;
+        strncpy(record.targetName, "swapper/0", sizeof(record.targetName));
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+
+        record.timestamp = sleep.end;
+        record.threadFrom = 0;
+        record.threadTo = sleep.thread;
+        record.processFrom = 0;
+        record.processTo = pid;
+        strncpy(record.targetName, "event_tracing", sizeof(record.targetName));
+        file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    return file.good();
+}
+
+int main(int argc, char* argv[])
+{
+    const bool ownLog = argc < 2;
+    const char* logFilename = ownLog ? LOG_FILENAME : argv[1];
+
+    const int paranoid = perfEventParanoid();
+    std::cout << "kernel.perf_event_paranoid = " << paranoid << std::endl;
+    std::cout << "Context switch log-file (used if perf events are not permitted): " << logFilename
+              << (ownLog ? " (written by the sample)" : "") << std::endl;
+
+    EASY_SET_EVENT_TRACING_ENABLED(true);
+    EASY_EVENT_TRACING_SET_LOG(logFilename);
+    EASY_PROFILER_ENABLE;
+    EASY_MAIN_THREAD;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; ++i)
+        threads.emplace_back(worker, i);
+    for (auto& thread : threads)
+        thread.join();
+
+    // The log is read only if the perf events tracer was not launched
+    if (ownLog && !writeLog(logFilename))
+    {
+        std::cout << "Can not write context switch log-file " << logFilename << std::endl;
+        return 1;
+    }
+
+    const auto blocksCount = profiler::dumpBlocksToFile(DUMP_FILENAME);
+    std::cout << "Blocks count: " << blocksCount << std::endl;
+
+    profiler::SerializedData serialized_blocks, serialized_descriptors;
+    profiler::descriptors_list_t descriptors;
+    profiler::blocks_t blocks;
+    profiler::thread_blocks_tree_t trees;
+    profiler::bookmarks_t bookmarks;
+    profiler::BeginEndTime beginEndTime;
+    std::stringstream errorMessage;
+    uint32_t descriptorsNumberInFile = 0;
+    uint32_t version = 0;
+    profiler::processid_t pid = 0;
+
+    if (fillTreesFromFile(DUMP_FILENAME, beginEndTime, serialized_blocks, serialized_descriptors, descriptors, blocks,
+                          trees, bookmarks, descriptorsNumberInFile, version, pid, false, false, errorMessage) == 0)
+    {
+        std::cout << "Can not read blocks from file " << DUMP_FILENAME << "\nReason: " << errorMessage.str();
+        return 1;
+    }
+
+    int result = 0, workers = 0;
+    for (const auto& thread : trees)
+    {
+        const auto& root = thread.second;
+        if (root.thread_name.compare(0, 7, "Worker ") != 0)
+            continue;
+
+        ++workers;
+        std::cout << root.thread_name << ": " << root.sync.size() << " context switches" << std::endl;
+        if (root.sync.empty())
+            result = 1;
+    }
+
+    if (workers != THREADS)
+    {
+        std::cout << "Expected " << THREADS << " worker threads in the dump, found " << workers << std::endl;
+        result = 1;
+    }
+
+    std::cout << (result == 0 ? "OK" : "FAILED: context switches are missing") << std::endl;
+    return result;
+}